@@ -0,0 +1,382 @@
+#include "AnimationBlender.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+    // Weight of every bone of the block starting at first, 0 for the padding bones
+    void GetBlockWeights(float weight, const float* boneWeights, size_t boneCount, size_t first, float* weights)
+    {
+        const size_t count = std::min(c_blendBlockSize, boneCount - first);
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            weights[k] = k < count ? (boneWeights ? weight * boneWeights[first + k] : weight) : 0.0f;
+        }
+    }
+
+    void Normalize(float (*q)[c_blendBlockSize])
+    {
+        float length[c_blendBlockSize] = {};
+        for (int c = 0; c < 4; c++)
+        {
+            for (size_t k = 0; k < c_blendBlockSize; k++)
+            {
+                length[k] += q[c][k] * q[c][k];
+            }
+        }
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            length[k] = length[k] > 0.0f ? 1.0f / std::sqrt(length[k]) : 0.0f;
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            for (size_t k = 0; k < c_blendBlockSize; k++)
+            {
+                q[c][k] *= length[k];
+            }
+        }
+    }
+}
+
+BlendPose::BlendPose(size_t boneCount) :
+    boneCount_(boneCount),
+    boneStride_((boneCount + c_blendBlockSize - 1) / c_blendBlockSize * c_blendBlockSize),
+    streams_(boneStride_ * BakedStreamCount, 0.0f)
+{
+}
+
+void BlendPose::Load(const BoneTransform* transforms)
+{
+    for (size_t i = 0; i < boneCount_; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            streams_[(BakedPositionX + c) * boneStride_ + i] = transforms[i].position[c];
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            streams_[(BakedOrientationX + c) * boneStride_ + i] = transforms[i].orientation[c];
+        }
+    }
+}
+
+void BlendPose::Store(BoneTransform* transforms) const
+{
+    for (size_t i = 0; i < boneCount_; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            transforms[i].position[c] = streams_[(BakedPositionX + c) * boneStride_ + i];
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            transforms[i].orientation[c] = streams_[(BakedOrientationX + c) * boneStride_ + i];
+        }
+    }
+}
+
+void BlendPoses(const BlendPose& a, const BlendPose& b, float weight, const float* boneWeights, BlendPose& out)
+{
+    const size_t boneCount = out.GetBoneCount();
+    for (size_t first = 0; first < boneCount; first += c_blendBlockSize)
+    {
+        float w[c_blendBlockSize];
+        GetBlockWeights(weight, boneWeights, boneCount, first, w);
+        for (int c = BakedPositionX; c <= BakedPositionZ; c++)
+        {
+            const float* pa = a.GetStream(static_cast<BakedStream>(c)) + first;
+            const float* pb = b.GetStream(static_cast<BakedStream>(c)) + first;
+            float* po = out.GetStream(static_cast<BakedStream>(c)) + first;
+            for (size_t k = 0; k < c_blendBlockSize; k++)
+            {
+                po[k] = pa[k] + w[k] * (pb[k] - pa[k]);
+            }
+        }
+
+        // Normalized lerp, b flipped onto a's side of the hypersphere
+        const float* qa[4];
+        const float* qb[4];
+        for (int c = 0; c < 4; c++)
+        {
+            qa[c] = a.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first;
+            qb[c] = b.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first;
+        }
+        float sign[c_blendBlockSize];
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            const float d = qa[0][k] * qb[0][k] + qa[1][k] * qb[1][k] + qa[2][k] * qb[2][k] + qa[3][k] * qb[3][k];
+            sign[k] = d < 0.0f ? -1.0f : 1.0f;
+        }
+        float q[4][c_blendBlockSize];
+        for (int c = 0; c < 4; c++)
+        {
+            for (size_t k = 0; k < c_blendBlockSize; k++)
+            {
+                q[c][k] = qa[c][k] + w[k] * (sign[k] * qb[c][k] - qa[c][k]);
+            }
+        }
+        Normalize(q);
+        for (int c = 0; c < 4; c++)
+        {
+            std::copy_n(q[c], c_blendBlockSize, out.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first);
+        }
+    }
+}
+
+void AddPoses(const BlendPose& base, const BlendPose& pose, const BlendPose& reference, float weight, const float* boneWeights,
+    BlendPose& out)
+{
+    const size_t boneCount = out.GetBoneCount();
+    for (size_t first = 0; first < boneCount; first += c_blendBlockSize)
+    {
+        float w[c_blendBlockSize];
+        GetBlockWeights(weight, boneWeights, boneCount, first, w);
+        for (int c = BakedPositionX; c <= BakedPositionZ; c++)
+        {
+            const float* pb = base.GetStream(static_cast<BakedStream>(c)) + first;
+            const float* pp = pose.GetStream(static_cast<BakedStream>(c)) + first;
+            const float* pr = reference.GetStream(static_cast<BakedStream>(c)) + first;
+            float* po = out.GetStream(static_cast<BakedStream>(c)) + first;
+            for (size_t k = 0; k < c_blendBlockSize; k++)
+            {
+                po[k] = pb[k] + w[k] * (pp[k] - pr[k]);
+            }
+        }
+
+        const float* b[4];
+        const float* p[4];
+        const float* r[4];
+        for (int c = 0; c < 4; c++)
+        {
+            b[c] = base.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first;
+            p[c] = pose.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first;
+            r[c] = reference.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first;
+        }
+
+        // Rotation from the reference to the pose, the conjugate of r times p, taken the shorter way
+        float d[4][c_blendBlockSize];
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            d[0][k] = r[3][k] * p[0][k] - r[0][k] * p[3][k] - r[1][k] * p[2][k] + r[2][k] * p[1][k];
+            d[1][k] = r[3][k] * p[1][k] - r[1][k] * p[3][k] - r[2][k] * p[0][k] + r[0][k] * p[2][k];
+            d[2][k] = r[3][k] * p[2][k] - r[2][k] * p[3][k] - r[0][k] * p[1][k] + r[1][k] * p[0][k];
+            d[3][k] = r[3][k] * p[3][k] + r[0][k] * p[0][k] + r[1][k] * p[1][k] + r[2][k] * p[2][k];
+        }
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            const float sign = d[3][k] < 0.0f ? -1.0f : 1.0f;
+            d[0][k] *= sign * w[k];
+            d[1][k] *= sign * w[k];
+            d[2][k] *= sign * w[k];
+            d[3][k] = 1.0f + w[k] * (sign * d[3][k] - 1.0f);
+        }
+        Normalize(d);
+
+        // Applied in the bone's own space, after the base rotation
+        float q[4][c_blendBlockSize];
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            q[0][k] = b[3][k] * d[0][k] + b[0][k] * d[3][k] + b[1][k] * d[2][k] - b[2][k] * d[1][k];
+            q[1][k] = b[3][k] * d[1][k] + b[1][k] * d[3][k] + b[2][k] * d[0][k] - b[0][k] * d[2][k];
+            q[2][k] = b[3][k] * d[2][k] + b[2][k] * d[3][k] + b[0][k] * d[1][k] - b[1][k] * d[0][k];
+            q[3][k] = b[3][k] * d[3][k] - b[0][k] * d[0][k] - b[1][k] * d[1][k] - b[2][k] * d[2][k];
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            std::copy_n(q[c], c_blendBlockSize, out.GetStream(static_cast<BakedStream>(BakedOrientationX + c)) + first);
+        }
+    }
+}
+
+std::vector<float> MakeBoneMask(const BoneHierarchy& hierarchy, uint32_t root, float weight)
+{
+    std::vector<float> mask(hierarchy.GetBoneCount(), 0.0f);
+    if (root >= hierarchy.GetBoneCount())
+    {
+        throw std::runtime_error("MakeBoneMask");
+    }
+
+    // Depth first through the child and sibling links, the siblings of root left out
+    std::vector<uint32_t> pending = { root };
+    while (!pending.empty())
+    {
+        const uint32_t bone = pending.back();
+        pending.pop_back();
+        mask[bone] = weight;
+        if (bone != root && hierarchy.GetNextSibling(bone) != c_noBone)
+        {
+            pending.push_back(hierarchy.GetNextSibling(bone));
+        }
+        if (hierarchy.GetFirstChild(bone) != c_noBone)
+        {
+            pending.push_back(hierarchy.GetFirstChild(bone));
+        }
+    }
+    return mask;
+}
+
+void AnimationBlender::Play(int animIdx)
+{
+    tracks_.assign(1, { animIdx, 0.0f, 1.0f, 1.0f });
+    fadeTime_ = fadeDuration_ = 0.0f;
+}
+
+void AnimationBlender::CrossFade(int animIdx, float duration)
+{
+    if (duration <= 0.0f || GetAnimIdx() < 0)
+    {
+        Play(animIdx);
+        return;
+    }
+
+    // The tracks playing now keep their share of the pose and fade out together
+    for (Track& track : tracks_)
+    {
+        track.fadeWeight = track.weight;
+    }
+    if (tracks_.size() == c_maxBaseTracks)
+    {
+        const float remaining = 1.0f - tracks_.front().fadeWeight;
+        tracks_.erase(tracks_.begin());
+        for (Track& track : tracks_)
+        {
+            track.fadeWeight = remaining > 0.0f ? track.fadeWeight / remaining : 1.0f / static_cast<float>(tracks_.size());
+        }
+    }
+    tracks_.push_back({ animIdx, 0.0f, 0.0f, 0.0f });
+    fadeTime_ = 0.0f;
+    fadeDuration_ = duration;
+    UpdateFade();
+}
+
+void AnimationBlender::Update(float elapsedTime)
+{
+    for (Track& track : tracks_)
+    {
+        track.animTime += elapsedTime;
+    }
+    for (LayerState& state : layers_)
+    {
+        state.layer.animTime += elapsedTime * state.layer.speed;
+    }
+    if (IsFading())
+    {
+        fadeTime_ += elapsedTime;
+        UpdateFade();
+    }
+}
+
+bool AnimationBlender::Evaluate(const std::vector<BakedClip>& clips, const AnimationPose& pose, BoneTransform* out)
+{
+    const auto isPlayable = [&](int animIdx) { return animIdx >= 0 && static_cast<size_t>(animIdx) < clips.size(); };
+    if (!isPlayable(GetAnimIdx()))
+    {
+        return false;
+    }
+    const bool layered = std::any_of(layers_.begin(), layers_.end(),
+        [&](const LayerState& state) { return state.layer.weight > 0.0f && isPlayable(state.layer.animIdx); });
+    if (!IsFading() && !layered)
+    {
+        clips[GetAnimIdx()].Sample(GetAnimTime(), out);
+        return true;
+    }
+
+    // Base tracks fold into the result one at a time, each weighted against the tracks already in
+    const size_t boneCount = pose.GetBoneCount();
+    PrepareScratch(boneCount);
+    float total = 0.0f;
+    for (size_t i = 0; i < tracks_.size(); i++)
+    {
+        const Track& track = tracks_[i];
+        BlendPose& target = i == 0 ? result_ : scratch_;
+        if (isPlayable(track.animIdx))
+        {
+            target.Sample(clips[track.animIdx], track.animTime);
+        }
+        else
+        {
+            target.Load(pose.GetBindTransforms());
+        }
+        total += track.weight;
+        if (i > 0)
+        {
+            BlendPoses(result_, scratch_, total > 0.0f ? track.weight / total : 0.0f, nullptr, result_);
+        }
+    }
+
+    for (LayerState& state : layers_)
+    {
+        const BlendLayer& layer = state.layer;
+        if (layer.weight <= 0.0f || !isPlayable(layer.animIdx))
+        {
+            continue;
+        }
+        if (!layer.boneWeights.empty() && layer.boneWeights.size() < boneCount)
+        {
+            throw std::runtime_error("AnimationBlender");
+        }
+        const float* boneWeights = layer.boneWeights.empty() ? nullptr : layer.boneWeights.data();
+        const BakedClip& clip = clips[layer.animIdx];
+        scratch_.Sample(clip, layer.animTime);
+        if (layer.mode == BlendMode::Additive)
+        {
+            if (state.referenceIdx != layer.animIdx || state.reference.GetBoneCount() != boneCount)
+            {
+                state.reference = BlendPose(boneCount);
+                state.reference.Sample(clip, 0.0f);
+                state.referenceIdx = layer.animIdx;
+            }
+            AddPoses(result_, scratch_, state.reference, layer.weight, boneWeights, result_);
+        }
+        else
+        {
+            BlendPoses(result_, scratch_, layer.weight, boneWeights, result_);
+        }
+    }
+    result_.Store(out);
+    return true;
+}
+
+size_t AnimationBlender::AddLayer(const BlendLayer& layer)
+{
+    LayerState state;
+    state.layer = layer;
+    layers_.push_back(std::move(state));
+    return layers_.size() - 1;
+}
+
+void AnimationBlender::RemoveLayer(size_t index)
+{
+    if (index >= layers_.size())
+    {
+        throw std::runtime_error("AnimationBlender");
+    }
+    layers_.erase(layers_.begin() + index);
+}
+
+void AnimationBlender::UpdateFade()
+{
+    const float progress = std::min(fadeTime_ / fadeDuration_, 1.0f);
+    if (progress >= 1.0f)
+    {
+        tracks_.erase(tracks_.begin(), tracks_.end() - 1);
+        tracks_.back().weight = 1.0f;
+        return;
+    }
+    for (size_t i = 0; i + 1 < tracks_.size(); i++)
+    {
+        tracks_[i].weight = tracks_[i].fadeWeight * (1.0f - progress);
+    }
+    tracks_.back().weight = progress;
+}
+
+void AnimationBlender::PrepareScratch(size_t boneCount)
+{
+    if (result_.GetBoneCount() != boneCount)
+    {
+        result_ = BlendPose(boneCount);
+        scratch_ = BlendPose(boneCount);
+    }
+}
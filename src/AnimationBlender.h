@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnimationPose.h"
+#include "BakedClip.h"
+
+// Local transforms of a skeleton in structure-of-arrays form, one stream per BakedStream, each padded to a
+// multiple of c_blendBlockSize bones so the blend loops run over whole blocks and vectorize.
+class BlendPose {
+
+public:
+
+    BlendPose() = default;
+    explicit BlendPose(size_t boneCount);
+    void Sample(const BakedClip& clip, float msec)      { clip.Sample(msec, streams_.data(), boneStride_); }
+    void Load(const BoneTransform* transforms);
+    void Store(BoneTransform* transforms) const;
+
+    size_t GetBoneCount()                       const   { return boneCount_; }
+    size_t GetBoneStride()                      const   { return boneStride_; }
+    float* GetStream(BakedStream stream)                { return &streams_[stream * boneStride_]; }
+    const float* GetStream(BakedStream stream)  const   { return &streams_[stream * boneStride_]; }
+
+private:
+
+    size_t boneCount_ = 0;
+    size_t boneStride_ = 0;
+    std::vector<float> streams_;
+};
+
+// Blends b over a by weight, scaled per bone by boneWeights when given: positions are lerped, orientations
+// take the shorter way and get renormalized. out may be a or b
+void BlendPoses(const BlendPose& a, const BlendPose& b, float weight, const float* boneWeights, BlendPose& out);
+// Adds to base the difference between pose and reference, scaled by weight and boneWeights: positions are
+// offset, orientations turned by the rotation from reference to pose. out may be base
+void AddPoses(const BlendPose& base, const BlendPose& pose, const BlendPose& reference, float weight, const float* boneWeights,
+    BlendPose& out);
+
+// Weights of every bone under root, root included, weight for those and 0 for the others
+std::vector<float> MakeBoneMask(const BoneHierarchy& hierarchy, uint32_t root, float weight = 1.0f);
+
+enum class BlendMode {
+    Override,       // Blends the layer's pose over what lies beneath
+    Additive,       // Adds the layer's motion relative to its action's first sample
+};
+
+// An action played on top of the base tracks
+struct BlendLayer {
+    int animIdx = 0;
+    float animTime = 0.0f;
+    float speed = 1.0f;
+    float weight = 1.0f;
+    BlendMode mode = BlendMode::Override;
+    std::vector<float> boneWeights;     // Per-bone scale of the weight, empty for the whole skeleton
+};
+
+// Plays actions through a small blend tree: the base tracks, crossfading from one action into the next,
+// then layers applied in order, overriding or adding to the result of those below.
+// Every track and layer samples its action into a BlendPose and the blends run over whole bone arrays.
+// With a single base track and no weighted layer, evaluation samples straight into the output and matches
+// playing the action alone.
+class AnimationBlender {
+
+public:
+
+    // Switches the base to an action from its start, without blending
+    void Play(int animIdx);
+    // Fades the base from what it plays now into an action from its start, over duration milliseconds.
+    // A fade started before the previous one ends keeps its tracks, scaled down, up to c_maxBaseTracks
+    void CrossFade(int animIdx, float duration);
+    void Update(float elapsedTime);
+    // Writes the pose of every bone, returns false when the base plays no action of clips
+    bool Evaluate(const std::vector<BakedClip>& clips, const AnimationPose& pose, BoneTransform* out);
+
+    size_t AddLayer(const BlendLayer& layer);
+    void RemoveLayer(size_t index);
+    size_t GetLayerCount()                      const   { return layers_.size(); }
+    BlendLayer& GetLayer(size_t index)                  { return layers_[index].layer; }
+
+    int GetAnimIdx()                            const   { return tracks_.empty() ? -1 : tracks_.back().animIdx; }
+    float GetAnimTime()                         const   { return tracks_.empty() ? 0.0f : tracks_.back().animTime; }
+    bool IsFading()                             const   { return tracks_.size() > 1; }
+
+    static constexpr size_t c_maxBaseTracks = 4;
+
+private:
+
+    struct Track {
+        int animIdx;
+        float animTime;
+        float weight;           // Base tracks always add up to 1
+        float fadeWeight;       // Weight when the current fade started
+    };
+
+    struct LayerState {
+        BlendLayer layer;
+        BlendPose reference;    // First sample of an additive layer's action
+        int referenceIdx = -1;  // Action the reference was sampled from
+    };
+
+    void UpdateFade();
+    void PrepareScratch(size_t boneCount);
+
+    std::vector<Track> tracks_ = { { 0, 0.0f, 1.0f, 1.0f } };     // Oldest first, the last one fading in
+    std::vector<LayerState> layers_;
+    float fadeTime_ = 0.0f;
+    float fadeDuration_ = 0.0f;
+    BlendPose result_;
+    BlendPose scratch_;
+};
@@ -0,0 +1,54 @@
+#include "AnimationLod.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+float EstimateScreenSize(float radius, float depth, float projScaleY)
+{
+    // Half the screen height spans depth / projScaleY at that depth
+    return radius * projScaleY / std::max(depth, radius);
+}
+
+AnimationLod::AnimationLod(const AnimationLodSettings& settings) :
+    settings_(settings)
+{
+    if (settings_.maxInterval == 0 || (settings_.maxInterval & (settings_.maxInterval - 1)) != 0)
+    {
+        throw std::runtime_error("AnimationLod");
+    }
+}
+
+void AnimationLod::Schedule(const float* priorities, size_t count)
+{
+    intervals_.assign(count, settings_.maxInterval);
+    if (ranking_.size() != count)
+    {
+        ranking_.resize(count);
+        std::iota(ranking_.begin(), ranking_.end(), 0);
+    }
+    // Sorting the previous ranking stably keeps tied models in the order they had, so equal priorities do not
+    // reshuffle who gets updated from frame to frame. The sort still costs n log n, a ranking nearly in order is no cheaper
+    std::stable_sort(ranking_.begin(), ranking_.end(), [&](uint32_t a, uint32_t b) { return priorities[a] > priorities[b]; });
+
+    // Every model costs 1 / interval updates per frame, the least it can cost is already spent
+    const float minCost = 1.0f / static_cast<float>(settings_.maxInterval);
+    float budget = static_cast<float>(settings_.updateBudget) - minCost * static_cast<float>(count);
+    for (uint32_t model : ranking_)
+    {
+        if (budget <= 0.0f || priorities[model] <= 0.0f)
+        {
+            break;
+        }
+        for (uint32_t interval = 1; interval < settings_.maxInterval; interval *= 2)
+        {
+            const float extraCost = 1.0f / static_cast<float>(interval) - minCost;
+            if (extraCost <= budget)
+            {
+                intervals_[model] = interval;
+                budget -= extraCost;
+                break;
+            }
+        }
+    }
+}
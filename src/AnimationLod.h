@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AnimationLodSettings {
+    size_t updateBudget = 100;      // Model updates per frame, on average, spread over all the models
+    uint32_t maxInterval = 8;       // Frames between two updates of the least important models, a power of two
+    bool interpolate = true;        // Blends between the last two updates of models not updated every frame
+};
+
+// Fraction of the screen height covered by a sphere of radius at depth in front of the camera, with projScaleY
+// the vertical scale of the projection matrix. The sphere is assumed seen from outside
+float EstimateScreenSize(float radius, float depth, float projScaleY);
+
+// Picks how often each of a set of animated models is updated so that, on average, a budget of them are per frame.
+// Models are ranked by priority, usually how large they show on screen. In that order each one is updated every
+// frame, or every 2, 4... frames, as often as the budget left allows once every model below it is counted at
+// maxInterval. A model with a priority of 0, offscreen, always waits maxInterval frames.
+// A model updated every n frames is due when the frame count plus its index is a multiple of n, which spreads the
+// models of one interval over its frames and keeps the updates of each frame close to the budget.
+class AnimationLod {
+
+public:
+
+    AnimationLod() = default;
+    explicit AnimationLod(const AnimationLodSettings& settings);
+    // Sets the intervals of count models from their priorities
+    void Schedule(const float* priorities, size_t count);
+    void NextFrame()                                    { frame_++; }
+
+    bool IsDue(size_t model)                    const   { return (frame_ + model) % intervals_[model] == 0; }
+    uint32_t GetInterval(size_t model)          const   { return intervals_[model]; }
+    uint64_t GetFrame()                         const   { return frame_; }
+    size_t GetModelCount()                      const   { return intervals_.size(); }
+    const AnimationLodSettings& GetSettings()   const   { return settings_; }
+
+private:
+
+    AnimationLodSettings settings_;
+    uint64_t frame_ = 0;
+    std::vector<uint32_t> intervals_;
+    std::vector<uint32_t> ranking_;     // Model indices by decreasing priority, kept from one schedule to the next
+};
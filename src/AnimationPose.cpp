@@ -0,0 +1,170 @@
+#include "AnimationPose.h"
+#include "AssetCache.h"
+#include "ForwardKinematics.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr float c_matrixEpsilon = 1e-7f;    // M3D_EPSILON
+
+    float FlushToZero(float value)
+    {
+        return value > -c_matrixEpsilon && value < c_matrixEpsilon ? 0.0f : value;
+    }
+
+    // M3D's fast inverse square root
+    float ReciprocalSqrt(float x)
+    {
+        const float half = x * 0.5f;
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits = 0x5f3759df - (bits >> 1);
+        memcpy(&x, &bits, sizeof(x));
+        return x * (1.5f - (half * x * x));
+    }
+}
+
+void LerpBonePosition(const BoneTransform& from, const BoneTransform& to, float t, BoneTransform& out)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        out.position[i] = from.position[i] + t * (to.position[i] - from.position[i]);
+    }
+}
+
+void NlerpBoneOrientation(const BoneTransform& from, const BoneTransform& to, float t, BoneTransform& out)
+{
+    const float* p = from.orientation;
+    const float* f = to.orientation;
+    float d = p[3] * f[3] + p[0] * f[0] + p[1] * f[1] + p[2] * f[2];
+    float s = 1.0f;
+    if (d < 0)
+    {
+        d = -d;
+        s = -1.0f;
+    }
+
+    // Approximated NLERP, the blend factor is corrected for the angle between the quaternions
+    const float c = t - 0.5f;
+    t += t * c * (t - 1.0f) * ((1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f))) * c * c +
+        (0.848013f + d * (-1.06021f + d * 0.215638f)));
+    float q[4];
+    for (int i = 0; i < 4; i++)
+    {
+        q[i] = p[i] + t * (s * f[i] - p[i]);
+    }
+    d = ReciprocalSqrt(q[3] * q[3] + q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+    for (int i = 0; i < 4; i++)
+    {
+        out.orientation[i] = q[i] * d;
+    }
+}
+
+void ComposeBoneMatrix(const BoneTransform& transform, float* out)
+{
+    const float x = transform.orientation[0];
+    const float y = transform.orientation[1];
+    const float z = transform.orientation[2];
+    const float w = transform.orientation[3];
+    if (x == 0.0f && y == 0.0f && z >= 0.7071065f && z <= 0.7071075f && w == 0.0f)
+    {
+        out[1] = out[2] = out[4] = out[6] = out[8] = out[9] = 0.0f;
+        out[0] = out[5] = out[10] = -1.0f;
+    }
+    else
+    {
+        out[0] = FlushToZero(1 - 2 * (y * y + z * z));
+        out[1] = FlushToZero(2 * (x * y - z * w));
+        out[2] = FlushToZero(2 * (x * z + y * w));
+        out[4] = FlushToZero(2 * (x * y + z * w));
+        out[5] = FlushToZero(1 - 2 * (x * x + z * z));
+        out[6] = FlushToZero(2 * (y * z - x * w));
+        out[8] = FlushToZero(2 * (x * z - y * w));
+        out[9] = FlushToZero(2 * (y * z + x * w));
+        out[10] = FlushToZero(1 - 2 * (x * x + y * y));
+    }
+    out[3] = transform.position[0];
+    out[7] = transform.position[1];
+    out[11] = transform.position[2];
+    out[12] = 0.0f;
+    out[13] = 0.0f;
+    out[14] = 0.0f;
+    out[15] = 1.0f;
+}
+
+void MultiplyBoneMatrices(const float* parent, const float* local, float* out)
+{
+    for (int r = 0; r < 4; r++)
+    {
+        const float* row = parent + r * 4;
+        for (int c = 0; c < 4; c++)
+        {
+            out[r * 4 + c] = local[c] * row[0] + local[4 + c] * row[1] + local[8 + c] * row[2] + local[12 + c] * row[3];
+        }
+    }
+}
+
+AnimationPose::AnimationPose(const m3d_t* model)
+{
+    const size_t boneCount = model->numbone;
+    std::vector<uint32_t> parents(boneCount);
+    bindTransforms_.resize(boneCount);
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        const m3db_t& bone = model->bone[i];
+        if (bone.parent != M3D_UNDEF && bone.parent >= i)
+        {
+            throw std::runtime_error("AnimationPose");
+        }
+        parents[i] = bone.parent == M3D_UNDEF ? c_rootBone : bone.parent;
+
+        const m3dv_t& pos = model->vertex[bone.pos];
+        const m3dv_t& ori = model->vertex[bone.ori];
+        bindTransforms_[i] = { { pos.x, pos.y, pos.z }, { ori.x, ori.y, ori.z, ori.w } };
+    }
+    hierarchy_ = BoneHierarchy(parents.data(), boneCount);
+    localTransforms_ = bindTransforms_;
+    boneMatrices_.resize(boneCount * c_boneMatrixSize);
+    UpdateBoneMatrices();
+}
+
+AnimationPose::AnimationPose(CacheReader& reader)
+{
+    std::vector<uint32_t> parents;
+    reader.Read(parents);
+    reader.Read(bindTransforms_);
+    const size_t boneCount = parents.size();
+    if (bindTransforms_.size() != boneCount)
+    {
+        throw std::runtime_error("AnimationPose");
+    }
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        if (parents[i] != c_rootBone && parents[i] >= i)
+        {
+            throw std::runtime_error("AnimationPose");
+        }
+    }
+    hierarchy_ = BoneHierarchy(parents.data(), boneCount);
+    localTransforms_ = bindTransforms_;
+    boneMatrices_.resize(boneCount * c_boneMatrixSize);
+    UpdateBoneMatrices();
+}
+
+void AnimationPose::Save(CacheWriter& writer) const
+{
+    writer.WriteArray(hierarchy_.GetParents(), hierarchy_.GetBoneCount());
+    writer.Write(bindTransforms_);
+}
+
+void AnimationPose::ResetToBindPose()
+{
+    localTransforms_ = bindTransforms_;
+}
+
+void AnimationPose::UpdateBoneMatrices()
+{
+    ComputeBoneMatrices(kernelLevel_, hierarchy_, localTransforms_.data(), boneMatrices_.data());
+}
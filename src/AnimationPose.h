@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "m3d/m3d.h"
+#include "BoneHierarchy.h"
+#include "SkinningKernel.h"
+
+class CacheReader;
+class CacheWriter;
+
+constexpr size_t c_boneMatrixSize = 16;         // Row-major 4x4 matrix transforming column vectors, as in M3D
+
+// Bone-local transform, the orientation is a quaternion stored x, y, z, w
+struct BoneTransform {
+    float position[3];
+    float orientation[4];
+};
+
+// The blend and matrix helpers reproduce M3D's own pose code operation for operation,
+// so poses built from them match m3d_pose to the bit.
+void LerpBonePosition(const BoneTransform& from, const BoneTransform& to, float t, BoneTransform& out);
+void NlerpBoneOrientation(const BoneTransform& from, const BoneTransform& to, float t, BoneTransform& out);
+void ComposeBoneMatrix(const BoneTransform& transform, float* out);
+void MultiplyBoneMatrices(const float* parent, const float* local, float* out);
+
+// Local transforms of every bone of a skeleton and the model-space matrices they resolve to.
+// The hierarchy and bind transforms are copied out of the model, parents come before their children.
+// Matrices are resolved with the widest forward kinematics kernel the CPU supports unless told otherwise.
+class AnimationPose {
+
+public:
+
+    AnimationPose() = default;
+    explicit AnimationPose(const m3d_t* model);
+    explicit AnimationPose(CacheReader& reader);
+    void Save(CacheWriter& writer) const;
+    void ResetToBindPose();
+    void UpdateBoneMatrices();
+
+    size_t GetBoneCount()                       const   { return hierarchy_.GetBoneCount(); }
+    const uint32_t* GetParents()                const   { return hierarchy_.GetParents(); }
+    const BoneHierarchy& GetHierarchy()         const   { return hierarchy_; }
+    const BoneTransform* GetBindTransforms()    const   { return bindTransforms_.data(); }
+    BoneTransform* GetLocalTransforms()                 { return localTransforms_.data(); }
+    const BoneTransform* GetLocalTransforms()   const   { return localTransforms_.data(); }
+    const float* GetBoneMatrices()              const   { return boneMatrices_.data(); }
+    SkinKernelLevel GetKernelLevel()            const   { return kernelLevel_; }
+    void SetKernelLevel(SkinKernelLevel level)          { kernelLevel_ = level; }
+
+private:
+
+    BoneHierarchy hierarchy_;
+    std::vector<BoneTransform> bindTransforms_;
+    std::vector<BoneTransform> localTransforms_;
+    std::vector<float> boneMatrices_;           // c_boneMatrixSize floats per bone, in model space
+    SkinKernelLevel kernelLevel_ = DetectSkinKernelLevel();
+};
@@ -0,0 +1,178 @@
+#include "AssetCache.h"
+#include "M3dAsset.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+    constexpr char c_cacheMagic[8] = { 'M', '3', 'D', 'C', 'A', 'C', 'H', 'E' };
+    constexpr uint32_t c_byteOrderMark = 0x01020304;
+
+    constexpr uint64_t c_hashPrime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t c_hashPrime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr size_t c_hashLanes = 4;
+
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;     // Caches are only read back on machines of the same endianness
+        uint64_t key;
+    };
+
+    uint64_t RotateLeft(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t HashRound(uint64_t lane, uint64_t word)
+    {
+        return RotateLeft(lane + word * c_hashPrime2, 31) * c_hashPrime1;
+    }
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t lanes[c_hashLanes] = { seed + c_hashPrime1 + c_hashPrime2, seed + c_hashPrime2, seed, seed - c_hashPrime1 };
+    size_t position = 0;
+    for (; position + c_hashLanes * sizeof(uint64_t) <= size; position += c_hashLanes * sizeof(uint64_t))
+    {
+        for (size_t l = 0; l < c_hashLanes; l++)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + position + l * sizeof(uint64_t), sizeof(word));
+            lanes[l] = HashRound(lanes[l], word);
+        }
+    }
+
+    uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18) + size;
+    for (; position < size; position++)
+    {
+        hash = HashRound(hash, bytes[position]);
+    }
+
+    // Final avalanche, so every input bit reaches every output bit
+    hash ^= hash >> 33;
+    hash *= c_hashPrime2;
+    hash ^= hash >> 29;
+    hash *= c_hashPrime1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void CacheWriter::Write(const std::vector<std::string>& values)
+{
+    Write(static_cast<uint64_t>(values.size()));
+    for (const std::string& value : values)
+    {
+        Write(value);
+    }
+}
+
+void CacheWriter::Append(const void* data, size_t size)
+{
+    const size_t position = data_.size();
+    data_.resize(position + size);
+    if (size > 0)
+    {
+        memcpy(&data_[position], data, size);
+    }
+}
+
+void CacheReader::Read(std::string& value)
+{
+    size_t length;
+    const char* data = ReadArray<char>(length);
+    value.assign(data, length);
+}
+
+void CacheReader::Read(std::vector<std::string>& values)
+{
+    uint64_t count;
+    Read(count);
+    if (count > size_ - position_)
+    {
+        throw std::runtime_error("CacheReader");
+    }
+    values.resize(static_cast<size_t>(count));
+    for (std::string& value : values)
+    {
+        Read(value);
+    }
+}
+
+const unsigned char* CacheReader::Take(size_t size)
+{
+    if (position_ > size_ || size > size_ - position_)
+    {
+        throw std::runtime_error("CacheReader");
+    }
+    const unsigned char* data = data_ + position_;
+    position_ += size;
+    return data;
+}
+
+std::filesystem::path GetAssetCachePath(const std::filesystem::path& modelPath)
+{
+    std::filesystem::path cachePath = modelPath;
+    cachePath += "c";
+    return cachePath;
+}
+
+bool ReadAssetCache(const std::filesystem::path& path, uint64_t key, M3dAsset& asset)
+{
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+    {
+        return false;
+    }
+
+    // A cache that is stale, of another version or damaged is the same as no cache at all
+    try
+    {
+        const MappedFile file(path);
+        CacheReader reader(file.GetData(), file.GetSize());
+        CacheHeader header;
+        reader.Read(header);
+        if (memcmp(header.magic, c_cacheMagic, sizeof(c_cacheMagic)) || header.version != c_assetCacheVersion ||
+            header.byteOrder != c_byteOrderMark || header.key != key)
+        {
+            return false;
+        }
+        asset = M3dAsset(reader);
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+void WriteAssetCache(const std::filesystem::path& path, uint64_t key, const M3dAsset& asset)
+{
+    CacheWriter writer;
+    CacheHeader header = {};
+    memcpy(header.magic, c_cacheMagic, sizeof(c_cacheMagic));
+    header.version = c_assetCacheVersion;
+    header.byteOrder = c_byteOrderMark;
+    header.key = key;
+    writer.Write(header);
+    asset.Save(writer);
+
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(writer.GetData().data()), static_cast<std::streamsize>(writer.GetData().size()));
+        if (!stream)
+        {
+            stream.close();
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            throw std::runtime_error("AssetCache");
+        }
+    }
+    std::filesystem::rename(temporaryPath, path);
+}
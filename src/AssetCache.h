@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class M3dAsset;
+
+// Bumped whenever anything written by a Save method changes, older caches are then rebuilt
+constexpr uint32_t c_assetCacheVersion = 1;
+constexpr size_t c_cacheAlignment = 64;         // Arrays start on a cache line of the mapped file
+
+// Hash of a block of bytes, read eight bytes at a time in four independent lanes. Not meant to resist
+// collisions crafted on purpose, only to tell apart the contents a cache was built from
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Appends values and arrays to a cache image in memory, in the order a CacheReader takes them back.
+// Arrays are written as their element count followed by their raw bytes, aligned so that a mapped cache
+// could also be used in place.
+class CacheWriter {
+
+public:
+
+    template <typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied byte for byte");
+        Append(&value, sizeof(T));
+    }
+
+    template <typename T, typename Allocator>
+    void Write(const std::vector<T, Allocator>& values)         { WriteArray(values.data(), values.size()); }
+    void Write(const std::string& value)                        { WriteArray(value.data(), value.size()); }
+    void Write(const std::vector<std::string>& values);
+
+    template <typename T>
+    void WriteArray(const T* values, size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied byte for byte");
+        Write(static_cast<uint64_t>(count));
+        Align();
+        Append(values, count * sizeof(T));
+    }
+
+    const std::vector<unsigned char>& GetData() const           { return data_; }
+
+private:
+
+    void Append(const void* data, size_t size);
+    void Align()                                                { data_.resize((data_.size() + c_cacheAlignment - 1) / c_cacheAlignment * c_cacheAlignment); }
+
+    std::vector<unsigned char> data_;
+};
+
+// Takes back what a CacheWriter wrote, out of a mapped cache file. Throws when reading past its end
+class CacheReader {
+
+public:
+
+    CacheReader(const unsigned char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    void Read(T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied byte for byte");
+        memcpy(&value, Take(sizeof(T)), sizeof(T));
+    }
+
+    template <typename T, typename Allocator>
+    void Read(std::vector<T, Allocator>& values)
+    {
+        size_t count;
+        const T* data = ReadArray<T>(count);
+        values.assign(data, data + count);
+    }
+    void Read(std::string& value);
+    void Read(std::vector<std::string>& values);
+
+    // Points into the mapping, valid as long as it is
+    template <typename T>
+    const T* ReadArray(size_t& count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Cached values are copied byte for byte");
+        uint64_t storedCount;
+        Read(storedCount);
+        position_ = (position_ + c_cacheAlignment - 1) / c_cacheAlignment * c_cacheAlignment;
+        if (storedCount > (size_ - std::min(position_, size_)) / sizeof(T))
+        {
+            throw std::runtime_error("CacheReader");
+        }
+        count = static_cast<size_t>(storedCount);
+        return reinterpret_cast<const T*>(Take(count * sizeof(T)));
+    }
+
+private:
+
+    const unsigned char* Take(size_t size);
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
+
+// Built models are cached next to their source file, model.m3d getting model.m3dc. A cache holds the final
+// vertex and index buffers, bone tables, inverse bind matrices and baked actions, so loading it only maps
+// the file and copies its arrays out, without parsing, welding or baking anything.
+// Caches are keyed by a hash of the model contents and of the build options, and a cache of another
+// version or key is ignored, then overwritten by the next build.
+std::filesystem::path GetAssetCachePath(const std::filesystem::path& modelPath);
+// Fills asset and returns true when path holds a cache of this version built under key, returns false otherwise
+bool ReadAssetCache(const std::filesystem::path& path, uint64_t key, M3dAsset& asset);
+// Writes to a temporary file renamed over the cache once complete, so a reader never sees half a cache
+void WriteAssetCache(const std::filesystem::path& path, uint64_t key, const M3dAsset& asset);
@@ -0,0 +1,115 @@
+#include "AssetLoader.h"
+#include "AssetCache.h"
+
+#include <utility>
+
+const char* GetLoadStageName(LoadStage stage)
+{
+    switch (stage)
+    {
+    case LoadStage::Queued:     return "queued";
+    case LoadStage::Cache:      return "cache";
+    case LoadStage::Parse:      return "parse";
+    case LoadStage::Weld:       return "weld";
+    case LoadStage::Skeleton:   return "skeleton";
+    case LoadStage::Store:      return "store";
+    case LoadStage::Ready:      return "ready";
+    case LoadStage::Failed:     return "failed";
+    default:                    return "unknown";
+    }
+}
+
+LoadProgress::LoadProgress() :
+    stageStart_(Clock::now())
+{
+}
+
+void LoadProgress::Begin(LoadStage stage)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point now = Clock::now();
+    milliseconds_[static_cast<size_t>(stage_.load(std::memory_order_relaxed))] +=
+        std::chrono::duration<double, std::milli>(now - stageStart_).count();
+    stageStart_ = now;
+    stage_.store(stage, std::memory_order_release);
+}
+
+double LoadProgress::GetStageMilliseconds(LoadStage stage) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    double milliseconds = milliseconds_[static_cast<size_t>(stage)];
+    if (stage == stage_.load(std::memory_order_relaxed) && stage != LoadStage::Ready && stage != LoadStage::Failed)
+    {
+        milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - stageStart_).count();
+    }
+    return milliseconds;
+}
+
+M3dAsset LoadAsset(const std::filesystem::path& path, const LoadOptions& options, LoadProgress* progress)
+{
+    LoadProgress unreported;
+    if (!progress)
+    {
+        progress = &unreported;
+    }
+
+    progress->Begin(LoadStage::Cache);
+    MappedFile file(path);
+    const std::filesystem::path cachePath = GetAssetCachePath(path);
+    uint64_t key = 0;
+    if (options.cached)
+    {
+        // Models built with other options get caches of their own keys
+        const float buildOptions[3] = { options.weldEpsilon, options.preferShortIndices ? 1.0f : 0.0f, options.animSampleRate };
+        key = HashBytes(buildOptions, sizeof(buildOptions), HashBytes(file.GetData(), file.GetSize()));
+        M3dAsset asset;
+        if (ReadAssetCache(cachePath, key, asset))
+        {
+            progress->Begin(LoadStage::Ready);
+            return asset;
+        }
+    }
+
+    progress->Begin(LoadStage::Parse);
+    M3dAsset asset(std::move(file), options.streamed);
+    progress->Begin(LoadStage::Weld);
+    asset.BuildMesh(options.weldEpsilon, options.preferShortIndices, options.animSampleRate, progress);
+    if (options.cached)
+    {
+        progress->Begin(LoadStage::Store);
+        try
+        {
+            WriteAssetCache(cachePath, key, asset);
+        }
+        catch (const std::exception&)
+        {
+            // A model in a folder that cannot be written to still loads, only without a cache
+        }
+    }
+    progress->Begin(LoadStage::Ready);
+    return asset;
+}
+
+AssetLoad::AssetLoad(std::filesystem::path path, const LoadOptions& options) :
+    progress_(std::make_shared<LoadProgress>())
+{
+    // The progress is shared so that the loading thread never outlives what it writes to
+    std::shared_ptr<LoadProgress> progress = progress_;
+    future_ = std::async(std::launch::async, [progress, path = std::move(path), options]()
+    {
+        try
+        {
+            return LoadAsset(path, options, progress.get());
+        }
+        catch (...)
+        {
+            progress->Begin(LoadStage::Failed);
+            throw;
+        }
+    });
+}
+
+bool AssetLoad::IsReady() const
+{
+    return future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "M3dAsset.h"
+
+// Stages of loading a model, in the order they run
+enum class LoadStage {
+    Queued,
+    Cache,          // Hash the file and look for a cache built from it, read it when there is one
+    Parse,          // Map and parse the file
+    Weld,           // Weld the faces into an indexed mesh
+    Skeleton,       // Bind pose skinning data, pose buffers and baked actions
+    Store,          // Write the cache for the next load
+    Ready,
+    Failed,
+    Count,
+};
+
+const char* GetLoadStageName(LoadStage stage);
+
+struct LoadOptions {
+    float weldEpsilon = 0.0f;
+    bool preferShortIndices = false;
+    float animSampleRate = 0.0f;
+    bool streamed = true;
+    bool cached = true;             // Read the built model from its cache when up to date, write the cache otherwise
+};
+
+// Current stage and per-stage timings of one load, written by the loading thread and read by any other.
+class LoadProgress {
+
+public:
+
+    LoadProgress();
+
+    // Ends the current stage and starts the given one
+    void Begin(LoadStage stage);
+    LoadStage GetStage()                        const   { return stage_.load(std::memory_order_acquire); }
+    // Time spent in a stage, the running one included, 0 for stages not reached
+    double GetStageMilliseconds(LoadStage stage) const;
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex_;
+    std::atomic<LoadStage> stage_{ LoadStage::Queued };
+    Clock::time_point stageStart_;
+    std::array<double, static_cast<size_t>(LoadStage::Count)> milliseconds_ = {};
+};
+
+// Loads and builds a model on the calling thread, reporting each stage to progress when given one
+M3dAsset LoadAsset(const std::filesystem::path& path, const LoadOptions& options = LoadOptions(), LoadProgress* progress = nullptr);
+
+// Future of a model loading in the background.
+// Parsing and building the mesh run on a thread of their own, the owner polls the stage to report progress
+// and takes the asset once it is ready, without ever blocking a frame on it.
+class AssetLoad {
+
+public:
+
+    AssetLoad() = default;
+    AssetLoad(std::filesystem::path path, const LoadOptions& options = LoadOptions());
+
+    bool IsValid()                              const   { return future_.valid(); }
+    bool IsReady()                              const;
+    LoadStage GetStage()                        const   { return progress_->GetStage(); }
+    double GetStageMilliseconds(LoadStage stage) const  { return progress_->GetStageMilliseconds(stage); }
+
+    // Waits for the load to finish and hands the asset over, rethrowing what made it fail. Valid only once
+    M3dAsset Get()                                      { return future_.get(); }
+
+private:
+
+    std::shared_ptr<LoadProgress> progress_;
+    std::future<M3dAsset> future_;
+};
@@ -0,0 +1,208 @@
+#include "BakedClip.h"
+#include "AssetCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+BakedClip::BakedClip(const KeyframeIndex& keyframes, float sampleRate)
+{
+    boneCount_ = keyframes.GetBoneCount();
+    duration_ = static_cast<float>(keyframes.GetDuration());
+
+    // Spread the samples evenly so the last one lands exactly on the loop point
+    float interval = sampleRate > 0.0f ? 1000.0f / sampleRate : duration_;
+    if (sampleRate <= 0.0f)
+    {
+        uint32_t previousTime = 0;
+        for (size_t i = 0; i < keyframes.GetFrameCount(); i++)
+        {
+            const uint32_t frameTime = keyframes.GetFrameTime(i);
+            if (frameTime > previousTime)
+            {
+                interval = std::min(interval, static_cast<float>(frameTime - previousTime));
+                previousTime = frameTime;
+            }
+        }
+    }
+    const size_t segmentCount = duration_ > 0.0f && interval > 0.0f ? std::max<size_t>(1, static_cast<size_t>(std::ceil(duration_ / interval))) : 1;
+    sampleInterval_ = duration_ / segmentCount;
+    sampleCount_ = segmentCount + 1;
+
+    boneStride_ = (boneCount_ + c_blendBlockSize - 1) / c_blendBlockSize * c_blendBlockSize;
+    const size_t sampleSize = boneStride_ * BakedStreamCount;
+    samples_.assign(sampleCount_ * sampleSize, 0.0f);
+    std::vector<BoneTransform> pose(boneCount_);
+    KeyframeCursor cursor;
+    for (size_t s = 0; s < segmentCount; s++)
+    {
+        keyframes.Sample(static_cast<uint32_t>(s * sampleInterval_ + 0.5f), cursor, pose.data());
+        float* sample = &samples_[s * sampleSize];
+        for (size_t i = 0; i < boneCount_; i++)
+        {
+            sample[BakedPositionX * boneStride_ + i] = pose[i].position[0];
+            sample[BakedPositionY * boneStride_ + i] = pose[i].position[1];
+            sample[BakedPositionZ * boneStride_ + i] = pose[i].position[2];
+            sample[BakedOrientationX * boneStride_ + i] = pose[i].orientation[0];
+            sample[BakedOrientationY * boneStride_ + i] = pose[i].orientation[1];
+            sample[BakedOrientationZ * boneStride_ + i] = pose[i].orientation[2];
+            sample[BakedOrientationW * boneStride_ + i] = pose[i].orientation[3];
+        }
+    }
+    std::copy_n(samples_.begin(), sampleSize, samples_.begin() + segmentCount * sampleSize);
+}
+
+BakedClip::BakedClip(CacheReader& reader)
+{
+    uint64_t sampleCount;
+    uint64_t boneCount;
+    reader.Read(duration_);
+    reader.Read(sampleInterval_);
+    reader.Read(sampleCount);
+    reader.Read(boneCount);
+    reader.Read(samples_);
+    sampleCount_ = static_cast<size_t>(sampleCount);
+    boneCount_ = static_cast<size_t>(boneCount);
+    boneStride_ = (boneCount_ + c_blendBlockSize - 1) / c_blendBlockSize * c_blendBlockSize;
+    if (sampleCount_ < 2 || samples_.size() / BakedStreamCount / sampleCount_ != boneStride_ ||
+        samples_.size() != sampleCount_ * boneStride_ * BakedStreamCount)
+    {
+        throw std::runtime_error("BakedClip");
+    }
+}
+
+void BakedClip::Save(CacheWriter& writer) const
+{
+    writer.Write(duration_);
+    writer.Write(sampleInterval_);
+    writer.Write(static_cast<uint64_t>(sampleCount_));
+    writer.Write(static_cast<uint64_t>(boneCount_));
+    writer.Write(samples_);
+}
+
+void BakedClip::Sample(float msec, BoneTransform* out) const
+{
+    float t;
+    const float* from;
+    const float* to;
+    if (!FindSamples(msec, from, to, t))
+    {
+        return;
+    }
+
+    for (size_t first = 0; first < boneCount_; first += c_blendBlockSize)
+    {
+        float blended[BakedStreamCount][c_blendBlockSize];
+        BlendBlock(from, to, t, first, blended);
+        const size_t count = std::min(c_blendBlockSize, boneCount_ - first);
+        for (size_t k = 0; k < count; k++)
+        {
+            BoneTransform& transform = out[first + k];
+            for (int c = 0; c < 3; c++)
+            {
+                transform.position[c] = blended[BakedPositionX + c][k];
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                transform.orientation[c] = blended[BakedOrientationX + c][k];
+            }
+        }
+    }
+}
+
+void BakedClip::Sample(float msec, float* streams, size_t streamStride) const
+{
+    float t;
+    const float* from;
+    const float* to;
+    if (!FindSamples(msec, from, to, t))
+    {
+        return;
+    }
+
+    for (size_t first = 0; first < boneCount_; first += c_blendBlockSize)
+    {
+        float blended[BakedStreamCount][c_blendBlockSize];
+        BlendBlock(from, to, t, first, blended);
+        for (int c = 0; c < BakedStreamCount; c++)
+        {
+            std::copy_n(blended[c], c_blendBlockSize, streams + c * streamStride + first);
+        }
+    }
+}
+
+bool BakedClip::FindSamples(float msec, const float*& from, const float*& to, float& t) const
+{
+    if (boneCount_ == 0)
+    {
+        return false;
+    }
+
+    float time = duration_ > 0.0f ? std::fmod(msec, duration_) : 0.0f;
+    if (time < 0.0f)
+    {
+        time += duration_;
+    }
+    const float position = sampleInterval_ > 0.0f ? time / sampleInterval_ : 0.0f;
+    const size_t sample = std::min(static_cast<size_t>(position), sampleCount_ - 2);
+    t = std::min(position - static_cast<float>(sample), 1.0f);
+    from = GetSample(sample);
+    to = GetSample(sample + 1);
+    return true;
+}
+
+void BakedClip::BlendBlock(const float* from, const float* to, float t, size_t first, float (*blended)[c_blendBlockSize]) const
+{
+    // Blend whole blocks of bones stream by stream so the loops vectorize, the padding bones are blended too
+    for (int c = BakedPositionX; c <= BakedPositionZ; c++)
+    {
+        const float* a = from + c * boneStride_ + first;
+        const float* b = to + c * boneStride_ + first;
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            blended[c][k] = a[k] + t * (b[k] - a[k]);
+        }
+    }
+
+    const float* a[4];
+    const float* b[4];
+    for (int c = 0; c < 4; c++)
+    {
+        a[c] = from + (BakedOrientationX + c) * boneStride_ + first;
+        b[c] = to + (BakedOrientationX + c) * boneStride_ + first;
+    }
+    float sign[c_blendBlockSize];
+    float factor[c_blendBlockSize];
+    for (size_t k = 0; k < c_blendBlockSize; k++)
+    {
+        // Same approximated NLERP as M3D, the blend factor is corrected for the angle between the quaternions
+        float d = a[0][k] * b[0][k] + a[1][k] * b[1][k] + a[2][k] * b[2][k] + a[3][k] * b[3][k];
+        sign[k] = d < 0.0f ? -1.0f : 1.0f;
+        d = std::fabs(d);
+        const float c = t - 0.5f;
+        factor[k] = t + t * c * (t - 1.0f) * ((1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f))) * c * c +
+            (0.848013f + d * (-1.06021f + d * 0.215638f)));
+    }
+    float length[c_blendBlockSize] = {};
+    for (int c = 0; c < 4; c++)
+    {
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            const float q = a[c][k] + factor[k] * (sign[k] * b[c][k] - a[c][k]);
+            blended[BakedOrientationX + c][k] = q;
+            length[k] += q * q;
+        }
+    }
+    for (size_t k = 0; k < c_blendBlockSize; k++)
+    {
+        // Padding bones are all zero
+        length[k] = length[k] > 0.0f ? 1.0f / std::sqrt(length[k]) : 0.0f;
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        for (size_t k = 0; k < c_blendBlockSize; k++)
+        {
+            blended[BakedOrientationX + c][k] *= length[k];
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnimationPose.h"
+#include "KeyframeIndex.h"
+
+class CacheReader;
+class CacheWriter;
+
+constexpr size_t c_blendBlockSize = 8;      // Bones blended together, streams are padded to a multiple of it
+
+// Streams of a baked sample, each holding one value per bone
+enum BakedStream {
+    BakedPositionX,
+    BakedPositionY,
+    BakedPositionZ,
+    BakedOrientationX,
+    BakedOrientationY,
+    BakedOrientationZ,
+    BakedOrientationW,
+    BakedStreamCount
+};
+
+// An action resampled at load time into dense per-bone tracks.
+// Samples are evenly spaced and laid out one after the other, each sample being one structure-of-arrays
+// block with a stream per transform component, so playback reads two adjacent blocks and blends them
+// without touching the model or searching keys. The last sample repeats the first one to close the loop.
+class BakedClip {
+
+public:
+
+    BakedClip() = default;
+    // A sample rate of 0 keeps the action's own rate, the shortest gap between two of its frames
+    BakedClip(const KeyframeIndex& keyframes, float sampleRate = 0.0f);
+    explicit BakedClip(CacheReader& reader);
+    void Save(CacheWriter& writer) const;
+    void Sample(float msec, BoneTransform* out) const;
+    // Same sample written as BakedStreamCount streams of streamStride floats, a multiple of c_blendBlockSize
+    void Sample(float msec, float* streams, size_t streamStride) const;
+
+    float GetDuration()                         const   { return duration_; }
+    float GetSampleInterval()                   const   { return sampleInterval_; }
+    size_t GetSampleCount()                     const   { return sampleCount_; }
+    size_t GetBoneCount()                       const   { return boneCount_; }
+    size_t GetMemorySize()                      const   { return samples_.size() * sizeof(float); }
+
+private:
+
+    const float* GetSample(size_t sample)       const   { return &samples_[sample * boneStride_ * BakedStreamCount]; }
+    bool FindSamples(float msec, const float*& from, const float*& to, float& t) const;
+    void BlendBlock(const float* from, const float* to, float t, size_t first, float (*blended)[c_blendBlockSize]) const;
+
+    float duration_ = 0.0f;
+    float sampleInterval_ = 0.0f;
+    size_t sampleCount_ = 0;
+    size_t boneCount_ = 0;
+    size_t boneStride_ = 0;                     // Bones per stream, padded to the blend block size
+    std::vector<float> samples_;
+};
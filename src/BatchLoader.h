@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AssetLoader.h"
+
+class JobPool;
+
+// Bytes reserved by the loads in flight. A reservation waits until it fits, except when nothing else is
+// reserved, so a model larger than the whole budget still loads, alone.
+class MemoryBudget {
+
+public:
+
+    explicit MemoryBudget(size_t capacity) : capacity_(capacity) {}
+
+    void Acquire(size_t bytes);
+    void Release(size_t bytes);
+    size_t GetPeak()                                    const   { return peak_; }
+
+private:
+
+    std::mutex mutex_;
+    std::condition_variable released_;
+    size_t capacity_;
+    size_t used_ = 0;
+    size_t peak_ = 0;
+};
+
+struct BatchLoadOptions {
+    LoadOptions load;
+    size_t memoryBudget = 0;        // Bytes the loads in flight may take, estimated from their files. 0 for no cap
+};
+
+// How the load of one file of a batch went
+struct BatchLoadReport {
+    std::filesystem::path path;
+    size_t fileSize = 0;
+    size_t estimatedMemory = 0;
+    double waitMilliseconds = 0.0;      // Spent waiting for the memory budget
+    double loadMilliseconds = 0.0;
+    std::array<double, static_cast<size_t>(LoadStage::Count)> stageMilliseconds = {};
+    std::string error;                  // Empty when the file loaded
+
+    bool IsLoaded()                                     const   { return error.empty(); }
+};
+
+// Summary of a whole batch, reports are in the order of the paths given
+struct BatchLoadResult {
+    std::vector<BatchLoadReport> reports;
+    double milliseconds = 0.0;
+    size_t peakEstimatedMemory = 0;
+
+    size_t GetLoadedCount() const;
+    size_t GetTotalFileSize() const;
+};
+
+// The .m3d files of a directory and its subdirectories, sorted by path
+std::vector<std::filesystem::path> FindModels(const std::filesystem::path& directory);
+
+// Memory a load is expected to take at its peak: the mapped file plus the built asset, several times larger
+// for a compressed model once inflated. Returns 0 when the file cannot be read
+size_t EstimateLoadMemory(const std::filesystem::path& path);
+
+// Loads every model on the pool's workers and the calling thread, largest files first so that the last
+// loads to finish are short ones. Each asset is handed to onLoaded by the thread that built it, as soon as it
+// is built, and released when the call returns unless moved from. A file that fails is only reported
+using BatchLoadCallback = std::function<void(size_t index, M3dAsset& asset)>;
+BatchLoadResult LoadBatch(const std::vector<std::filesystem::path>& paths, JobPool& jobPool,
+    const BatchLoadOptions& options = BatchLoadOptions(), const BatchLoadCallback& onLoaded = nullptr);
@@ -0,0 +1,61 @@
+#include "BoneHierarchy.h"
+
+#include <stdexcept>
+
+BoneHierarchy::BoneHierarchy(const uint32_t* parents, size_t boneCount) :
+    parents_(parents, parents + boneCount),
+    firstChild_(boneCount, c_noBone),
+    nextSibling_(boneCount, c_noBone)
+{
+    if (boneCount >= c_noBone)
+    {
+        throw std::runtime_error("BoneHierarchy");
+    }
+
+    // The last child linked so far of every bone, where the next one gets appended
+    std::vector<uint32_t> lastChild(boneCount, c_noBone);
+    depthOrder_.reserve(boneCount);
+    for (uint32_t i = 0; i < boneCount; i++)
+    {
+        const uint32_t parent = parents_[i];
+        if (parent == c_rootBone)
+        {
+            depthOrder_.push_back(i);
+            continue;
+        }
+        if (parent >= boneCount || parent == i)
+        {
+            throw std::runtime_error("BoneHierarchy");
+        }
+        if (lastChild[parent] == c_noBone)
+        {
+            firstChild_[parent] = i;
+        }
+        else
+        {
+            nextSibling_[lastChild[parent]] = i;
+        }
+        lastChild[parent] = i;
+    }
+
+    // Walk the children level by level from the roots, bones left out are part of a loop
+    levelOffsets_.push_back(0);
+    size_t levelBegin = 0;
+    while (levelBegin < depthOrder_.size())
+    {
+        const size_t levelEnd = depthOrder_.size();
+        levelOffsets_.push_back(static_cast<uint32_t>(levelEnd));
+        for (size_t i = levelBegin; i < levelEnd; i++)
+        {
+            for (uint32_t child = firstChild_[depthOrder_[i]]; child != c_noBone; child = nextSibling_[child])
+            {
+                depthOrder_.push_back(child);
+            }
+        }
+        levelBegin = levelEnd;
+    }
+    if (depthOrder_.size() != boneCount)
+    {
+        throw std::runtime_error("BoneHierarchy");
+    }
+}
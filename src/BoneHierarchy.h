@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t c_rootBone = 0xFFFFFFFF;     // Parent of bones without one, same as M3D_UNDEF
+constexpr uint32_t c_noBone = 0xFFFFFFFF;       // Missing child or sibling
+
+// Parent, first child and next sibling of every bone in flat arrays, linked in one pass over the parents.
+// Children and siblings follow bone index order, root bones are not linked to each other.
+// Bones are also listed level by level, roots first and every bone after its parent, so the matrices of
+// a whole level can be propagated together once the level above is done.
+class BoneHierarchy {
+
+public:
+
+    BoneHierarchy() = default;
+    // Throws when a parent is out of range or when parents loop back on themselves
+    BoneHierarchy(const uint32_t* parents, size_t boneCount);
+
+    size_t GetBoneCount()                       const   { return parents_.size(); }
+    const uint32_t* GetParents()                const   { return parents_.data(); }
+    uint32_t GetParent(size_t bone)             const   { return parents_[bone]; }
+    uint32_t GetFirstChild(size_t bone)         const   { return firstChild_[bone]; }
+    uint32_t GetNextSibling(size_t bone)        const   { return nextSibling_[bone]; }
+
+    // Bones sorted by depth, the bones of level l being [GetLevelBegin(l), GetLevelEnd(l)) of the order
+    const uint32_t* GetDepthOrder()             const   { return depthOrder_.data(); }
+    size_t GetLevelCount()                      const   { return levelOffsets_.empty() ? 0 : levelOffsets_.size() - 1; }
+    size_t GetLevelBegin(size_t level)          const   { return levelOffsets_[level]; }
+    size_t GetLevelEnd(size_t level)            const   { return levelOffsets_[level + 1]; }
+
+private:
+
+    std::vector<uint32_t> parents_;
+    std::vector<uint32_t> firstChild_;
+    std::vector<uint32_t> nextSibling_;
+    std::vector<uint32_t> depthOrder_;
+    std::vector<uint32_t> levelOffsets_;
+};
@@ -0,0 +1,285 @@
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+    constexpr float c_quaternionRange = 0.70710678f;     // Largest value of a component other than the largest
+    constexpr uint16_t c_componentMask = 0x7FFF;
+    constexpr float c_componentScale = 32767.0f;
+    constexpr float c_positionScale = 65535.0f;
+
+    uint16_t QuantizeComponent(float value)
+    {
+        const float unit = std::clamp((value / c_quaternionRange + 1.0f) * 0.5f, 0.0f, 1.0f);
+        return static_cast<uint16_t>(unit * c_componentScale + 0.5f);
+    }
+
+    // M3D's NLERP normalizes with an approximate reciprocal square root, renormalize exactly like BakedClip does
+    void NlerpOrientation(const BoneTransform& from, const BoneTransform& to, float t, BoneTransform& out)
+    {
+        NlerpBoneOrientation(from, to, t, out);
+        float* q = out.orientation;
+        const float length = 1.0f / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int i = 0; i < 4; i++)
+        {
+            q[i] *= length;
+        }
+    }
+
+    // In double, acos of a float dot product cannot resolve angles under a milliradian
+    float AngleBetween(const float* a, const float* b)
+    {
+        const double d = std::fabs(static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] +
+            static_cast<double>(a[2]) * b[2] + static_cast<double>(a[3]) * b[3]);
+        return static_cast<float>(2.0 * std::acos(std::min(d, 1.0)));
+    }
+
+    // Greedily extends each segment of a track while interpolating its two end values rebuilds every value in
+    // between within tolerance, returns the indices of the values kept
+    template <typename Interpolate, typename Error>
+    std::vector<uint16_t> ReduceTrack(size_t count, Interpolate interpolate, Error error)
+    {
+        std::vector<uint16_t> keys = { 0 };
+        size_t start = 0;
+        while (start + 1 < count)
+        {
+            size_t end = start + 1;
+            while (end + 1 < count)
+            {
+                bool fits = true;
+                const size_t next = end + 1;
+                for (size_t i = start + 1; i < next && fits; i++)
+                {
+                    fits = error(interpolate(start, next, static_cast<float>(i - start) / (next - start)), i);
+                }
+                if (!fits)
+                {
+                    break;
+                }
+                end = next;
+            }
+            keys.push_back(static_cast<uint16_t>(end));
+            start = end;
+        }
+        return keys;
+    }
+}
+
+void PackQuaternion(const float* q, uint16_t* packed)
+{
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (std::fabs(q[i]) > std::fabs(q[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same orientation, keeping the largest component positive lets it be rebuilt from the others
+    const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+    uint16_t components[3];
+    for (int i = 0, c = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            components[c++] = QuantizeComponent(sign * q[i]);
+        }
+    }
+    packed[0] = static_cast<uint16_t>(components[0] | (largest & 1) << 15);
+    packed[1] = static_cast<uint16_t>(components[1] | (largest >> 1) << 15);
+    packed[2] = components[2];
+}
+
+void UnpackQuaternion(const uint16_t* packed, float* q)
+{
+    const int largest = (packed[0] >> 15) | (packed[1] >> 15) << 1;
+    float squares = 0.0f;
+    for (int i = 0, c = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            q[i] = ((packed[c++] & c_componentMask) / c_componentScale * 2.0f - 1.0f) * c_quaternionRange;
+            squares += q[i] * q[i];
+        }
+    }
+    q[largest] = std::sqrt(std::max(1.0f - squares, 0.0f));
+}
+
+CompressedClip::CompressedClip(const BakedClip& clip, const ClipCompressionOptions& options)
+{
+    duration_ = clip.GetDuration();
+    sampleInterval_ = clip.GetSampleInterval();
+    sampleCount_ = clip.GetSampleCount();
+    if (sampleCount_ > UINT16_MAX + size_t(1))
+    {
+        throw std::runtime_error("CompressedClip");
+    }
+
+    // Rebuild the baked samples, bone by bone
+    const size_t boneCount = clip.GetBoneCount();
+    std::vector<BoneTransform> samples(sampleCount_ * boneCount);
+    for (size_t s = 0; s < sampleCount_; s++)
+    {
+        clip.Sample(s * sampleInterval_, &samples[s * boneCount]);
+    }
+    // The sample time of the last one wraps back to the first, which it repeats
+    if (sampleCount_ > 1)
+    {
+        std::copy_n(samples.begin(), boneCount, samples.end() - boneCount);
+    }
+
+    positionTracks_.resize(boneCount);
+    orientationTracks_.resize(boneCount);
+    positionRanges_.resize(boneCount);
+    std::vector<BoneTransform> quantized(sampleCount_);
+    for (size_t bone = 0; bone < boneCount; bone++)
+    {
+        auto sample = [&](size_t s) -> const BoneTransform& { return samples[s * boneCount + bone]; };
+
+        // Positions are quantized over the range of the track, a constant component collapses to its minimum
+        PositionRange& range = positionRanges_[bone];
+        bool constant = true;
+        for (int c = 0; c < 3; c++)
+        {
+            float min = sample(0).position[c];
+            float max = min;
+            for (size_t s = 1; s < sampleCount_; s++)
+            {
+                min = std::min(min, sample(s).position[c]);
+                max = std::max(max, sample(s).position[c]);
+            }
+            range.min[c] = min;
+            range.scale[c] = (max - min) / c_positionScale;
+            constant = constant && max - min <= options.positionTolerance;
+        }
+        std::vector<uint16_t> values(sampleCount_ * 3);
+        for (size_t s = 0; s < sampleCount_; s++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                const float unit = range.scale[c] > 0.0f ? (sample(s).position[c] - range.min[c]) / range.scale[c] : 0.0f;
+                values[s * 3 + c] = static_cast<uint16_t>(std::clamp(unit, 0.0f, c_positionScale) + 0.5f);
+                quantized[s].position[c] = range.min[c] + values[s * 3 + c] * range.scale[c];
+            }
+        }
+
+        // Reduction only bounds the error it adds on top of quantization
+        std::vector<uint16_t> keys = constant ? std::vector<uint16_t>{ 0 } : ReduceTrack(sampleCount_,
+            [&](size_t a, size_t b, float t) { BoneTransform out; LerpBonePosition(quantized[a], quantized[b], t, out); return out; },
+            [&](const BoneTransform& out, size_t i)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    if (std::fabs(out.position[c] - quantized[i].position[c]) > options.positionTolerance)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        positionTracks_[bone] = { static_cast<uint32_t>(positionKeys_.size()), static_cast<uint32_t>(keys.size()) };
+        for (uint16_t key : keys)
+        {
+            positionKeys_.push_back(key);
+            positions_.insert(positions_.end(), &values[key * 3], &values[key * 3] + 3);
+        }
+
+        std::vector<uint16_t> packed(sampleCount_ * 3);
+        constant = true;
+        for (size_t s = 0; s < sampleCount_; s++)
+        {
+            PackQuaternion(sample(s).orientation, &packed[s * 3]);
+            UnpackQuaternion(&packed[s * 3], quantized[s].orientation);
+            constant = constant && AngleBetween(sample(s).orientation, sample(0).orientation) <= options.rotationTolerance;
+        }
+        keys = constant ? std::vector<uint16_t>{ 0 } : ReduceTrack(sampleCount_,
+            [&](size_t a, size_t b, float t) { BoneTransform out; NlerpOrientation(quantized[a], quantized[b], t, out); return out; },
+            [&](const BoneTransform& out, size_t i) { return AngleBetween(out.orientation, quantized[i].orientation) <= options.rotationTolerance; });
+        orientationTracks_[bone] = { static_cast<uint32_t>(orientationKeys_.size()), static_cast<uint32_t>(keys.size()) };
+        for (uint16_t key : keys)
+        {
+            orientationKeys_.push_back(key);
+            orientations_.insert(orientations_.end(), &packed[key * 3], &packed[key * 3] + 3);
+        }
+    }
+}
+
+void CompressedClip::Sample(float msec, BoneTransform* out) const
+{
+    if (positionTracks_.empty())
+    {
+        return;
+    }
+
+    // Same wrapping as BakedClip, then time is counted in baked samples
+    float time = duration_ > 0.0f ? std::fmod(msec, duration_) : 0.0f;
+    if (time < 0.0f)
+    {
+        time += duration_;
+    }
+    const float position = sampleInterval_ > 0.0f ? time / sampleInterval_ : 0.0f;
+
+    for (size_t bone = 0; bone < positionTracks_.size(); bone++)
+    {
+        BoneTransform from;
+        BoneTransform to;
+        float t;
+        const Track& positions = positionTracks_[bone];
+        size_t key = positions.firstKey + FindKey(&positionKeys_[positions.firstKey], positions.keyCount, position, t);
+        DecodePosition(bone, key, from.position);
+        if (positions.keyCount > 1)
+        {
+            DecodePosition(bone, key + 1, to.position);
+            LerpBonePosition(from, to, t, out[bone]);
+        }
+        else
+        {
+            std::copy_n(from.position, 3, out[bone].position);
+        }
+
+        const Track& orientations = orientationTracks_[bone];
+        key = orientations.firstKey + FindKey(&orientationKeys_[orientations.firstKey], orientations.keyCount, position, t);
+        UnpackQuaternion(&orientations_[key * 3], from.orientation);
+        if (orientations.keyCount > 1)
+        {
+            UnpackQuaternion(&orientations_[(key + 1) * 3], to.orientation);
+            NlerpOrientation(from, to, t, out[bone]);
+        }
+        else
+        {
+            std::copy_n(from.orientation, 4, out[bone].orientation);
+        }
+    }
+}
+
+size_t CompressedClip::GetMemorySize() const
+{
+    return (positionTracks_.size() + orientationTracks_.size()) * sizeof(Track) + positionRanges_.size() * sizeof(PositionRange) +
+        (positionKeys_.size() + orientationKeys_.size() + positions_.size() + orientations_.size()) * sizeof(uint16_t);
+}
+
+size_t CompressedClip::FindKey(const uint16_t* keyTimes, uint32_t keyCount, float position, float& t)
+{
+    t = 0.0f;
+    if (keyCount < 2)
+    {
+        return 0;
+    }
+    const size_t next = std::upper_bound(keyTimes + 1, keyTimes + keyCount - 1, position) - keyTimes;
+    const size_t key = next - 1;
+    t = std::clamp((position - keyTimes[key]) / (keyTimes[next] - keyTimes[key]), 0.0f, 1.0f);
+    return key;
+}
+
+void CompressedClip::DecodePosition(size_t bone, size_t key, float* position) const
+{
+    const PositionRange& range = positionRanges_[bone];
+    for (int c = 0; c < 3; c++)
+    {
+        position[c] = range.min[c] + positions_[key * 3 + c] * range.scale[c];
+    }
+}
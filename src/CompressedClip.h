@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnimationPose.h"
+#include "BakedClip.h"
+
+// Largest error keyframe reduction may add on top of quantization
+struct ClipCompressionOptions {
+    float positionTolerance = 1e-4f;    // Model units
+    float rotationTolerance = 1e-3f;    // Radians
+};
+
+// Orientation packed into 48 bits: the index of its largest component, dropped and rebuilt from the unit
+// length, then the three others quantized to 15 bits over [-1/sqrt(2), 1/sqrt(2)]
+void PackQuaternion(const float* q, uint16_t* packed);
+void UnpackQuaternion(const uint16_t* packed, float* q);
+
+// A baked action stored in a fraction of its memory, decompressed bone by bone while sampling.
+// Every bone keeps a position track and an orientation track over the baked sample grid. Each track only
+// keeps the samples that linear interpolation between its neighbours, quantized, cannot rebuild within the
+// tolerance, and always its first and last sample. Positions are quantized to 16 bits per component over the
+// range of their track, orientations to 48 bits. Samples lerp positions and nlerp orientations between the
+// two keys around the sampled time, found by binary search in the track.
+class CompressedClip {
+
+public:
+
+    CompressedClip() = default;
+    explicit CompressedClip(const BakedClip& clip, const ClipCompressionOptions& options = ClipCompressionOptions());
+    void Sample(float msec, BoneTransform* out) const;
+
+    float GetDuration()                         const   { return duration_; }
+    size_t GetBoneCount()                       const   { return positionTracks_.size(); }
+    size_t GetSampleCount()                     const   { return sampleCount_; }
+    size_t GetKeyCount()                        const   { return positionKeys_.size() + orientationKeys_.size(); }
+    size_t GetMemorySize() const;
+
+private:
+
+    struct Track {
+        uint32_t firstKey;
+        uint32_t keyCount;
+    };
+
+    // Range a position track is quantized over
+    struct PositionRange {
+        float min[3];
+        float scale[3];
+    };
+
+    // Key interval holding position, and how far position is into it
+    static size_t FindKey(const uint16_t* keyTimes, uint32_t keyCount, float position, float& t);
+    void DecodePosition(size_t bone, size_t key, float* position) const;
+
+    float duration_ = 0.0f;
+    float sampleInterval_ = 0.0f;
+    size_t sampleCount_ = 0;
+    std::vector<Track> positionTracks_;
+    std::vector<Track> orientationTracks_;
+    std::vector<PositionRange> positionRanges_;
+    std::vector<uint16_t> positionKeys_;        // Sample index of every position key
+    std::vector<uint16_t> orientationKeys_;
+    std::vector<uint16_t> positions_;           // Three quantized components per position key
+    std::vector<uint16_t> orientations_;        // Three words per orientation key
+};
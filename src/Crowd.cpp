@@ -0,0 +1,285 @@
+#include "Crowd.h"
+#include "ForwardKinematics.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t c_chunksPerWorker = 4;
+    constexpr SkinnedVertexLayout c_meshLayout = { sizeof(MeshVertex), offsetof(MeshVertex, position), offsetof(MeshVertex, normal) };
+}
+
+Crowd::Crowd(const M3dAsset& asset) :
+    asset_(&asset),
+    vertexCount_(asset.GetVertices().size())
+{
+}
+
+size_t Crowd::AddInstance(const CrowdInstance& instance)
+{
+    size_t id;
+    if (!freeSlots_.empty())
+    {
+        id = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        id = slots_.size();
+        slots_.emplace_back();
+        vertices_.resize(slots_.size() * vertexCount_);
+    }
+
+    // Colors and texture coordinates are never skinned, every slot starts as a copy of the whole mesh
+    std::copy(asset_->GetVertices().begin(), asset_->GetVertices().end(), vertices_.begin() + id * vertexCount_);
+    slots_[id].instance = instance;
+    slots_[id].position = instanceIds_.size();
+    slots_[id].priority = 1.0f;
+    slots_[id].updateFrame = UINT64_MAX;
+    slots_[id].keyed = false;
+    slots_[id].revision++;
+    instanceIds_.push_back(id);
+    return id;
+}
+
+void Crowd::RemoveInstance(size_t id)
+{
+    if (id >= slots_.size() || slots_[id].position == SIZE_MAX)
+    {
+        throw std::runtime_error("Crowd");
+    }
+
+    // The last instance takes the place of the removed one
+    const size_t position = slots_[id].position;
+    instanceIds_[position] = instanceIds_.back();
+    slots_[instanceIds_[position]].position = position;
+    instanceIds_.pop_back();
+    slots_[id].position = SIZE_MAX;
+    freeSlots_.push_back(id);
+}
+
+void Crowd::UpdateAnimTime(float elapsedTime)
+{
+    for (size_t id : instanceIds_)
+    {
+        CrowdInstance& instance = slots_[id].instance;
+        instance.animTime += elapsedTime * instance.speed;
+    }
+}
+
+void Crowd::Animate(JobPool* jobPool)
+{
+    const size_t instanceCount = instanceIds_.size();
+    if (instanceCount == 0)
+    {
+        return;
+    }
+    const size_t chunkCount = jobPool ? (jobPool->GetWorkerCount() + 1) * c_chunksPerWorker : 1;
+    const size_t chunkSize = (instanceCount + chunkCount - 1) / chunkCount;
+
+    // Scratch buffers are indexed by chunk, each chunk running on a single thread
+    const size_t scratchCount = (instanceCount + chunkSize - 1) / chunkSize;
+    while (scratches_.size() < scratchCount)
+    {
+        Scratch& scratch = scratches_.emplace_back();
+        scratch.localTransforms.assign(asset_->GetPose().GetBindTransforms(), asset_->GetPose().GetBindTransforms() + asset_->GetPose().GetBoneCount());
+        scratch.boneMatrices.resize(asset_->GetPose().GetBoneCount() * c_boneMatrixSize);
+        asset_->GetSkinning().AllocateScratch(scratch.skinning);
+    }
+
+    updateCount_ = instanceCount;
+    if (lod_)
+    {
+        ScheduleLod();
+    }
+
+    auto animateChunk = [&](size_t begin, size_t end)
+    {
+        Scratch& scratch = scratches_[begin / chunkSize];
+        for (size_t i = begin; i < end; i++)
+        {
+            const size_t id = instanceIds_[i];
+            if (lod_)
+            {
+                AnimateLodInstance(id, i, scratch);
+            }
+            else if (AnimateInstance(slots_[id].instance, &vertices_[id * vertexCount_], c_meshLayout, scratch))
+            {
+                slots_[id].revision++;
+            }
+        }
+    };
+    if (jobPool)
+    {
+        jobPool->ParallelFor(instanceCount, chunkSize, animateChunk);
+    }
+    else
+    {
+        animateChunk(0, instanceCount);
+    }
+    if (lod_)
+    {
+        lod_->NextFrame();
+    }
+}
+
+void Crowd::EnablePoseCache(size_t capacity, float timeStep)
+{
+    poseCache_ = std::make_unique<PoseCache>(asset_->GetPose().GetBoneCount(), capacity, timeStep);
+}
+
+void Crowd::EnableLod(const AnimationLodSettings& settings)
+{
+    lod_ = std::make_unique<AnimationLod>(settings);
+    for (Slot& slot : slots_)
+    {
+        slot.updateFrame = UINT64_MAX;
+        slot.keyed = false;
+    }
+}
+
+void Crowd::DisableLod()
+{
+    lod_.reset();
+    keyVertices_.clear();
+    keyVertices_.shrink_to_fit();
+}
+
+size_t Crowd::GetMemorySize() const
+{
+    size_t size = poseCache_ ? poseCache_->GetMemorySize() : 0;
+    size += slots_.capacity() * sizeof(Slot) + (freeSlots_.capacity() + instanceIds_.capacity()) * sizeof(size_t) +
+        vertices_.capacity() * sizeof(MeshVertex) + keyVertices_.capacity() * sizeof(KeyVertex) + priorities_.capacity() * sizeof(float);
+    for (const Scratch& scratch : scratches_)
+    {
+        size += scratch.localTransforms.capacity() * sizeof(BoneTransform) + scratch.boneMatrices.capacity() * sizeof(float) +
+            scratch.skinning.skinMatrices.capacity() * sizeof(float);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            size += (scratch.skinning.skinnedPositions[axis].capacity() + scratch.skinning.skinnedNormals[axis].capacity()) * sizeof(float);
+        }
+    }
+    return size;
+}
+
+bool Crowd::AnimateInstance(const CrowdInstance& instance, void* dst, const SkinnedVertexLayout& layout, Scratch& scratch) const
+{
+    const std::vector<BakedClip>& animations = asset_->GetAnimations();
+    if (instance.animIdx < 0 || static_cast<size_t>(instance.animIdx) >= animations.size())
+    {
+        return false;
+    }
+
+    // Same steps as M3dAsset::Animate, on this chunk's buffers rather than the asset's
+    const BakedClip& clip = animations[instance.animIdx];
+    const AnimationPose& pose = asset_->GetPose();
+    uint64_t key = 0;
+    float time = instance.animTime;
+    if (poseCache_)
+    {
+        time = poseCache_->Quantize(instance.animIdx, time, clip.GetDuration(), key);
+    }
+    if (!poseCache_ || !poseCache_->Find(key, scratch.boneMatrices.data()))
+    {
+        clip.Sample(time, scratch.localTransforms.data());
+        ComputeBoneMatrices(pose.GetKernelLevel(), pose.GetHierarchy(), scratch.localTransforms.data(), scratch.boneMatrices.data());
+        if (poseCache_)
+        {
+            poseCache_->Insert(key, scratch.boneMatrices.data());
+        }
+    }
+
+    const SkinningContext& skinning = asset_->GetSkinning();
+    skinning.UpdateSkinMatrices(scratch.boneMatrices.data(), scratch.skinning);
+    skinning.SkinRange(0, vertexCount_, dst, layout, scratch.skinning);
+    return true;
+}
+
+void Crowd::ScheduleLod()
+{
+    priorities_.resize(instanceIds_.size());
+    for (size_t i = 0; i < instanceIds_.size(); i++)
+    {
+        priorities_[i] = slots_[instanceIds_[i]].priority;
+    }
+    lod_->Schedule(priorities_.data(), priorities_.size());
+
+    updateCount_ = 0;
+    for (size_t i = 0; i < instanceIds_.size(); i++)
+    {
+        updateCount_ += lod_->IsDue(i) || slots_[instanceIds_[i]].updateFrame == UINT64_MAX;
+    }
+
+    // Key poses are seeded from the shown vertices before their first use
+    if (lod_->GetSettings().interpolate)
+    {
+        keyVertices_.resize(slots_.size() * 2 * vertexCount_);
+    }
+}
+
+void Crowd::AnimateLodInstance(size_t id, size_t position, Scratch& scratch)
+{
+    Slot& slot = slots_[id];
+    MeshVertex* vertices = &vertices_[id * vertexCount_];
+    const uint64_t frame = lod_->GetFrame();
+    const uint32_t interval = lod_->GetInterval(position);
+    const bool due = slot.updateFrame == UINT64_MAX || lod_->IsDue(position);
+
+    // Instances updated every frame or out of view gain nothing from blending, they are skinned in place or hold
+    if (!lod_->GetSettings().interpolate || interval == 1 || slot.priority <= 0.0f)
+    {
+        if (due)
+        {
+            if (AnimateInstance(slot.instance, vertices, c_meshLayout, scratch))
+            {
+                slot.revision++;
+            }
+            slot.updateFrame = frame;
+        }
+        slot.keyed = false;
+        return;
+    }
+
+    if (due)
+    {
+        // Blending starts from what is shown when the key poses were not kept up
+        slot.latestKey ^= 1;
+        if (!slot.keyed)
+        {
+            KeyVertex* previous = GetKeyVertices(id, slot.latestKey ^ 1);
+            for (size_t v = 0; v < vertexCount_; v++)
+            {
+                std::copy_n(vertices[v].position, 3, previous[v].position);
+                std::copy_n(vertices[v].normal, 3, previous[v].normal);
+            }
+            slot.keyed = true;
+        }
+        AnimateInstance(slot.instance, GetKeyVertices(id, slot.latestKey), c_keyLayout, scratch);
+        slot.updateFrame = frame;
+        slot.updateInterval = interval;
+    }
+
+    // Reaches the last update as the next one comes due, the vertices then stay there until it does
+    const uint64_t elapsed = frame - slot.updateFrame + 1;
+    if (!slot.keyed || elapsed > slot.updateInterval)
+    {
+        return;
+    }
+    // Weighting both ends lands the last step exactly on the latest key
+    const KeyVertex* latest = GetKeyVertices(id, slot.latestKey);
+    const KeyVertex* previous = GetKeyVertices(id, slot.latestKey ^ 1);
+    const float t = static_cast<float>(elapsed) / static_cast<float>(slot.updateInterval);
+    const float s = 1.0f - t;
+    for (size_t v = 0; v < vertexCount_; v++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            vertices[v].position[c] = s * previous[v].position[c] + t * latest[v].position[c];
+            vertices[v].normal[c] = s * previous[v].normal[c] + t * latest[v].normal[c];
+        }
+    }
+    slot.revision++;
+}
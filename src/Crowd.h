@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AnimationLod.h"
+#include "AnimationPose.h"
+#include "M3dAsset.h"
+#include "PoseCache.h"
+#include "SkinningContext.h"
+
+class JobPool;
+
+// Playback state of one member of a crowd
+struct CrowdInstance {
+    int animIdx = 0;            // Out of range leaves the instance's vertices as they were last skinned
+    float animTime = 0.0f;
+    float speed = 1.0f;         // Scales the time given to UpdateAnimTime
+};
+
+// Many copies of one built model, each playing its own action at its own time and speed.
+// The mesh, skin weights, skeleton and baked actions stay in the shared asset, an instance only adds its
+// playback state and a slot of the vertex pool its skinned copy of the mesh is written to. Slots of removed
+// instances go to the next instances added, so the pool only grows with the largest crowd it held.
+// Animate spreads the instances over a job pool in a few chunks per thread, each chunk sampling, posing and
+// skinning its instances one after the other on scratch buffers of its own.
+// With the animation LOD enabled, only the instances it finds due are animated, the others keep their last
+// vertices or, when interpolating, blend between their last two updates and so trail their time by up to an
+// update interval.
+class Crowd {
+
+public:
+
+    // The asset must be built, and must outlive the crowd and not be animated while the crowd is
+    explicit Crowd(const M3dAsset& asset);
+
+    Crowd(const Crowd&) = delete;
+    Crowd& operator=(const Crowd&) = delete;
+
+    // Returns the id of the new instance, its vertices start in the asset's current pose
+    size_t AddInstance(const CrowdInstance& instance = CrowdInstance());
+    void RemoveInstance(size_t id);
+    void UpdateAnimTime(float elapsedTime);
+    void Animate(JobPool* jobPool = nullptr);
+    // Lets instances playing the same action at the same time, within timeStep milliseconds, share one pose.
+    // Poses are then sampled at the start of their step, a step of 0 keeps every instance on its exact time
+    void EnablePoseCache(size_t capacity, float timeStep);
+    void DisablePoseCache()                             { poseCache_.reset(); }
+    // Time-slices Animate over the instances by their priorities, see AnimationLod
+    void EnableLod(const AnimationLodSettings& settings);
+    void DisableLod();
+    // How much the instance matters, its screen size say, 0 once offscreen. Only used by the animation LOD
+    void SetPriority(size_t id, float priority)         { slots_[id].priority = priority; }
+
+    size_t GetInstanceCount()                   const   { return instanceIds_.size(); }
+    // Ids of the instances in the crowd, in no particular order
+    const std::vector<size_t>& GetInstanceIds() const   { return instanceIds_; }
+    CrowdInstance& GetInstance(size_t id)               { return slots_[id].instance; }
+    const CrowdInstance& GetInstance(size_t id) const   { return slots_[id].instance; }
+    size_t GetVertexCount()                     const   { return vertexCount_; }
+    // Skinned vertices of an instance, moved when adding an instance grows the pool
+    const MeshVertex* GetVertices(size_t id)    const   { return &vertices_[id * vertexCount_]; }
+    // Changes whenever the vertices of the slot are written, including by the next instance given the slot
+    uint64_t GetRevision(size_t id)             const   { return slots_[id].revision; }
+    // Instance ids are below it
+    size_t GetSlotCount()                       const   { return slots_.size(); }
+    const PoseCache* GetPoseCache()             const   { return poseCache_.get(); }
+    const AnimationLod* GetLod()                const   { return lod_.get(); }
+    // Instances animated by the last call to Animate
+    size_t GetUpdateCount()                     const   { return updateCount_; }
+    size_t GetMemorySize() const;
+
+private:
+
+    struct Slot {
+        CrowdInstance instance;
+        size_t position = SIZE_MAX;     // Index in instanceIds_, SIZE_MAX for a free slot
+        float priority = 1.0f;
+        uint64_t updateFrame = UINT64_MAX;  // LOD frame of the last update, UINT64_MAX before the first one
+        uint32_t updateInterval = 1;        // Frames until the next update, as scheduled at the last one
+        uint32_t latestKey = 0;             // Which of the slot's two key poses holds the last update
+        bool keyed = false;                 // Whether the key poses hold the last two updates
+        uint64_t revision = 0;              // Bumped each time vertices_ of the slot is written
+    };
+
+    // Buffers of one chunk of instances, reused from frame to frame
+    struct Scratch {
+        std::vector<BoneTransform> localTransforms;
+        std::vector<float> boneMatrices;
+        SkinningScratch skinning;
+    };
+
+    // Skinned positions and normals of an instance, kept to interpolate between
+    struct KeyVertex {
+        float position[3];
+        float normal[3];
+    };
+    static constexpr SkinnedVertexLayout c_keyLayout = { sizeof(KeyVertex), offsetof(KeyVertex, position), offsetof(KeyVertex, normal) };
+
+    // Returns whether dst was written, an instance without a valid action is left as it was
+    bool AnimateInstance(const CrowdInstance& instance, void* dst, const SkinnedVertexLayout& layout, Scratch& scratch) const;
+    void ScheduleLod();
+    void AnimateLodInstance(size_t id, size_t position, Scratch& scratch);
+    KeyVertex* GetKeyVertices(size_t id, uint32_t key)          { return &keyVertices_[(id * 2 + key) * vertexCount_]; }
+
+    const M3dAsset* asset_;
+    size_t vertexCount_;
+    std::vector<Slot> slots_;
+    std::vector<size_t> freeSlots_;
+    std::vector<size_t> instanceIds_;
+    std::vector<MeshVertex> vertices_;  // vertexCount_ vertices per slot
+    std::vector<Scratch> scratches_;
+    std::unique_ptr<PoseCache> poseCache_;
+    std::unique_ptr<AnimationLod> lod_;
+    std::vector<KeyVertex> keyVertices_;    // Two key poses per slot, to interpolate between
+    std::vector<float> priorities_;         // Indexed like instanceIds_
+    size_t updateCount_ = 0;
+};
@@ -0,0 +1,307 @@
+#include "ForwardKinematics.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define M3DV_FK_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define M3DV_FK_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define M3DV_TARGET(features) __attribute__((target(features)))
+#else
+#define M3DV_TARGET(features)
+#endif
+
+namespace
+{
+    constexpr size_t c_lanes = 4;
+    constexpr float c_matrixEpsilon = 1e-7f;        // M3D_EPSILON, same as ComposeBoneMatrix
+    constexpr float c_flipMin = 0.7071065f;         // Orientations ComposeBoneMatrix turns into a flip of every axis
+    constexpr float c_flipMax = 0.7071075f;
+
+    void ComputeBoneMatricesScalar(const BoneHierarchy& hierarchy, const BoneTransform* localTransforms, float* boneMatrices)
+    {
+        float local[c_boneMatrixSize];
+        const uint32_t* order = hierarchy.GetDepthOrder();
+        for (size_t i = 0; i < hierarchy.GetBoneCount(); i++)
+        {
+            const uint32_t bone = order[i];
+            const uint32_t parent = hierarchy.GetParent(bone);
+            float* matrix = &boneMatrices[bone * c_boneMatrixSize];
+            if (parent == c_rootBone)
+            {
+                ComposeBoneMatrix(localTransforms[bone], matrix);
+            }
+            else
+            {
+                ComposeBoneMatrix(localTransforms[bone], local);
+                MultiplyBoneMatrices(&boneMatrices[parent * c_boneMatrixSize], local, matrix);
+            }
+        }
+    }
+
+    // The bones of a level taken four at a time, the last group repeating its last bone in the unused lanes
+    void GetLaneBones(const uint32_t* order, size_t first, size_t end, uint32_t* bones, size_t& count)
+    {
+        count = std::min(c_lanes, end - first);
+        for (size_t k = 0; k < c_lanes; k++)
+        {
+            bones[k] = order[first + std::min(k, count - 1)];
+        }
+    }
+
+#ifdef M3DV_FK_X86
+    M3DV_TARGET("sse4.1")
+    __m128 FlushToZeroSse41(__m128 value)
+    {
+        const __m128 tiny = _mm_and_ps(_mm_cmpgt_ps(value, _mm_set1_ps(-c_matrixEpsilon)), _mm_cmplt_ps(value, _mm_set1_ps(c_matrixEpsilon)));
+        return _mm_andnot_ps(tiny, value);
+    }
+
+    // Local matrices of four bones, entry e of every bone in m[e]
+    M3DV_TARGET("sse4.1")
+    void ComposeBoneMatricesSse41(const BoneTransform* localTransforms, const uint32_t* bones, __m128* m)
+    {
+        __m128 x = _mm_loadu_ps(localTransforms[bones[0]].orientation);
+        __m128 y = _mm_loadu_ps(localTransforms[bones[1]].orientation);
+        __m128 z = _mm_loadu_ps(localTransforms[bones[2]].orientation);
+        __m128 w = _mm_loadu_ps(localTransforms[bones[3]].orientation);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        __m128 px = _mm_loadu_ps(localTransforms[bones[0]].position);
+        __m128 py = _mm_loadu_ps(localTransforms[bones[1]].position);
+        __m128 pz = _mm_loadu_ps(localTransforms[bones[2]].position);
+        __m128 unused = _mm_loadu_ps(localTransforms[bones[3]].position);
+        _MM_TRANSPOSE4_PS(px, py, pz, unused);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        m[0] = FlushToZeroSse41(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)))));
+        m[1] = FlushToZeroSse41(_mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, y), _mm_mul_ps(z, w))));
+        m[2] = FlushToZeroSse41(_mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, z), _mm_mul_ps(y, w))));
+        m[4] = FlushToZeroSse41(_mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, y), _mm_mul_ps(z, w))));
+        m[5] = FlushToZeroSse41(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z)))));
+        m[6] = FlushToZeroSse41(_mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(y, z), _mm_mul_ps(x, w))));
+        m[8] = FlushToZeroSse41(_mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, z), _mm_mul_ps(y, w))));
+        m[9] = FlushToZeroSse41(_mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, z), _mm_mul_ps(x, w))));
+        m[10] = FlushToZeroSse41(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)))));
+
+        const __m128 flip = _mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(x, zero), _mm_cmpeq_ps(y, zero)),
+            _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(z, _mm_set1_ps(c_flipMin)), _mm_cmple_ps(z, _mm_set1_ps(c_flipMax))), _mm_cmpeq_ps(w, zero)));
+        for (int e : { 1, 2, 4, 6, 8, 9 })
+        {
+            m[e] = _mm_blendv_ps(m[e], zero, flip);
+        }
+        for (int e : { 0, 5, 10 })
+        {
+            m[e] = _mm_blendv_ps(m[e], _mm_set1_ps(-1.0f), flip);
+        }
+        m[3] = px;
+        m[7] = py;
+        m[11] = pz;
+        m[12] = zero;
+        m[13] = zero;
+        m[14] = zero;
+        m[15] = one;
+    }
+
+    M3DV_TARGET("sse4.1")
+    void ComputeBoneMatricesSse41(const BoneHierarchy& hierarchy, const BoneTransform* localTransforms, float* boneMatrices)
+    {
+        const uint32_t* order = hierarchy.GetDepthOrder();
+        for (size_t level = 0; level < hierarchy.GetLevelCount(); level++)
+        {
+            const size_t end = hierarchy.GetLevelEnd(level);
+            for (size_t first = hierarchy.GetLevelBegin(level); first < end; first += c_lanes)
+            {
+                uint32_t bones[c_lanes];
+                size_t count;
+                GetLaneBones(order, first, end, bones, count);
+                __m128 local[c_boneMatrixSize];
+                ComposeBoneMatricesSse41(localTransforms, bones, local);
+
+                // Only the roots make up the first level, every other bone gets its parent's matrix applied
+                __m128 result[c_boneMatrixSize];
+                if (level == 0)
+                {
+                    std::copy_n(local, c_boneMatrixSize, result);
+                }
+                else
+                {
+                    const float* p0 = &boneMatrices[hierarchy.GetParent(bones[0]) * c_boneMatrixSize];
+                    const float* p1 = &boneMatrices[hierarchy.GetParent(bones[1]) * c_boneMatrixSize];
+                    const float* p2 = &boneMatrices[hierarchy.GetParent(bones[2]) * c_boneMatrixSize];
+                    const float* p3 = &boneMatrices[hierarchy.GetParent(bones[3]) * c_boneMatrixSize];
+                    for (int r = 0; r < 4; r++)
+                    {
+                        __m128 row0 = _mm_loadu_ps(p0 + r * 4);
+                        __m128 row1 = _mm_loadu_ps(p1 + r * 4);
+                        __m128 row2 = _mm_loadu_ps(p2 + r * 4);
+                        __m128 row3 = _mm_loadu_ps(p3 + r * 4);
+                        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+                        for (int c = 0; c < 4; c++)
+                        {
+                            result[r * 4 + c] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(local[c], row0), _mm_mul_ps(local[4 + c], row1)),
+                                _mm_mul_ps(local[8 + c], row2)), _mm_mul_ps(local[12 + c], row3));
+                        }
+                    }
+                }
+
+                for (int r = 0; r < 4; r++)
+                {
+                    __m128 lane[c_lanes] = { result[r * 4], result[r * 4 + 1], result[r * 4 + 2], result[r * 4 + 3] };
+                    _MM_TRANSPOSE4_PS(lane[0], lane[1], lane[2], lane[3]);
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        _mm_storeu_ps(&boneMatrices[bones[k] * c_boneMatrixSize + r * 4], lane[k]);
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+#ifdef M3DV_FK_NEON
+    void TransposeNeon(float32x4_t& r0, float32x4_t& r1, float32x4_t& r2, float32x4_t& r3)
+    {
+        const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+    float32x4_t FlushToZeroNeon(float32x4_t value)
+    {
+        const uint32x4_t tiny = vandq_u32(vcgtq_f32(value, vdupq_n_f32(-c_matrixEpsilon)), vcltq_f32(value, vdupq_n_f32(c_matrixEpsilon)));
+        return vbslq_f32(tiny, vdupq_n_f32(0.0f), value);
+    }
+
+    // Same structure as the SSE kernel, without fused multiply-adds to keep the scalar rounding
+    void ComposeBoneMatricesNeon(const BoneTransform* localTransforms, const uint32_t* bones, float32x4_t* m)
+    {
+        float32x4_t x = vld1q_f32(localTransforms[bones[0]].orientation);
+        float32x4_t y = vld1q_f32(localTransforms[bones[1]].orientation);
+        float32x4_t z = vld1q_f32(localTransforms[bones[2]].orientation);
+        float32x4_t w = vld1q_f32(localTransforms[bones[3]].orientation);
+        TransposeNeon(x, y, z, w);
+        float32x4_t px = vld1q_f32(localTransforms[bones[0]].position);
+        float32x4_t py = vld1q_f32(localTransforms[bones[1]].position);
+        float32x4_t pz = vld1q_f32(localTransforms[bones[2]].position);
+        float32x4_t unused = vld1q_f32(localTransforms[bones[3]].position);
+        TransposeNeon(px, py, pz, unused);
+
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        const float32x4_t two = vdupq_n_f32(2.0f);
+        m[0] = FlushToZeroNeon(vsubq_f32(one, vmulq_f32(two, vaddq_f32(vmulq_f32(y, y), vmulq_f32(z, z)))));
+        m[1] = FlushToZeroNeon(vmulq_f32(two, vsubq_f32(vmulq_f32(x, y), vmulq_f32(z, w))));
+        m[2] = FlushToZeroNeon(vmulq_f32(two, vaddq_f32(vmulq_f32(x, z), vmulq_f32(y, w))));
+        m[4] = FlushToZeroNeon(vmulq_f32(two, vaddq_f32(vmulq_f32(x, y), vmulq_f32(z, w))));
+        m[5] = FlushToZeroNeon(vsubq_f32(one, vmulq_f32(two, vaddq_f32(vmulq_f32(x, x), vmulq_f32(z, z)))));
+        m[6] = FlushToZeroNeon(vmulq_f32(two, vsubq_f32(vmulq_f32(y, z), vmulq_f32(x, w))));
+        m[8] = FlushToZeroNeon(vmulq_f32(two, vsubq_f32(vmulq_f32(x, z), vmulq_f32(y, w))));
+        m[9] = FlushToZeroNeon(vmulq_f32(two, vaddq_f32(vmulq_f32(y, z), vmulq_f32(x, w))));
+        m[10] = FlushToZeroNeon(vsubq_f32(one, vmulq_f32(two, vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)))));
+
+        const uint32x4_t flip = vandq_u32(vandq_u32(vceqq_f32(x, zero), vceqq_f32(y, zero)),
+            vandq_u32(vandq_u32(vcgeq_f32(z, vdupq_n_f32(c_flipMin)), vcleq_f32(z, vdupq_n_f32(c_flipMax))), vceqq_f32(w, zero)));
+        for (int e : { 1, 2, 4, 6, 8, 9 })
+        {
+            m[e] = vbslq_f32(flip, zero, m[e]);
+        }
+        for (int e : { 0, 5, 10 })
+        {
+            m[e] = vbslq_f32(flip, vdupq_n_f32(-1.0f), m[e]);
+        }
+        m[3] = px;
+        m[7] = py;
+        m[11] = pz;
+        m[12] = zero;
+        m[13] = zero;
+        m[14] = zero;
+        m[15] = one;
+    }
+
+    void ComputeBoneMatricesNeon(const BoneHierarchy& hierarchy, const BoneTransform* localTransforms, float* boneMatrices)
+    {
+        const uint32_t* order = hierarchy.GetDepthOrder();
+        for (size_t level = 0; level < hierarchy.GetLevelCount(); level++)
+        {
+            const size_t end = hierarchy.GetLevelEnd(level);
+            for (size_t first = hierarchy.GetLevelBegin(level); first < end; first += c_lanes)
+            {
+                uint32_t bones[c_lanes];
+                size_t count;
+                GetLaneBones(order, first, end, bones, count);
+                float32x4_t local[c_boneMatrixSize];
+                ComposeBoneMatricesNeon(localTransforms, bones, local);
+
+                float32x4_t result[c_boneMatrixSize];
+                if (level == 0)
+                {
+                    std::copy_n(local, c_boneMatrixSize, result);
+                }
+                else
+                {
+                    const float* p0 = &boneMatrices[hierarchy.GetParent(bones[0]) * c_boneMatrixSize];
+                    const float* p1 = &boneMatrices[hierarchy.GetParent(bones[1]) * c_boneMatrixSize];
+                    const float* p2 = &boneMatrices[hierarchy.GetParent(bones[2]) * c_boneMatrixSize];
+                    const float* p3 = &boneMatrices[hierarchy.GetParent(bones[3]) * c_boneMatrixSize];
+                    for (int r = 0; r < 4; r++)
+                    {
+                        float32x4_t row0 = vld1q_f32(p0 + r * 4);
+                        float32x4_t row1 = vld1q_f32(p1 + r * 4);
+                        float32x4_t row2 = vld1q_f32(p2 + r * 4);
+                        float32x4_t row3 = vld1q_f32(p3 + r * 4);
+                        TransposeNeon(row0, row1, row2, row3);
+                        for (int c = 0; c < 4; c++)
+                        {
+                            result[r * 4 + c] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(local[c], row0), vmulq_f32(local[4 + c], row1)),
+                                vmulq_f32(local[8 + c], row2)), vmulq_f32(local[12 + c], row3));
+                        }
+                    }
+                }
+
+                for (int r = 0; r < 4; r++)
+                {
+                    float32x4_t lane[c_lanes] = { result[r * 4], result[r * 4 + 1], result[r * 4 + 2], result[r * 4 + 3] };
+                    TransposeNeon(lane[0], lane[1], lane[2], lane[3]);
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        vst1q_f32(&boneMatrices[bones[k] * c_boneMatrixSize + r * 4], lane[k]);
+                    }
+                }
+            }
+        }
+    }
+#endif
+}
+
+void ComputeBoneMatrices(SkinKernelLevel level, const BoneHierarchy& hierarchy, const BoneTransform* localTransforms, float* boneMatrices)
+{
+    static const SkinKernelLevel detected = DetectSkinKernelLevel();
+    switch (std::min(level, detected))
+    {
+#ifdef M3DV_FK_X86
+    case SkinKernelLevel::Sse41:
+    case SkinKernelLevel::Avx2:
+        ComputeBoneMatricesSse41(hierarchy, localTransforms, boneMatrices);
+        break;
+#endif
+#ifdef M3DV_FK_NEON
+    case SkinKernelLevel::Neon:
+        ComputeBoneMatricesNeon(hierarchy, localTransforms, boneMatrices);
+        break;
+#endif
+    default:
+        ComputeBoneMatricesScalar(hierarchy, localTransforms, boneMatrices);
+        break;
+    }
+}
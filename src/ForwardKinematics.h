@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+#include "AnimationPose.h"
+#include "BoneHierarchy.h"
+#include "SkinningKernel.h"
+
+// Resolves the local transform of every bone into its model-space matrix, c_boneMatrixSize floats per bone.
+// Bones are handled level by level in the hierarchy's depth order, so every parent matrix is ready before its
+// children need it. The SIMD paths compose the matrices of four bones of a level at once, each lane holding
+// one bone, then multiply them with their four parents. They run the scalar operations in the same order,
+// so every level gives the same matrices to the bit. Levels the CPU does not support fall back to scalar
+void ComputeBoneMatrices(SkinKernelLevel level, const BoneHierarchy& hierarchy, const BoneTransform* localTransforms,
+    float* boneMatrices);
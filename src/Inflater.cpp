@@ -0,0 +1,552 @@
+#include "Inflater.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const uint16_t c_lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t c_lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t c_distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t c_distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t c_codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Bits fed past the end of the input before the stream is known to be truncated, the bit buffer holds 8 bytes
+    constexpr size_t c_maxOverrun = 16;
+}
+
+Inflater::Inflater(const unsigned char* data, size_t size, bool zlibHeader) :
+    data_(data),
+    size_(size),
+    window_(c_windowSize)
+{
+    if (zlibHeader)
+    {
+        const uint32_t cmf = GetBits(8);
+        const uint32_t flg = GetBits(8);
+        if ((cmf * 256 + flg) % 31 != 0 || (cmf & 15) != 8 || (flg & 32) != 0)
+        {
+            throw std::runtime_error("Inflater");
+        }
+    }
+}
+
+uint32_t Inflater::MakeLiteralEntry(size_t symbol)
+{
+    if (symbol < 256)
+    {
+        return c_entryLiteral | static_cast<uint32_t>(symbol);
+    }
+    if (symbol == 256)
+    {
+        return c_entryEnd;
+    }
+    if (symbol - 257 >= 29)
+    {
+        return c_entryInvalid;
+    }
+    return c_entryMatch | c_lengthExtra[symbol - 257] << 20 | c_lengthBase[symbol - 257];
+}
+
+uint32_t Inflater::MakeDistanceEntry(size_t symbol)
+{
+    if (symbol >= 30)
+    {
+        return c_entryInvalid;
+    }
+    return c_entryMatch | c_distanceExtra[symbol] << 20 | c_distanceBase[symbol];
+}
+
+uint32_t Inflater::MakeCodeLengthEntry(size_t symbol)
+{
+    return c_entryLiteral | static_cast<uint32_t>(symbol);
+}
+
+void Inflater::BuildTable(HuffmanTable& table, const uint8_t* lengths, size_t count, uint32_t (*makeEntry)(size_t symbol))
+{
+    memset(table.fast, 0, sizeof(table.fast));
+    memset(table.count, 0, sizeof(table.count));
+    for (size_t i = 0; i < count; i++)
+    {
+        table.count[lengths[i]]++;
+    }
+    table.count[0] = 0;
+
+    // Over-subscribed codes are corrupt, incomplete ones only happen with a single code and are fine
+    int left = 1;
+    uint16_t offsets[c_maxCodeLength + 2] = {};
+    uint32_t nextCode[c_maxCodeLength + 1] = {};
+    for (unsigned length = 1; length <= c_maxCodeLength; length++)
+    {
+        left = (left << 1) - table.count[length];
+        if (left < 0)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        offsets[length + 1] = offsets[length] + table.count[length];
+        nextCode[length] = (nextCode[length - 1] + table.count[length - 1]) << 1;
+    }
+
+    for (size_t symbol = 0; symbol < count; symbol++)
+    {
+        const unsigned length = lengths[symbol];
+        if (!length)
+        {
+            continue;
+        }
+        const uint32_t entry = makeEntry(symbol);
+        table.entries[offsets[length]++] = entry;
+        const uint32_t code = nextCode[length]++;
+        if (length <= c_fastBits)
+        {
+            // Codes are stored most significant bit first, the bit buffer is read least significant bit first
+            uint32_t reversed = 0;
+            for (unsigned bit = 0; bit < length; bit++)
+            {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+            for (uint32_t index = reversed; index < (1u << c_fastBits); index += 1u << length)
+            {
+                table.fast[index] = entry | length << 16;
+            }
+        }
+    }
+}
+
+void Inflater::Refill()
+{
+    // Loads 8 bytes at once and keeps the whole ones that fit, the bits above bitCount_ are loaded again next time
+    if (position_ + 8 <= size_)
+    {
+        uint64_t word;
+        memcpy(&word, data_ + position_, sizeof(word));
+        bits_ |= word << bitCount_;
+        position_ += (63 - bitCount_) >> 3;
+        bitCount_ |= 56;
+        return;
+    }
+    while (bitCount_ <= 56)
+    {
+        if (position_ >= size_ + c_maxOverrun)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        const uint64_t byte = position_ < size_ ? data_[position_] : 0;
+        position_++;
+        bits_ |= byte << bitCount_;
+        bitCount_ += 8;
+    }
+}
+
+uint32_t Inflater::GetBits(unsigned count)
+{
+    if (bitCount_ < count)
+    {
+        Refill();
+    }
+    return TakeBits(count);
+}
+
+uint32_t Inflater::TakeBits(unsigned count)
+{
+    const uint32_t value = static_cast<uint32_t>(bits_ & ((uint64_t(1) << count) - 1));
+    bits_ >>= count;
+    bitCount_ -= count;
+    return value;
+}
+
+uint32_t Inflater::Decode(const HuffmanTable& table)
+{
+    if (bitCount_ < c_maxCodeLength)
+    {
+        Refill();
+    }
+    const uint32_t entry = table.fast[bits_ & ((1u << c_fastBits) - 1)];
+    if (entry)
+    {
+        const unsigned length = (entry >> 16) & 15;
+        bits_ >>= length;
+        bitCount_ -= length;
+        return entry;
+    }
+
+    // Longer codes, walked one bit at a time through the canonical code ranges
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (unsigned length = 1; length <= c_maxCodeLength; length++)
+    {
+        code |= static_cast<int>(bits_ & 1);
+        bits_ >>= 1;
+        bitCount_--;
+        const int count = table.count[length];
+        if (code - count < first)
+        {
+            return table.entries[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    throw std::runtime_error("Inflater");
+}
+
+void Inflater::ReadBlockHeader()
+{
+    lastBlock_ = GetBits(1) != 0;
+    const uint32_t type = GetBits(2);
+    if (type == 0)
+    {
+        // Stored blocks start on a byte boundary, give the whole bytes left in the bit buffer back to the input
+        GetBits(bitCount_ & 7);
+        position_ -= bitCount_ / 8;
+        bits_ = 0;
+        bitCount_ = 0;
+        if (position_ + 4 > size_)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        const uint32_t length = data_[position_] | (data_[position_ + 1] << 8);
+        const uint32_t complement = data_[position_ + 2] | (data_[position_ + 3] << 8);
+        position_ += 4;
+        if ((length ^ 0xFFFF) != complement || position_ + length > size_)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        storedLeft_ = length;
+        state_ = State::Stored;
+    }
+    else if (type == 1)
+    {
+        uint8_t lengths[288 + 30];
+        std::fill(lengths, lengths + 144, uint8_t(8));
+        std::fill(lengths + 144, lengths + 256, uint8_t(9));
+        std::fill(lengths + 256, lengths + 280, uint8_t(7));
+        std::fill(lengths + 280, lengths + 288, uint8_t(8));
+        std::fill(lengths + 288, lengths + 318, uint8_t(5));
+        BuildTable(literals_, lengths, 288, MakeLiteralEntry);
+        BuildTable(distances_, lengths + 288, 30, MakeDistanceEntry);
+        state_ = State::Huffman;
+    }
+    else if (type == 2)
+    {
+        ReadDynamicTables();
+        state_ = State::Huffman;
+    }
+    else
+    {
+        throw std::runtime_error("Inflater");
+    }
+}
+
+void Inflater::ReadDynamicTables()
+{
+    const unsigned literalCount = GetBits(5) + 257;
+    const unsigned distanceCount = GetBits(5) + 1;
+    const unsigned codeLengthCount = GetBits(4) + 4;
+    // The header can count up to 288 literal and 32 distance codes, only 286 and 30 exist
+    if (literalCount > 286 || distanceCount > 30)
+    {
+        throw std::runtime_error("Inflater");
+    }
+
+    uint8_t codeLengthLengths[19] = {};
+    for (unsigned i = 0; i < codeLengthCount; i++)
+    {
+        codeLengthLengths[c_codeLengthOrder[i]] = static_cast<uint8_t>(GetBits(3));
+    }
+    HuffmanTable codeLengths;
+    BuildTable(codeLengths, codeLengthLengths, 19, MakeCodeLengthEntry);
+
+    // Literal and distance code lengths form one sequence, repeats may cross from one to the other
+    uint8_t lengths[286 + 30] = {};
+    const unsigned total = literalCount + distanceCount;
+    unsigned i = 0;
+    while (i < total)
+    {
+        const unsigned symbol = Decode(codeLengths) & 0xFFFF;
+        if (symbol < 16)
+        {
+            lengths[i++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        uint8_t value = 0;
+        unsigned repeat;
+        if (symbol == 16)
+        {
+            if (i == 0)
+            {
+                throw std::runtime_error("Inflater");
+            }
+            value = lengths[i - 1];
+            repeat = 3 + GetBits(2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + GetBits(3);
+        }
+        else
+        {
+            repeat = 11 + GetBits(7);
+        }
+        if (i + repeat > total)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        std::fill(lengths + i, lengths + i + repeat, value);
+        i += repeat;
+    }
+    if (lengths[256] == 0)
+    {
+        throw std::runtime_error("Inflater");
+    }
+    BuildTable(literals_, lengths, literalCount, MakeLiteralEntry);
+    BuildTable(distances_, lengths + literalCount, distanceCount, MakeDistanceEntry);
+}
+
+size_t Inflater::Read(unsigned char* dst, size_t size)
+{
+    size_t produced = 0;
+    while (produced < size && state_ != State::Done)
+    {
+        switch (state_)
+        {
+        case State::BlockHeader:
+            if (lastBlock_)
+            {
+                state_ = State::Done;
+                break;
+            }
+            ReadBlockHeader();
+            break;
+
+        case State::Stored:
+        {
+            const size_t count = std::min(storedLeft_, size - produced);
+            memcpy(dst + produced, data_ + position_, count);
+            produced += count;
+            position_ += count;
+            storedLeft_ -= count;
+            if (!storedLeft_)
+            {
+                state_ = State::BlockHeader;
+            }
+            break;
+        }
+
+        case State::Huffman:
+            produced = ReadHuffman(dst, produced, size);
+            break;
+
+        case State::Done:
+            break;
+        }
+    }
+    UpdateWindow(dst, produced);
+    return produced;
+}
+
+size_t Inflater::ReadHuffman(unsigned char* dst, size_t produced, size_t size)
+{
+    if (copyLength_)
+    {
+        produced = CopyMatch(dst, produced, size);
+    }
+    while (produced < size && state_ == State::Huffman)
+    {
+        produced = ReadFast(dst, produced, size);
+        if (produced < size && state_ == State::Huffman)
+        {
+            produced = ReadSymbol(dst, produced, size);
+        }
+    }
+    return produced;
+}
+
+size_t Inflater::ReadFast(unsigned char* dst, size_t produced, size_t size)
+{
+    // The bit buffer lives in locals here, as members it would be reloaded after every byte written to dst.
+    // Leaves long codes, bad codes and the last input bytes to ReadSymbol
+    constexpr uint64_t fastMask = (1u << c_fastBits) - 1;
+    uint64_t bits = bits_;
+    unsigned bitCount = bitCount_;
+    size_t position = position_;
+    while (produced < size && position + 8 <= size_)
+    {
+        // A length code, its extra bits, a distance code and its extra bits take 48 bits at most
+        if (bitCount < 48)
+        {
+            uint64_t word;
+            memcpy(&word, data_ + position, sizeof(word));
+            bits |= word << bitCount;
+            position += (63 - bitCount) >> 3;
+            bitCount |= 56;
+        }
+
+        const uint32_t entry = literals_.fast[bits & fastMask];
+        if (entry < c_entryMatch)
+        {
+            if (!entry)
+            {
+                break;
+            }
+            const unsigned length = (entry >> 16) & 15;
+            bits >>= length;
+            bitCount -= length;
+            dst[produced++] = static_cast<unsigned char>(entry);
+            continue;
+        }
+        if ((entry & c_entryInvalid) == c_entryEnd)
+        {
+            const unsigned length = (entry >> 16) & 15;
+            bits >>= length;
+            bitCount -= length;
+            state_ = State::BlockHeader;
+            break;
+        }
+        if ((entry & c_entryInvalid) != c_entryMatch)
+        {
+            break;
+        }
+
+        // Nothing is consumed until the distance code is known to be a short one as well
+        uint64_t rest = bits >> ((entry >> 16) & 15);
+        const unsigned lengthExtra = (entry >> 20) & 15;
+        const unsigned matchLength = (entry & 0xFFFF) + static_cast<unsigned>(rest & ((1u << lengthExtra) - 1));
+        rest >>= lengthExtra;
+        const uint32_t distanceEntry = distances_.fast[rest & fastMask];
+        if ((distanceEntry & c_entryInvalid) != c_entryMatch)
+        {
+            break;
+        }
+        rest >>= (distanceEntry >> 16) & 15;
+        const unsigned distanceExtra = (distanceEntry >> 20) & 15;
+        const unsigned distance = (distanceEntry & 0xFFFF) + static_cast<unsigned>(rest & ((1u << distanceExtra) - 1));
+        bitCount -= ((entry >> 16) & 15) + lengthExtra + ((distanceEntry >> 16) & 15) + distanceExtra;
+        bits = rest >> distanceExtra;
+        if (distance <= produced && size - produced >= matchLength + 8)
+        {
+            // The common case of a match inside dst with room to spare, copied in whole words unless it overlaps
+            unsigned char* out = dst + produced;
+            const unsigned char* in = out - distance;
+            produced += matchLength;
+            if (distance >= 8)
+            {
+                for (unsigned i = 0; i < matchLength; i += 8)
+                {
+                    memcpy(out + i, in + i, 8);
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < matchLength; i++)
+                {
+                    out[i] = in[i];
+                }
+            }
+            continue;
+        }
+        if (distance > totalOutput_ + produced)
+        {
+            throw std::runtime_error("Inflater");
+        }
+        copyLength_ = matchLength;
+        copyDistance_ = distance;
+        produced = CopyMatch(dst, produced, size);
+    }
+    bits_ = bits;
+    bitCount_ = bitCount;
+    position_ = position;
+    return produced;
+}
+
+size_t Inflater::ReadSymbol(unsigned char* dst, size_t produced, size_t size)
+{
+    if (bitCount_ < 48)
+    {
+        Refill();
+    }
+    uint32_t entry = Decode(literals_);
+    if (entry < c_entryMatch)
+    {
+        dst[produced++] = static_cast<unsigned char>(entry);
+        return produced;
+    }
+    if ((entry & c_entryInvalid) == c_entryEnd)
+    {
+        state_ = State::BlockHeader;
+        return produced;
+    }
+    if ((entry & c_entryInvalid) != c_entryMatch)
+    {
+        throw std::runtime_error("Inflater");
+    }
+    copyLength_ = (entry & 0xFFFF) + TakeBits((entry >> 20) & 15);
+
+    entry = Decode(distances_);
+    if ((entry & c_entryInvalid) != c_entryMatch)
+    {
+        throw std::runtime_error("Inflater");
+    }
+    copyDistance_ = (entry & 0xFFFF) + TakeBits((entry >> 20) & 15);
+    if (copyDistance_ > totalOutput_ + produced)
+    {
+        throw std::runtime_error("Inflater");
+    }
+    return CopyMatch(dst, produced, size);
+}
+
+size_t Inflater::CopyMatch(unsigned char* dst, size_t produced, size_t size)
+{
+    const size_t count = std::min<size_t>(copyLength_, size - produced);
+    copyLength_ -= static_cast<unsigned>(count);
+    size_t left = count;
+
+    // The start of the match may lie in the output of earlier reads
+    for (; left && copyDistance_ > produced; left--, produced++)
+    {
+        dst[produced] = window_[(windowPosition_ + produced - copyDistance_) & (c_windowSize - 1)];
+    }
+
+    unsigned char* out = dst + produced;
+    const unsigned char* in = out - copyDistance_;
+    produced += left;
+    if (copyDistance_ >= 8 && size - produced >= 8)
+    {
+        // Whole words, the last one may spill past the match into output not written yet
+        for (size_t i = 0; i < left; i += 8)
+        {
+            memcpy(out + i, in + i, 8);
+        }
+    }
+    else if (copyDistance_ == 1)
+    {
+        memset(out, *in, left);
+    }
+    else
+    {
+        // Overlapping matches repeat the last copyDistance_ bytes, which must be copied one at a time
+        for (size_t i = 0; i < left; i++)
+        {
+            out[i] = in[i];
+        }
+    }
+    return produced;
+}
+
+void Inflater::UpdateWindow(const unsigned char* dst, size_t size)
+{
+    totalOutput_ += size;
+    if (size >= c_windowSize)
+    {
+        memcpy(window_.data(), dst + size - c_windowSize, c_windowSize);
+        windowPosition_ = 0;
+        return;
+    }
+    const size_t first = std::min(size, c_windowSize - windowPosition_);
+    memcpy(window_.data() + windowPosition_, dst, first);
+    memcpy(window_.data(), dst + first, size - first);
+    windowPosition_ = (windowPosition_ + size) & (c_windowSize - 1);
+}
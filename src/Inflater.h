@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deflate decoder producing its output in pieces.
+// The whole compressed input is at hand, typically a mapped file, while the output is read in slices of the
+// caller's choosing and only the last 32 KB of it are kept for back references, so decompressing never needs
+// the whole output in memory. Input is loaded 64 bits at a time, Huffman codes of up to c_fastBits bits are
+// decoded with one table lookup and back references are copied straight out of the caller's buffer.
+class Inflater {
+
+public:
+
+    Inflater(const unsigned char* data, size_t size, bool zlibHeader);
+
+    // Decodes up to size bytes into dst, fewer only once the stream ended. Throws on corrupt data
+    size_t Read(unsigned char* dst, size_t size);
+    bool IsFinished()                           const   { return state_ == State::Done; }
+
+private:
+
+    static constexpr unsigned c_fastBits = 10;
+    static constexpr unsigned c_maxCodeLength = 15;
+    static constexpr size_t c_windowSize = 32768;
+
+    // Decoded symbols are entries carrying what the symbol stands for: a literal byte, the base and extra bit
+    // count of a match length or distance, or the end of the block. Entries in the fast table add the code length
+    static constexpr uint32_t c_entryLiteral = 0;
+    static constexpr uint32_t c_entryMatch = 1u << 24;
+    static constexpr uint32_t c_entryEnd = 2u << 24;
+    static constexpr uint32_t c_entryInvalid = 3u << 24;
+
+    // Canonical Huffman code, with a direct lookup table for the short codes
+    struct HuffmanTable {
+        uint32_t fast[1 << c_fastBits];         // Entry | code length << 16, 0 for codes longer than c_fastBits
+        uint16_t count[c_maxCodeLength + 1];    // Number of codes of each length
+        uint32_t entries[288];                  // Entries sorted by code
+    };
+
+    enum class State {
+        BlockHeader,
+        Stored,
+        Huffman,
+        Done,
+    };
+
+    static uint32_t MakeLiteralEntry(size_t symbol);
+    static uint32_t MakeDistanceEntry(size_t symbol);
+    static uint32_t MakeCodeLengthEntry(size_t symbol);
+    static void BuildTable(HuffmanTable& table, const uint8_t* lengths, size_t count, uint32_t (*makeEntry)(size_t symbol));
+    void Refill();
+    uint32_t GetBits(unsigned count);
+    uint32_t TakeBits(unsigned count);
+    uint32_t Decode(const HuffmanTable& table);
+    void ReadBlockHeader();
+    void ReadDynamicTables();
+    size_t ReadHuffman(unsigned char* dst, size_t produced, size_t size);
+    size_t ReadFast(unsigned char* dst, size_t produced, size_t size);
+    size_t ReadSymbol(unsigned char* dst, size_t produced, size_t size);
+    size_t CopyMatch(unsigned char* dst, size_t produced, size_t size);
+    void UpdateWindow(const unsigned char* dst, size_t size);
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t position_ = 0;
+    uint64_t bits_ = 0;
+    unsigned bitCount_ = 0;
+    State state_ = State::BlockHeader;
+    bool lastBlock_ = false;
+    size_t storedLeft_ = 0;
+    unsigned copyLength_ = 0;                   // Back reference still to be copied when the last read ended
+    unsigned copyDistance_ = 0;
+    uint64_t totalOutput_ = 0;                  // Bytes returned by earlier reads
+    HuffmanTable literals_;
+    HuffmanTable distances_;
+    std::vector<unsigned char> window_;         // Output of earlier reads, ring buffer
+    size_t windowPosition_ = 0;
+};
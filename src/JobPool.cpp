@@ -0,0 +1,153 @@
+#include "JobPool.h"
+
+#include <algorithm>
+
+bool JobPool::JobQueue::PushBack(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == Capacity)
+    {
+        return false;
+    }
+    jobs[(head + count) % Capacity] = job;
+    count++;
+    return true;
+}
+
+bool JobPool::JobQueue::PopBack(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+    {
+        return false;
+    }
+    count--;
+    job = jobs[(head + count) % Capacity];
+    return true;
+}
+
+bool JobPool::JobQueue::PopFront(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+    {
+        return false;
+    }
+    job = jobs[head];
+    head = (head + 1) % Capacity;
+    count--;
+    return true;
+}
+
+JobPool::JobPool(size_t workerCount)
+{
+    for (size_t i = 0; i <= workerCount; i++)
+    {
+        queues_.push_back(std::make_unique<JobQueue>());
+    }
+    threads_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        threads_.emplace_back(&JobPool::WorkerLoop, this, i);
+    }
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+size_t JobPool::DefaultWorkerCount()
+{
+    // Leave one core to the thread that submits the work
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void JobPool::Run(size_t count, size_t grain, JobFunction function, void* context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+
+    std::atomic<size_t> remaining{ (count + grain - 1) / grain };
+    const size_t callerQueue = threads_.size();
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        Job job = { function, context, begin, std::min(begin + grain, count), &remaining };
+
+        // Deal the chunks round-robin over every ring, the caller's own included
+        const size_t target = nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        queuedJobs_.fetch_add(1, std::memory_order_acq_rel);
+        if (!queues_[target]->PushBack(job))
+        {
+            queuedJobs_.fetch_sub(1, std::memory_order_acq_rel);
+            function(context, job.begin, job.end);
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    if (!threads_.empty())
+    {
+        // Taking the lock orders the queued jobs before a worker goes back to sleep
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        wakeUp_.notify_all();
+    }
+
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!TryRunJob(callerQueue))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobPool::TryRunJob(size_t queueIndex)
+{
+    Job job;
+    bool found = queues_[queueIndex]->PopBack(job);
+    for (size_t i = 1; !found && i < queues_.size(); i++)
+    {
+        found = queues_[(queueIndex + i) % queues_.size()]->PopFront(job);
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    queuedJobs_.fetch_sub(1, std::memory_order_acq_rel);
+    job.function(job.context, job.begin, job.end);
+    job.remaining->fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void JobPool::WorkerLoop(size_t workerIndex)
+{
+    while (true)
+    {
+        if (TryRunJob(workerIndex))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeUp_.wait(lock, [this] { return stopping_ || queuedJobs_.load(std::memory_order_acquire) > 0; });
+        if (stopping_)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent work-stealing thread pool.
+// Every worker owns a fixed-size job ring, pops its own jobs from the back and steals from the front of the
+// other rings once it runs dry. Threads calling into the pool share one extra ring and help run jobs while
+// they wait, so a pool with zero workers simply runs everything on the caller. Jobs are plain function
+// pointers with a range, pushing them never allocates.
+class JobPool {
+
+public:
+
+    explicit JobPool(size_t workerCount = DefaultWorkerCount());
+    ~JobPool();
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    static size_t DefaultWorkerCount();
+    size_t GetWorkerCount() const { return threads_.size(); }
+
+    // Runs body(begin, end) over [0, count) in chunks of grain items and returns once every chunk ran
+    template <typename Body>
+    void ParallelFor(size_t count, size_t grain, Body&& body)
+    {
+        using BodyType = std::remove_reference_t<Body>;
+        auto invoke = [](void* context, size_t begin, size_t end) { (*static_cast<BodyType*>(context))(begin, end); };
+        Run(count, grain, invoke, const_cast<void*>(static_cast<const void*>(&body)));
+    }
+
+private:
+
+    using JobFunction = void (*)(void* context, size_t begin, size_t end);
+
+    struct Job {
+        JobFunction function;
+        void* context;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    struct JobQueue {
+        static constexpr size_t Capacity = 1024;
+        std::mutex mutex;
+        Job jobs[Capacity];
+        size_t head = 0;
+        size_t count = 0;
+
+        bool PushBack(const Job& job);
+        bool PopBack(Job& job);
+        bool PopFront(Job& job);
+    };
+
+    void Run(size_t count, size_t grain, JobFunction function, void* context);
+    bool TryRunJob(size_t queueIndex);
+    void WorkerLoop(size_t workerIndex);
+
+    std::vector<std::unique_ptr<JobQueue>> queues_;    // One per worker, then one shared by calling threads
+    std::vector<std::thread> threads_;
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUp_;
+    std::atomic<size_t> queuedJobs_{ 0 };
+    std::atomic<size_t> nextQueue_{ 0 };
+    bool stopping_ = false;
+};
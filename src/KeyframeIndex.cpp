@@ -0,0 +1,173 @@
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    // Keys a cursor steps over before giving up and binary searching the rest
+    constexpr uint32_t c_cursorSteps = 4;
+
+    struct TrackKey {
+        uint32_t frame;
+        uint32_t positionId;
+        uint32_t orientationId;
+    };
+}
+
+KeyframeIndex::KeyframeIndex(const m3d_t* model, M3D_INDEX actionId)
+{
+    if (actionId >= model->numaction)
+    {
+        throw std::runtime_error("KeyframeIndex");
+    }
+    const m3da_t& action = model->action[actionId];
+    duration_ = action.durationmsec;
+
+    // Each track starts with the bind transform, a frame listing a bone twice keeps the last value like m3d_pose
+    const size_t boneCount = model->numbone;
+    std::vector<std::vector<TrackKey>> tracks(boneCount);
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        tracks[i].push_back({ 0, model->bone[i].pos, model->bone[i].ori });
+    }
+
+    frameTimes_.resize(action.numframe);
+    frameTimeBounds_.resize(action.numframe);
+    for (uint32_t f = 0; f < action.numframe; f++)
+    {
+        const m3dfr_t& frame = action.frame[f];
+        frameTimes_[f] = frame.msec;
+        frameTimeBounds_[f] = f > 0 ? std::max(frameTimeBounds_[f - 1], frame.msec) : frame.msec;
+        for (M3D_INDEX i = 0; i < frame.numtransform; i++)
+        {
+            const m3dtr_t& transform = frame.transform[i];
+            if (transform.boneid >= boneCount)
+            {
+                continue;
+            }
+            std::vector<TrackKey>& track = tracks[transform.boneid];
+            if (track.size() > 1 && track.back().frame == f)
+            {
+                track.pop_back();
+            }
+            track.push_back({ f, transform.pos, transform.ori });
+        }
+    }
+
+    trackOffsets_.push_back(0);
+    for (const std::vector<TrackKey>& track : tracks)
+    {
+        for (const TrackKey& key : track)
+        {
+            const m3dv_t& pos = model->vertex[key.positionId];
+            const m3dv_t& ori = model->vertex[key.orientationId];
+            keyFrames_.push_back(key.frame);
+            keyPositionIds_.push_back(key.positionId);
+            keyOrientationIds_.push_back(key.orientationId);
+            keyTransforms_.push_back({ { pos.x, pos.y, pos.z }, { ori.x, ori.y, ori.z, ori.w } });
+        }
+        trackOffsets_.push_back(static_cast<uint32_t>(keyFrames_.size()));
+    }
+}
+
+void KeyframeIndex::Sample(uint32_t msec, KeyframeCursor& cursor, BoneTransform* out) const
+{
+    const size_t boneCount = GetBoneCount();
+    if (cursor.keys.size() != boneCount)
+    {
+        cursor.frame = 0;
+        cursor.keys.assign(trackOffsets_.begin(), trackOffsets_.begin() + boneCount);
+    }
+    const uint32_t frameCount = static_cast<uint32_t>(frameTimes_.size());
+    if (frameCount == 0)
+    {
+        for (size_t i = 0; i < boneCount; i++)
+        {
+            out[i] = keyTransforms_[trackOffsets_[i]];
+        }
+        return;
+    }
+
+    // The pose sits between the last frame at or before msec and the one after it, wrapping to the first frame
+    msec = duration_ > 0 ? msec % duration_ : 0;
+    const uint32_t frame = FindFrame(msec, cursor.frame);
+    cursor.frame = frame;
+    const uint32_t frameTime = frame > 0 ? frameTimes_[frame - 1] : 0;
+    const uint32_t nextFrame = frame % frameCount;
+    const uint32_t nextFrameTime = frameTimes_[nextFrame];
+    const bool interpolate = frameTime != msec;
+    const float t = frameTime >= nextFrameTime ? 1.0f : static_cast<float>(msec - frameTime) / static_cast<float>(nextFrameTime - frameTime);
+
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        const uint32_t key = FindKey(i, frame, cursor.keys[i]);
+        cursor.keys[i] = key;
+        out[i] = keyTransforms_[key];
+        if (!interpolate)
+        {
+            continue;
+        }
+
+        // The bone only moves if the next frame has a key for it
+        const uint32_t candidate = frame < frameCount ? key + 1 : trackOffsets_[i] + 1;
+        if (candidate >= trackOffsets_[i + 1] || keyFrames_[candidate] != nextFrame)
+        {
+            continue;
+        }
+        if (keyPositionIds_[key] != keyPositionIds_[candidate])
+        {
+            LerpBonePosition(keyTransforms_[key], keyTransforms_[candidate], t, out[i]);
+        }
+        if (keyOrientationIds_[key] != keyOrientationIds_[candidate])
+        {
+            NlerpBoneOrientation(keyTransforms_[key], keyTransforms_[candidate], t, out[i]);
+        }
+    }
+}
+
+size_t KeyframeIndex::GetMemorySize() const
+{
+    return (frameTimes_.size() + frameTimeBounds_.size() + trackOffsets_.size()) * sizeof(uint32_t) +
+        (keyFrames_.size() + keyPositionIds_.size() + keyOrientationIds_.size()) * sizeof(uint32_t) +
+        keyTransforms_.size() * sizeof(BoneTransform);
+}
+
+uint32_t KeyframeIndex::FindFrame(uint32_t msec, uint32_t hint) const
+{
+    // Number of frames m3d_pose would apply, it stops at the first frame later than msec
+    const uint32_t frameCount = static_cast<uint32_t>(frameTimeBounds_.size());
+    uint32_t first = 0;
+    if (hint <= frameCount && (hint == 0 || frameTimeBounds_[hint - 1] <= msec))
+    {
+        for (uint32_t step = 0; step < c_cursorSteps; step++, hint++)
+        {
+            if (hint == frameCount || frameTimeBounds_[hint] > msec)
+            {
+                return hint;
+            }
+        }
+        first = hint;
+    }
+    return static_cast<uint32_t>(std::upper_bound(frameTimeBounds_.begin() + first, frameTimeBounds_.end(), msec) - frameTimeBounds_.begin());
+}
+
+uint32_t KeyframeIndex::FindKey(size_t bone, uint32_t frame, uint32_t hint) const
+{
+    // Last key of the track set before frame, the bind key if there is none
+    const uint32_t begin = trackOffsets_[bone];
+    const uint32_t end = trackOffsets_[bone + 1];
+    uint32_t first = begin + 1;
+    if (hint >= begin && hint < end && (hint == begin || keyFrames_[hint] < frame))
+    {
+        for (uint32_t step = 0; step < c_cursorSteps; step++, hint++)
+        {
+            if (hint + 1 == end || keyFrames_[hint + 1] >= frame)
+            {
+                return hint;
+            }
+        }
+        first = hint;
+    }
+    return static_cast<uint32_t>(std::lower_bound(keyFrames_.begin() + first, keyFrames_.begin() + end, frame) - keyFrames_.begin()) - 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "m3d/m3d.h"
+#include "AnimationPose.h"
+
+// Where the last sample of an action landed, so the next one can resume from there
+struct KeyframeCursor {
+    uint32_t frame = 0;             // Number of frames applied
+    std::vector<uint32_t> keys;     // Current key of every bone track
+};
+
+// Per-bone keyframe tracks of one M3D action, built once at load time.
+// An M3D frame only lists the bones it moves, and m3d_pose replays every frame from the start of the action
+// up to the sampled time. Here each bone keeps the sorted list of values it takes instead, starting with its
+// bind transform, so a sample binary searches the frame and each track, or steps forward from the cursor
+// when time moves forward. Values are copied out of the model and samples match m3d_pose.
+class KeyframeIndex {
+
+public:
+
+    KeyframeIndex() = default;
+    KeyframeIndex(const m3d_t* model, M3D_INDEX actionId);
+    void Sample(uint32_t msec, KeyframeCursor& cursor, BoneTransform* out) const;
+
+    uint32_t GetDuration()                      const   { return duration_; }
+    size_t GetFrameCount()                      const   { return frameTimes_.size(); }
+    uint32_t GetFrameTime(size_t frame)         const   { return frameTimes_[frame]; }
+    size_t GetBoneCount()                       const   { return trackOffsets_.empty() ? 0 : trackOffsets_.size() - 1; }
+    size_t GetKeyCount()                        const   { return keyFrames_.size(); }
+    size_t GetMemorySize() const;
+
+private:
+
+    uint32_t FindFrame(uint32_t msec, uint32_t hint) const;
+    uint32_t FindKey(size_t bone, uint32_t frame, uint32_t hint) const;
+
+    uint32_t duration_ = 0;
+    std::vector<uint32_t> frameTimes_;
+    std::vector<uint32_t> frameTimeBounds_;     // Running maximum of the frame times, which the frame search runs on
+    std::vector<uint32_t> trackOffsets_;        // First key of every bone, then the total key count
+    std::vector<uint32_t> keyFrames_;           // Frame setting each key, unused for the leading bind keys
+    std::vector<uint32_t> keyPositionIds_;      // M3D vertex ids, only compared to tell whether two keys differ
+    std::vector<uint32_t> keyOrientationIds_;
+    std::vector<BoneTransform> keyTransforms_;
+};
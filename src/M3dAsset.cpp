@@ -0,0 +1,469 @@
+#include "M3dChunkStream.h"
+
+// Compressed bodies parsed as a whole are inflated by the table driven decoder rather than the built-in one
+#define M3D_INFLATE InflateM3dBody
+#define M3D_IMPLEMENTATION
+#include "m3d/m3d.h"
+
+#include "M3dAsset.h"
+#include "AssetCache.h"
+#include "AssetLoader.h"
+#include "VertexWelder.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    constexpr size_t c_fileHeaderSize = 8;     // Magic and length, followed by the possibly compressed chunks
+
+    // m3d_load hands back what it parsed along with an error code. A texture, procedure or material property it
+    // could not use only costs the model that one, every other error leaves faces that cannot be built from.
+    // M3D does not check the vertex indices of faces, bones and keyframes either, the asset reads through them
+    bool IsUsableModel(const m3d_t* model)
+    {
+        if (model->errcode != M3D_SUCCESS && model->errcode != M3D_ERR_UNKIMG && model->errcode != M3D_ERR_UNKPROP &&
+            model->errcode != M3D_ERR_UNIMPL)
+        {
+            return false;
+        }
+        for (M3D_INDEX f = 0; f < model->numface; f++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                if (model->face[f].vertex[i] >= model->numvertex || model->face[f].normal[i] >= model->numvertex)
+                {
+                    return false;
+                }
+            }
+        }
+        for (M3D_INDEX b = 0; b < model->numbone; b++)
+        {
+            if (model->bone[b].pos >= model->numvertex || model->bone[b].ori >= model->numvertex)
+            {
+                return false;
+            }
+        }
+        for (M3D_INDEX a = 0; a < model->numaction; a++)
+        {
+            for (M3D_INDEX f = 0; f < model->action[a].numframe; f++)
+            {
+                const m3dfr_t& frame = model->action[a].frame[f];
+                for (M3D_INDEX t = 0; t < frame.numtransform; t++)
+                {
+                    if (frame.transform[t].pos >= model->numvertex || frame.transform[t].ori >= model->numvertex)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+}
+
+M3dAsset::M3dAsset(std::vector<unsigned char> data) :
+    data_(std::move(data))
+{
+    // ASCII models are parsed as a zero terminated string
+    const size_t size = data_.size();
+    data_.push_back(0);
+    Parse(data_.data(), size);
+    CopyModelInfo();
+}
+
+M3dAsset::M3dAsset(MappedFile file, bool streamed) :
+    file_(std::move(file))
+{
+    bool compressed;
+    if (streamed && file_.GetSize() >= 4 && !memcmp(file_.GetData(), "3DMO", 4))
+    {
+        ParseStreamed(file_.GetData(), file_.GetSize());
+        compressed = !chunks_.empty();
+    }
+    else
+    {
+        Parse(file_.GetData(), file_.GetSize());
+        compressed = (model_->flags & M3D_FLG_FREERAW) != 0;
+    }
+
+    // Compressed models are inflated into buffers of their own, the mapping is only needed by a preview image
+    if (compressed && !model_->preview.data)
+    {
+        file_ = MappedFile();
+    }
+    CopyModelInfo();
+}
+
+M3dAsset::M3dAsset(CacheReader& reader)
+{
+    uint64_t faceCount;
+    uint64_t materialCount;
+    reader.Read(faceCount);
+    reader.Read(materialCount);
+    faceCount_ = static_cast<size_t>(faceCount);
+    materialCount_ = static_cast<size_t>(materialCount);
+    reader.Read(textureNames_);
+    reader.Read(boneNames_);
+    reader.Read(animNames_);
+    reader.Read(vertices_);
+    reader.Read(indices_);
+    reader.Read(shortIndices_);
+    reader.Read(parts_);
+    skinning_ = SkinningContext(reader);
+    animPose_ = AnimationPose(reader);
+    uint64_t animationCount;
+    reader.Read(animationCount);
+    if (animationCount != animNames_.size())
+    {
+        throw std::runtime_error("M3dAsset");
+    }
+    animations_.reserve(animNames_.size());
+    for (size_t i = 0; i < animNames_.size(); i++)
+    {
+        animations_.emplace_back(reader);
+    }
+
+    // The buffers end up on the GPU as they are, every part must stay within them
+    const size_t boneCount = boneNames_.size();
+    if (skinning_.GetVertexCount() != vertices_.size() || skinning_.GetBoneCount() != boneCount || animPose_.GetBoneCount() != boneCount)
+    {
+        throw std::runtime_error("M3dAsset");
+    }
+    const size_t indexCount = shortIndices_.empty() ? indices_.size() : shortIndices_.size();
+    for (const MeshPartRange& part : parts_)
+    {
+        if (static_cast<size_t>(part.startIndex) + part.indexCount > indexCount ||
+            static_cast<size_t>(part.vertexOffset) + part.vertexCount > vertices_.size())
+        {
+            throw std::runtime_error("M3dAsset");
+        }
+    }
+    for (const BakedClip& animation : animations_)
+    {
+        if (animation.GetBoneCount() != boneCount)
+        {
+            throw std::runtime_error("M3dAsset");
+        }
+    }
+}
+
+void M3dAsset::Save(CacheWriter& writer) const
+{
+    writer.Write(static_cast<uint64_t>(faceCount_));
+    writer.Write(static_cast<uint64_t>(materialCount_));
+    writer.Write(textureNames_);
+    writer.Write(boneNames_);
+    writer.Write(animNames_);
+    writer.Write(vertices_);
+    writer.Write(indices_);
+    writer.Write(shortIndices_);
+    writer.Write(parts_);
+    skinning_.Save(writer);
+    animPose_.Save(writer);
+    writer.Write(static_cast<uint64_t>(animations_.size()));
+    for (const BakedClip& animation : animations_)
+    {
+        animation.Save(writer);
+    }
+}
+
+void M3dAsset::CopyModelInfo()
+{
+    // Kept apart from the model, so that assets read from a cache provide them as well
+    faceCount_ = model_->numface;
+    materialCount_ = model_->nummaterial;
+    for (M3D_INDEX i = 0; i < model_->numtexture; i++)
+    {
+        textureNames_.push_back(model_->texture[i].name ? model_->texture[i].name : "");
+    }
+    for (M3D_INDEX i = 0; i < model_->numbone; i++)
+    {
+        boneNames_.push_back(model_->bone[i].name ? model_->bone[i].name : "");
+    }
+    for (M3D_INDEX i = 0; i < model_->numaction; i++)
+    {
+        animNames_.push_back(model_->action[i].name ? model_->action[i].name : "");
+    }
+}
+
+void M3dAsset::Parse(unsigned char* data, size_t size)
+{
+    // m3d_load trusts the length in the binary header, which must not run past the end of the file
+    if (size < c_fileHeaderSize)
+    {
+        throw std::runtime_error("M3dAsset");
+    }
+    if (!memcmp(data, "3DMO", 4))
+    {
+        uint32_t length;
+        memcpy(&length, data + 4, sizeof(length));
+        if (length < c_fileHeaderSize || length > size)
+        {
+            throw std::runtime_error("M3dAsset");
+        }
+    }
+    model_ = m3d_load(data, nullptr, nullptr, nullptr);
+    if (!model_)
+    {
+        throw std::runtime_error("M3dAsset");
+    }
+    if (!IsUsableModel(model_))
+    {
+        m3d_free(model_);
+        model_ = nullptr;
+        throw std::runtime_error("M3dAsset");
+    }
+}
+
+void M3dAsset::ParseStreamed(unsigned char* data, size_t size)
+{
+    // Peak memory stays at the largest inflated chunk, plus the few chunks the model points into: the header,
+    // color map, inlined assets and unknown chunks
+    {
+        M3dChunkStream stream(data, size);
+        stream.Next();
+        unsigned char* head = stream.GetChunk();
+        if (stream.IsCompressed())
+        {
+            chunks_.push_back(stream.TakeChunk());
+        }
+        model_ = m3d_loadhead(head, nullptr);
+        if (!model_)
+        {
+            throw std::runtime_error("M3dAsset");
+        }
+        model_->preview.data = stream.GetPreview();
+        model_->preview.length = static_cast<uint32_t>(stream.GetPreviewSize());
+
+        try
+        {
+            while (stream.Next())
+            {
+                const int result = m3d_loadchunk(model_, stream.GetChunk(), nullptr, nullptr);
+                if (result == M3D_CHUNK_KEEP && stream.IsCompressed())
+                {
+                    chunks_.push_back(stream.TakeChunk());
+                }
+                else if (result == M3D_CHUNK_STOP)
+                {
+                    break;
+                }
+                else if (result == M3D_CHUNK_ABORT)
+                {
+                    // The model stopped half parsed, without the post-processing that fills in missing normals
+                    throw std::runtime_error("M3dAsset");
+                }
+            }
+        }
+        catch (...)
+        {
+            m3d_free(model_);
+            model_ = nullptr;
+            throw;
+        }
+    }
+
+    // The chunk buffer is gone by now, post-processing allocates the missing normals
+    m3d_loadend(model_);
+    if (!IsUsableModel(model_))
+    {
+        m3d_free(model_);
+        model_ = nullptr;
+        throw std::runtime_error("M3dAsset");
+    }
+}
+
+M3dAsset::~M3dAsset()
+{
+    if (model_)
+    {
+        m3d_free(model_);
+    }
+}
+
+M3dAsset::M3dAsset(M3dAsset&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+M3dAsset& M3dAsset::operator=(M3dAsset&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (model_)
+        {
+            m3d_free(model_);
+        }
+        // Moving the vector keeps its storage, so the model's pointers into it stay valid
+        data_ = std::move(other.data_);
+        file_ = std::move(other.file_);
+        chunks_ = std::move(other.chunks_);
+        model_ = std::exchange(other.model_, nullptr);
+        faceCount_ = other.faceCount_;
+        materialCount_ = other.materialCount_;
+        textureNames_ = std::move(other.textureNames_);
+        boneNames_ = std::move(other.boneNames_);
+        animNames_ = std::move(other.animNames_);
+        vertices_ = std::move(other.vertices_);
+        indices_ = std::move(other.indices_);
+        shortIndices_ = std::move(other.shortIndices_);
+        parts_ = std::move(other.parts_);
+        skinning_ = std::move(other.skinning_);
+        animPose_ = std::move(other.animPose_);
+        animations_ = std::move(other.animations_);
+        blender_ = std::move(other.blender_);
+        skinnedPose_ = std::move(other.skinnedPose_);
+        skinCount_ = other.skinCount_;
+        skipCount_ = other.skipCount_;
+    }
+    return *this;
+}
+
+void M3dAsset::BuildMesh(float weldEpsilon, bool preferShortIndices, float animSampleRate, LoadProgress* progress)
+{
+    // Cached assets come built, without the model to build from
+    if (!model_)
+    {
+        throw std::runtime_error("M3dAsset");
+    }
+    vertices_.clear();
+    skinnedPose_.clear();
+    indices_.clear();
+    shortIndices_.clear();
+    parts_.clear();
+
+    const size_t faceCount = model_->numface;
+    VertexWelder welder(faceCount * 3, weldEpsilon);
+    indices_.reserve(faceCount * 3);
+    std::vector<uint32_t> vertexMap;
+    std::vector<uint32_t> normalMap;
+
+    // See M3D specification: https://gitlab.com/bztsrc/model3d/-/blob/master/docs/m3d_format.md
+    for (size_t f = 0; f < faceCount; f++)
+    {
+        const m3df_t& face = model_->face[f];
+        float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        if (face.materialid < model_->nummaterial)
+        {
+            const m3dm_t& material = model_->material[face.materialid];
+            for (int i = 0; i < material.numprop; i++)
+            {
+                if (material.prop[i].type == m3dp_Kd)
+                {
+                    const uint32_t packed = material.prop[i].value.color;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        color[c] = ((packed >> (c * 8)) & 0xFF) / 255.0f;
+                    }
+                    break;
+                }
+            }
+        }
+        for (int i : { 0, 1, 2 })
+        {
+            const m3dv_t& position = model_->vertex[face.vertex[i]];
+            const m3dv_t& normal = model_->vertex[face.normal[i]];
+            const bool textured = face.texcoord[i] < model_->numtmap;
+            const MeshVertex vertex = {
+                { position.x, position.y, position.z },
+                { normal.x, normal.y, normal.z },
+                { color[0], color[1], color[2], color[3] },
+                { textured ? model_->tmap[face.texcoord[i]].u : 0.0f, 1 - (textured ? model_->tmap[face.texcoord[i]].v : 0.0f) }
+            };
+            const float vertexKey[VertexWelder::KeySize] = {
+                vertex.position[0], vertex.position[1], vertex.position[2],
+                vertex.normal[0], vertex.normal[1], vertex.normal[2],
+                vertex.textureCoordinate[0], vertex.textureCoordinate[1]
+            };
+
+            bool inserted;
+            const uint32_t weldedIndex = welder.Weld(vertexKey, inserted);
+            indices_.push_back(weldedIndex);
+            if (inserted)
+            {
+                vertices_.push_back(vertex);
+                vertexMap.push_back(face.vertex[i]);
+                normalMap.push_back(face.normal[i]);
+            }
+        }
+    }
+
+    // Pick the index format from the welded vertex count. Meshes too large for 16-bit indices either keep
+    // 32-bit indices or, when bandwidth matters more than draw count, get split into several 16-bit parts
+    const uint32_t indexCount = static_cast<uint32_t>(indices_.size());
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices_.size());
+    if (vertices_.size() <= c_maxShortIndexVertices)
+    {
+        shortIndices_.assign(indices_.begin(), indices_.end());
+        parts_.push_back({ 0, indexCount, 0, vertexCount });
+    }
+    else if (preferShortIndices)
+    {
+        PartitionedMesh partitioned = PartitionForShortIndices(indices_, vertices_.size());
+        std::vector<MeshVertex> partVertices;
+        std::vector<uint32_t> partVertexMap;
+        std::vector<uint32_t> partNormalMap;
+        partVertices.reserve(partitioned.vertexRemap.size());
+        partVertexMap.reserve(partitioned.vertexRemap.size());
+        partNormalMap.reserve(partitioned.vertexRemap.size());
+        for (uint32_t src : partitioned.vertexRemap)
+        {
+            partVertices.push_back(vertices_[src]);
+            partVertexMap.push_back(vertexMap[src]);
+            partNormalMap.push_back(normalMap[src]);
+        }
+        std::swap(vertices_, partVertices);
+        std::swap(vertexMap, partVertexMap);
+        std::swap(normalMap, partNormalMap);
+        shortIndices_ = std::move(partitioned.indices);
+        parts_ = std::move(partitioned.parts);
+    }
+    else
+    {
+        parts_.push_back({ 0, indexCount, 0, vertexCount });
+    }
+
+    if (progress)
+    {
+        progress->Begin(LoadStage::Skeleton);
+    }
+
+    // Gather the bind-pose data used to skin each vertex of the buffer
+    skinning_ = SkinningContext(model_, vertexMap, normalMap);
+
+    // Bake every action into dense tracks once, so playing them never goes back to the M3D frames
+    animPose_ = AnimationPose(model_);
+    animations_.clear();
+    for (M3D_INDEX i = 0; i < model_->numaction; i++)
+    {
+        animations_.emplace_back(KeyframeIndex(model_, i), animSampleRate);
+    }
+}
+
+bool M3dAsset::Animate(JobPool* jobPool)
+{
+    // Get the animation-pose skeleton, blended when fading or layered
+    if (!blender_.Evaluate(animations_, animPose_, animPose_.GetLocalTransforms()))
+    {
+        return false;
+    }
+
+    // Sampling is cheap next to skinning, comparing what it gives catches every state that lands on the same pose
+    const BoneTransform* pose = animPose_.GetLocalTransforms();
+    const size_t boneCount = animPose_.GetBoneCount();
+    if (skinnedPose_.size() == boneCount && !memcmp(skinnedPose_.data(), pose, boneCount * sizeof(BoneTransform)))
+    {
+        skipCount_++;
+        return false;
+    }
+    skinnedPose_.assign(pose, pose + boneCount);
+    animPose_.UpdateBoneMatrices();
+
+    // Convert mesh vertices from bind pose to animation pose, in place
+    const SkinnedVertexLayout layout = { sizeof(MeshVertex), offsetof(MeshVertex, position), offsetof(MeshVertex, normal) };
+    skinning_.Skin(animPose_.GetBoneMatrices(), vertices_.data(), layout, jobPool);
+    skinCount_++;
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "m3d/m3d.h"
+#include "AnimationBlender.h"
+#include "AnimationPose.h"
+#include "BakedClip.h"
+#include "MappedFile.h"
+#include "MeshPartitioner.h"
+#include "SkinningContext.h"
+
+class CacheReader;
+class CacheWriter;
+class JobPool;
+class LoadProgress;
+
+// Vertex of the built mesh, laid out like DirectX::VertexPositionNormalColorTexture
+struct MeshVertex {
+    float position[3];
+    float normal[3];
+    float color[4];
+    float textureCoordinate[2];
+};
+
+// The CPU side of an M3D model, free of any graphics API.
+// Owns the parsed model along with the file contents it points into, welds the faces into an indexed mesh,
+// bakes the actions and skins the mesh at the current animation time.
+// Models loaded from a mapped file are parsed in place, uncompressed ones never get copied to the heap and
+// compressed ones are inflated one chunk at a time rather than as a whole.
+// Assets read back from a cache come already built and have no M3D model, only what was copied out of it.
+class M3dAsset {
+
+public:
+
+    M3dAsset() = default;
+    explicit M3dAsset(std::vector<unsigned char> data);
+    explicit M3dAsset(MappedFile file, bool streamed = true);
+    explicit M3dAsset(CacheReader& reader);
+    ~M3dAsset();
+
+    M3dAsset(M3dAsset&& other) noexcept;
+    M3dAsset& operator=(M3dAsset&& other) noexcept;
+    M3dAsset(const M3dAsset&) = delete;
+    M3dAsset& operator=(const M3dAsset&) = delete;
+
+    // Reports the weld and skeleton stages to progress when given one
+    void BuildMesh(float weldEpsilon = 0.0f, bool preferShortIndices = false, float animSampleRate = 0.0f, LoadProgress* progress = nullptr);
+    void UpdateAnimTime(float elapsedTime)              { blender_.Update(elapsedTime); }
+    void SetAnimIdx(int idx)                            { blender_.Play(idx); }
+    // Blends from the current action into idx over duration milliseconds rather than switching at once
+    void CrossFadeAnim(int idx, float duration)         { blender_.CrossFade(idx, duration); }
+    // Skins the vertices to the pose of the current animation state, returns whether they changed.
+    // A pose the vertices already show, when paused or between two updates, is skipped
+    bool Animate(JobPool* jobPool = nullptr);
+    // Writes the built mesh, skeleton and baked actions, read back by the CacheReader constructor.
+    // Vertices are written as they are, an asset is saved before it gets animated
+    void Save(CacheWriter& writer) const;
+
+    const m3d_t* GetModel()                     const   { return model_; }
+    size_t GetFaceCount()                       const   { return faceCount_; }
+    size_t GetMaterialCount()                   const   { return materialCount_; }
+    const std::vector<std::string>& GetTextureNames()   const   { return textureNames_; }
+    const std::vector<std::string>& GetBoneNames()      const   { return boneNames_; }
+    const BoneHierarchy& GetBoneHierarchy()     const   { return animPose_.GetHierarchy(); }
+    const float* GetInverseBindMatrices()       const   { return skinning_.GetInverseBindPose(); }
+    const std::vector<std::string>& GetAnimNames()      const   { return animNames_; }
+    int GetAnimIdx()                            const   { return blender_.GetAnimIdx(); }
+    float GetAnimTime()                         const   { return blender_.GetAnimTime(); }
+    AnimationBlender& GetBlender()                      { return blender_; }
+    // Calls to Animate that skinned the vertices, and those that found them already in pose
+    uint64_t GetSkinCount()                     const   { return skinCount_; }
+    uint64_t GetSkipCount()                     const   { return skipCount_; }
+    const std::vector<MeshVertex>& GetVertices()        const   { return vertices_; }
+    const std::vector<uint32_t>& GetIndices()           const   { return indices_; }
+    const std::vector<uint16_t>& GetShortIndices()      const   { return shortIndices_; }
+    bool HasShortIndices()                              const   { return !shortIndices_.empty(); }
+    const std::vector<MeshPartRange>& GetParts()        const   { return parts_; }
+    const std::vector<BakedClip>& GetAnimations()       const   { return animations_; }
+    const AnimationPose& GetPose()                      const   { return animPose_; }
+    SkinningContext& GetSkinning()                              { return skinning_; }
+    const SkinningContext& GetSkinning()                const   { return skinning_; }
+
+private:
+
+    void Parse(unsigned char* data, size_t size);
+    void ParseStreamed(unsigned char* data, size_t size);
+    void CopyModelInfo();
+
+    // M3D keeps pointers into the file contents of uncompressed models, held by one of these
+    std::vector<unsigned char> data_;
+    MappedFile file_;
+    std::vector<std::vector<unsigned char>> chunks_;    // Inflated chunks the model points into
+    m3d_t* model_ = nullptr;
+    size_t faceCount_ = 0;
+    size_t materialCount_ = 0;
+    std::vector<std::string> textureNames_;
+    std::vector<std::string> boneNames_;
+    std::vector<std::string> animNames_;
+    std::vector<MeshVertex> vertices_;
+    std::vector<uint32_t> indices_;
+    std::vector<uint16_t> shortIndices_;    // Only filled when every part fits 16-bit indices
+    std::vector<MeshPartRange> parts_;
+    SkinningContext skinning_;
+    AnimationPose animPose_;
+    std::vector<BakedClip> animations_;
+    AnimationBlender blender_;
+    std::vector<BoneTransform> skinnedPose_;    // Local transforms the vertices were last skinned to, empty in bind pose
+    uint64_t skinCount_ = 0;
+    uint64_t skipCount_ = 0;
+};
@@ -0,0 +1,198 @@
+#include "M3dChunkStream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t c_chunkHeaderSize = 8;     // Magic and length
+    constexpr size_t c_maxDeflateRatio = 1032;  // Deflate never expands its input by more than this
+    constexpr size_t c_expectedDeflateRatio = 4;    // Inflated bytes per packed byte few model bodies exceed
+
+    uint32_t GetChunkLength(const unsigned char* chunk)
+    {
+        uint32_t length;
+        memcpy(&length, chunk + 4, sizeof(length));
+        return length;
+    }
+}
+
+M3dChunkStream::M3dChunkStream(unsigned char* data, size_t size)
+{
+    if (size < c_chunkHeaderSize || memcmp(data, "3DMO", 4) != 0)
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    const uint32_t length = GetChunkLength(data);
+    if (length < c_chunkHeaderSize || length > size)
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    body_ = data + c_chunkHeaderSize;
+    end_ = data + length;
+
+    // The optional preview stays uncompressed in front of the body
+    if (end_ - body_ >= static_cast<ptrdiff_t>(c_chunkHeaderSize) && !memcmp(body_, "PRVW", 4))
+    {
+        previewSize_ = GetChunkLength(body_);
+        if (previewSize_ < c_chunkHeaderSize || previewSize_ > static_cast<size_t>(end_ - body_))
+        {
+            throw std::runtime_error("M3dChunkStream");
+        }
+        preview_ = body_ + c_chunkHeaderSize;
+        body_ += previewSize_;
+    }
+
+    if (end_ - body_ >= 4 && !memcmp(body_, "HEAD", 4))
+    {
+        // Like m3d_load, an uncompressed body has to close with the end chunk
+        if (end_ - body_ < static_cast<ptrdiff_t>(c_chunkHeaderSize) || memcmp(end_ - 4, "OMD3", 4) != 0)
+        {
+            throw std::runtime_error("M3dChunkStream");
+        }
+    }
+    else
+    {
+        inflater_.emplace(body_, static_cast<size_t>(end_ - body_), true);
+    }
+}
+
+bool M3dChunkStream::Next()
+{
+    const bool first = chunk_ == nullptr;
+    const bool found = inflater_ ? NextInflated() : NextInPlace();
+    if (first && (!found || memcmp(chunk_, "HEAD", 4) != 0))
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    if (found && chunkSize_ > largestChunkSize_)
+    {
+        largestChunkSize_ = chunkSize_;
+    }
+    return found;
+}
+
+bool M3dChunkStream::NextInPlace()
+{
+    unsigned char* chunk = chunk_ ? chunk_ + chunkSize_ : body_;
+    if (end_ - chunk < static_cast<ptrdiff_t>(c_chunkHeaderSize) || !memcmp(chunk, "OMD3", 4))
+    {
+        return false;
+    }
+
+    // A chunk reaching the end chunk is invalid, m3d_load stops there and keeps what it parsed so far
+    const uint32_t length = GetChunkLength(chunk);
+    if (length < c_chunkHeaderSize || length >= static_cast<size_t>(end_ - chunk))
+    {
+        return false;
+    }
+    chunk_ = chunk;
+    chunkSize_ = length;
+    return true;
+}
+
+bool M3dChunkStream::NextInflated()
+{
+    // Chunk magic first, the end chunk has no length
+    unsigned char header[c_chunkHeaderSize];
+    if (inflater_->Read(header, 4) != 4)
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    if (!memcmp(header, "OMD3", 4))
+    {
+        return false;
+    }
+    if (inflater_->Read(header + 4, 4) != 4)
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    const uint32_t length = GetChunkLength(header);
+    if (length < c_chunkHeaderSize || length / c_maxDeflateRatio > static_cast<size_t>(end_ - body_))
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+
+    // The old buffer goes before the larger one is allocated, so the two never add up
+    if (buffer_.size() < length)
+    {
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        buffer_.resize(length);
+    }
+    memcpy(buffer_.data(), header, c_chunkHeaderSize);
+    if (inflater_->Read(buffer_.data() + c_chunkHeaderSize, length - c_chunkHeaderSize) != length - c_chunkHeaderSize)
+    {
+        throw std::runtime_error("M3dChunkStream");
+    }
+    chunk_ = buffer_.data();
+    chunkSize_ = length;
+    return true;
+}
+
+unsigned char* InflateM3dBody(const unsigned char* data, unsigned int size, unsigned int* outSize)
+{
+    *outSize = 0;
+    size_t capacity = std::min<size_t>(std::max<size_t>(static_cast<size_t>(size) * c_expectedDeflateRatio, c_chunkHeaderSize), UINT32_MAX);
+    unsigned char* body = static_cast<unsigned char*>(malloc(capacity));
+    if (!body)
+    {
+        return nullptr;
+    }
+    size_t length = 0;
+    try
+    {
+        Inflater inflater(data, size, true);
+        unsigned char header[c_chunkHeaderSize];
+        while (inflater.Read(header, 4) == 4)
+        {
+            // The end chunk is only its magic
+            const bool last = !memcmp(header, "OMD3", 4);
+            size_t chunkLength = 4;
+            if (!last)
+            {
+                if (inflater.Read(header + 4, 4) != 4)
+                {
+                    break;
+                }
+                chunkLength = GetChunkLength(header);
+                if (chunkLength < c_chunkHeaderSize || chunkLength / c_maxDeflateRatio > size || length + chunkLength > UINT32_MAX)
+                {
+                    break;
+                }
+            }
+
+            // Only a body packed tighter than expected outgrows the block, it then at least doubles
+            if (length + chunkLength > capacity)
+            {
+                capacity = std::min<size_t>(std::max(capacity * 2, length + chunkLength), UINT32_MAX);
+                unsigned char* grown = static_cast<unsigned char*>(realloc(body, capacity));
+                if (!grown)
+                {
+                    break;
+                }
+                body = grown;
+            }
+            const size_t headerLength = last ? 4 : c_chunkHeaderSize;
+            memcpy(body + length, header, headerLength);
+            if (inflater.Read(body + length + headerLength, chunkLength - headerLength) != chunkLength - headerLength)
+            {
+                break;
+            }
+            length += chunkLength;
+            if (last)
+            {
+                *outSize = static_cast<unsigned int>(length);
+                return body;
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+    }
+    free(body);
+    return nullptr;
+}
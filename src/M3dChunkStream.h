@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Inflater.h"
+
+// Walks the chunks of a binary M3D file one at a time.
+// Uncompressed bodies are walked in place. Compressed ones are inflated one chunk at a time into a buffer
+// reused from chunk to chunk, so the decompressed body never needs to be in memory at once and the buffer
+// only ever grows to the largest chunk.
+class M3dChunkStream {
+
+public:
+
+    M3dChunkStream(unsigned char* data, size_t size);
+
+    // Moves to the next chunk, the HEAD chunk first. Returns false at the end chunk, throws on truncated data
+    bool Next();
+    unsigned char* GetChunk()                           { return chunk_; }
+    size_t GetChunkSize()                       const   { return chunkSize_; }
+    // Hands the buffer of the current chunk of a compressed body over, its storage and so the pointers into it
+    // stay valid. The next chunk gets a buffer of its own
+    std::vector<unsigned char> TakeChunk()              { return std::move(buffer_); }
+
+    bool IsCompressed()                         const   { return inflater_.has_value(); }
+    size_t GetLargestChunkSize()                const   { return largestChunkSize_; }
+    unsigned char* GetPreview()                 const   { return preview_; }
+    size_t GetPreviewSize()                     const   { return previewSize_; }
+
+private:
+
+    bool NextInPlace();
+    bool NextInflated();
+
+    unsigned char* body_ = nullptr;
+    unsigned char* end_ = nullptr;
+    unsigned char* preview_ = nullptr;          // Preview image data and chunk length, as m3d_load sets them
+    size_t previewSize_ = 0;
+    std::optional<Inflater> inflater_;
+    std::vector<unsigned char> buffer_;
+    unsigned char* chunk_ = nullptr;
+    size_t chunkSize_ = 0;
+    size_t largestChunkSize_ = 0;
+};
+
+// Inflates a whole compressed model body into one malloc'd block, the M3D_INFLATE backend of m3d_load.
+// M3D does not store the inflated length, so the block is allocated once from the packed length times a ratio
+// few models exceed, and only doubles for a body whose chunk lengths outgrow it. m3d_load trims the block to
+// the returned size. Returns nullptr on corrupt data, as m3d_load expects
+unsigned char* InflateM3dBody(const unsigned char* data, unsigned int size, unsigned int* outSize);
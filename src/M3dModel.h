@@ -3,6 +3,7 @@
 #include <iostream>
 #include <string>
 #include "Model.h"
+#include "M3dAsset.h"
 
 
 using namespace DirectX;
@@ -13,27 +14,26 @@ class M3dModel {
 public:
     
     M3dModel() = default;
-    M3dModel(ID3D12Device* device, const wchar_t* szFileName);
-    std::unique_ptr<Model> BuildDXTKModel();
+    // Wraps an asset whose mesh is already built, typically handed over by an AssetLoad
+    M3dModel(const wchar_t* szFileName, M3dAsset asset);
+    // Can be called again with the new device once the previous one was lost
+    std::unique_ptr<Model> BuildDXTKModel(ID3D12Device* device);
     void UpdateAnimTime(float elapsedTime);
-    void ApplyAnimToDXTKModel(const DirectX::Model& dxtkModel);
+    // Skins the CPU copy of the vertices, returns whether they changed. Uploading them is left to the caller
+    bool Animate(JobPool* jobPool = nullptr)            { return asset_.Animate(jobPool); }
     
     std::wstring GetName()                      const   { return name_; };
+    const M3dAsset& GetAsset()                  const   { return asset_; }
 	std::vector<std::wstring> GetAnimNames()    const   { return animNames_; }
-	void SetAnimIdx(int idx)                            { animIdx_ = idx; animTime_ = 0;}
+	void SetAnimIdx(int idx)                            { asset_.SetAnimIdx(idx); }
+    void CrossFadeAnim(int idx, float duration)         { asset_.CrossFadeAnim(idx, duration); }
     
 private:
     
-    ID3D12Device* device_;
-    void* m3dModel_;
+    M3dAsset asset_;
     std::wstring name_;
 	std::wstring containing_dir_;
-    float animTime_;
-    int animIdx_;
 	std::vector<std::wstring> animNames_;
-    std::vector<VertexPositionNormalColorTexture> vertexBuffer_;
-    std::map<uint16_t, uint16_t> dxtkM3dVertexMap_;
-    std::map<uint16_t, uint16_t> dxtkM3dNormalMap_;
 };
 
 
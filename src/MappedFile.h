@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+// Read-only view of a whole file, mapped copy-on-write.
+// Pages are read from the page cache on first access and never copied into the process heap,
+// unless something writes to them, which only copies the written pages.
+class MappedFile {
+
+public:
+
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    unsigned char* GetData()                    const   { return data_; }
+    size_t GetSize()                            const   { return size_; }
+
+private:
+
+    void Unmap();
+
+    unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+};
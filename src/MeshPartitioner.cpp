@@ -0,0 +1,63 @@
+#include "MeshPartitioner.h"
+
+#include <stdexcept>
+
+PartitionedMesh PartitionForShortIndices(const std::vector<uint32_t>& indices, size_t vertexCount, size_t maxPartVertices)
+{
+    if (maxPartVertices < 3 || maxPartVertices > c_maxShortIndexVertices)
+    {
+        throw std::invalid_argument("PartitionForShortIndices");
+    }
+
+    PartitionedMesh result;
+    result.indices.reserve(indices.size());
+    result.vertexRemap.reserve(vertexCount);
+
+    // Part-local index of each source vertex, only valid when its stamp matches the current part
+    std::vector<uint16_t> localIndex(vertexCount);
+    std::vector<uint32_t> partStamp(vertexCount, 0);
+    uint32_t currStamp = 1;
+    MeshPartRange currPart = { 0, 0, 0, 0 };
+
+    for (size_t tri = 0; tri + 2 < indices.size(); tri += 3)
+    {
+        // Start a new part when this triangle would not fit in the current one
+        size_t newVertices = 0;
+        for (size_t i = 0; i < 3; i++)
+        {
+            uint32_t src = indices[tri + i];
+            if (partStamp[src] != currStamp && (i < 1 || src != indices[tri]) && (i < 2 || src != indices[tri + 1]))
+            {
+                newVertices++;
+            }
+        }
+        if (currPart.vertexCount + newVertices > maxPartVertices)
+        {
+            result.parts.push_back(currPart);
+            currPart.startIndex += currPart.indexCount;
+            currPart.vertexOffset += currPart.vertexCount;
+            currPart.indexCount = 0;
+            currPart.vertexCount = 0;
+            currStamp++;
+        }
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            uint32_t src = indices[tri + i];
+            if (partStamp[src] != currStamp)
+            {
+                partStamp[src] = currStamp;
+                localIndex[src] = static_cast<uint16_t>(currPart.vertexCount++);
+                result.vertexRemap.push_back(src);
+            }
+            result.indices.push_back(localIndex[src]);
+        }
+        currPart.indexCount += 3;
+    }
+
+    if (currPart.indexCount > 0)
+    {
+        result.parts.push_back(currPart);
+    }
+    return result;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Largest vertex count a part can address with 16-bit indices, 0xFFFF is kept free as the strip-cut value
+constexpr size_t c_maxShortIndexVertices = 0xFFFF;
+
+struct MeshPartRange {
+    uint32_t startIndex;
+    uint32_t indexCount;
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+};
+
+// Triangle list split into parts that each reference at most c_maxShortIndexVertices vertices.
+// Parts own contiguous vertex ranges, vertexRemap maps every output vertex back to its source vertex
+// (vertices shared by two parts are duplicated), and indices are relative to their part's vertexOffset.
+struct PartitionedMesh {
+    std::vector<uint32_t> vertexRemap;
+    std::vector<uint16_t> indices;
+    std::vector<MeshPartRange> parts;
+};
+
+PartitionedMesh PartitionForShortIndices(const std::vector<uint32_t>& indices, size_t vertexCount,
+    size_t maxPartVertices = c_maxShortIndexVertices);
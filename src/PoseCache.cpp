@@ -0,0 +1,130 @@
+#include "PoseCache.h"
+#include "AnimationPose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+PoseCache::PoseCache(size_t boneCount, size_t capacity, float timeStep) :
+    boneCount_(boneCount),
+    timeStep_(timeStep),
+    keys_(capacity),
+    previous_(capacity, c_noEntry),
+    next_(capacity, c_noEntry),
+    matrices_(capacity * boneCount * c_boneMatrixSize)
+{
+    if (capacity == 0 || capacity >= c_noEntry || !(timeStep >= 0.0f))
+    {
+        throw std::runtime_error("PoseCache");
+    }
+    entries_.reserve(capacity);
+}
+
+float PoseCache::Quantize(int action, float msec, float duration, uint64_t& key) const
+{
+    // Same wrapping as BakedClip::Sample, which leaves a time already inside the action unchanged
+    float time = duration > 0.0f ? std::fmod(msec, duration) : 0.0f;
+    if (time < 0.0f)
+    {
+        time += duration;
+    }
+
+    uint32_t slot;
+    if (timeStep_ > 0.0f)
+    {
+        slot = static_cast<uint32_t>(time / timeStep_);
+        time = static_cast<float>(slot) * timeStep_;
+    }
+    else
+    {
+        memcpy(&slot, &time, sizeof(slot));
+    }
+    key = static_cast<uint64_t>(static_cast<uint32_t>(action)) << 32 | slot;
+    return time;
+}
+
+bool PoseCache::Find(uint64_t key, float* boneMatrices)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = entries_.find(key);
+    if (found == entries_.end())
+    {
+        misses_++;
+        return false;
+    }
+
+    const uint32_t entry = found->second;
+    Unlink(entry);
+    PushFront(entry);
+    const size_t size = boneCount_ * c_boneMatrixSize;
+    std::copy_n(&matrices_[entry * size], size, boneMatrices);
+    hits_++;
+    return true;
+}
+
+void PoseCache::Insert(uint64_t key, const float* boneMatrices)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Another actor may have computed the same pose in the meantime, it is the same pose
+    uint32_t entry;
+    const auto found = entries_.find(key);
+    if (found != entries_.end())
+    {
+        entry = found->second;
+        Unlink(entry);
+    }
+    else if (used_ < keys_.size())
+    {
+        entry = static_cast<uint32_t>(used_++);
+        entries_.emplace(key, entry);
+    }
+    else
+    {
+        entry = tail_;
+        Unlink(entry);
+        entries_.erase(keys_[entry]);
+        entries_.emplace(key, entry);
+        evictions_++;
+    }
+    keys_[entry] = key;
+    PushFront(entry);
+    const size_t size = boneCount_ * c_boneMatrixSize;
+    std::copy_n(boneMatrices, size, &matrices_[entry * size]);
+}
+
+void PoseCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    head_ = tail_ = c_noEntry;
+    used_ = 0;
+}
+
+void PoseCache::ResetCounters()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    hits_ = misses_ = evictions_ = 0;
+}
+
+size_t PoseCache::GetMemorySize() const
+{
+    return keys_.size() * (sizeof(uint64_t) + 2 * sizeof(uint32_t)) + matrices_.size() * sizeof(float) +
+        entries_.bucket_count() * sizeof(void*) + entries_.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void*));
+}
+
+void PoseCache::Unlink(uint32_t entry)
+{
+    (previous_[entry] != c_noEntry ? next_[previous_[entry]] : head_) = next_[entry];
+    (next_[entry] != c_noEntry ? previous_[next_[entry]] : tail_) = previous_[entry];
+    previous_[entry] = next_[entry] = c_noEntry;
+}
+
+void PoseCache::PushFront(uint32_t entry)
+{
+    previous_[entry] = c_noEntry;
+    next_[entry] = head_;
+    (head_ != c_noEntry ? previous_[head_] : tail_) = entry;
+    head_ = entry;
+}
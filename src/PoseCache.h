@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Model-space bone matrices of recently sampled poses, keyed by action and time, so actors playing the same
+// action at the same moment pose the skeleton once between them.
+// Times are wrapped into the action and rounded down to a multiple of the time step, and a missing pose is
+// sampled at that rounded time, so every actor sharing a key gets the same pose whichever of them computed
+// it. A step of 0 keys on the exact time. Once full, the least recently used pose makes room for the next.
+// Entries live in flat arrays linked into a recency list by index, only the key lookup is a hash map.
+// Calls are serialized by a mutex and copy matrices in and out, a pose never changes while in use.
+// Counters are meant to be read between frames.
+class PoseCache {
+
+public:
+
+    PoseCache(size_t boneCount, size_t capacity, float timeStep);
+
+    PoseCache(const PoseCache&) = delete;
+    PoseCache& operator=(const PoseCache&) = delete;
+
+    // Returns the time to sample an action of that duration at for msec, and sets the key its pose is cached under
+    float Quantize(int action, float msec, float duration, uint64_t& key) const;
+    // Copies the cached pose into boneMatrices and returns true, or returns false on a miss
+    bool Find(uint64_t key, float* boneMatrices);
+    void Insert(uint64_t key, const float* boneMatrices);
+    void Clear();
+    void ResetCounters();
+
+    size_t GetBoneCount()                       const   { return boneCount_; }
+    size_t GetCapacity()                        const   { return keys_.size(); }
+    float GetTimeStep()                         const   { return timeStep_; }
+    size_t GetHitCount()                        const   { return hits_; }
+    size_t GetMissCount()                       const   { return misses_; }
+    size_t GetEvictionCount()                   const   { return evictions_; }
+    double GetHitRate()                         const   { return hits_ + misses_ ? static_cast<double>(hits_) / static_cast<double>(hits_ + misses_) : 0.0; }
+    size_t GetMemorySize() const;
+
+private:
+
+    static constexpr uint32_t c_noEntry = 0xFFFFFFFF;
+
+    void Unlink(uint32_t entry);
+    void PushFront(uint32_t entry);
+
+    size_t boneCount_;
+    float timeStep_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, uint32_t> entries_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> previous_;        // Recency list, most recently used first
+    std::vector<uint32_t> next_;
+    std::vector<float> matrices_;           // c_boneMatrixSize floats per bone of every entry
+    uint32_t head_ = c_noEntry;
+    uint32_t tail_ = c_noEntry;
+    size_t used_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t evictions_ = 0;
+};
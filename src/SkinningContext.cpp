@@ -0,0 +1,222 @@
+#include "SkinningContext.h"
+#include "AssetCache.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(M3D_FLOAT) == sizeof(float), "Skinning expects M3D built without M3D_DOUBLE");
+static_assert(M3D_NUMBONE <= c_skinInfluences, "Skinning kernel has fewer influence slots than M3D");
+
+namespace
+{
+    // Chunks start on a cache line in every stream, the uint16_t bone ids being the narrowest
+    constexpr size_t c_chunkAlignment = c_cacheLineSize / sizeof(uint16_t);
+    constexpr size_t c_minChunkVertices = 2048;
+    constexpr size_t c_chunksPerWorker = 4;
+
+    // M3D matrices are row-major and transform column vectors, skin matrices only keep the top three rows
+    void ComputeSkinMatrix(const float* animPose, const float* bindPose, float* out)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                out[r * 4 + c] = animPose[r * 4] * bindPose[c] + animPose[r * 4 + 1] * bindPose[4 + c] +
+                    animPose[r * 4 + 2] * bindPose[8 + c] + animPose[r * 4 + 3] * bindPose[12 + c];
+            }
+        }
+    }
+}
+
+SkinningContext::SkinningContext(const m3d_t* model, const std::vector<uint32_t>& vertexIds, const std::vector<uint32_t>& normalIds)
+{
+    // Unskinned vertices and unused influence slots point at an identity matrix stored after the last bone
+    if (model->numbone >= 0xFFFF)
+    {
+        throw std::runtime_error("SkinningContext");
+    }
+    const uint16_t identityId = static_cast<uint16_t>(model->numbone);
+
+    vertexCount_ = vertexIds.size();
+    for (int axis = 0; axis < 3; axis++)
+    {
+        bindPositions_[axis].resize(vertexCount_);
+        bindNormals_[axis].resize(vertexCount_);
+    }
+    for (size_t j = 0; j < c_skinInfluences; j++)
+    {
+        boneIds_[j].assign(vertexCount_, identityId);
+        weights_[j].assign(vertexCount_, 0.0f);
+    }
+
+    for (size_t i = 0; i < vertexCount_; i++)
+    {
+        const m3dv_t& vert = model->vertex[vertexIds[i]];
+        const m3dv_t& norm = model->vertex[normalIds[i]];
+        bindPositions_[0][i] = vert.x;
+        bindPositions_[1][i] = vert.y;
+        bindPositions_[2][i] = vert.z;
+        bindNormals_[0][i] = norm.x;
+        bindNormals_[1][i] = norm.y;
+        bindNormals_[2][i] = norm.z;
+        if (vert.skinid == M3D_UNDEF || vert.skinid >= model->numskin)
+        {
+            weights_[0][i] = 1.0f;
+            continue;
+        }
+
+        const m3ds_t& skin = model->skin[vert.skinid];
+        for (int j = 0; j < M3D_NUMBONE && skin.boneid[j] < model->numbone && skin.weight[j] > 0.0f; j++)
+        {
+            boneIds_[j][i] = static_cast<uint16_t>(skin.boneid[j]);
+            weights_[j][i] = skin.weight[j];
+        }
+        if (weights_[0][i] == 0.0f)
+        {
+            weights_[0][i] = 1.0f;
+        }
+    }
+
+    bindPose_.resize(model->numbone * c_boneMatrixSize);
+    for (M3D_INDEX i = 0; i < model->numbone; i++)
+    {
+        memcpy(&bindPose_[i * c_boneMatrixSize], model->bone[i].mat4, c_boneMatrixSize * sizeof(float));
+    }
+    AllocateScratch(scratch_);
+    kernelLevel_ = DetectSkinKernelLevel();
+}
+
+SkinningContext::SkinningContext(CacheReader& reader)
+{
+    uint64_t vertexCount;
+    reader.Read(vertexCount);
+    vertexCount_ = static_cast<size_t>(vertexCount);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        reader.Read(bindPositions_[axis]);
+        reader.Read(bindNormals_[axis]);
+    }
+    for (size_t j = 0; j < c_skinInfluences; j++)
+    {
+        reader.Read(boneIds_[j]);
+        reader.Read(weights_[j]);
+    }
+    reader.Read(bindPose_);
+
+    // Every stream must cover every vertex, and every bone id the identity matrix at most
+    const size_t boneCount = GetBoneCount();
+    if (bindPose_.size() % c_boneMatrixSize != 0 || boneCount >= 0xFFFF)
+    {
+        throw std::runtime_error("SkinningContext");
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (bindPositions_[axis].size() != vertexCount_ || bindNormals_[axis].size() != vertexCount_)
+        {
+            throw std::runtime_error("SkinningContext");
+        }
+    }
+    for (size_t j = 0; j < c_skinInfluences; j++)
+    {
+        if (boneIds_[j].size() != vertexCount_ || weights_[j].size() != vertexCount_ ||
+            std::any_of(boneIds_[j].begin(), boneIds_[j].end(), [boneCount](uint16_t id) { return id > boneCount; }))
+        {
+            throw std::runtime_error("SkinningContext");
+        }
+    }
+    AllocateScratch(scratch_);
+    kernelLevel_ = DetectSkinKernelLevel();
+}
+
+void SkinningContext::Save(CacheWriter& writer) const
+{
+    writer.Write(static_cast<uint64_t>(vertexCount_));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        writer.Write(bindPositions_[axis]);
+        writer.Write(bindNormals_[axis]);
+    }
+    for (size_t j = 0; j < c_skinInfluences; j++)
+    {
+        writer.Write(boneIds_[j]);
+        writer.Write(weights_[j]);
+    }
+    writer.Write(bindPose_);
+}
+
+void SkinningContext::AllocateScratch(SkinningScratch& scratch) const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        scratch.skinnedPositions[axis].resize(vertexCount_);
+        scratch.skinnedNormals[axis].resize(vertexCount_);
+    }
+    const size_t boneCount = GetBoneCount();
+    scratch.skinMatrices.assign((boneCount + 1) * c_skinMatrixSize, 0.0f);
+    float* identity = &scratch.skinMatrices[boneCount * c_skinMatrixSize];
+    identity[0] = identity[5] = identity[10] = 1.0f;
+}
+
+void SkinningContext::Skin(const float* boneMatrices, void* dst, const SkinnedVertexLayout& layout, JobPool* jobPool)
+{
+    UpdateSkinMatrices(boneMatrices);
+    if (!jobPool || jobPool->GetWorkerCount() == 0 || vertexCount_ < 2 * c_minChunkVertices)
+    {
+        SkinRange(0, vertexCount_, dst, layout);
+        return;
+    }
+
+    // A few chunks per thread leave room for stealing when a worker gets descheduled
+    const size_t chunkCount = (jobPool->GetWorkerCount() + 1) * c_chunksPerWorker;
+    size_t chunkSize = std::max(c_minChunkVertices, (vertexCount_ + chunkCount - 1) / chunkCount);
+    chunkSize = (chunkSize + c_chunkAlignment - 1) / c_chunkAlignment * c_chunkAlignment;
+    jobPool->ParallelFor(vertexCount_, chunkSize, [&](size_t begin, size_t end) { SkinRange(begin, end, dst, layout); });
+}
+
+void SkinningContext::UpdateSkinMatrices(const float* boneMatrices, SkinningScratch& scratch) const
+{
+    // Combine the animation pose with the inverse bind pose once per bone
+    const size_t boneCount = GetBoneCount();
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        ComputeSkinMatrix(&boneMatrices[i * c_boneMatrixSize], &bindPose_[i * c_boneMatrixSize], &scratch.skinMatrices[i * c_skinMatrixSize]);
+    }
+}
+
+void SkinningContext::SkinRange(size_t begin, size_t end, void* dst, const SkinnedVertexLayout& layout, SkinningScratch& scratch) const
+{
+    SkinOutputStreams out;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        out.position[axis] = scratch.skinnedPositions[axis].data();
+        out.normal[axis] = scratch.skinnedNormals[axis].data();
+    }
+    SkinVertices(kernelLevel_, scratch.skinMatrices.data(), GetInputStreams(), out, begin, end);
+
+    uint8_t* dstVertex = static_cast<uint8_t*>(dst) + begin * layout.stride;
+    for (size_t i = begin; i < end; i++, dstVertex += layout.stride)
+    {
+        const float position[3] = { out.position[0][i], out.position[1][i], out.position[2][i] };
+        const float normal[3] = { out.normal[0][i], out.normal[1][i], out.normal[2][i] };
+        memcpy(dstVertex + layout.positionOffset, position, sizeof(position));
+        memcpy(dstVertex + layout.normalOffset, normal, sizeof(normal));
+    }
+}
+
+SkinInputStreams SkinningContext::GetInputStreams() const
+{
+    SkinInputStreams streams;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        streams.position[axis] = bindPositions_[axis].data();
+        streams.normal[axis] = bindNormals_[axis].data();
+    }
+    for (size_t j = 0; j < c_skinInfluences; j++)
+    {
+        streams.boneId[j] = boneIds_[j].data();
+        streams.weight[j] = weights_[j].data();
+    }
+    return streams;
+}
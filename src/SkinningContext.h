@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "m3d/m3d.h"
+#include "AnimationPose.h"
+#include "SkinningKernel.h"
+
+class CacheReader;
+class CacheWriter;
+class JobPool;
+
+// Where the skinned position and normal live inside a destination vertex
+struct SkinnedVertexLayout {
+    size_t stride;
+    size_t positionOffset;
+    size_t normalOffset;
+};
+
+// Buffers a skinning pass writes before scattering its results. A context owns one for its own passes,
+// callers skinning several poses of the same mesh at once hand in one per concurrent pass
+struct SkinningScratch {
+    AlignedVector<float> skinMatrices;      // Animation pose times inverse bind pose of every bone, then identity
+    AlignedVector<float> skinnedPositions[3];
+    AlignedVector<float> skinnedNormals[3];
+};
+
+// Everything skinning needs from the M3D model, gathered once at load time.
+// The bind-pose positions, normals and skin weights of every output vertex are copied out of the model
+// into structure-of-arrays streams, so a frame only reads these streams and the bone matrices.
+// Each frame first combines the model-space bone matrices with the inverse bind pose into one skin matrix per bone,
+// then the skinning kernel blends the skin matrices of every vertex's influences and transforms once,
+// and the results are scattered into the destination vertices.
+// Given a job pool, large meshes are skinned in cache-line aligned vertex chunks spread over its workers.
+class SkinningContext {
+
+public:
+
+    SkinningContext() = default;
+    SkinningContext(const m3d_t* model, const std::vector<uint32_t>& vertexIds, const std::vector<uint32_t>& normalIds);
+    explicit SkinningContext(CacheReader& reader);
+    void Save(CacheWriter& writer) const;
+    void Skin(const float* boneMatrices, void* dst, const SkinnedVertexLayout& layout, JobPool* jobPool = nullptr);
+    void UpdateSkinMatrices(const float* boneMatrices)  { UpdateSkinMatrices(boneMatrices, scratch_); }
+    void SkinRange(size_t begin, size_t end, void* dst, const SkinnedVertexLayout& layout)  { SkinRange(begin, end, dst, layout, scratch_); }
+
+    // Same passes on the caller's scratch, leaving the context untouched so that several threads can share it
+    void AllocateScratch(SkinningScratch& scratch) const;
+    void UpdateSkinMatrices(const float* boneMatrices, SkinningScratch& scratch) const;
+    void SkinRange(size_t begin, size_t end, void* dst, const SkinnedVertexLayout& layout, SkinningScratch& scratch) const;
+
+    size_t GetVertexCount()                     const   { return vertexCount_; }
+    size_t GetBoneCount()                       const   { return bindPose_.size() / c_boneMatrixSize; }
+    const float* GetInverseBindPose()           const   { return bindPose_.data(); }
+    SkinKernelLevel GetKernelLevel()            const   { return kernelLevel_; }
+    void SetKernelLevel(SkinKernelLevel level)          { kernelLevel_ = level; }
+
+private:
+
+    SkinInputStreams GetInputStreams() const;
+
+    size_t vertexCount_ = 0;
+    SkinKernelLevel kernelLevel_ = SkinKernelLevel::Scalar;
+    AlignedVector<float> bindPositions_[3];
+    AlignedVector<float> bindNormals_[3];
+    AlignedVector<uint16_t> boneIds_[c_skinInfluences];
+    AlignedVector<float> weights_[c_skinInfluences];
+    std::vector<float> bindPose_;           // Inverse bind matrix of every bone, as stored by m3d_load
+    SkinningScratch scratch_;
+};
@@ -0,0 +1,309 @@
+#include "SkinningKernel.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define M3DV_SKIN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define M3DV_SKIN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles intrinsics for any instruction set, GCC and Clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define M3DV_TARGET(features) __attribute__((target(features)))
+#else
+#define M3DV_TARGET(features)
+#endif
+
+namespace
+{
+    void SkinVerticesScalar(const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            float m[c_skinMatrixSize] = {};
+            for (size_t j = 0; j < c_skinInfluences; j++)
+            {
+                const float weight = in.weight[j][i];
+                if (weight == 0.0f)
+                {
+                    continue;
+                }
+                const float* skinMatrix = skinMatrices + in.boneId[j][i] * c_skinMatrixSize;
+                for (size_t k = 0; k < c_skinMatrixSize; k++)
+                {
+                    m[k] += skinMatrix[k] * weight;
+                }
+            }
+
+            const float px = in.position[0][i], py = in.position[1][i], pz = in.position[2][i];
+            const float nx = in.normal[0][i], ny = in.normal[1][i], nz = in.normal[2][i];
+            float normal[3];
+            for (int r = 0; r < 3; r++)
+            {
+                out.position[r][i] = m[r * 4] * px + m[r * 4 + 1] * py + m[r * 4 + 2] * pz + m[r * 4 + 3];
+                normal[r] = m[r * 4] * nx + m[r * 4 + 1] * ny + m[r * 4 + 2] * nz;
+            }
+
+            const float lengthSq = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+            const float invLength = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 1.0f;
+            for (int r = 0; r < 3; r++)
+            {
+                out.normal[r][i] = normal[r] * invLength;
+            }
+        }
+    }
+
+#ifdef M3DV_SKIN_X86
+    M3DV_TARGET("sse4.1")
+    void SkinVerticesSse41(const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out, size_t begin, size_t end)
+    {
+        // No gathers before AVX2, matrix lanes are loaded one vertex at a time
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 m[c_skinMatrixSize];
+            for (size_t k = 0; k < c_skinMatrixSize; k++)
+            {
+                m[k] = zero;
+            }
+            for (size_t j = 0; j < c_skinInfluences; j++)
+            {
+                const __m128 weight = _mm_loadu_ps(in.weight[j] + i);
+                const float* s0 = skinMatrices + in.boneId[j][i] * c_skinMatrixSize;
+                const float* s1 = skinMatrices + in.boneId[j][i + 1] * c_skinMatrixSize;
+                const float* s2 = skinMatrices + in.boneId[j][i + 2] * c_skinMatrixSize;
+                const float* s3 = skinMatrices + in.boneId[j][i + 3] * c_skinMatrixSize;
+                for (size_t k = 0; k < c_skinMatrixSize; k++)
+                {
+                    m[k] = _mm_add_ps(m[k], _mm_mul_ps(_mm_setr_ps(s0[k], s1[k], s2[k], s3[k]), weight));
+                }
+            }
+
+            const __m128 px = _mm_loadu_ps(in.position[0] + i);
+            const __m128 py = _mm_loadu_ps(in.position[1] + i);
+            const __m128 pz = _mm_loadu_ps(in.position[2] + i);
+            const __m128 nx = _mm_loadu_ps(in.normal[0] + i);
+            const __m128 ny = _mm_loadu_ps(in.normal[1] + i);
+            const __m128 nz = _mm_loadu_ps(in.normal[2] + i);
+            __m128 normal[3];
+            for (int r = 0; r < 3; r++)
+            {
+                __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r * 4], px), _mm_mul_ps(m[r * 4 + 1], py)),
+                    _mm_add_ps(_mm_mul_ps(m[r * 4 + 2], pz), m[r * 4 + 3]));
+                _mm_storeu_ps(out.position[r] + i, position);
+                normal[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r * 4], nx), _mm_mul_ps(m[r * 4 + 1], ny)), _mm_mul_ps(m[r * 4 + 2], nz));
+            }
+
+            const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[0], normal[0]), _mm_mul_ps(normal[1], normal[1])),
+                _mm_mul_ps(normal[2], normal[2]));
+            const __m128 invLength = _mm_blendv_ps(one, _mm_div_ps(one, _mm_sqrt_ps(lengthSq)), _mm_cmpgt_ps(lengthSq, zero));
+            for (int r = 0; r < 3; r++)
+            {
+                _mm_storeu_ps(out.normal[r] + i, _mm_mul_ps(normal[r], invLength));
+            }
+        }
+        SkinVerticesScalar(skinMatrices, in, out, i, end);
+    }
+
+    M3DV_TARGET("avx2,fma")
+    void SkinVerticesAvx2(const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out, size_t begin, size_t end)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i matrixSize = _mm256_set1_epi32(static_cast<int>(c_skinMatrixSize));
+        size_t i = begin;
+        for (; i + c_skinBlockSize <= end; i += c_skinBlockSize)
+        {
+            __m256 m[c_skinMatrixSize];
+            for (size_t k = 0; k < c_skinMatrixSize; k++)
+            {
+                m[k] = zero;
+            }
+            for (size_t j = 0; j < c_skinInfluences; j++)
+            {
+                const __m256 weight = _mm256_loadu_ps(in.weight[j] + i);
+                const __m128i boneId = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.boneId[j] + i));
+                const __m256i offset = _mm256_mullo_epi32(_mm256_cvtepu16_epi32(boneId), matrixSize);
+                for (size_t k = 0; k < c_skinMatrixSize; k++)
+                {
+                    m[k] = _mm256_fmadd_ps(_mm256_i32gather_ps(skinMatrices + k, offset, 4), weight, m[k]);
+                }
+            }
+
+            const __m256 px = _mm256_loadu_ps(in.position[0] + i);
+            const __m256 py = _mm256_loadu_ps(in.position[1] + i);
+            const __m256 pz = _mm256_loadu_ps(in.position[2] + i);
+            const __m256 nx = _mm256_loadu_ps(in.normal[0] + i);
+            const __m256 ny = _mm256_loadu_ps(in.normal[1] + i);
+            const __m256 nz = _mm256_loadu_ps(in.normal[2] + i);
+            __m256 normal[3];
+            for (int r = 0; r < 3; r++)
+            {
+                __m256 position = _mm256_fmadd_ps(m[r * 4], px, _mm256_fmadd_ps(m[r * 4 + 1], py, _mm256_fmadd_ps(m[r * 4 + 2], pz, m[r * 4 + 3])));
+                _mm256_storeu_ps(out.position[r] + i, position);
+                normal[r] = _mm256_fmadd_ps(m[r * 4], nx, _mm256_fmadd_ps(m[r * 4 + 1], ny, _mm256_mul_ps(m[r * 4 + 2], nz)));
+            }
+
+            const __m256 lengthSq = _mm256_fmadd_ps(normal[0], normal[0], _mm256_fmadd_ps(normal[1], normal[1], _mm256_mul_ps(normal[2], normal[2])));
+            const __m256 invLength = _mm256_blendv_ps(one, _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq)), _mm256_cmp_ps(lengthSq, zero, _CMP_GT_OQ));
+            for (int r = 0; r < 3; r++)
+            {
+                _mm256_storeu_ps(out.normal[r] + i, _mm256_mul_ps(normal[r], invLength));
+            }
+        }
+        SkinVerticesScalar(skinMatrices, in, out, i, end);
+    }
+
+    void DetectX86Features(bool& sse41, bool& avx2)
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        sse41 = (info[2] & (1 << 19)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        avx2 = false;
+        if (maxLeaf >= 7 && fma && osAvx)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        sse41 = __builtin_cpu_supports("sse4.1");
+        avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+#ifdef M3DV_SKIN_NEON
+    void SkinVerticesNeon(const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out, size_t begin, size_t end)
+    {
+        // Same structure as the SSE kernel, NEON has no gathers either
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            float32x4_t m[c_skinMatrixSize];
+            for (size_t k = 0; k < c_skinMatrixSize; k++)
+            {
+                m[k] = zero;
+            }
+            for (size_t j = 0; j < c_skinInfluences; j++)
+            {
+                const float32x4_t weight = vld1q_f32(in.weight[j] + i);
+                const float* s0 = skinMatrices + in.boneId[j][i] * c_skinMatrixSize;
+                const float* s1 = skinMatrices + in.boneId[j][i + 1] * c_skinMatrixSize;
+                const float* s2 = skinMatrices + in.boneId[j][i + 2] * c_skinMatrixSize;
+                const float* s3 = skinMatrices + in.boneId[j][i + 3] * c_skinMatrixSize;
+                for (size_t k = 0; k < c_skinMatrixSize; k++)
+                {
+                    const float lanes[4] = { s0[k], s1[k], s2[k], s3[k] };
+                    m[k] = vfmaq_f32(m[k], vld1q_f32(lanes), weight);
+                }
+            }
+
+            const float32x4_t px = vld1q_f32(in.position[0] + i);
+            const float32x4_t py = vld1q_f32(in.position[1] + i);
+            const float32x4_t pz = vld1q_f32(in.position[2] + i);
+            const float32x4_t nx = vld1q_f32(in.normal[0] + i);
+            const float32x4_t ny = vld1q_f32(in.normal[1] + i);
+            const float32x4_t nz = vld1q_f32(in.normal[2] + i);
+            float32x4_t normal[3];
+            for (int r = 0; r < 3; r++)
+            {
+                float32x4_t position = vfmaq_f32(vfmaq_f32(vfmaq_f32(m[r * 4 + 3], m[r * 4], px), m[r * 4 + 1], py), m[r * 4 + 2], pz);
+                vst1q_f32(out.position[r] + i, position);
+                normal[r] = vfmaq_f32(vfmaq_f32(vmulq_f32(m[r * 4], nx), m[r * 4 + 1], ny), m[r * 4 + 2], nz);
+            }
+
+            const float32x4_t lengthSq = vfmaq_f32(vfmaq_f32(vmulq_f32(normal[0], normal[0]), normal[1], normal[1]), normal[2], normal[2]);
+            const float32x4_t invLength = vbslq_f32(vcgtq_f32(lengthSq, zero), vdivq_f32(one, vsqrtq_f32(lengthSq)), one);
+            for (int r = 0; r < 3; r++)
+            {
+                vst1q_f32(out.normal[r] + i, vmulq_f32(normal[r], invLength));
+            }
+        }
+        SkinVerticesScalar(skinMatrices, in, out, i, end);
+    }
+#endif
+}
+
+SkinKernelLevel DetectSkinKernelLevel()
+{
+#if defined(M3DV_SKIN_X86)
+    bool sse41 = false;
+    bool avx2 = false;
+    DetectX86Features(sse41, avx2);
+    return avx2 ? SkinKernelLevel::Avx2 : sse41 ? SkinKernelLevel::Sse41 : SkinKernelLevel::Scalar;
+#elif defined(M3DV_SKIN_NEON)
+    return SkinKernelLevel::Neon;
+#else
+    return SkinKernelLevel::Scalar;
+#endif
+}
+
+const char* GetSkinKernelName(SkinKernelLevel level)
+{
+    switch (level)
+    {
+    case SkinKernelLevel::Sse41:
+        return "sse4.1";
+    case SkinKernelLevel::Neon:
+        return "neon";
+    case SkinKernelLevel::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+bool IsSkinKernelSupported(SkinKernelLevel level)
+{
+    static const SkinKernelLevel detected = DetectSkinKernelLevel();
+    if (level == SkinKernelLevel::Neon || detected == SkinKernelLevel::Neon)
+    {
+        return level == detected || level == SkinKernelLevel::Scalar;
+    }
+    return level <= detected;
+}
+
+void SkinVertices(SkinKernelLevel level, const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out,
+    size_t begin, size_t end)
+{
+    if (!IsSkinKernelSupported(level))
+    {
+        level = SkinKernelLevel::Scalar;
+    }
+
+    switch (level)
+    {
+#ifdef M3DV_SKIN_X86
+    case SkinKernelLevel::Avx2:
+        SkinVerticesAvx2(skinMatrices, in, out, begin, end);
+        break;
+    case SkinKernelLevel::Sse41:
+        SkinVerticesSse41(skinMatrices, in, out, begin, end);
+        break;
+#endif
+#ifdef M3DV_SKIN_NEON
+    case SkinKernelLevel::Neon:
+        SkinVerticesNeon(skinMatrices, in, out, begin, end);
+        break;
+#endif
+    default:
+        SkinVerticesScalar(skinMatrices, in, out, begin, end);
+        break;
+    }
+}
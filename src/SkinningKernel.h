@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+constexpr size_t c_skinInfluences = 4;      // Influence slots per vertex, unused slots have a weight of 0
+constexpr size_t c_skinMatrixSize = 12;     // Top 3 rows of a row-major 4x4 matrix
+constexpr size_t c_skinBlockSize = 8;       // Vertices handled per kernel iteration
+constexpr size_t c_cacheLineSize = 64;
+
+enum class SkinKernelLevel {
+    Scalar,
+    Sse41,
+    Neon,
+    Avx2,
+};
+
+// Allocator keeping every vertex stream on its own cache line
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(c_cacheLineSize))); }
+    void deallocate(T* ptr, size_t) { ::operator delete(ptr, std::align_val_t(c_cacheLineSize)); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Bind-pose vertices in structure-of-arrays layout, each stream indexed by vertex
+struct SkinInputStreams {
+    const float* position[3];
+    const float* normal[3];
+    const uint16_t* boneId[c_skinInfluences];
+    const float* weight[c_skinInfluences];
+};
+
+struct SkinOutputStreams {
+    float* position[3];
+    float* normal[3];
+};
+
+SkinKernelLevel DetectSkinKernelLevel();
+const char* GetSkinKernelName(SkinKernelLevel level);
+// Whether this CPU runs the kernel of level, the scalar one always runs
+bool IsSkinKernelSupported(SkinKernelLevel level);
+
+// Skins vertices [begin, end) with c_skinMatrixSize floats per bone in skinMatrices.
+// Levels the CPU does not support fall back to the scalar kernel, which all SIMD kernels match within float rounding.
+void SkinVertices(SkinKernelLevel level, const float* skinMatrices, const SkinInputStreams& in, const SkinOutputStreams& out,
+    size_t begin, size_t end);
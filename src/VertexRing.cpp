@@ -0,0 +1,30 @@
+#include "VertexRing.h"
+
+#include <stdexcept>
+
+VertexRing::VertexRing(size_t frameCount) :
+    revisions_(frameCount, c_noRevision)
+{
+    if (frameCount == 0)
+    {
+        throw std::runtime_error("VertexRing");
+    }
+}
+
+bool VertexRing::BeginFrame(size_t frameIndex, uint64_t revision)
+{
+    if (frameIndex >= revisions_.size() || revision == c_noRevision)
+    {
+        throw std::runtime_error("VertexRing");
+    }
+
+    currentFrame_ = frameIndex;
+    if (revisions_[frameIndex] == revision)
+    {
+        skipCount_++;
+        return false;
+    }
+    revisions_[frameIndex] = revision;
+    writeCount_++;
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Picks which of a ring of per-frame vertex buffers a frame writes its skinned vertices to and draws from.
+// The ring is indexed by the swap chain frame index, and the swap chain only hands an index back once the GPU
+// finished the frame that last used it, so the buffer written never is one an in-flight frame reads.
+// Each buffer remembers the revision of the vertices it holds: vertices that did not change since a buffer was
+// last written are not copied into it again. Only the bookkeeping lives here, the caller owns the buffers.
+class VertexRing {
+
+public:
+
+    static constexpr size_t c_noFrame = SIZE_MAX;
+    static constexpr uint64_t c_noRevision = UINT64_MAX;
+
+    VertexRing() = default;
+    explicit VertexRing(size_t frameCount);
+    // Starts the frame of frameIndex with vertices at revision, returns whether its buffer must be written
+    bool BeginFrame(size_t frameIndex, uint64_t revision);
+
+    size_t GetFrameCount()                      const   { return revisions_.size(); }
+    // Buffer the current frame draws from, c_noFrame before the first frame
+    size_t GetCurrentFrame()                    const   { return currentFrame_; }
+    // Revision a buffer holds, c_noRevision before it is first written
+    uint64_t GetRevision(size_t frameIndex)     const   { return revisions_[frameIndex]; }
+    uint64_t GetWriteCount()                    const   { return writeCount_; }
+    uint64_t GetSkipCount()                     const   { return skipCount_; }
+
+private:
+
+    std::vector<uint64_t> revisions_;
+    size_t currentFrame_ = c_noFrame;
+    uint64_t writeCount_ = 0;
+    uint64_t skipCount_ = 0;
+};
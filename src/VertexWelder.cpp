@@ -0,0 +1,109 @@
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t c_minCapacity = 16;
+    // Largest float below 2^31, so every clamped grid cell converts to int32
+    constexpr float c_cellLimit = 2147483520.0f;
+
+    size_t NextPowerOfTwo(size_t value)
+    {
+        size_t result = c_minCapacity;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+VertexWelder::VertexWelder(size_t expectedCorners, float epsilon)
+{
+    invEpsilon_ = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+    // Keep the load factor under 1/2 even if every corner turns out to be unique
+    slots_.assign(NextPowerOfTwo(expectedCorners * 2), InvalidIndex);
+    mask_ = slots_.size() - 1;
+}
+
+uint32_t VertexWelder::Weld(const float (&key)[KeySize], bool& inserted)
+{
+    uint32_t packedKey[KeySize];
+    for (size_t i = 0; i < KeySize; i++)
+    {
+        packedKey[i] = Pack(key[i]);
+    }
+
+    size_t slot = Hash(packedKey) & mask_;
+    while (slots_[slot] != InvalidIndex)
+    {
+        uint32_t candidate = slots_[slot];
+        if (memcmp(&keys_[candidate * KeySize], packedKey, sizeof(packedKey)) == 0)
+        {
+            inserted = false;
+            return candidate;
+        }
+        slot = (slot + 1) & mask_;
+    }
+
+    uint32_t newIndex = static_cast<uint32_t>(GetVertexCount());
+    slots_[slot] = newIndex;
+    keys_.insert(keys_.end(), packedKey, packedKey + KeySize);
+    if (GetVertexCount() * 2 > slots_.size())
+    {
+        Grow();
+    }
+
+    inserted = true;
+    return newIndex;
+}
+
+uint32_t VertexWelder::Pack(float value) const
+{
+    if (invEpsilon_ > 0.0f)
+    {
+        // Cells past the int32 range share the outermost one, NaN gets the one cell no clamped value reaches
+        const float cell = std::floor(value * invEpsilon_ + 0.5f);
+        if (std::isnan(cell))
+        {
+            return 0x80000000u;
+        }
+        return static_cast<uint32_t>(static_cast<int32_t>(std::min(std::max(cell, -c_cellLimit), c_cellLimit)));
+    }
+
+    // -0.0 and +0.0 compare equal, so they must weld together as well
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits == 0x80000000u ? 0u : bits;
+}
+
+size_t VertexWelder::Hash(const uint32_t* packedKey)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < KeySize; i++)
+    {
+        hash = (hash ^ packedKey[i]) * 0x9E3779B97F4A7C15ull;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+void VertexWelder::Grow()
+{
+    // Only reached when the corner estimate was too low
+    slots_.assign(slots_.size() * 2, InvalidIndex);
+    mask_ = slots_.size() - 1;
+    const uint32_t vertexCount = static_cast<uint32_t>(GetVertexCount());
+    for (uint32_t i = 0; i < vertexCount; i++)
+    {
+        size_t slot = Hash(&keys_[i * KeySize]) & mask_;
+        while (slots_[slot] != InvalidIndex)
+        {
+            slot = (slot + 1) & mask_;
+        }
+        slots_[slot] = i;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Merges identical triangle corners into shared vertices.
+// Corners are keyed on the packed bit patterns of their position, normal and texture coordinate and looked up
+// in an open-addressing table sized up front, so welding does not allocate per corner.
+// With a non-zero epsilon, each component is snapped to a grid of that size before hashing. This is grid snapping,
+// not epsilon welding: corners closer than epsilon still stay apart when they fall on both sides of a cell boundary.
+class VertexWelder {
+
+public:
+
+    static constexpr size_t KeySize = 8; // position xyz, normal xyz, texcoord uv
+    static constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+    VertexWelder(size_t expectedCorners, float epsilon = 0.0f);
+    uint32_t Weld(const float (&key)[KeySize], bool& inserted);
+
+    size_t GetVertexCount()     const   { return keys_.size() / KeySize; }
+    size_t GetCapacity()        const   { return slots_.size(); }
+
+private:
+
+    uint32_t Pack(float value) const;
+    static size_t Hash(const uint32_t* packedKey);
+    void Grow();
+
+    float invEpsilon_;
+    size_t mask_;
+    std::vector<uint32_t> slots_;   // Welded vertex index, or InvalidIndex for an empty slot
+    std::vector<uint32_t> keys_;    // KeySize packed components per welded vertex
+};
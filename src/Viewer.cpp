@@ -29,6 +29,7 @@ namespace
     constexpr float c_defaultRadius = 3.3f;
     constexpr float c_minRadius = 0.1f;
     constexpr float c_maxRadius = 5.f;
+    constexpr int c_maxCrowdSize = 1000;
 }
 
 // Pix debugging
@@ -127,6 +128,8 @@ void Viewer::Tick()
         Update(m_timer);
     });
 
+    // Skin once per rendered frame, into the buffers of the frame about to be recorded
+    viewerModel.Animate(m_deviceResources->GetCurrentFrameIndex(), m_world, m_view, m_proj);
     Render();
 }
 
@@ -142,7 +145,9 @@ void Viewer::Update(DX::StepTimer const& timer)
 
     m_radius -= float(mouse.scrollWheelValue) * ROTATION_GAIN;
     m_mouse->ResetScrollWheelValue();
-    m_radius = std::max(c_minRadius, std::min(c_maxRadius, m_radius));
+    // A crowd spreads over a grid growing with the square root of its size, the camera may back off as far
+    const float maxRadius = c_maxRadius * std::sqrt(static_cast<float>(viewerModel.GetCrowdSize()));
+    m_radius = std::max(c_minRadius, std::min(maxRadius, m_radius));
 
     if (mouse.positionMode == Mouse::MODE_RELATIVE)
     {
@@ -211,7 +216,11 @@ void Viewer::Render()
     ImGui::Begin(Util::WStringToString(viewerModel.GetModelName()).c_str());
 	ImGui::Text("Orbit camera with mouse");
     std::vector<std::wstring> animations = viewerModel.GetAnimationNames();
-    if (animations.size() > 0)
+    if (viewerModel.IsLoading())
+    {
+        ImGui::Text("Loading: %s", GetLoadStageName(viewerModel.GetLoadStage()));
+    }
+    else if (animations.size() > 0)
     {
         ImGui::Text("Choose animation");
         int count = 0;
@@ -226,6 +235,25 @@ void Viewer::Render()
     {
         ImGui::Text("No animations");
     }
+    if (!viewerModel.IsLoading())
+    {
+        ImGui::Text("Skinned %llu frames, skipped %llu", static_cast<unsigned long long>(viewerModel.GetSkinCount()),
+            static_cast<unsigned long long>(viewerModel.GetSkipCount()));
+        int crowdSize = static_cast<int>(viewerModel.GetCrowdSize());
+        if (ImGui::SliderInt("Crowd", &crowdSize, 1, c_maxCrowdSize))
+        {
+            viewerModel.SetCrowdSize(static_cast<size_t>(crowdSize));
+        }
+        if (crowdSize > 1)
+        {
+            // 0 turns the animation LOD off
+            int lodBudget = static_cast<int>(viewerModel.GetLodBudget());
+            if (ImGui::SliderInt("Animated per frame", &lodBudget, 0, crowdSize))
+            {
+                viewerModel.SetLodBudget(static_cast<size_t>(lodBudget));
+            }
+        }
+    }
     ImGui::End();
     ImGui::Render();
     
@@ -352,7 +380,7 @@ void Viewer::CreateDeviceDependentResources()
 
     m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
 
-    viewerModel.CreateDeviceDependentResources(device, backBufferFormat, depthBufferFormat, commandQueue);
+    viewerModel.CreateDeviceDependentResources(device, backBufferFormat, depthBufferFormat, commandQueue, m_deviceResources->GetBackBufferCount());
 
     m_world = Matrix::Identity;
 }
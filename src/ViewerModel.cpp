@@ -2,18 +2,163 @@
 
 #include "ViewerModel.h"
 
-ViewerModel::ViewerModel(const wchar_t* m3dPath)
+namespace
+{
+    constexpr float c_crowdTimeStep = 250.0f;       // Milliseconds between the start times of neighbouring instances
+    constexpr float c_crowdSpacing = 1.5f;          // Grid cell size, in model extents
+    constexpr float c_crossFadeTime = 250.0f;       // Milliseconds a newly picked action takes to blend in
+}
+
+ViewerModel::ViewerModel(const wchar_t* m3dPath, size_t skinningWorkers)
 {
 	m3dPath_ = m3dPath;
+    jobPool_ = std::make_unique<JobPool>(skinningWorkers);
+    load_ = AssetLoad(m3dPath);
 }
 
 void ViewerModel::Update(DX::StepTimer const& timer)
 {
+    // Swap the model in once parsed and built, Get rethrows what made the load fail
+    if (load_.IsReady() && device_)
+    {
+        crowd_.reset();
+        m3dModel_ = M3dModel(m3dPath_, load_.Get());
+        CreateModelResources();
+        CreateCrowd();
+    }
+    if (textureUpload_.valid() && textureUpload_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        textureUpload_.get();
+    }
+    if (IsLoading())
+    {
+        return;
+    }
+
     float elapsedTime = float(timer.GetElapsedSeconds());
-    m3dModel_.UpdateAnimTime(elapsedTime * 1000);
+    if (crowd_)
+    {
+        crowd_->UpdateAnimTime(elapsedTime * 1000);
+    }
+    else
+    {
+        m3dModel_.UpdateAnimTime(elapsedTime * 1000);
+    }
+}
+
+void ViewerModel::Animate(size_t frameIndex, Matrix world, Matrix view, Matrix proj)
+{
+    if (!dxtkModel_ || textureUpload_.valid())
+    {
+        return;
+    }
+
+    if (!crowd_)
+    {
+        // The buffer of this frame index was last drawn by a frame the GPU is done with, the others may be in flight
+        if (m3dModel_.GetAnimNames().size() > 0)
+        {
+            m3dModel_.Animate(jobPool_.get());
+        }
+        const M3dAsset& asset = m3dModel_.GetAsset();
+        if (vertexRing_.BeginFrame(frameIndex, asset.GetSkinCount()))
+        {
+            memcpy(vertexBuffers_[frameIndex].Memory(), asset.GetVertices().data(), asset.GetVertices().size() * sizeof(MeshVertex));
+        }
+        return;
+    }
+
+    // The animation LOD ranks instances by their size on screen, those out of the frustum by 0
+    if (crowd_->GetLod())
+    {
+        const std::vector<size_t>& ids = crowd_->GetInstanceIds();
+        const Matrix worldView = world * view;
+        const float radius = crowdSpacing_ / (2.0f * c_crowdSpacing);
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            const Vector3 position = Vector3::Transform(GetCrowdOffset(i), worldView);
+            const float depth = -position.z;
+            const bool visible = depth > -radius && std::abs(position.x) - radius < depth / proj._11 &&
+                std::abs(position.y) - radius < depth / proj._22;
+            crowd_->SetPriority(ids[i], visible ? EstimateScreenSize(radius, depth, proj._22) : 0.0f);
+        }
+    }
+    crowd_->Animate(jobPool_.get());
+    UploadCrowd(frameIndex);
 }
 
 void ViewerModel::Render(ID3D12GraphicsCommandList* commandList, Matrix world, Matrix view, Matrix proj)
+{
+    // Nothing to draw until the model is loaded and its textures uploaded
+    if (!dxtkModel_ || textureUpload_.valid())
+    {
+        return;
+    }
+
+    if (!crowd_)
+    {
+        const size_t frame = vertexRing_.GetCurrentFrame();
+        if (frame != VertexRing::c_noFrame)
+        {
+            for (auto& part : dxtkModel_->meshes[0]->opaqueMeshParts)
+            {
+                part->vertexBuffer = vertexBuffers_[frame];
+            }
+        }
+        DrawModel(commandList, world, view, proj);
+        return;
+    }
+
+    // Each instance draws the shared index buffer with the vertices its slot last uploaded, instances added
+    // since Animate wait for the next frame
+    const std::vector<size_t>& ids = crowd_->GetInstanceIds();
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        const size_t frame = ids[i] < crowdVertexRings_.size() ? crowdVertexRings_[ids[i]].GetCurrentFrame() : VertexRing::c_noFrame;
+        if (frame == VertexRing::c_noFrame)
+        {
+            continue;
+        }
+        for (auto& part : dxtkModel_->meshes[0]->opaqueMeshParts)
+        {
+            part->vertexBuffer = crowdVertexBuffers_[ids[i] * frameCount_ + frame];
+        }
+        DrawModel(commandList, world * Matrix::CreateTranslation(GetCrowdOffset(i)), view, proj);
+    }
+}
+
+void ViewerModel::UploadCrowd(size_t frameIndex)
+{
+    // Slots keep their buffers while the crowd shrinks, the instances later given them start at a new revision
+    const size_t vertexBufferSize = crowd_->GetVertexCount() * sizeof(MeshVertex);
+    while (crowdVertexRings_.size() < crowd_->GetSlotCount())
+    {
+        for (size_t i = 0; i < frameCount_; i++)
+        {
+            crowdVertexBuffers_.emplace_back(GraphicsMemory::Get(device_).Allocate(vertexBufferSize));
+        }
+        crowdVertexRings_.emplace_back(frameCount_);
+    }
+
+    // Instances the LOD left alone or that have no action to play keep their revision and are not copied again
+    for (size_t id : crowd_->GetInstanceIds())
+    {
+        if (crowdVertexRings_[id].BeginFrame(frameIndex, crowd_->GetRevision(id)))
+        {
+            memcpy(crowdVertexBuffers_[id * frameCount_ + frameIndex].Memory(), crowd_->GetVertices(id), vertexBufferSize);
+        }
+    }
+}
+
+Vector3 ViewerModel::GetCrowdOffset(size_t position) const
+{
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(crowd_->GetInstanceCount()))));
+    const float center = (static_cast<float>(columns) - 1.0f) * 0.5f;
+    return Vector3((static_cast<float>(position % columns) - center) * crowdSpacing_, 0.0f,
+        (static_cast<float>(position / columns) - center) * crowdSpacing_);
+}
+
+void ViewerModel::DrawModel(ID3D12GraphicsCommandList* commandList, Matrix world, Matrix view, Matrix proj)
 {
 	// If there are no texture, just display vertex colors
     if (dxtkModel_->textureNames.empty()) 
@@ -31,44 +176,155 @@ void ViewerModel::Render(ID3D12GraphicsCommandList* commandList, Matrix world, M
         Model::UpdateEffectMatrices(dxtkModelNormal_, world, view, proj);
         dxtkModel_->Draw(commandList, dxtkModelNormal_.cbegin());
     }
+}
+
+void ViewerModel::SetAnimation(int idx)
+{
+    m3dModel_.CrossFadeAnim(idx, c_crossFadeTime);
+    if (crowd_)
+    {
+        for (size_t id : crowd_->GetInstanceIds())
+        {
+            crowd_->GetInstance(id).animIdx = idx;
+        }
+    }
+}
+
+void ViewerModel::SetCrowdSize(size_t count)
+{
+    crowdSize_ = std::max<size_t>(count, 1);
+    if (!IsLoading())
+    {
+        CreateCrowd();
+    }
+}
+
+void ViewerModel::SetLodBudget(size_t budget)
+{
+    lodBudget_ = budget;
+    if (!crowd_)
+    {
+        return;
+    }
+    if (budget == 0)
+    {
+        crowd_->DisableLod();
+        return;
+    }
+    AnimationLodSettings settings;
+    settings.updateBudget = budget;
+    crowd_->EnableLod(settings);
+}
+
+void ViewerModel::CreateCrowd()
+{
+    if (crowdSize_ <= 1)
+    {
+        crowd_.reset();
+        crowdVertexBuffers_.clear();
+        crowdVertexRings_.clear();
+        return;
+    }
 
-	if (m3dModel_.GetAnimNames().size() > 0)
+    // Cells are sized after the widest horizontal extent of the mesh
+    const M3dAsset& asset = m3dModel_.GetAsset();
+    if (!crowd_)
     {
-        m3dModel_.ApplyAnimToDXTKModel(*dxtkModel_);
+        float extent = 0.0f;
+        for (const MeshVertex& vertex : asset.GetVertices())
+        {
+            extent = std::max({ extent, std::abs(vertex.position[0]), std::abs(vertex.position[2]) });
+        }
+        crowdSpacing_ = 2.0f * extent * c_crowdSpacing;
+        crowd_ = std::make_unique<Crowd>(asset);
+        crowdVertexBuffers_.clear();
+        crowdVertexRings_.clear();
+        SetLodBudget(lodBudget_);
+    }
+
+    // Instances are added and removed at the end, those already there keep playing undisturbed
+    while (crowd_->GetInstanceCount() > crowdSize_)
+    {
+        crowd_->RemoveInstance(crowd_->GetInstanceIds().back());
+    }
+    while (crowd_->GetInstanceCount() < crowdSize_)
+    {
+        const size_t i = crowd_->GetInstanceCount();
+        CrowdInstance instance;
+        instance.animIdx = asset.GetAnimIdx();
+        instance.animTime = asset.GetAnimTime() + static_cast<float>(i) * c_crowdTimeStep;
+        instance.speed = 0.8f + 0.1f * static_cast<float>(i % 5);
+        crowd_->AddInstance(instance);
     }
 }
 
-void ViewerModel::CreateDeviceDependentResources(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, ID3D12CommandQueue* commandQueue)
+void ViewerModel::CreateDeviceDependentResources(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, ID3D12CommandQueue* commandQueue,
+    size_t frameCount)
 {
-    const auto& cull = CommonStates::CullClockwise;
+    device_ = device;
+    frameCount_ = frameCount;
+    backBufferFormat_ = backBufferFormat;
+    depthBufferFormat_ = depthBufferFormat;
+    commandQueue_ = commandQueue;
     dxtkStates_ = std::make_unique<CommonStates>(device);
-    ResourceUploadBatch resourceUpload(device);
-    RenderTargetState rtState(backBufferFormat, depthBufferFormat);
 
-    m3dModel_ = M3dModel(device, m3dPath_);
-    dxtkModel_ = m3dModel_.BuildDXTKModel();
+    // A model still loading gets its resources in Update, a model already loaded rebuilds them for the new device
+    if (!IsLoading())
+    {
+        CreateModelResources();
+    }
+}
+
+void ViewerModel::CreateModelResources()
+{
+    ResourceUploadBatch resourceUpload(device_);
+    RenderTargetState rtState(backBufferFormat_, depthBufferFormat_);
+
+    dxtkModel_ = m3dModel_.BuildDXTKModel(device_);
+
+    // One vertex buffer per frame in flight, each filled by the first frame that draws from it
+    const size_t vertexBufferSize = m3dModel_.GetAsset().GetVertices().size() * sizeof(MeshVertex);
+    vertexBuffers_.clear();
+    for (size_t i = 0; i < frameCount_; i++)
+    {
+        vertexBuffers_.emplace_back(GraphicsMemory::Get(device_).Allocate(vertexBufferSize));
+    }
+    vertexRing_ = VertexRing(frameCount_);
+    crowdVertexBuffers_.clear();
+    crowdVertexRings_.clear();
     if (!dxtkModel_->textureNames.empty())
     {
+        // The upload completes in the background, Update polls it
         EffectPipelineStateDescription pd(nullptr, CommonStates::Opaque, CommonStates::DepthDefault, CommonStates::CullClockwise, rtState);
         resourceUpload.Begin();
-        dxtkModelResources_ = dxtkModel_->LoadTextures(device, resourceUpload);
+        dxtkModelResources_ = dxtkModel_->LoadTextures(device_, resourceUpload);
         dxtkFxFactory_ = std::make_unique<EffectFactory>(dxtkModelResources_->Heap(), dxtkStates_->Heap());
-        auto uploadResourcesFinished = resourceUpload.End(commandQueue);
-        uploadResourcesFinished.wait();
+        textureUpload_ = resourceUpload.End(commandQueue_);
         dxtkModelNormal_ = dxtkModel_->CreateEffects(*dxtkFxFactory_, pd, pd);
     }
     else {
         EffectPipelineStateDescription pd(&VertexPositionNormalColorTexture::InputLayout, CommonStates::Opaque, CommonStates::DepthDefault, CommonStates::CullClockwise, rtState);
-        dxtkBasic = std::make_unique<BasicEffect>(device, EffectFlags::Lighting|EffectFlags::VertexColor, pd);
+        dxtkBasic = std::make_unique<BasicEffect>(device_, EffectFlags::Lighting|EffectFlags::VertexColor, pd);
     }
 }
 
 void ViewerModel::OnDeviceLost()
 {
+    if (textureUpload_.valid())
+    {
+        textureUpload_.wait();
+        textureUpload_ = {};
+    }
+    device_ = nullptr;
+    commandQueue_ = nullptr;
     dxtkStates_.reset();
 	dxtkFxFactory_.reset();
 	dxtkModelResources_.reset();
 	dxtkModel_.reset();
+    vertexBuffers_.clear();
+    vertexRing_ = VertexRing();
+    crowdVertexBuffers_.clear();
+    crowdVertexRings_.clear();
 	dxtkModelNormal_.clear();
 	dxtkBasic.reset();
 }
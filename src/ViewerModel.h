@@ -4,7 +4,11 @@
 
 #include "additionnal-dx-deps/StepTimer.h"
 #include "additionnal-dx-deps/DeviceResources.h"
+#include "AssetLoader.h"
+#include "Crowd.h"
+#include "JobPool.h"
 #include "M3dModel.h"
+#include "VertexRing.h"
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
@@ -15,24 +19,67 @@ class ViewerModel {
 public:
     
     ViewerModel() = default;
-    ViewerModel(const wchar_t* m3dPath);
+    // Starts loading the model in the background, frames render without it until it is ready
+    ViewerModel(const wchar_t* m3dPath, size_t skinningWorkers = JobPool::DefaultWorkerCount());
     void Update(DX::StepTimer const& timer);
+    // Skins the model, or the crowd, for the frame of frameIndex before Render records it, once per frame however
+    // many fixed steps Update ran. Skinning the next frame then overlaps the GPU drawing the previous ones
+    void Animate(size_t frameIndex, Matrix world, Matrix view, Matrix proj);
     void Render(ID3D12GraphicsCommandList* commandList, Matrix world, Matrix view, Matrix proj);
-    void CreateDeviceDependentResources(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, ID3D12CommandQueue* commandQueue);
+    // frameCount is the number of frames the swap chain keeps in flight
+    void CreateDeviceDependentResources(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, ID3D12CommandQueue* commandQueue,
+        size_t frameCount);
     void OnDeviceLost();
     
-	std::wstring GetModelName()                     const   { return m3dModel_.GetName(); };
+	std::wstring GetModelName()                     const   { return IsLoading() ? std::filesystem::path(m3dPath_).filename().wstring() : m3dModel_.GetName(); };
+    bool IsLoading()                                const   { return load_.IsValid(); }
+    LoadStage GetLoadStage()                        const   { return load_.GetStage(); }
     std::vector<std::wstring> GetAnimationNames()   const   { return m3dModel_.GetAnimNames(); };
-    void SetAnimation(int idx) { m3dModel_.SetAnimIdx(idx); };
+    void SetAnimation(int idx);
+    // Above one, draws that many copies of the model on a grid, each playing from its own time at its own speed
+    void SetCrowdSize(size_t count);
+    size_t GetCrowdSize()                           const   { return crowdSize_; }
+    // Instances of the crowd animated per frame on average, the others blend between their updates. 0 animates them all
+    void SetLodBudget(size_t budget);
+    size_t GetLodBudget()                           const   { return lodBudget_; }
+    // Frames the single model was skinned and uploaded, and frames it was skipped as already in pose
+    uint64_t GetSkinCount()                         const   { return m3dModel_.GetAsset().GetSkinCount(); }
+    uint64_t GetSkipCount()                         const   { return m3dModel_.GetAsset().GetSkipCount(); }
     
 private:
     
+    void CreateModelResources();
+    void CreateCrowd();
+    // Copies the vertices of the crowd instances that changed since their buffer of frameIndex was written
+    void UploadCrowd(size_t frameIndex);
+    void DrawModel(ID3D12GraphicsCommandList* commandList, Matrix world, Matrix view, Matrix proj);
+    // Grid cell of the instance at position in the crowd's instance ids
+    Vector3 GetCrowdOffset(size_t position) const;
+
     const wchar_t* m3dPath_;
+    AssetLoad load_;
     M3dModel m3dModel_;
+    std::unique_ptr<Crowd> crowd_;          // Shares the mesh and actions of m3dModel_
+    size_t crowdSize_ = 1;
+    float crowdSpacing_ = 0.0f;
+    size_t lodBudget_ = 0;
+    std::unique_ptr<JobPool> jobPool_;
     std::unique_ptr<CommonStates> dxtkStates_;
     std::unique_ptr<DirectX::Model> dxtkModel_;
+    std::vector<SharedGraphicsResource> vertexBuffers_;     // Skinned vertices of the single model, one per frame in flight
+    VertexRing vertexRing_;
+    std::vector<SharedGraphicsResource> crowdVertexBuffers_;    // frameCount_ per crowd slot, indexed by slot then frame
+    std::vector<VertexRing> crowdVertexRings_;                  // One per crowd slot
     DirectX::Model::EffectCollection dxtkModelNormal_;
     std::unique_ptr<DirectX::EffectTextureFactory> dxtkModelResources_;
     std::unique_ptr<DirectX::EffectFactory> dxtkFxFactory_;
     std::unique_ptr<BasicEffect> dxtkBasic;
+    std::future<void> textureUpload_;
+
+    // Kept to create the model resources once the load completes
+    ID3D12Device* device_ = nullptr;
+    DXGI_FORMAT backBufferFormat_ = DXGI_FORMAT_UNKNOWN;
+    DXGI_FORMAT depthBufferFormat_ = DXGI_FORMAT_UNKNOWN;
+    ID3D12CommandQueue* commandQueue_ = nullptr;
+    size_t frameCount_ = 1;
 };
\ No newline at end of file
@@ -0,0 +1,1243 @@
+#include "Cli.h"
+#include "SyntheticModel.h"
+#include "AnimationBlender.h"
+#include "AnimationLod.h"
+#include "AnimationPose.h"
+#include "AssetCache.h"
+#include "AssetLoader.h"
+#include "BakedClip.h"
+#include "BatchLoader.h"
+#include "CompressedClip.h"
+#include "Crowd.h"
+#include "ForwardKinematics.h"
+#include "JobPool.h"
+#include "KeyframeIndex.h"
+#include "M3dAsset.h"
+#include "M3dChunkStream.h"
+#include "PoseCache.h"
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Random sample times, drawn once so every sampling path sees the same ones
+    std::vector<uint32_t> MakeSampleTimes(uint32_t duration, size_t count)
+    {
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<uint32_t> distribution(0, duration ? duration - 1 : 0);
+        std::vector<uint32_t> times(count);
+        for (uint32_t& time : times)
+        {
+            time = distribution(random);
+        }
+        return times;
+    }
+
+    // Microseconds per sample of m3d_pose_r, which replays the action from its first frame every time
+    double TimeM3dPose(const m3d_t* model, M3D_INDEX actionId, const std::vector<uint32_t>& times)
+    {
+        std::vector<m3db_t> pose(model->numbone);
+        std::vector<m3dtr_t> frame(model->numbone);
+        std::vector<m3dv_t> interp(M3D_POSEINTERP(model));
+        Stopwatch stopwatch;
+        for (uint32_t time : times)
+        {
+            m3d_pose_r(model, actionId, time, pose.data(), frame.data(), interp.data());
+        }
+        return stopwatch.GetMilliseconds() * 1000.0 / times.size();
+    }
+
+    double TimeKeyframeIndex(const KeyframeIndex& keyframes, AnimationPose& pose, const std::vector<uint32_t>& times)
+    {
+        KeyframeCursor cursor;
+        Stopwatch stopwatch;
+        for (uint32_t time : times)
+        {
+            keyframes.Sample(time, cursor, pose.GetLocalTransforms());
+        }
+        return stopwatch.GetMilliseconds() * 1000.0 / times.size();
+    }
+
+    double TimeBakedClip(const BakedClip& clip, AnimationPose& pose, const std::vector<uint32_t>& times)
+    {
+        Stopwatch stopwatch;
+        for (uint32_t time : times)
+        {
+            clip.Sample(static_cast<float>(time), pose.GetLocalTransforms());
+        }
+        return stopwatch.GetMilliseconds() * 1000.0 / times.size();
+    }
+
+    double TimeCompressedClip(const CompressedClip& clip, AnimationPose& pose, const std::vector<uint32_t>& times)
+    {
+        Stopwatch stopwatch;
+        for (uint32_t time : times)
+        {
+            clip.Sample(static_cast<float>(time), pose.GetLocalTransforms());
+        }
+        return stopwatch.GetMilliseconds() * 1000.0 / times.size();
+    }
+
+    // Bytes an action takes in the loaded model, its frames and the transforms they list, each pointing at a
+    // position and an orientation vertex
+    size_t GetM3dActionSize(const m3da_t& action)
+    {
+        size_t size = sizeof(m3da_t) + action.numframe * sizeof(m3dfr_t);
+        for (M3D_INDEX i = 0; i < action.numframe; i++)
+        {
+            size += action.frame[i].numtransform * (sizeof(m3dtr_t) + 2 * sizeof(m3dv_t));
+        }
+        return size;
+    }
+
+    // Compressed is the clip under test, largest position and angle gaps of any bone at any of the times
+    void MeasureClipError(const BakedClip& baked, const CompressedClip& compressed, const std::vector<uint32_t>& times,
+        float& positionError, float& rotationError)
+    {
+        std::vector<BoneTransform> expected(baked.GetBoneCount());
+        std::vector<BoneTransform> actual(baked.GetBoneCount());
+        positionError = 0.0f;
+        rotationError = 0.0f;
+        for (uint32_t time : times)
+        {
+            baked.Sample(static_cast<float>(time), expected.data());
+            compressed.Sample(static_cast<float>(time), actual.data());
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                const float* p = expected[i].orientation;
+                const float* q = actual[i].orientation;
+                for (int c = 0; c < 3; c++)
+                {
+                    positionError = std::max(positionError, std::fabs(expected[i].position[c] - actual[i].position[c]));
+                }
+                const double d = std::fabs(static_cast<double>(p[0]) * q[0] + static_cast<double>(p[1]) * q[1] +
+                    static_cast<double>(p[2]) * q[2] + static_cast<double>(p[3]) * q[3]);
+                rotationError = std::max(rotationError, static_cast<float>(2.0 * std::acos(std::min(d, 1.0))));
+            }
+        }
+    }
+
+    // Seen from a camera at cameraX, cameraZ looking at the origin with the viewer's field of view, over a grid
+    // of models of radius at positions, the screen size of each, 0 when it falls out of view
+    void SetCrowdPriorities(Crowd& crowd, const std::vector<float>& positions, float radius, float cameraX, float cameraZ)
+    {
+        constexpr float c_tanHalfFovY = 0.41421356f;        // Quarter pi vertical field of view
+        constexpr float c_tanHalfFovX = c_tanHalfFovY * 16.0f / 9.0f;
+        const float distance = std::sqrt(cameraX * cameraX + cameraZ * cameraZ);
+        const float forwardX = -cameraX / distance;
+        const float forwardZ = -cameraZ / distance;
+        const std::vector<size_t>& ids = crowd.GetInstanceIds();
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            const float x = positions[i * 2] - cameraX;
+            const float z = positions[i * 2 + 1] - cameraZ;
+            const float depth = x * forwardX + z * forwardZ;
+            const float side = x * forwardZ - z * forwardX;
+            const bool visible = depth > -radius && std::fabs(side) - radius < depth * c_tanHalfFovX;
+            crowd.SetPriority(ids[i], visible ? EstimateScreenSize(radius, depth, 1.0f / c_tanHalfFovY) : 0.0f);
+        }
+    }
+
+    // Compressed body of a binary model, past the file header and the uncompressed preview
+    const unsigned char* FindCompressedBody(const std::vector<unsigned char>& file, size_t& size)
+    {
+        uint32_t length = 0;
+        if (file.size() >= 8)
+        {
+            memcpy(&length, file.data() + 4, sizeof(length));
+        }
+        if (file.size() < 16 || memcmp(file.data(), "3DMO", 4) != 0 || length < 16 || length > file.size())
+        {
+            return nullptr;
+        }
+        size_t offset = 8;
+        if (!memcmp(file.data() + offset, "PRVW", 4))
+        {
+            uint32_t previewLength;
+            memcpy(&previewLength, file.data() + offset + 4, sizeof(previewLength));
+            offset += previewLength;
+        }
+        if (offset + 4 > length || !memcmp(file.data() + offset, "HEAD", 4))
+        {
+            return nullptr;
+        }
+        size = length - offset;
+        return file.data() + offset;
+    }
+
+    // Inflated megabytes per second of a whole-body decompressor, checking it against the expected output
+    using InflateFunction = unsigned char* (*)(const unsigned char* data, unsigned int size, unsigned int* outSize);
+    double TimeInflate(InflateFunction function, const unsigned char* body, size_t size, size_t runs,
+        std::vector<unsigned char>& expected)
+    {
+        double bestTime = 0.0;
+        for (size_t i = 0; i < runs; i++)
+        {
+            unsigned int outSize = 0;
+            Stopwatch stopwatch;
+            unsigned char* output = function(body, static_cast<unsigned int>(size), &outSize);
+            const double time = stopwatch.GetMilliseconds();
+            if (!output)
+            {
+                throw std::runtime_error("RunInflateBenchmark");
+            }
+            if (expected.empty())
+            {
+                expected.assign(output, output + outSize);
+            }
+            const bool same = expected.size() == outSize && !memcmp(expected.data(), output, outSize);
+            free(output);
+            if (!same)
+            {
+                throw std::runtime_error("RunInflateBenchmark");
+            }
+            bestTime = i ? std::min(bestTime, time) : time;
+        }
+        return expected.size() / (bestTime * 1000.0);
+    }
+
+    // Same for the chunk by chunk decompression of the streamed parse
+    template <typename T, typename Allocator>
+    bool IsSameArray(const std::vector<T, Allocator>& a, const std::vector<T, Allocator>& b)
+    {
+        return a.size() == b.size() && (a.empty() || !memcmp(a.data(), b.data(), a.size() * sizeof(T)));
+    }
+
+    // Built buffers and names, then the vertices after skinning a few frames of every action
+    bool IsSameAsset(M3dAsset& a, M3dAsset& b)
+    {
+        if (!IsSameArray(a.GetVertices(), b.GetVertices()) || !IsSameArray(a.GetIndices(), b.GetIndices()) ||
+            !IsSameArray(a.GetShortIndices(), b.GetShortIndices()) || !IsSameArray(a.GetParts(), b.GetParts()) ||
+            a.GetTextureNames() != b.GetTextureNames() || a.GetBoneNames() != b.GetBoneNames() ||
+            a.GetAnimNames() != b.GetAnimNames() || a.GetFaceCount() != b.GetFaceCount())
+        {
+            return false;
+        }
+        for (size_t action = 0; action < a.GetAnimations().size(); action++)
+        {
+            a.SetAnimIdx(static_cast<int>(action));
+            b.SetAnimIdx(static_cast<int>(action));
+            for (int frame = 0; frame < 4; frame++)
+            {
+                a.UpdateAnimTime(37.0f);
+                b.UpdateAnimTime(37.0f);
+                a.Animate();
+                b.Animate();
+                if (!IsSameArray(a.GetVertices(), b.GetVertices()))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    double TimeChunkStream(std::vector<unsigned char>& file, size_t runs, size_t inflatedSize)
+    {
+        double bestTime = 0.0;
+        for (size_t i = 0; i < runs; i++)
+        {
+            Stopwatch stopwatch;
+            M3dChunkStream stream(file.data(), file.size());
+            while (stream.Next())
+            {
+            }
+            const double time = stopwatch.GetMilliseconds();
+            bestTime = i ? std::min(bestTime, time) : time;
+        }
+        return inflatedSize / (bestTime * 1000.0);
+    }
+    // Poses of every actor over a number of frames at 60 Hz, through the cache when given one, the way a crowd
+    // poses its instances. Returns the time per frame in microseconds
+    double TimeActorPoses(const M3dAsset& asset, std::vector<CrowdInstance> actors, size_t frameCount, PoseCache* cache)
+    {
+        const AnimationPose& pose = asset.GetPose();
+        std::vector<BoneTransform> local(pose.GetBindTransforms(), pose.GetBindTransforms() + pose.GetBoneCount());
+        std::vector<float> matrices(pose.GetBoneCount() * c_boneMatrixSize);
+        Stopwatch stopwatch;
+        for (size_t frame = 0; frame < frameCount; frame++)
+        {
+            for (CrowdInstance& actor : actors)
+            {
+                const BakedClip& clip = asset.GetAnimations()[actor.animIdx];
+                uint64_t key = 0;
+                const float time = cache ? cache->Quantize(actor.animIdx, actor.animTime, clip.GetDuration(), key) : actor.animTime;
+                if (!cache || !cache->Find(key, matrices.data()))
+                {
+                    clip.Sample(time, local.data());
+                    ComputeBoneMatrices(pose.GetKernelLevel(), pose.GetHierarchy(), local.data(), matrices.data());
+                    if (cache)
+                    {
+                        cache->Insert(key, matrices.data());
+                    }
+                }
+                actor.animTime += actor.speed * 1000.0f / 60.0f;
+            }
+        }
+        return stopwatch.GetMilliseconds() * 1000.0 / frameCount;
+    }
+
+    struct WeldKey {
+        float values[VertexWelder::KeySize];
+    };
+
+    // The weld key of every triangle corner of a model, as M3dAsset::BuildMesh makes them
+    std::vector<WeldKey> GatherWeldKeys(const m3d_t* model)
+    {
+        std::vector<WeldKey> keys;
+        keys.reserve(static_cast<size_t>(model->numface) * 3);
+        for (M3D_INDEX f = 0; f < model->numface; f++)
+        {
+            const m3df_t& face = model->face[f];
+            for (int i : { 0, 1, 2 })
+            {
+                const m3dv_t& position = model->vertex[face.vertex[i]];
+                const m3dv_t& normal = model->vertex[face.normal[i]];
+                const bool textured = face.texcoord[i] < model->numtmap;
+                keys.push_back({ { position.x, position.y, position.z, normal.x, normal.y, normal.z,
+                    textured ? model->tmap[face.texcoord[i]].u : 0.0f, 1 - (textured ? model->tmap[face.texcoord[i]].v : 0.0f) } });
+            }
+        }
+        return keys;
+    }
+
+    // Bind vertex of the skinning path SkinningContext replaced, which rebuilt every influence through both the
+    // inverse bind matrix and the pose matrix of its bone
+    struct LegacySkinVertex {
+        float position[3];
+        float normal[3];
+        M3D_INDEX boneId[M3D_NUMBONE];
+        float weight[M3D_NUMBONE];
+        uint32_t influenceCount;
+    };
+
+    // The welded vertices of a model in M3dAsset::BuildMesh order, without splitting for short indices
+    std::vector<LegacySkinVertex> GatherLegacySkinVertices(const m3d_t* model)
+    {
+        const std::vector<WeldKey> keys = GatherWeldKeys(model);
+        VertexWelder welder(keys.size());
+        std::vector<LegacySkinVertex> vertices;
+        for (size_t corner = 0; corner < keys.size(); corner++)
+        {
+            bool inserted;
+            welder.Weld(keys[corner].values, inserted);
+            if (!inserted)
+            {
+                continue;
+            }
+            const m3df_t& face = model->face[corner / 3];
+            const m3dv_t& position = model->vertex[face.vertex[corner % 3]];
+            const m3dv_t& normal = model->vertex[face.normal[corner % 3]];
+            LegacySkinVertex vertex = { { position.x, position.y, position.z }, { normal.x, normal.y, normal.z }, {}, {}, 0 };
+            if (position.skinid != M3D_UNDEF && position.skinid < model->numskin)
+            {
+                const m3ds_t& skin = model->skin[position.skinid];
+                for (int j = 0; j < M3D_NUMBONE && skin.boneid[j] < model->numbone && skin.weight[j] > 0.0f; j++)
+                {
+                    vertex.boneId[j] = skin.boneid[j];
+                    vertex.weight[j] = skin.weight[j];
+                    vertex.influenceCount++;
+                }
+            }
+            vertices.push_back(vertex);
+        }
+        return vertices;
+    }
+
+    void TransformPoint(const float* m, const float* v, float* out)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            out[r] = m[r * 4] * v[0] + m[r * 4 + 1] * v[1] + m[r * 4 + 2] * v[2] + m[r * 4 + 3];
+        }
+    }
+
+    void TransformDirection(const float* m, const float* v, float* out)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            out[r] = m[r * 4] * v[0] + m[r * 4 + 1] * v[1] + m[r * 4 + 2] * v[2];
+        }
+    }
+
+    void SkinPerInfluence(const std::vector<LegacySkinVertex>& vertices, const float* inverseBindMatrices, const float* boneMatrices,
+        MeshVertex* out)
+    {
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            const LegacySkinVertex& vertex = vertices[v];
+            float position[3] = { vertex.position[0], vertex.position[1], vertex.position[2] };
+            float normal[3] = { vertex.normal[0], vertex.normal[1], vertex.normal[2] };
+            if (vertex.influenceCount > 0)
+            {
+                position[0] = position[1] = position[2] = 0.0f;
+                normal[0] = normal[1] = normal[2] = 0.0f;
+                for (uint32_t i = 0; i < vertex.influenceCount; i++)
+                {
+                    const float* bindMatrix = &inverseBindMatrices[vertex.boneId[i] * c_boneMatrixSize];
+                    const float* poseMatrix = &boneMatrices[vertex.boneId[i] * c_boneMatrixSize];
+                    float boneSpace[3];
+                    float poseSpace[3];
+                    TransformPoint(bindMatrix, vertex.position, boneSpace);
+                    TransformPoint(poseMatrix, boneSpace, poseSpace);
+                    TransformDirection(bindMatrix, vertex.normal, boneSpace);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        position[c] += poseSpace[c] * vertex.weight[i];
+                    }
+                    TransformDirection(poseMatrix, boneSpace, poseSpace);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        normal[c] += poseSpace[c] * vertex.weight[i];
+                    }
+                }
+                const float lengthSq = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+                const float invLength = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 1.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    normal[c] *= invLength;
+                }
+            }
+            std::copy_n(position, 3, out[v].position);
+            std::copy_n(normal, 3, out[v].normal);
+        }
+    }
+
+    // Times the per-influence path against SkinningContext with each kernel, skinning one pose of a model.
+    // Fails when a kernel moves a position or normal component further than tolerance from the per-influence path.
+    int CompareSkinningPaths(const std::string& path, size_t runs, float tolerance)
+    {
+        M3dAsset asset(ReadFile(path));
+        asset.BuildMesh();
+        if (asset.GetAnimations().empty())
+        {
+            std::printf("%s: no actions, skipped\n", path.c_str());
+            return 0;
+        }
+        asset.SetAnimIdx(0);
+        asset.UpdateAnimTime(asset.GetAnimations()[0].GetDuration() * 0.5f);
+        asset.Animate();
+        const size_t boneCount = asset.GetPose().GetBoneCount();
+        const std::vector<float> boneMatrices(asset.GetPose().GetBoneMatrices(), asset.GetPose().GetBoneMatrices() + boneCount * c_boneMatrixSize);
+
+        const std::vector<LegacySkinVertex> legacyVertices = GatherLegacySkinVertices(asset.GetModel());
+        if (legacyVertices.size() != asset.GetVertices().size())
+        {
+            throw std::runtime_error("Welded vertices differ from the asset's");
+        }
+        std::vector<MeshVertex> expected = asset.GetVertices();
+        Stopwatch stopwatch;
+        for (size_t run = 0; run < runs; run++)
+        {
+            SkinPerInfluence(legacyVertices, asset.GetInverseBindMatrices(), boneMatrices.data(), expected.data());
+        }
+        const double legacyTime = stopwatch.GetMilliseconds() * 1000.0 / runs;
+
+        std::printf("%s: %zu vertices, %zu bones, one pose skinned %zu times on one thread\n", path.c_str(), expected.size(), boneCount, runs);
+        std::printf("%-16s %12s %10s %14s %14s\n", "path", "us/pose", "speedup", "position error", "normal error");
+        std::printf("%-16s %12.2f %10s %14s %14s\n", "per-influence", legacyTime, "1.00x", "-", "-");
+
+        const SkinnedVertexLayout layout = { sizeof(MeshVertex), offsetof(MeshVertex, position), offsetof(MeshVertex, normal) };
+        std::vector<MeshVertex> skinned = asset.GetVertices();
+        int result = 0;
+        for (SkinKernelLevel level : { SkinKernelLevel::Scalar, SkinKernelLevel::Sse41, SkinKernelLevel::Neon, SkinKernelLevel::Avx2 })
+        {
+            if (!IsSkinKernelSupported(level))
+            {
+                continue;
+            }
+            asset.GetSkinning().SetKernelLevel(level);
+            stopwatch.Restart();
+            for (size_t run = 0; run < runs; run++)
+            {
+                asset.GetSkinning().Skin(boneMatrices.data(), skinned.data(), layout);
+            }
+            const double time = stopwatch.GetMilliseconds() * 1000.0 / runs;
+
+            float positionError = 0.0f;
+            float normalError = 0.0f;
+            for (size_t v = 0; v < skinned.size(); v++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    positionError = std::max(positionError, std::fabs(skinned[v].position[c] - expected[v].position[c]));
+                    normalError = std::max(normalError, std::fabs(skinned[v].normal[c] - expected[v].normal[c]));
+                }
+            }
+            // Written so that NaN fails as well
+            const bool matches = positionError <= tolerance && normalError <= tolerance;
+            result = matches ? result : 1;
+            const std::string name = std::string("context ") + GetSkinKernelName(level);
+            std::printf("%-16s %12.2f %9.2fx %14.3g %14.3g%s\n", name.c_str(), time, legacyTime / time, positionError, normalError,
+                matches ? "" : "  MISMATCH");
+        }
+        return result;
+    }
+}
+
+int RunWeldBenchmark(const CliOptions& options)
+{
+    std::vector<std::filesystem::path> paths;
+    for (const std::string& argument : options.arguments)
+    {
+        if (std::filesystem::is_directory(argument))
+        {
+            const std::vector<std::filesystem::path> found = FindModels(argument);
+            paths.insert(paths.end(), found.begin(), found.end());
+        }
+        else
+        {
+            paths.emplace_back(argument);
+        }
+    }
+    if (paths.empty())
+    {
+        std::fprintf(stderr, "bench-weld needs a model or a directory of models\n");
+        return 1;
+    }
+    const size_t runs = std::max<size_t>(static_cast<size_t>(options.GetNumber("runs", 5)), 1);
+    const float epsilon = static_cast<float>(options.GetNumber("weld", 0));
+
+    // Only the welder is timed, the corners are gathered from the model once
+    std::printf("best of %zu runs, weld distance %g\n", runs, epsilon);
+    std::printf("%-24s %14s %14s %10s %14s\n", "model", "input vertices", "welded",  "ms", "Mvertices/s");
+    for (const std::filesystem::path& path : paths)
+    {
+        const M3dAsset asset(ReadFile(path.string()));
+        const std::vector<WeldKey> keys = GatherWeldKeys(asset.GetModel());
+        size_t weldedCount = 0;
+        double time = 0.0;
+        for (size_t run = 0; run < runs; run++)
+        {
+            Stopwatch stopwatch;
+            VertexWelder welder(keys.size(), epsilon);
+            for (const WeldKey& key : keys)
+            {
+                bool inserted;
+                welder.Weld(key.values, inserted);
+            }
+            time = run ? std::min(time, stopwatch.GetMilliseconds()) : stopwatch.GetMilliseconds();
+            weldedCount = welder.GetVertexCount();
+        }
+        std::printf("%-24s %14zu %14zu %10.3f %14.1f\n", path.string().c_str(), keys.size(), weldedCount, time,
+            time > 0.0 ? keys.size() / (time * 1000.0) : 0.0);
+    }
+    return 0;
+}
+
+int RunSkinningBenchmark(const CliOptions& options)
+{
+    if (!options.arguments.empty())
+    {
+        const size_t runs = std::max<size_t>(static_cast<size_t>(options.GetNumber("frames", 1000)), 1);
+        const float tolerance = static_cast<float>(options.GetNumber("tolerance", 1e-5));
+        int result = 0;
+        for (const std::string& argument : options.arguments)
+        {
+            std::vector<std::filesystem::path> paths = { argument };
+            if (std::filesystem::is_directory(argument))
+            {
+                paths = FindModels(argument);
+            }
+            for (const std::filesystem::path& path : paths)
+            {
+                result = CompareSkinningPaths(path.string(), runs, tolerance) ? 1 : result;
+            }
+        }
+        return result;
+    }
+
+    SyntheticModelDesc desc;
+    desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", static_cast<double>(desc.vertexCount)));
+    desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 100));
+    const size_t maxWorkers = static_cast<size_t>(options.GetNumber("max-workers", static_cast<double>(JobPool::DefaultWorkerCount())));
+
+    SyntheticModel synthetic(desc);
+    M3dAsset asset(synthetic.Save(false));
+    asset.BuildMesh();
+    std::printf("%zu vertices, %u bones, %zu frames per run\n", asset.GetVertices().size(), asset.GetModel()->numbone, frameCount);
+    std::printf("%-8s %8s %12s %14s\n", "kernel", "workers", "ms/frame", "Mvertices/s");
+
+    for (SkinKernelLevel level : { SkinKernelLevel::Scalar, SkinKernelLevel::Sse41, SkinKernelLevel::Neon, SkinKernelLevel::Avx2 })
+    {
+        if (!IsSkinKernelSupported(level))
+        {
+            continue;
+        }
+        asset.GetSkinning().SetKernelLevel(level);
+        for (size_t workers = 0;; workers = workers ? workers * 2 : 1)
+        {
+            JobPool jobPool(std::min(workers, maxWorkers));
+            asset.SetAnimIdx(0);
+            asset.Animate(&jobPool);
+            Stopwatch stopwatch;
+            for (size_t i = 0; i < frameCount; i++)
+            {
+                asset.UpdateAnimTime(1000.0f / 60.0f);
+                asset.Animate(&jobPool);
+            }
+            const double frameTime = stopwatch.GetMilliseconds() / frameCount;
+            std::printf("%-8s %8zu %12.3f %14.1f\n", GetSkinKernelName(level), jobPool.GetWorkerCount(), frameTime,
+                asset.GetVertices().size() / (frameTime * 1000.0));
+            if (workers >= maxWorkers)
+            {
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+int RunKeyframeBenchmark(const CliOptions& options)
+{
+    const size_t boneCount = static_cast<size_t>(options.GetNumber("bones", 64));
+    const size_t sampleCount = static_cast<size_t>(options.GetNumber("samples", 2000));
+
+    // Lengthening the action shows which sampling paths depend on the number of frames before the sampled time
+    std::printf("%u bones, %zu random samples per action\n", static_cast<unsigned>(boneCount), sampleCount);
+    std::printf("%8s %16s %18s %14s\n", "frames", "m3d_pose_r us", "keyframe index us", "baked clip us");
+    for (size_t frameCount : { 30, 120, 480, 1920, 7680 })
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        desc.boneCount = boneCount;
+        desc.frameCount = frameCount;
+        desc.keyedBoneStride = 2;
+        SyntheticModel synthetic(desc);
+        const m3d_t* model = synthetic.Get();
+
+        const KeyframeIndex keyframes(model, 0);
+        const BakedClip clip(keyframes);
+        AnimationPose pose(model);
+        const std::vector<uint32_t> times = MakeSampleTimes(keyframes.GetDuration(), sampleCount);
+        std::printf("%8zu %16.3f %18.3f %14.3f\n", frameCount, TimeM3dPose(model, 0, times),
+            TimeKeyframeIndex(keyframes, pose, times), TimeBakedClip(clip, pose, times));
+    }
+    return 0;
+}
+
+int RunPoseBenchmark(const CliOptions& options)
+{
+    const size_t sampleCount = static_cast<size_t>(options.GetNumber("samples", 20000));
+
+    std::unique_ptr<SyntheticModel> synthetic;
+    std::unique_ptr<M3dAsset> asset;
+    const m3d_t* model;
+    if (!options.arguments.empty())
+    {
+        asset = std::make_unique<M3dAsset>(ReadFile(options.arguments[0]));
+        model = asset->GetModel();
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        synthetic = std::make_unique<SyntheticModel>(desc);
+        model = synthetic->Get();
+    }
+
+    // Forward kinematics is timed apart, every sampling path feeds the same local transforms into it
+    AnimationPose pose(model);
+    std::printf("%u bones, %zu random samples per action\n", model->numbone, sampleCount);
+    std::printf("%-24s %8s %14s %14s %14s %16s %16s\n", "action", "frames", "m3d_pose_r us", "keyframes us", "baked us",
+        "keyframes bytes", "baked bytes");
+    for (M3D_INDEX i = 0; i < model->numaction; i++)
+    {
+        const KeyframeIndex keyframes(model, i);
+        const BakedClip clip(keyframes);
+        const std::vector<uint32_t> times = MakeSampleTimes(keyframes.GetDuration(), sampleCount);
+        std::printf("%-24s %8zu %14.3f %14.3f %14.3f %16zu %16zu\n", model->action[i].name ? model->action[i].name : "",
+            keyframes.GetFrameCount(), TimeM3dPose(model, i, times), TimeKeyframeIndex(keyframes, pose, times),
+            TimeBakedClip(clip, pose, times), keyframes.GetMemorySize(), clip.GetMemorySize());
+    }
+
+    Stopwatch stopwatch;
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        pose.UpdateBoneMatrices();
+    }
+    std::printf("bone matrices %.3f us\n", stopwatch.GetMilliseconds() * 1000.0 / sampleCount);
+    return 0;
+}
+
+int RunForwardKinematicsBenchmark(const CliOptions& options)
+{
+    const size_t sampleCount = static_cast<size_t>(options.GetNumber("samples", 20000));
+    std::vector<size_t> boneCounts = { 256, 1024 };
+    if (options.Has("bones"))
+    {
+        boneCounts = { static_cast<size_t>(options.GetNumber("bones", 0)) };
+    }
+
+    std::printf("%zu updates per skeleton\n", sampleCount);
+    std::printf("%8s %8s %-8s %14s %10s\n", "bones", "levels", "kernel", "us/update", "speedup");
+    bool matches = true;
+    for (size_t boneCount : boneCounts)
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        desc.boneCount = boneCount;
+        desc.frameCount = 1;
+        SyntheticModel synthetic(desc);
+        AnimationPose pose(synthetic.Get());
+
+        // Random unit quaternions, plus the orientation M3D turns into a flip, so every lane path gets exercised
+        std::mt19937 random(static_cast<uint32_t>(boneCount));
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        BoneTransform* local = pose.GetLocalTransforms();
+        for (size_t i = 0; i < pose.GetBoneCount(); i++)
+        {
+            float length = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                local[i].orientation[k] = distribution(random);
+                length += local[i].orientation[k] * local[i].orientation[k];
+            }
+            for (int k = 0; k < 4; k++)
+            {
+                local[i].orientation[k] /= std::sqrt(length);
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                local[i].position[k] = distribution(random);
+            }
+        }
+        const BoneTransform flip = { { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.707107f, 0.0f } };
+        local[pose.GetBoneCount() / 2] = flip;
+
+        std::vector<float> reference;
+        double scalarTime = 0.0;
+        for (SkinKernelLevel level : { SkinKernelLevel::Scalar, SkinKernelLevel::Sse41, SkinKernelLevel::Neon, SkinKernelLevel::Avx2 })
+        {
+            if (!IsSkinKernelSupported(level))
+            {
+                continue;
+            }
+            pose.SetKernelLevel(level);
+            pose.UpdateBoneMatrices();
+            Stopwatch stopwatch;
+            for (size_t i = 0; i < sampleCount; i++)
+            {
+                pose.UpdateBoneMatrices();
+            }
+            const double updateTime = stopwatch.GetMilliseconds() * 1000.0 / sampleCount;
+
+            const float* matrices = pose.GetBoneMatrices();
+            const size_t floatCount = pose.GetBoneCount() * c_boneMatrixSize;
+            const char* result = "";
+            if (level == SkinKernelLevel::Scalar)
+            {
+                reference.assign(matrices, matrices + floatCount);
+                scalarTime = updateTime;
+            }
+            else if (memcmp(reference.data(), matrices, floatCount * sizeof(float)))
+            {
+                result = "  MISMATCH";
+                matches = false;
+            }
+            std::printf("%8zu %8zu %-8s %14.3f %9.2fx%s\n", pose.GetBoneCount(), pose.GetHierarchy().GetLevelCount(),
+                GetSkinKernelName(level), updateTime, scalarTime / updateTime, result);
+        }
+    }
+    return matches ? 0 : 1;
+}
+
+int RunCrowdBenchmark(const CliOptions& options)
+{
+    const size_t instanceCount = static_cast<size_t>(options.GetNumber("instances", 1000));
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 100));
+    const size_t maxWorkers = static_cast<size_t>(options.GetNumber("max-workers", static_cast<double>(JobPool::DefaultWorkerCount())));
+
+    M3dAsset asset;
+    if (!options.arguments.empty())
+    {
+        LoadOptions loadOptions;
+        loadOptions.cached = false;
+        asset = LoadAsset(options.arguments[0], loadOptions);
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", 2000));
+        desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+        SyntheticModel synthetic(desc);
+        asset = M3dAsset(synthetic.Save(false));
+        asset.BuildMesh();
+    }
+    if (asset.GetAnimations().empty())
+    {
+        throw std::runtime_error("Model has no actions");
+    }
+
+    // Every instance plays a random action from a random time at its own speed
+    Crowd crowd(asset);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> actions(0, static_cast<int>(asset.GetAnimations().size()) - 1);
+    std::uniform_real_distribution<float> times(0.0f, 10000.0f);
+    std::uniform_real_distribution<float> speeds(0.5f, 1.5f);
+    for (size_t i = 0; i < instanceCount; i++)
+    {
+        crowd.AddInstance({ actions(random), times(random), speeds(random) });
+    }
+    const bool poseCached = options.Has("pose-step");
+    const float poseStep = static_cast<float>(options.GetNumber("pose-step", 0.0));
+    if (poseCached)
+    {
+        crowd.EnablePoseCache(std::max<size_t>(instanceCount, 1), poseStep);
+    }
+
+    std::printf("%zu instances of %zu vertices and %zu bones, %zu frames per run\n", crowd.GetInstanceCount(),
+        crowd.GetVertexCount(), asset.GetPose().GetBoneCount(), frameCount);
+    std::printf("%8s %12s %14s %12s %10s\n", "workers", "ms/frame", "instances/ms", "pool MB", "pose hits");
+    for (size_t workers = 0;; workers = workers ? workers * 2 : 1)
+    {
+        JobPool jobPool(std::min(workers, maxWorkers));
+        crowd.Animate(&jobPool);
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            crowd.UpdateAnimTime(1000.0f / 60.0f);
+            crowd.Animate(&jobPool);
+        }
+        const double frameTime = stopwatch.GetMilliseconds() / frameCount;
+        std::printf("%8zu %12.3f %14.1f %12.1f %9.1f%%\n", jobPool.GetWorkerCount(), frameTime, crowd.GetInstanceCount() / frameTime,
+            crowd.GetMemorySize() / (1024.0 * 1024.0), poseCached ? crowd.GetPoseCache()->GetHitRate() * 100.0 : 0.0);
+        if (workers >= maxWorkers)
+        {
+            break;
+        }
+    }
+
+    // An instance must match the asset animated on its own at the same action and time, quantized poses aside
+    if (poseStep > 0.0f)
+    {
+        return 0;
+    }
+    const size_t id = crowd.GetInstanceIds().back();
+    const CrowdInstance& instance = crowd.GetInstance(id);
+    asset.SetAnimIdx(instance.animIdx);
+    asset.UpdateAnimTime(instance.animTime);
+    asset.Animate();
+    if (memcmp(asset.GetVertices().data(), crowd.GetVertices(id), crowd.GetVertexCount() * sizeof(MeshVertex)))
+    {
+        std::printf("instance %zu differs from the asset animated alone\n", id);
+        return 1;
+    }
+    return 0;
+}
+
+int RunPoseCacheBenchmark(const CliOptions& options)
+{
+    const size_t actorCount = static_cast<size_t>(options.GetNumber("actors", 1000));
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 100));
+    const float timeStep = static_cast<float>(options.GetNumber("step", 1.0));
+    const float jitter = static_cast<float>(options.GetNumber("jitter", 0.25));
+    const size_t capacity = static_cast<size_t>(options.GetNumber("capacity", static_cast<double>(std::max<size_t>(actorCount, 1))));
+
+    M3dAsset asset;
+    if (!options.arguments.empty())
+    {
+        LoadOptions loadOptions;
+        loadOptions.cached = false;
+        asset = LoadAsset(options.arguments[0], loadOptions);
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+        SyntheticModel synthetic(desc);
+        asset = M3dAsset(synthetic.Save(false));
+        asset.BuildMesh();
+    }
+    if (asset.GetAnimations().empty())
+    {
+        throw std::runtime_error("Model has no actions");
+    }
+
+    // Actors come in groups playing the same action from nearly the same time, within the jitter, at the same speed
+    std::printf("%zu actors, %zu bones, %zu frames, %.2f ms step, %.2f ms jitter, %zu poses cached at most\n", actorCount,
+        asset.GetPose().GetBoneCount(), frameCount, timeStep, jitter, capacity);
+    std::printf("%12s %14s %14s %10s %10s %12s\n", "actors/clip", "uncached us", "cached us", "speedup", "hit rate", "evictions");
+    for (size_t groupSize : { 1, 2, 5, 10, 50, 100, 1000 })
+    {
+        groupSize = std::min(groupSize, std::max<size_t>(actorCount, 1));
+        std::mt19937 random(static_cast<uint32_t>(groupSize));
+        std::uniform_int_distribution<int> actions(0, static_cast<int>(asset.GetAnimations().size()) - 1);
+        std::uniform_real_distribution<float> times(0.0f, 10000.0f);
+        std::uniform_real_distribution<float> offsets(0.0f, jitter);
+        std::vector<CrowdInstance> actors(actorCount);
+        for (size_t i = 0; i < actorCount; i += groupSize)
+        {
+            const CrowdInstance leader = { actions(random), times(random), 1.0f };
+            for (size_t j = i; j < std::min(i + groupSize, actorCount); j++)
+            {
+                actors[j] = leader;
+                actors[j].animTime += offsets(random);
+            }
+        }
+
+        PoseCache cache(asset.GetPose().GetBoneCount(), capacity, timeStep);
+        const double uncachedTime = TimeActorPoses(asset, actors, frameCount, nullptr);
+        const double cachedTime = TimeActorPoses(asset, actors, frameCount, &cache);
+        std::printf("%12zu %14.1f %14.1f %9.2fx %9.1f%% %12zu\n", groupSize, uncachedTime, cachedTime, uncachedTime / cachedTime,
+            cache.GetHitRate() * 100.0, cache.GetEvictionCount());
+        if (groupSize >= actorCount)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+int RunBlendBenchmark(const CliOptions& options)
+{
+    const size_t sampleCount = static_cast<size_t>(options.GetNumber("samples", 20000));
+    std::vector<size_t> boneCounts = { 64, 256 };
+    if (options.Has("bones"))
+    {
+        boneCounts = { static_cast<size_t>(options.GetNumber("bones", 0)) };
+    }
+
+    // Layers above the base alternate between an override masked to half the skeleton and a full additive
+    std::printf("%zu evaluations per setup\n", sampleCount);
+    std::printf("%8s %8s %14s %16s\n", "bones", "layers", "us/evaluate", "ns/bone/layer");
+    for (size_t boneCount : boneCounts)
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        desc.boneCount = boneCount;
+        SyntheticModel synthetic(desc);
+        M3dAsset asset(synthetic.Save(false));
+        asset.BuildMesh();
+        const AnimationPose& pose = asset.GetPose();
+        std::vector<BoneTransform> out(pose.GetBoneCount());
+        std::vector<float> halfMask(pose.GetBoneCount(), 0.0f);
+        std::fill(halfMask.begin(), halfMask.begin() + halfMask.size() / 2, 1.0f);
+
+        for (size_t layerCount : { 1, 2, 4, 8 })
+        {
+            AnimationBlender blender;
+            for (size_t i = 1; i < layerCount; i++)
+            {
+                BlendLayer layer;
+                layer.animTime = 100.0f * static_cast<float>(i);
+                layer.weight = 0.5f;
+                if (i % 2)
+                {
+                    layer.boneWeights = halfMask;
+                }
+                else
+                {
+                    layer.mode = BlendMode::Additive;
+                }
+                blender.AddLayer(layer);
+            }
+
+            blender.Evaluate(asset.GetAnimations(), pose, out.data());
+            Stopwatch stopwatch;
+            for (size_t i = 0; i < sampleCount; i++)
+            {
+                blender.Update(1000.0f / 60.0f);
+                blender.Evaluate(asset.GetAnimations(), pose, out.data());
+            }
+            const double evaluateTime = stopwatch.GetMilliseconds() * 1000.0 / sampleCount;
+            std::printf("%8zu %8zu %14.3f %16.2f\n", pose.GetBoneCount(), layerCount, evaluateTime,
+                evaluateTime * 1000.0 / static_cast<double>(pose.GetBoneCount() * layerCount));
+        }
+
+        // A crossfade samples both actions and blends them, like a two layer setup
+        AnimationBlender blender;
+        blender.CrossFade(0, static_cast<float>(sampleCount) * 1000.0f);
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < sampleCount; i++)
+        {
+            blender.Update(1000.0f / 60.0f);
+            blender.Evaluate(asset.GetAnimations(), pose, out.data());
+        }
+        std::printf("%8zu %8s %14.3f\n", pose.GetBoneCount(), "fade", stopwatch.GetMilliseconds() * 1000.0 / sampleCount);
+    }
+    return 0;
+}
+
+int RunCompressBenchmark(const CliOptions& options)
+{
+    const size_t sampleCount = static_cast<size_t>(options.GetNumber("samples", 20000));
+    ClipCompressionOptions compression;
+    compression.positionTolerance = static_cast<float>(options.GetNumber("position-tolerance", compression.positionTolerance));
+    compression.rotationTolerance = static_cast<float>(options.GetNumber("rotation-tolerance", compression.rotationTolerance));
+
+    std::unique_ptr<SyntheticModel> synthetic;
+    std::unique_ptr<M3dAsset> asset;
+    const m3d_t* model;
+    if (!options.arguments.empty())
+    {
+        asset = std::make_unique<M3dAsset>(ReadFile(options.arguments[0]));
+        model = asset->GetModel();
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = 4;
+        desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+        desc.frameCount = static_cast<size_t>(options.GetNumber("frames", 480));
+        synthetic = std::make_unique<SyntheticModel>(desc);
+        model = synthetic->Get();
+    }
+
+    // Sizes are in bytes, the ratio is baked over compressed, and errors are measured against the baked clip
+    AnimationPose pose(model);
+    std::printf("%u bones, %zu random samples per action, tolerance %g units %g radians\n", model->numbone, sampleCount,
+        compression.positionTolerance, compression.rotationTolerance);
+    std::printf("%-24s %8s %10s %10s %10s %10s %7s %10s %10s %12s %10s %12s\n", "action", "frames", "m3d", "keyframes", "baked",
+        "compressed", "ratio", "pos error", "rot error", "m3d_pose_r us", "baked us", "compressed us");
+    for (M3D_INDEX i = 0; i < model->numaction; i++)
+    {
+        const KeyframeIndex keyframes(model, i);
+        const BakedClip clip(keyframes);
+        const CompressedClip compressed(clip, compression);
+        const std::vector<uint32_t> times = MakeSampleTimes(keyframes.GetDuration(), sampleCount);
+        float positionError;
+        float rotationError;
+        MeasureClipError(clip, compressed, times, positionError, rotationError);
+        std::printf("%-24s %8zu %10zu %10zu %10zu %10zu %6.1fx %10.2e %10.2e %12.3f %10.3f %12.3f\n",
+            model->action[i].name ? model->action[i].name : "", keyframes.GetFrameCount(), GetM3dActionSize(model->action[i]),
+            keyframes.GetMemorySize(), clip.GetMemorySize(), compressed.GetMemorySize(),
+            static_cast<double>(clip.GetMemorySize()) / compressed.GetMemorySize(), positionError, rotationError,
+            TimeM3dPose(model, i, times), TimeBakedClip(clip, pose, times), TimeCompressedClip(compressed, pose, times));
+    }
+    return 0;
+}
+
+int RunLodBenchmark(const CliOptions& options)
+{
+    const size_t modelCount = static_cast<size_t>(options.GetNumber("models", 500));
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 240));
+    const size_t workers = static_cast<size_t>(options.GetNumber("workers", static_cast<double>(JobPool::DefaultWorkerCount())));
+    std::vector<size_t> budgets = { modelCount / 2, modelCount / 5, modelCount / 10 };
+    if (options.Has("budget"))
+    {
+        budgets = { static_cast<size_t>(options.GetNumber("budget", 0)) };
+    }
+    AnimationLodSettings settings;
+    settings.maxInterval = static_cast<uint32_t>(options.GetNumber("max-interval", settings.maxInterval));
+
+    M3dAsset asset;
+    if (!options.arguments.empty())
+    {
+        LoadOptions loadOptions;
+        loadOptions.cached = false;
+        asset = LoadAsset(options.arguments[0], loadOptions);
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", 2000));
+        desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+        SyntheticModel synthetic(desc);
+        asset = M3dAsset(synthetic.Save(false));
+        asset.BuildMesh();
+    }
+    if (asset.GetAnimations().empty())
+    {
+        throw std::runtime_error("Model has no actions");
+    }
+
+    // Models stand on a grid like the viewer's crowd, the camera circles once around it from inside its edge
+    float radius = 0.0f;
+    for (const MeshVertex& vertex : asset.GetVertices())
+    {
+        radius = std::max(radius, std::sqrt(vertex.position[0] * vertex.position[0] + vertex.position[1] * vertex.position[1] +
+            vertex.position[2] * vertex.position[2]));
+    }
+    radius = std::max(radius, 1e-3f);
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(modelCount))));
+    const float spacing = 3.0f * radius;
+    const float center = (static_cast<float>(columns) - 1.0f) * 0.5f;
+    std::vector<float> positions(modelCount * 2);
+    for (size_t i = 0; i < modelCount; i++)
+    {
+        positions[i * 2] = (static_cast<float>(i % columns) - center) * spacing;
+        positions[i * 2 + 1] = (static_cast<float>(i / columns) - center) * spacing;
+    }
+    const float cameraDistance = std::max(center * spacing, spacing);
+
+    JobPool jobPool(workers);
+    std::printf("%zu models of %zu vertices and %zu bones, %zu frames per run, %zu workers\n", modelCount, asset.GetVertices().size(),
+        asset.GetPose().GetBoneCount(), frameCount, jobPool.GetWorkerCount());
+    std::printf("%8s %12s %16s %12s %12s\n", "budget", "interpolate", "updates/frame", "ms/frame", "speedup");
+    double fullTime = 0.0;
+    for (size_t run = 0; run <= budgets.size() * 2; run++)
+    {
+        // The first run updates every model every frame, the others alternate holding and interpolating
+        Crowd crowd(asset);
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> actions(0, static_cast<int>(asset.GetAnimations().size()) - 1);
+        std::uniform_real_distribution<float> times(0.0f, 10000.0f);
+        for (size_t i = 0; i < modelCount; i++)
+        {
+            crowd.AddInstance({ actions(random), times(random), 1.0f });
+        }
+        if (run > 0)
+        {
+            settings.updateBudget = budgets[(run - 1) / 2];
+            settings.interpolate = run % 2 == 0;
+            crowd.EnableLod(settings);
+        }
+        crowd.Animate(&jobPool);
+
+        // Priorities are part of the frame, as they would be for a renderer
+        size_t updateCount = 0;
+        Stopwatch stopwatch;
+        for (size_t frame = 0; frame < frameCount; frame++)
+        {
+            const float angle = 6.2831853f * static_cast<float>(frame) / static_cast<float>(frameCount);
+            if (run > 0)
+            {
+                SetCrowdPriorities(crowd, positions, radius, std::cos(angle) * cameraDistance, std::sin(angle) * cameraDistance);
+            }
+            crowd.UpdateAnimTime(1000.0f / 60.0f);
+            crowd.Animate(&jobPool);
+            updateCount += crowd.GetUpdateCount();
+        }
+        const double frameTime = stopwatch.GetMilliseconds() / frameCount;
+        fullTime = run == 0 ? frameTime : fullTime;
+        if (run == 0)
+        {
+            std::printf("%8s %12s %16.1f %12.3f %12s\n", "none", "-", static_cast<double>(updateCount) / frameCount, frameTime, "1.00x");
+        }
+        else
+        {
+            std::printf("%8zu %12s %16.1f %12.3f %11.2fx\n", settings.updateBudget, settings.interpolate ? "yes" : "no",
+                static_cast<double>(updateCount) / frameCount, frameTime, fullTime / frameTime);
+        }
+    }
+    return 0;
+}
+
+int RunInflateBenchmark(const CliOptions& options)
+{
+    const size_t runs = std::max<size_t>(static_cast<size_t>(options.GetNumber("runs", 3)), 1);
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> files;
+    for (const std::string& path : options.arguments)
+    {
+        files.emplace_back(path, ReadFile(path));
+    }
+
+    // About 100 MB once inflated, unless other sizes are asked for
+    SyntheticModelDesc desc;
+    desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", 1100000));
+    desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+    if (desc.vertexCount)
+    {
+        SyntheticModel synthetic(desc);
+        files.emplace_back("synthetic", synthetic.Save(true));
+    }
+
+    std::printf("best of %zu runs, MB/s of inflated output\n", runs);
+    std::printf("%-24s %12s %12s %12s %12s %12s\n", "model", "packed MB", "inflated MB", "built-in", "table", "chunked");
+    for (auto& [name, file] : files)
+    {
+        size_t size = 0;
+        const unsigned char* body = FindCompressedBody(file, size);
+        if (!body)
+        {
+            std::printf("%-24s not compressed\n", name.c_str());
+            continue;
+        }
+        std::vector<unsigned char> expected;
+        const double builtin = TimeInflate(m3d_inflate, body, size, runs, expected);
+        const double table = TimeInflate(InflateM3dBody, body, size, runs, expected);
+        const double chunked = TimeChunkStream(file, runs, expected.size());
+        std::printf("%-24s %12.2f %12.2f %12.1f %12.1f %12.1f\n", name.c_str(), size / 1048576.0, expected.size() / 1048576.0,
+            builtin, table, chunked);
+    }
+    return 0;
+}
+
+int RunCacheBenchmark(const CliOptions& options)
+{
+    if (options.arguments.empty())
+    {
+        std::fprintf(stderr, "bench-cache needs at least one model\n");
+        return 1;
+    }
+    const size_t runs = std::max<size_t>(static_cast<size_t>(options.GetNumber("runs", 3)), 1);
+    LoadOptions loadOptions;
+    loadOptions.weldEpsilon = static_cast<float>(options.GetNumber("weld", 0));
+    loadOptions.preferShortIndices = options.Has("short-indices");
+    loadOptions.animSampleRate = static_cast<float>(options.GetNumber("rate", 0));
+
+    // Cold loads parse and build the model, warm loads hash it and find its cache
+    std::printf("best of %zu runs, milliseconds\n", runs);
+    std::printf("%-24s %10s %10s %10s %10s %10s %10s %8s\n", "model", "model MB", "cache MB", "cold", "store", "hash", "warm", "speedup");
+    int result = 0;
+    for (const std::string& path : options.arguments)
+    {
+        const std::filesystem::path cachePath = GetAssetCachePath(path);
+        LoadOptions coldOptions = loadOptions;
+        coldOptions.cached = false;
+        double cold = 0.0;
+        M3dAsset built;
+        for (size_t run = 0; run < runs; run++)
+        {
+            Stopwatch stopwatch;
+            built = LoadAsset(path, coldOptions);
+            const double time = stopwatch.GetMilliseconds();
+            cold = run ? std::min(cold, time) : time;
+        }
+
+        std::filesystem::remove(cachePath);
+        LoadProgress storeProgress;
+        LoadAsset(path, loadOptions, &storeProgress);
+        const double store = storeProgress.GetStageMilliseconds(LoadStage::Store);
+
+        const MappedFile file(path);
+        double hash = 0.0;
+        for (size_t run = 0; run < runs; run++)
+        {
+            Stopwatch stopwatch;
+            volatile uint64_t key = HashBytes(file.GetData(), file.GetSize());
+            (void)key;
+            hash = run ? std::min(hash, stopwatch.GetMilliseconds()) : stopwatch.GetMilliseconds();
+        }
+
+        double warm = 0.0;
+        M3dAsset cached;
+        for (size_t run = 0; run < runs; run++)
+        {
+            LoadProgress progress;
+            Stopwatch stopwatch;
+            cached = LoadAsset(path, loadOptions, &progress);
+            const double time = stopwatch.GetMilliseconds();
+            if (progress.GetStageMilliseconds(LoadStage::Parse) > 0.0)
+            {
+                std::fprintf(stderr, "%s: cache missed\n", path.c_str());
+                return 1;
+            }
+            warm = run ? std::min(warm, time) : time;
+        }
+
+        if (!IsSameAsset(built, cached))
+        {
+            std::printf("%-24s cached asset differs from the built one\n", path.c_str());
+            result = 1;
+            continue;
+        }
+        std::printf("%-24s %10.2f %10.2f %10.3f %10.3f %10.3f %10.3f %7.1fx\n", path.c_str(),
+            std::filesystem::file_size(path) / 1048576.0, std::filesystem::file_size(cachePath) / 1048576.0, cold, store, hash, warm, cold / warm);
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Command line of the headless tool: a command, its positional arguments and its --name value options
+struct CliOptions {
+    std::string command;
+    std::vector<std::string> arguments;
+    std::map<std::string, std::string> values;
+
+    bool Has(const std::string& name) const                             { return values.count(name) != 0; }
+    std::string Get(const std::string& name, const std::string& fallback) const;
+    double GetNumber(const std::string& name, double fallback) const;
+};
+
+class Stopwatch {
+
+public:
+
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+    void Restart()                                      { start_ = std::chrono::steady_clock::now(); }
+    double GetMilliseconds() const                      { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count(); }
+
+private:
+
+    std::chrono::steady_clock::time_point start_;
+};
+
+std::vector<unsigned char> ReadFile(const std::string& path);
+size_t GetPeakMemory();     // Peak resident set size of the process in bytes, 0 when unknown
+
+int RunWeldBenchmark(const CliOptions& options);
+int RunSkinningBenchmark(const CliOptions& options);
+int RunKeyframeBenchmark(const CliOptions& options);
+int RunPoseBenchmark(const CliOptions& options);
+int RunForwardKinematicsBenchmark(const CliOptions& options);
+int RunCrowdBenchmark(const CliOptions& options);
+int RunPoseCacheBenchmark(const CliOptions& options);
+int RunLodBenchmark(const CliOptions& options);
+int RunBlendBenchmark(const CliOptions& options);
+int RunCompressBenchmark(const CliOptions& options);
+int RunInflateBenchmark(const CliOptions& options);
+int RunCacheBenchmark(const CliOptions& options);
+int RunVerifyStream(const CliOptions& options);
+int RunVerifyRing(const CliOptions& options);
+int RunVerifyAlloc(const CliOptions& options);
+int RunVerifyIndices(const CliOptions& options);
@@ -0,0 +1,529 @@
+#include "Cli.h"
+#include "SyntheticModel.h"
+#include "AssetLoader.h"
+#include "BatchLoader.h"
+#include "JobPool.h"
+#include "M3dAsset.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::printf(
+            "usage: m3d-cli <command> [arguments] [--option value ...]\n"
+            "\n"
+            "  play <model.m3d>         Load, weld and bake a model, then skin N animation frames\n"
+            "      --frames N           Frames to play (120)\n"
+            "      --step MS            Animation time between frames in milliseconds, 0 plays paused (16.667)\n"
+            "      --pause N            Holds the time still every other run of N frames (0)\n"
+            "      --action I           Action to play (0)\n"
+            "      --workers N          Skinning worker threads (hardware concurrency - 1)\n"
+            "      --kernel NAME        scalar, sse4.1, neon or avx2 (detected)\n"
+            "      --weld EPSILON       Vertex weld distance (0)\n"
+            "      --short-indices      Split large meshes into 16-bit index parts\n"
+            "      --rate HZ            Bake sample rate, 0 keeps each action's own rate (0)\n"
+            "      --copy               Read the file into memory instead of mapping it\n"
+            "      --whole              Inflate the whole body before parsing instead of streaming its chunks\n"
+            "  load <m3d ...>           Load models in the background, printing each stage and its time\n"
+            "      --weld EPSILON --short-indices --rate HZ --whole\n"
+            "      --no-cache           Neither read nor write the built model caches\n"
+            "  batch <dir|m3d ...>      Load every model of the directories and files given on a thread pool\n"
+            "      --workers N          Loading worker threads (hardware concurrency - 1)\n"
+            "      --memory MB          Memory the loads in flight may take, estimated from their files (no cap)\n"
+            "      --weld EPSILON --short-indices --rate HZ --whole --no-cache --quiet\n"
+            "  generate <out.m3d>       Write a synthetic skinned and animated grid\n"
+            "      --vertices N --bones N --frames N --uncompressed\n"
+            "  bench-weld <dir|m3d ...> Input and welded vertices and weld speed of each model\n"
+            "      --runs N (5) --weld EPSILON (0)\n"
+            "  bench-skin [dir|m3d ...] Skinning time per kernel and worker count, or for models, against the per-influence path\n"
+            "      --vertices N --bones N --frames N (100, 1000 for a model) --max-workers N\n"
+            "      --tolerance E        Position and normal error a kernel may have against the per-influence path (1e-5)\n"
+            "  bench-keyframes          Pose sampling cost as actions grow longer\n"
+            "      --bones N --samples N\n"
+            "  bench-pose [model.m3d]   Memory and time of each pose sampling path\n"
+            "      --samples N\n"
+            "  bench-fk                 Bone matrix time per kernel on synthetic skeletons, checked against scalar\n"
+            "      --bones N (256 and 1024) --samples N\n"
+            "  bench-crowd [model.m3d]  Time to animate and skin a crowd of instances per worker count\n"
+            "      --instances N (1000) --frames N --max-workers N --vertices N (2000) --bones N\n"
+            "      --pose-step MS       Share poses through a pose cache keyed on that time step (no cache)\n"
+            "  bench-pose-cache [m3d]   Pose time of a crowd of actors with and without the pose cache, as more actors share clips\n"
+            "      --actors N (1000) --frames N --step MS (1) --jitter MS (0.25) --capacity N (actors) --bones N\n"
+            "  bench-lod [model.m3d]    Frame time of a crowd under an orbiting camera, updating every model or time-sliced by the animation LOD\n"
+            "      --models N (500) --frames N (240) --budget N (1/2, 1/5 and 1/10 of models) --max-interval N (8) --workers N\n"
+            "      --vertices N (2000) --bones N\n"
+            "  bench-blend              Time to sample and blend 1, 2, 4 and 8 layers, and a crossfade\n"
+            "      --bones N (64 and 256) --samples N\n"
+            "  bench-compress [m3d]     Size, error and sampling time of compressed clips against the raw and baked actions\n"
+            "      --samples N --position-tolerance UNITS (0.0001) --rotation-tolerance RADIANS (0.001) --bones N --frames N (480)\n"
+            "  bench-inflate [m3d ...]  Decompression speed of each inflate path, plus a synthetic model\n"
+            "      --runs N --vertices N (1100000, 0 skips the synthetic model)\n"
+            "  bench-cache <m3d ...>    Load time without and with the built model cache, written next to each model\n"
+            "      --runs N --weld EPSILON --short-indices --rate HZ\n"
+            "  verify-stream <m3d ...>  Check that whole and streamed parsing give the same models\n"
+            "  verify-ring              Check the per-frame vertex buffer ring against a simulated swap chain\n"
+            "      --frames N (10000) --in-flight N (3) --pause-rate P (0.3)\n"
+            "  verify-alloc [model.m3d] Check that animating and skinning a warmed up model allocates nothing\n"
+            "      --frames N (1000) --warmup N (10) --step MS --workers N --vertices N (20000)\n"
+            "  verify-indices           Check the index format and the 16-bit parts of a mesh too large for 16-bit indices\n"
+            "      --vertices N (500000)\n");
+    }
+
+    CliOptions ParseOptions(int argc, char** argv)
+    {
+        CliOptions options;
+        options.command = argv[1];
+        for (int i = 2; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0)
+            {
+                options.arguments.push_back(arg);
+            }
+            else if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+            {
+                options.values[arg.substr(2)] = argv[++i];
+            }
+            else
+            {
+                options.values[arg.substr(2)] = "1";
+            }
+        }
+        return options;
+    }
+
+    bool ParseKernel(const std::string& name, SkinKernelLevel& level)
+    {
+        for (SkinKernelLevel candidate : { SkinKernelLevel::Scalar, SkinKernelLevel::Sse41, SkinKernelLevel::Neon, SkinKernelLevel::Avx2 })
+        {
+            if (name == GetSkinKernelName(candidate))
+            {
+                level = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int RunPlay(const CliOptions& options)
+    {
+        if (options.arguments.empty())
+        {
+            PrintUsage();
+            return 1;
+        }
+        const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 120));
+        const float step = static_cast<float>(options.GetNumber("step", 1000.0 / 60.0));
+        const size_t pause = static_cast<size_t>(options.GetNumber("pause", 0));
+        const size_t workers = static_cast<size_t>(options.GetNumber("workers", static_cast<double>(JobPool::DefaultWorkerCount())));
+
+        Stopwatch stopwatch;
+        M3dAsset asset = options.Has("copy") ? M3dAsset(ReadFile(options.arguments[0])) : M3dAsset(MappedFile(options.arguments[0]), !options.Has("whole"));
+        const double loadTime = stopwatch.GetMilliseconds();
+        const size_t loadMemory = GetPeakMemory();
+
+        stopwatch.Restart();
+        asset.BuildMesh(static_cast<float>(options.GetNumber("weld", 0)), options.Has("short-indices"),
+            static_cast<float>(options.GetNumber("rate", 0)));
+        const double buildTime = stopwatch.GetMilliseconds();
+        const size_t buildMemory = GetPeakMemory();
+
+        if (options.Has("kernel"))
+        {
+            SkinKernelLevel level;
+            if (!ParseKernel(options.Get("kernel", ""), level))
+            {
+                std::fprintf(stderr, "unknown kernel %s\n", options.Get("kernel", "").c_str());
+                return 1;
+            }
+            asset.GetSkinning().SetKernelLevel(level);
+        }
+
+        std::printf("%s: %zu faces, %zu vertices in %zu part(s), %s indices, %zu bones, %zu action(s)\n",
+            options.arguments[0].c_str(), asset.GetFaceCount(), asset.GetVertices().size(), asset.GetParts().size(),
+            asset.HasShortIndices() ? "16-bit" : "32-bit", asset.GetBoneNames().size(), asset.GetAnimations().size());
+        std::printf("load %.3f ms (%s), build %.3f ms\n", loadTime, options.Has("copy") ? "copied" : options.Has("whole") ? "mapped" : "streamed", buildTime);
+        std::printf("peak memory %.1f MB after load, %.1f MB after build\n", loadMemory / 1048576.0, buildMemory / 1048576.0);
+
+        const std::vector<std::string> names = asset.GetAnimNames();
+        const int action = static_cast<int>(options.GetNumber("action", 0));
+        if (action < 0 || static_cast<size_t>(action) >= names.size())
+        {
+            std::printf("no action to play\n");
+            return 0;
+        }
+        asset.SetAnimIdx(action);
+
+        JobPool jobPool(workers);
+        std::printf("playing \"%s\" for %zu frames, %s kernel, %zu worker(s)\n", names[action].c_str(), frameCount,
+            GetSkinKernelName(asset.GetSkinning().GetKernelLevel()), jobPool.GetWorkerCount());
+
+        double totalTime = 0.0;
+        double worstTime = 0.0;
+        size_t heldFrames = 0;
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            stopwatch.Restart();
+            asset.Animate(&jobPool);
+            const double frameTime = stopwatch.GetMilliseconds();
+            totalTime += frameTime;
+            worstTime = std::max(worstTime, frameTime);
+            if (step > 0.0f && (pause == 0 || (i / pause) % 2 == 0))
+            {
+                asset.UpdateAnimTime(step);
+            }
+            else if (i + 1 < frameCount)
+            {
+                heldFrames++;
+            }
+        }
+
+        // Lets runs with different kernels, worker counts or options be compared for the same result
+        double checksum = 0.0;
+        for (const MeshVertex& vertex : asset.GetVertices())
+        {
+            checksum += vertex.position[0] + vertex.position[1] + vertex.position[2];
+        }
+        std::printf("frame %.3f ms average, %.3f ms worst, checksum %.6g\n",
+            frameCount ? totalTime / frameCount : 0.0, worstTime, checksum);
+
+        // Every frame played without moving the time since the previous one must have been skipped
+        std::printf("skinned %llu frames, skipped %llu\n", static_cast<unsigned long long>(asset.GetSkinCount()),
+            static_cast<unsigned long long>(asset.GetSkipCount()));
+        if (asset.GetSkipCount() < heldFrames || (frameCount && asset.GetSkinCount() == 0))
+        {
+            std::printf("%zu frames held the same pose, %llu skipped\n", heldFrames, static_cast<unsigned long long>(asset.GetSkipCount()));
+            return 1;
+        }
+        return 0;
+    }
+
+    int RunLoad(const CliOptions& options)
+    {
+        if (options.arguments.empty())
+        {
+            PrintUsage();
+            return 1;
+        }
+        LoadOptions loadOptions;
+        loadOptions.weldEpsilon = static_cast<float>(options.GetNumber("weld", 0));
+        loadOptions.preferShortIndices = options.Has("short-indices");
+        loadOptions.animSampleRate = static_cast<float>(options.GetNumber("rate", 0));
+        loadOptions.streamed = !options.Has("whole");
+        loadOptions.cached = !options.Has("no-cache");
+
+        // All the models load at once, polled the way a frame loop would
+        Stopwatch stopwatch;
+        std::vector<AssetLoad> loads;
+        std::vector<LoadStage> stages;
+        for (const std::string& path : options.arguments)
+        {
+            loads.emplace_back(path, loadOptions);
+            stages.push_back(LoadStage::Queued);
+        }
+
+        int result = 0;
+        size_t pending = loads.size();
+        while (pending > 0)
+        {
+            for (size_t i = 0; i < loads.size(); i++)
+            {
+                if (!loads[i].IsValid())
+                {
+                    continue;
+                }
+                const LoadStage stage = loads[i].GetStage();
+                if (stage != stages[i])
+                {
+                    std::printf("%9.3f ms  %s: %s\n", stopwatch.GetMilliseconds(), options.arguments[i].c_str(), GetLoadStageName(stage));
+                    stages[i] = stage;
+                }
+                if (!loads[i].IsReady())
+                {
+                    continue;
+                }
+                pending--;
+                try
+                {
+                    const M3dAsset asset = loads[i].Get();
+                    std::printf("%9.3f ms  %s: %zu vertices, %zu action(s)\n", stopwatch.GetMilliseconds(), options.arguments[i].c_str(),
+                        asset.GetVertices().size(), asset.GetAnimations().size());
+                }
+                catch (const std::exception& e)
+                {
+                    std::printf("%9.3f ms  %s: %s\n", stopwatch.GetMilliseconds(), options.arguments[i].c_str(), e.what());
+                    result = 1;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        const LoadStage timedStages[] = { LoadStage::Cache, LoadStage::Parse, LoadStage::Weld, LoadStage::Skeleton, LoadStage::Store };
+        std::printf("%-32s", "model");
+        for (LoadStage stage : timedStages)
+        {
+            std::printf(" %11s", GetLoadStageName(stage));
+        }
+        std::printf("\n");
+        for (size_t i = 0; i < loads.size(); i++)
+        {
+            std::printf("%-32s", options.arguments[i].c_str());
+            for (LoadStage stage : timedStages)
+            {
+                std::printf(" %8.3f ms", loads[i].GetStageMilliseconds(stage));
+            }
+            std::printf("\n");
+        }
+        return result;
+    }
+
+    int RunBatch(const CliOptions& options)
+    {
+        std::vector<std::filesystem::path> paths;
+        for (const std::string& argument : options.arguments)
+        {
+            if (std::filesystem::is_directory(argument))
+            {
+                const std::vector<std::filesystem::path> found = FindModels(argument);
+                paths.insert(paths.end(), found.begin(), found.end());
+            }
+            else
+            {
+                paths.emplace_back(argument);
+            }
+        }
+        if (paths.empty())
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        BatchLoadOptions batchOptions;
+        batchOptions.load.weldEpsilon = static_cast<float>(options.GetNumber("weld", 0));
+        batchOptions.load.preferShortIndices = options.Has("short-indices");
+        batchOptions.load.animSampleRate = static_cast<float>(options.GetNumber("rate", 0));
+        batchOptions.load.streamed = !options.Has("whole");
+        batchOptions.load.cached = !options.Has("no-cache");
+        batchOptions.memoryBudget = static_cast<size_t>(options.GetNumber("memory", 0) * 1048576.0);
+        JobPool jobPool(static_cast<size_t>(options.GetNumber("workers", static_cast<double>(JobPool::DefaultWorkerCount()))));
+
+        // Assets are dropped as soon as they are built, only their size is kept
+        std::vector<size_t> vertexCounts(paths.size());
+        const BatchLoadResult result = LoadBatch(paths, jobPool, batchOptions,
+            [&](size_t index, M3dAsset& asset) { vertexCounts[index] = asset.GetVertices().size(); });
+
+        if (!options.Has("quiet"))
+        {
+            std::printf("%-40s %9s %10s %10s %10s %10s %10s\n", "model", "MB", "wait ms", "load ms", "parse ms", "build ms", "vertices");
+            for (size_t i = 0; i < result.reports.size(); i++)
+            {
+                const BatchLoadReport& report = result.reports[i];
+                const auto stage = [&](LoadStage s) { return report.stageMilliseconds[static_cast<size_t>(s)]; };
+                std::printf("%-40s %9.2f %10.3f %10.3f %10.3f %10.3f ", report.path.string().c_str(), report.fileSize / 1048576.0,
+                    report.waitMilliseconds, report.loadMilliseconds, stage(LoadStage::Parse), stage(LoadStage::Weld) + stage(LoadStage::Skeleton));
+                if (report.IsLoaded())
+                {
+                    std::printf("%10zu\n", vertexCounts[i]);
+                }
+                else
+                {
+                    std::printf("%10s  %s\n", "failed", report.error.c_str());
+                }
+            }
+        }
+
+        const double seconds = result.milliseconds / 1000.0;
+        const size_t failed = result.reports.size() - result.GetLoadedCount();
+        std::printf("%zu file(s), %zu failed, %.2f MB in %.3f s with %zu worker(s): %.1f files/s, %.1f MB/s\n",
+            result.reports.size(), failed, result.GetTotalFileSize() / 1048576.0, seconds, jobPool.GetWorkerCount(),
+            result.reports.size() / seconds, result.GetTotalFileSize() / 1048576.0 / seconds);
+        std::printf("peak memory %.1f MB estimated for the loads in flight, %.1f MB resident\n",
+            result.peakEstimatedMemory / 1048576.0, GetPeakMemory() / 1048576.0);
+        return failed ? 1 : 0;
+    }
+
+    int RunGenerate(const CliOptions& options)
+    {
+        if (options.arguments.empty())
+        {
+            PrintUsage();
+            return 1;
+        }
+        SyntheticModelDesc desc;
+        desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", static_cast<double>(desc.vertexCount)));
+        desc.boneCount = static_cast<size_t>(options.GetNumber("bones", static_cast<double>(desc.boneCount)));
+        desc.frameCount = static_cast<size_t>(options.GetNumber("frames", static_cast<double>(desc.frameCount)));
+        SyntheticModel model(desc);
+        const std::vector<unsigned char> file = model.Save(!options.Has("uncompressed"));
+
+        std::ofstream stream(options.arguments[0], std::ios::binary);
+        stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!stream)
+        {
+            std::fprintf(stderr, "cannot write %s\n", options.arguments[0].c_str());
+            return 1;
+        }
+        std::printf("wrote %s, %zu bytes\n", options.arguments[0].c_str(), file.size());
+        return 0;
+    }
+}
+
+std::string CliOptions::Get(const std::string& name, const std::string& fallback) const
+{
+    const auto it = values.find(name);
+    return it != values.end() ? it->second : fallback;
+}
+
+double CliOptions::GetNumber(const std::string& name, double fallback) const
+{
+    const auto it = values.find(name);
+    return it != values.end() ? std::strtod(it->second.c_str(), nullptr) : fallback;
+}
+
+std::vector<unsigned char> ReadFile(const std::string& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+    {
+        throw std::runtime_error("ReadFile");
+    }
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+size_t GetPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+    const CliOptions options = ParseOptions(argc, argv);
+    try
+    {
+        if (options.command == "play")
+        {
+            return RunPlay(options);
+        }
+        if (options.command == "load")
+        {
+            return RunLoad(options);
+        }
+        if (options.command == "batch")
+        {
+            return RunBatch(options);
+        }
+        if (options.command == "generate")
+        {
+            return RunGenerate(options);
+        }
+        if (options.command == "bench-weld")
+        {
+            return RunWeldBenchmark(options);
+        }
+        if (options.command == "bench-skin")
+        {
+            return RunSkinningBenchmark(options);
+        }
+        if (options.command == "bench-keyframes")
+        {
+            return RunKeyframeBenchmark(options);
+        }
+        if (options.command == "bench-pose")
+        {
+            return RunPoseBenchmark(options);
+        }
+        if (options.command == "bench-fk")
+        {
+            return RunForwardKinematicsBenchmark(options);
+        }
+        if (options.command == "bench-crowd")
+        {
+            return RunCrowdBenchmark(options);
+        }
+        if (options.command == "bench-pose-cache")
+        {
+            return RunPoseCacheBenchmark(options);
+        }
+        if (options.command == "bench-lod")
+        {
+            return RunLodBenchmark(options);
+        }
+        if (options.command == "bench-blend")
+        {
+            return RunBlendBenchmark(options);
+        }
+        if (options.command == "bench-compress")
+        {
+            return RunCompressBenchmark(options);
+        }
+        if (options.command == "bench-inflate")
+        {
+            return RunInflateBenchmark(options);
+        }
+        if (options.command == "bench-cache")
+        {
+            return RunCacheBenchmark(options);
+        }
+        if (options.command == "verify-ring")
+        {
+            return RunVerifyRing(options);
+        }
+        if (options.command == "verify-stream")
+        {
+            return RunVerifyStream(options);
+        }
+        if (options.command == "verify-alloc")
+        {
+            return RunVerifyAlloc(options);
+        }
+        if (options.command == "verify-indices")
+        {
+            return RunVerifyIndices(options);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s failed: %s\n", options.command.c_str(), e.what());
+        return 1;
+    }
+    PrintUsage();
+    return 1;
+}
@@ -0,0 +1,179 @@
+#include "SyntheticModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+    // M3D limits the depth of the bone hierarchy, so bones hang from the root in short chains
+    constexpr size_t c_chainLength = 16;
+    constexpr float c_gridSpacing = 0.1f;
+
+    uint32_t GetParentBone(size_t bone)
+    {
+        if (bone == 0)
+        {
+            return M3D_UNDEF;
+        }
+        return (bone - 1) % c_chainLength == 0 ? 0 : static_cast<uint32_t>(bone - 1);
+    }
+
+    m3dv_t MakeVertex(float x, float y, float z, float w, M3D_INDEX skinId = M3D_UNDEF)
+    {
+        m3dv_t vertex = {};
+        vertex.x = x;
+        vertex.y = y;
+        vertex.z = z;
+        vertex.w = w;
+        vertex.skinid = skinId;
+        return vertex;
+    }
+}
+
+SyntheticModel::SyntheticModel(const SyntheticModelDesc& desc)
+{
+    const size_t vertexCount = std::max<size_t>(desc.vertexCount, 4);
+    const size_t boneCount = std::max<size_t>(desc.boneCount, 1);
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(vertexCount))));
+    const size_t keyStride = std::max<size_t>(desc.keyedBoneStride, 1);
+    const size_t keyedBones = (boneCount + keyStride - 1) / keyStride;
+
+    // Grid positions, one shared normal, the bind transforms, then an orientation per key
+    vertices_.reserve(vertexCount + 1 + 2 * boneCount + desc.frameCount * keyedBones);
+    textureMap_.reserve(vertexCount);
+    skins_.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const size_t column = i % columns;
+        const size_t row = i / columns;
+        vertices_.push_back(MakeVertex(column * c_gridSpacing, 0.0f, row * c_gridSpacing, 1.0f, static_cast<M3D_INDEX>(i)));
+        textureMap_.push_back({ static_cast<float>(column) / columns, static_cast<float>(row) / columns });
+
+        m3ds_t skin = {};
+        const size_t bone = boneCount > 1 ? 1 + column % (boneCount - 1) : 0;
+        const uint32_t parent = GetParentBone(bone);
+        for (int j = 0; j < M3D_NUMBONE; j++)
+        {
+            skin.boneid[j] = M3D_UNDEF;
+        }
+        skin.boneid[0] = static_cast<M3D_INDEX>(bone);
+        skin.weight[0] = parent == M3D_UNDEF ? 1.0f : 0.75f;
+        if (parent != M3D_UNDEF)
+        {
+            skin.boneid[1] = parent;
+            skin.weight[1] = 0.25f;
+        }
+        skins_.push_back(skin);
+    }
+    const M3D_INDEX normalId = static_cast<M3D_INDEX>(vertices_.size());
+    vertices_.push_back(MakeVertex(0.0f, 1.0f, 0.0f, 1.0f));
+
+    boneNames_.reserve(boneCount);
+    bones_.resize(boneCount);
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        boneNames_.push_back("bone" + std::to_string(i));
+        m3db_t& bone = bones_[i];
+        bone = {};
+        bone.parent = GetParentBone(i);
+        bone.name = &boneNames_[i][0];
+        bone.pos = static_cast<M3D_INDEX>(vertices_.size());
+        vertices_.push_back(MakeVertex(i == 0 ? 0.0f : columns * c_gridSpacing / c_chainLength, 0.0f, 0.0f, 1.0f));
+        bone.ori = static_cast<M3D_INDEX>(vertices_.size());
+        vertices_.push_back(MakeVertex(0.0f, 0.0f, 0.0f, 1.0f));
+        bone.mat4[0] = bone.mat4[5] = bone.mat4[10] = bone.mat4[15] = 1.0f;
+    }
+
+    // Two triangles per full grid cell
+    for (size_t row = 0; (row + 2) * columns <= vertexCount; row++)
+    {
+        for (size_t column = 0; column + 1 < columns; column++)
+        {
+            const M3D_INDEX v0 = static_cast<M3D_INDEX>(row * columns + column);
+            const M3D_INDEX v1 = v0 + 1;
+            const M3D_INDEX v2 = static_cast<M3D_INDEX>(v0 + columns);
+            const M3D_INDEX v3 = v2 + 1;
+            const M3D_INDEX triangles[2][3] = { { v0, v2, v1 }, { v1, v2, v3 } };
+            for (const M3D_INDEX* corners : triangles)
+            {
+                m3df_t face = {};
+                face.materialid = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    face.vertex[k] = corners[k];
+                    face.normal[k] = normalId;
+                    face.texcoord[k] = corners[k];
+                }
+                faces_.push_back(face);
+            }
+        }
+    }
+
+    materialName_ = "default";
+    materialProperties_.push_back({});
+    materialProperties_[0].type = m3dp_Kd;
+    materialProperties_[0].value.color = 0xFFC0C0C0;
+    materials_.push_back({ &materialName_[0], 1, materialProperties_.data() });
+
+    // Every frame swings the keyed bones around the vertical axis
+    transforms_.reserve(desc.frameCount * keyedBones);
+    frames_.resize(desc.frameCount);
+    for (size_t f = 0; f < desc.frameCount; f++)
+    {
+        frames_[f].msec = static_cast<uint32_t>(f * desc.frameMsec);
+        frames_[f].numtransform = static_cast<M3D_INDEX>(keyedBones);
+        for (size_t b = 0; b < boneCount; b += keyStride)
+        {
+            const float angle = 0.4f * std::sin(0.15f * f + 0.5f * b);
+            const M3D_INDEX ori = static_cast<M3D_INDEX>(vertices_.size());
+            vertices_.push_back(MakeVertex(0.0f, std::sin(angle * 0.5f), 0.0f, std::cos(angle * 0.5f)));
+            transforms_.push_back({ static_cast<M3D_INDEX>(b), bones_[b].pos, ori });
+        }
+    }
+    for (size_t f = 0; f < desc.frameCount; f++)
+    {
+        frames_[f].transform = &transforms_[f * keyedBones];
+    }
+    actionName_ = "swing";
+    if (!frames_.empty())
+    {
+        actions_.push_back({ &actionName_[0], static_cast<uint32_t>(desc.frameCount * desc.frameMsec),
+            static_cast<M3D_INDEX>(frames_.size()), frames_.data() });
+    }
+
+    modelName_ = "synthetic";
+    model_.name = &modelName_[0];
+    model_.license = const_cast<char*>("");
+    model_.author = const_cast<char*>("");
+    model_.desc = const_cast<char*>("");
+    model_.scale = 1.0f;
+    model_.numtmap = static_cast<M3D_INDEX>(textureMap_.size());
+    model_.tmap = textureMap_.data();
+    model_.numbone = static_cast<M3D_INDEX>(bones_.size());
+    model_.bone = bones_.data();
+    model_.numvertex = static_cast<M3D_INDEX>(vertices_.size());
+    model_.vertex = vertices_.data();
+    model_.numskin = static_cast<M3D_INDEX>(skins_.size());
+    model_.skin = skins_.data();
+    model_.nummaterial = static_cast<M3D_INDEX>(materials_.size());
+    model_.material = materials_.data();
+    model_.numface = static_cast<M3D_INDEX>(faces_.size());
+    model_.face = faces_.data();
+    model_.numaction = static_cast<M3D_INDEX>(actions_.size());
+    model_.action = actions_.data();
+}
+
+std::vector<unsigned char> SyntheticModel::Save(bool compress)
+{
+    unsigned int size = 0;
+    unsigned char* data = m3d_save(&model_, M3D_EXP_FLOAT, compress ? 0 : M3D_EXP_NOZLIB, &size);
+    if (!data)
+    {
+        throw std::runtime_error("SyntheticModel");
+    }
+    std::vector<unsigned char> file(data, data + size);
+    free(data);
+    return file;
+}
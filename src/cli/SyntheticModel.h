@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "m3d/m3d.h"
+
+struct SyntheticModelDesc {
+    size_t vertexCount = 100000;
+    size_t boneCount = 64;
+    size_t frameCount = 120;
+    uint32_t frameMsec = 33;
+    size_t keyedBoneStride = 1;     // Every n-th bone gets a key in each frame, the others only keep their bind pose
+};
+
+// Skinned and animated grid built in memory, to benchmark the pipeline at sizes the sample models do not reach.
+// The bones form chains hanging from a root, each grid vertex blends two neighbouring bones, and every frame
+// swings the keyed bones around the vertical axis. The model points into this object's storage.
+class SyntheticModel {
+
+public:
+
+    explicit SyntheticModel(const SyntheticModelDesc& desc);
+
+    SyntheticModel(const SyntheticModel&) = delete;
+    SyntheticModel& operator=(const SyntheticModel&) = delete;
+
+    m3d_t* Get()                                        { return &model_; }
+    std::vector<unsigned char> Save(bool compress);
+
+private:
+
+    m3d_t model_ = {};
+    std::vector<std::string> boneNames_;
+    std::string modelName_;
+    std::string actionName_;
+    std::string materialName_;
+    std::vector<m3dv_t> vertices_;
+    std::vector<m3dti_t> textureMap_;
+    std::vector<m3ds_t> skins_;
+    std::vector<m3db_t> bones_;
+    std::vector<m3df_t> faces_;
+    std::vector<m3dp_t> materialProperties_;
+    std::vector<m3dm_t> materials_;
+    std::vector<m3dtr_t> transforms_;
+    std::vector<m3dfr_t> frames_;
+    std::vector<m3da_t> actions_;
+};
@@ -0,0 +1,415 @@
+#include "Cli.h"
+#include "SyntheticModel.h"
+#include "AssetLoader.h"
+#include "JobPool.h"
+#include "M3dAsset.h"
+#include "M3dChunkStream.h"
+#include "VertexRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Counted by the global allocation functions below, which every allocation of the tool goes through
+    std::atomic<uint64_t> g_allocationCount{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    // Compares two parsed models field by field, reporting the first few differences
+    class ModelComparer {
+
+    public:
+
+        ModelComparer(const m3d_t* expected, const m3d_t* actual) : expected_(expected), actual_(actual) {}
+
+        size_t Compare()
+        {
+            const m3d_t* a = expected_;
+            const m3d_t* b = actual_;
+            Check(a->errcode == b->errcode, "errcode");
+            Check(a->scale == b->scale, "scale");
+            Check(Equal(a->name, b->name) && Equal(a->license, b->license) && Equal(a->author, b->author) &&
+                Equal(a->desc, b->desc), "header strings");
+            Check(a->preview.length == b->preview.length && Equal(a->preview.data, b->preview.data, a->preview.length), "preview");
+
+            CheckArray(a->numcmap, a->cmap, b->numcmap, b->cmap, "color map");
+            CheckArray(a->numtmap, a->tmap, b->numtmap, b->tmap, "texture map");
+            CheckArray(a->numvertex, a->vertex, b->numvertex, b->vertex, "vertices");
+            CheckArray(a->numskin, a->skin, b->numskin, b->skin, "skins");
+            CheckArray(a->numface, a->face, b->numface, b->face, "faces");
+
+            if (Check(a->numbone == b->numbone, "bone count"))
+            {
+                for (M3D_INDEX i = 0; i < a->numbone; i++)
+                {
+                    const m3db_t& x = a->bone[i];
+                    const m3db_t& y = b->bone[i];
+                    Check(x.parent == y.parent && Equal(x.name, y.name) && x.pos == y.pos && x.ori == y.ori &&
+                        !memcmp(x.mat4, y.mat4, sizeof(x.mat4)), "bone");
+                    CheckArray(x.numweight, x.weight, y.numweight, y.weight, "bone weights");
+                }
+            }
+
+            if (Check(a->nummaterial == b->nummaterial, "material count"))
+            {
+                for (M3D_INDEX i = 0; i < a->nummaterial; i++)
+                {
+                    const m3dm_t& x = a->material[i];
+                    const m3dm_t& y = b->material[i];
+                    if (Check(Equal(x.name, y.name) && x.numprop == y.numprop, "material"))
+                    {
+                        // Properties are compared by member, their padding is left uninitialized
+                        for (int j = 0; j < x.numprop; j++)
+                        {
+                            Check(x.prop[j].type == y.prop[j].type && x.prop[j].value.num == y.prop[j].value.num, "material property");
+                        }
+                    }
+                }
+            }
+
+            if (Check(a->numtexture == b->numtexture, "texture count"))
+            {
+                for (M3D_INDEX i = 0; i < a->numtexture; i++)
+                {
+                    const m3dtx_t& x = a->texture[i];
+                    const m3dtx_t& y = b->texture[i];
+                    // The format of a texture that failed to load is left uninitialized
+                    Check(Equal(x.name, y.name) && (x.d != nullptr) == (y.d != nullptr) && (!x.d || (x.w == y.w && x.h == y.h &&
+                        x.f == y.f && Equal(x.d, y.d, static_cast<size_t>(x.w) * x.h * x.f))), "texture");
+                }
+            }
+
+            if (Check(a->numaction == b->numaction, "action count"))
+            {
+                for (M3D_INDEX i = 0; i < a->numaction; i++)
+                {
+                    const m3da_t& x = a->action[i];
+                    const m3da_t& y = b->action[i];
+                    if (Check(Equal(x.name, y.name) && x.durationmsec == y.durationmsec && x.numframe == y.numframe, "action"))
+                    {
+                        for (M3D_INDEX j = 0; j < x.numframe; j++)
+                        {
+                            Check(x.frame[j].msec == y.frame[j].msec, "frame time");
+                            CheckArray(x.frame[j].numtransform, x.frame[j].transform, y.frame[j].numtransform, y.frame[j].transform,
+                                "frame transforms");
+                        }
+                    }
+                }
+            }
+
+            if (Check(a->numinlined == b->numinlined, "inlined asset count"))
+            {
+                for (M3D_INDEX i = 0; i < a->numinlined; i++)
+                {
+                    const m3di_t& x = a->inlined[i];
+                    const m3di_t& y = b->inlined[i];
+                    Check(Equal(x.name, y.name) && x.length == y.length && Equal(x.data, y.data, x.length), "inlined asset");
+                }
+            }
+
+            if (Check(a->numextra == b->numextra, "extra chunk count"))
+            {
+                for (M3D_INDEX i = 0; i < a->numextra; i++)
+                {
+                    Check(a->extra[i]->length == b->extra[i]->length && Equal(a->extra[i], b->extra[i], a->extra[i]->length), "extra chunk");
+                }
+            }
+            Check(a->numvoxtype == b->numvoxtype && a->numvoxel == b->numvoxel && a->numshape == b->numshape &&
+                a->numlabel == b->numlabel, "voxel, shape and label counts");
+            return mismatches_;
+        }
+
+    private:
+
+        static constexpr size_t c_maxReported = 8;
+
+        static bool Equal(const char* x, const char* y)
+        {
+            return x == y || (x && y && !strcmp(x, y));
+        }
+
+        static bool Equal(const void* x, const void* y, size_t size)
+        {
+            return x == y || (x && y && !memcmp(x, y, size));
+        }
+
+        bool Check(bool equal, const char* what)
+        {
+            if (!equal && mismatches_++ < c_maxReported)
+            {
+                std::printf("  %s differ\n", what);
+            }
+            return equal;
+        }
+
+        template <typename T>
+        void CheckArray(M3D_INDEX countX, const T* x, M3D_INDEX countY, const T* y, const char* what)
+        {
+            Check(countX == countY && Equal(x, y, countX * sizeof(T)), what);
+        }
+
+        const m3d_t* expected_;
+        const m3d_t* actual_;
+        size_t mismatches_ = 0;
+    };
+
+    // A compressed model whose first deflate block declares 288 literal and 32 distance codes, past the 286 and
+    // 30 deflate defines, then repeats zero lengths 320 times. Both inflate paths must reject it before the repeats
+    bool RejectsOversizedDynamicHeader()
+    {
+        std::vector<unsigned char> file = { '3', 'D', 'M', 'O', 0, 0, 0, 0, 0x78, 0x01, 0xFD, 0x1F, 0x90, 0xE0, 0xFF, 0x7F, 0x08 };
+        file.resize(file.size() + 64, 0);
+        const uint32_t length = static_cast<uint32_t>(file.size());
+        memcpy(&file[4], &length, sizeof(length));
+
+        bool streamedRejected = false;
+        try
+        {
+            M3dChunkStream stream(file.data(), file.size());
+            stream.Next();
+        }
+        catch (const std::exception&)
+        {
+            streamedRejected = true;
+        }
+        unsigned int size = 0;
+        unsigned char* body = InflateM3dBody(file.data() + 8, static_cast<unsigned int>(file.size() - 8), &size);
+        free(body);
+        return streamedRejected && !body;
+    }
+}
+
+int RunVerifyStream(const CliOptions& options)
+{
+    if (options.arguments.empty())
+    {
+        std::fprintf(stderr, "no model given\n");
+        return 1;
+    }
+
+    // Every model is parsed through m3d_load over the whole body and chunk by chunk, both must agree
+    size_t failed = 0;
+    for (const std::string& path : options.arguments)
+    {
+        Stopwatch stopwatch;
+        const M3dAsset whole(MappedFile(path), false);
+        const double wholeTime = stopwatch.GetMilliseconds();
+        stopwatch.Restart();
+        const M3dAsset streamed(MappedFile(path), true);
+        const double streamedTime = stopwatch.GetMilliseconds();
+
+        const size_t mismatches = ModelComparer(whole.GetModel(), streamed.GetModel()).Compare();
+        std::printf("%s: %s, whole %.3f ms, streamed %.3f ms\n", path.c_str(), mismatches ? "MISMATCH" : "identical",
+            wholeTime, streamedTime);
+        failed += mismatches != 0;
+    }
+
+    const bool rejected = RejectsOversizedDynamicHeader();
+    std::printf("corrupt dynamic block header: %s\n", rejected ? "rejected" : "ACCEPTED");
+    failed += !rejected;
+    return failed ? 1 : 0;
+}
+
+int RunVerifyRing(const CliOptions& options)
+{
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 10000));
+    const size_t inFlight = std::max<size_t>(static_cast<size_t>(options.GetNumber("in-flight", 3)), 1);
+    const double pauseRate = options.GetNumber("pause-rate", 0.3);
+
+    // A swap chain stand-in hands out any frame index no frame in flight holds, the vertices change on some
+    // frames only, and each buffer's contents are tracked apart from the ring
+    VertexRing ring(inFlight);
+    std::mt19937 random(1);
+    std::bernoulli_distribution paused(pauseRate);
+    std::deque<size_t> submitted;
+    std::vector<uint64_t> contents(inFlight, VertexRing::c_noRevision);
+    uint64_t revision = 0;
+    size_t expectedWrites = 0;
+    size_t failures = 0;
+    for (size_t frame = 0; frame < frameCount; frame++)
+    {
+        // The GPU finishes the oldest frame once every buffer is taken
+        if (submitted.size() == inFlight)
+        {
+            submitted.pop_front();
+        }
+        std::vector<size_t> available;
+        for (size_t i = 0; i < inFlight; i++)
+        {
+            if (std::find(submitted.begin(), submitted.end(), i) == submitted.end())
+            {
+                available.push_back(i);
+            }
+        }
+        const size_t frameIndex = available[std::uniform_int_distribution<size_t>(0, available.size() - 1)(random)];
+
+        revision += paused(random) ? 0 : 1;
+        const bool stale = contents[frameIndex] != revision;
+        expectedWrites += stale;
+        if (ring.BeginFrame(frameIndex, revision))
+        {
+            contents[frameIndex] = revision;
+        }
+        if (ring.GetCurrentFrame() != frameIndex || contents[frameIndex] != revision || ring.GetRevision(frameIndex) != revision)
+        {
+            if (failures++ < 8)
+            {
+                std::printf("frame %zu: buffer %zu holds revision %llu, expected %llu\n", frame, frameIndex,
+                    static_cast<unsigned long long>(contents[frameIndex]), static_cast<unsigned long long>(revision));
+            }
+        }
+        submitted.push_back(frameIndex);
+    }
+
+    if (ring.GetWriteCount() != expectedWrites || ring.GetWriteCount() + ring.GetSkipCount() != frameCount)
+    {
+        std::printf("%llu writes, expected %zu\n", static_cast<unsigned long long>(ring.GetWriteCount()), expectedWrites);
+        failures++;
+    }
+    std::printf("%zu frames over %zu buffers, %llu revisions: %llu writes, %llu skipped, %s\n", frameCount, inFlight,
+        static_cast<unsigned long long>(revision), static_cast<unsigned long long>(ring.GetWriteCount()),
+        static_cast<unsigned long long>(ring.GetSkipCount()), failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+int RunVerifyAlloc(const CliOptions& options)
+{
+    const size_t warmupFrames = static_cast<size_t>(options.GetNumber("warmup", 10));
+    const size_t frameCount = static_cast<size_t>(options.GetNumber("frames", 1000));
+    const float step = static_cast<float>(options.GetNumber("step", 1000.0 / 60.0));
+
+    M3dAsset asset;
+    if (!options.arguments.empty())
+    {
+        LoadOptions loadOptions;
+        loadOptions.cached = false;
+        asset = LoadAsset(options.arguments[0], loadOptions);
+    }
+    else
+    {
+        SyntheticModelDesc desc;
+        desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", 20000));
+        SyntheticModel synthetic(desc);
+        asset = M3dAsset(synthetic.Save(false));
+        asset.BuildMesh();
+    }
+    if (asset.GetAnimations().empty())
+    {
+        throw std::runtime_error("Model has no actions");
+    }
+    asset.SetAnimIdx(0);
+    JobPool jobPool(static_cast<size_t>(options.GetNumber("workers", static_cast<double>(JobPool::DefaultWorkerCount()))));
+
+    // The time moves every frame, otherwise Animate finds the pose unchanged and skips the skinning it checks
+    for (size_t i = 0; i < warmupFrames; i++)
+    {
+        asset.Animate(&jobPool);
+        asset.UpdateAnimTime(step);
+    }
+    const uint64_t skinCount = asset.GetSkinCount();
+    const uint64_t allocationCount = g_allocationCount.load();
+    for (size_t i = 0; i < frameCount; i++)
+    {
+        asset.Animate(&jobPool);
+        asset.UpdateAnimTime(step);
+    }
+    const uint64_t allocations = g_allocationCount.load() - allocationCount;
+    const uint64_t skinned = asset.GetSkinCount() - skinCount;
+
+    std::printf("%zu frames after %zu warm-up frames, %llu skinned, %zu worker(s): %llu allocation(s), %s\n", frameCount, warmupFrames,
+        static_cast<unsigned long long>(skinned), jobPool.GetWorkerCount(), static_cast<unsigned long long>(allocations),
+        allocations == 0 && skinned != 0 ? "ok" : "FAILED");
+    return allocations == 0 && skinned != 0 ? 0 : 1;
+}
+
+int RunVerifyIndices(const CliOptions& options)
+{
+    SyntheticModelDesc desc;
+    desc.vertexCount = static_cast<size_t>(options.GetNumber("vertices", 500000));
+    desc.frameCount = 2;
+    SyntheticModel synthetic(desc);
+    const std::vector<unsigned char> file = synthetic.Save(false);
+    M3dAsset wide(file);
+    wide.BuildMesh();
+    M3dAsset split(file);
+    split.BuildMesh(0.0f, true);
+
+    // Meshes past 16-bit indices keep 32-bit ones unless short indices are asked for
+    size_t failures = 0;
+    const size_t vertexCount = wide.GetVertices().size();
+    const bool needsWide = vertexCount > c_maxShortIndexVertices;
+    if (wide.HasShortIndices() == needsWide)
+    {
+        std::printf("%zu vertices built with %s indices\n", vertexCount, wide.HasShortIndices() ? "16-bit" : "32-bit");
+        failures++;
+    }
+
+    // No part may address the strip-cut index 0xFFFF, and together they draw the same triangles, in order, as the 32-bit mesh
+    const std::vector<uint32_t>& indices = wide.GetIndices();
+    const std::vector<uint16_t>& shortIndices = split.GetShortIndices();
+    size_t largestPart = 0;
+    size_t nextIndex = 0;
+    for (const MeshPartRange& part : split.GetParts())
+    {
+        largestPart = std::max<size_t>(largestPart, part.vertexCount);
+        if (part.vertexCount > c_maxShortIndexVertices || part.startIndex != nextIndex)
+        {
+            std::printf("part at index %u: %u vertices, expected to start at %zu\n", part.startIndex, part.vertexCount, nextIndex);
+            failures++;
+        }
+        for (size_t i = part.startIndex; i < part.startIndex + part.indexCount && i < indices.size(); i++)
+        {
+            const MeshVertex& expected = wide.GetVertices()[indices[i]];
+            const size_t local = shortIndices[i];
+            if (local >= part.vertexCount || local == 0xFFFF || memcmp(&split.GetVertices()[part.vertexOffset + local], &expected, sizeof(MeshVertex)) != 0)
+            {
+                if (failures++ < 8)
+                {
+                    std::printf("index %zu of the part at %u does not re-expand to the same vertex\n", i, part.startIndex);
+                }
+            }
+        }
+        nextIndex = part.startIndex + part.indexCount;
+    }
+    if (!split.HasShortIndices() || nextIndex != indices.size() || shortIndices.size() != indices.size())
+    {
+        std::printf("short index build: %zu indices in %zu part(s), expected %zu\n", shortIndices.size(), split.GetParts().size(), indices.size());
+        failures++;
+    }
+
+    std::printf("%zu vertices, %zu triangles: %s indices by default, %zu 16-bit part(s) of at most %zu vertices, %s\n",
+        vertexCount, indices.size() / 3, wide.HasShortIndices() ? "16-bit" : "32-bit", split.GetParts().size(), largestPart,
+        failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -485,6 +485,7 @@ extern "C" {
 #define M3D_FLG_FREESTR     (1<<1)
 #define M3D_FLG_MTLLIB      (1<<2)
 #define M3D_FLG_GENNORM     (1<<3)
+#define M3D_FLG_NEEDNORM    (1<<4)      /* some faces have no normals, only set while loading */
 
     typedef struct {
         m3dhdr_t* raw;              /* pointer to raw data */
@@ -587,11 +588,24 @@ extern "C" {
 /*** C prototypes ***/
 /* import / export */
     m3d_t* m3d_load(unsigned char* data, m3dread_t readfilecb, m3dfree_t freecb, m3d_t* mtllib);
+    /* same one chunk at a time, for callers streaming the model body, see m3d_loadhead */
+    m3d_t* m3d_loadhead(unsigned char* head, m3d_t* mtllib);
+    int m3d_loadchunk(m3d_t* model, unsigned char* chunk, m3dread_t readfilecb, m3dfree_t freecb);
+    m3d_t* m3d_loadend(m3d_t* model);
+#define M3D_CHUNK_NEXT  0   /* chunk parsed, its buffer can be reused */
+#define M3D_CHUNK_KEEP  1   /* chunk parsed, the model points into it so it must live as long as the model */
+#define M3D_CHUNK_STOP  2   /* loading stops here, what was parsed so far still gets post-processed */
+#define M3D_CHUNK_ABORT 3   /* loading failed, see the model's errcode */
+    /* built-in zlib decompressor of compressed models, define M3D_INFLATE with the same signature to replace it */
+    unsigned char* m3d_inflate(const unsigned char* data, unsigned int len, unsigned int* outlen);
     unsigned char* m3d_save(m3d_t* model, int quality, int flags, unsigned int* size);
     void m3d_free(m3d_t* model);
     /* generate animation pose skeleton */
     m3dtr_t* m3d_frame(m3d_t* model, M3D_INDEX actionid, M3D_INDEX frameid, m3dtr_t* skeleton);
     m3db_t* m3d_pose(m3d_t* model, M3D_INDEX actionid, uint32_t msec);
+    /* same without allocating nor touching the model, see M3D_POSEINTERP for the interp buffer size */
+    m3db_t* m3d_pose_r(const m3d_t* model, M3D_INDEX actionid, uint32_t msec, m3db_t* pose, m3dtr_t* frame, m3dv_t* interp);
+#define M3D_POSEINTERP(model) (2 * (model)->numbone)
 
     /* private prototypes used by both importer and exporter */
     char* _m3d_safestr(char* in, int morelines);
@@ -2192,14 +2206,43 @@ extern "C" {
 #endif
 #ifndef M3D_NOIMPORTER
     /* helper function to load and decode/generate a texture */
+    /* decode the image of a texture from its file contents */
+    static void _m3d_decodetx(m3d_t* model, M3D_INDEX i, unsigned char* buff, unsigned int len)
+    {
+        unsigned int w, h;
+        stbi__context s;
+        stbi__result_info ri;
+
+        if (buff[0] == 0x89 && buff[1] == 'P' && buff[2] == 'N' && buff[3] == 'G') {
+            s.read_from_callbacks = 0;
+            s.img_buffer = s.img_buffer_original = (unsigned char*)buff;
+            s.img_buffer_end = s.img_buffer_original_end = (unsigned char*)buff + len;
+            /* don't use model->texture[i].w directly, it's a uint16_t */
+            w = h = len = 0;
+            ri.bits_per_channel = 8;
+            model->texture[i].d = (uint8_t*)stbi__png_load(&s, (int*)&w, (int*)&h, (int*)&len, 0, &ri);
+            model->texture[i].w = w;
+            model->texture[i].h = h;
+            model->texture[i].f = (uint8_t)len;
+        }
+        else {
+#ifdef M3D_TX_INTERP
+            if ((model->errcode = M3D_TX_INTERP(model->texture[i].name, buff, len, &model->texture[i])) != M3D_SUCCESS) {
+                M3D_LOG("Unable to generate texture");
+                M3D_LOG(model->texture[i].name);
+            }
+#else
+            M3D_LOG("Unimplemented interpreter");
+            M3D_LOG(model->texture[i].name);
+#endif
+        }
+    }
+
     M3D_INDEX _m3d_gettx(m3d_t* model, m3dread_t readfilecb, m3dfree_t freecb, char* fn)
     {
         unsigned int i, len = 0;
         unsigned char* buff = NULL;
         char* fn2;
-        unsigned int w, h;
-        stbi__context s;
-        stbi__result_info ri;
 
         /* failsafe */
         if (!fn || !*fn) return M3D_UNDEF;
@@ -2243,29 +2286,7 @@ extern "C" {
         model->texture[i].name = fn;
         model->texture[i].w = model->texture[i].h = 0; model->texture[i].d = NULL;
         if (buff) {
-            if (buff[0] == 0x89 && buff[1] == 'P' && buff[2] == 'N' && buff[3] == 'G') {
-                s.read_from_callbacks = 0;
-                s.img_buffer = s.img_buffer_original = (unsigned char*)buff;
-                s.img_buffer_end = s.img_buffer_original_end = (unsigned char*)buff + len;
-                /* don't use model->texture[i].w directly, it's a uint16_t */
-                w = h = len = 0;
-                ri.bits_per_channel = 8;
-                model->texture[i].d = (uint8_t*)stbi__png_load(&s, (int*)&w, (int*)&h, (int*)&len, 0, &ri);
-                model->texture[i].w = w;
-                model->texture[i].h = h;
-                model->texture[i].f = (uint8_t)len;
-            }
-            else {
-#ifdef M3D_TX_INTERP
-                if ((model->errcode = M3D_TX_INTERP(fn, buff, len, &model->texture[i])) != M3D_SUCCESS) {
-                    M3D_LOG("Unable to generate texture");
-                    M3D_LOG(fn);
-                }
-#else
-                M3D_LOG("Unimplemented interpreter");
-                M3D_LOG(fn);
-#endif
-            }
+            _m3d_decodetx(model, i, buff, len);
             if (freecb) (*freecb)(buff);
         }
         if (!model->texture[i].d)
@@ -2407,21 +2428,95 @@ extern "C" {
     }
 #endif
 
-    /**
-     * Function to decode a Model 3D into in-memory format
-     */
-    m3d_t* m3d_load(unsigned char* data, m3dread_t readfilecb, m3dfree_t freecb, m3d_t* mtllib)
+    /* parse the header chunk model->raw points to, returns 0 if the model can't be loaded */
+    static int _m3d_parsehead(m3d_t* model)
     {
-        unsigned char* end, * chunk, * buff, weights[8];
-        unsigned int i, j, k, l, n, am, len = 0, reclen, offs;
-#ifndef M3D_NOVOXELS
-        int32_t min_x, min_y, min_z, max_x, max_y, max_z, sx, sy, sz, x, y, z;
-        M3D_INDEX edge[8], enorm;
-#endif
+        unsigned char* data = (unsigned char*)model->raw, * end = data + model->raw->length;
+
+        data += sizeof(m3dhdr_t);
+        M3D_LOG((char*)data);
+        model->name = (char*)data;
+        for (; data < end && *data; data++) {}; data++;
+        model->license = (char*)data;
+        for (; data < end && *data; data++) {}; data++;
+        model->author = (char*)data;
+        for (; data < end && *data; data++) {}; data++;
+        model->desc = (char*)data;
+        model->scale = (M3D_FLOAT)model->raw->scale;
+        if (model->scale <= (M3D_FLOAT)0.0) model->scale = (M3D_FLOAT)1.0;
+        model->vc_s = 1 << ((model->raw->types >> 0) & 3);  /* vertex coordinate size */
+        model->vi_s = 1 << ((model->raw->types >> 2) & 3);  /* vertex index size */
+        model->si_s = 1 << ((model->raw->types >> 4) & 3);  /* string offset size */
+        model->ci_s = 1 << ((model->raw->types >> 6) & 3);  /* color index size */
+        model->ti_s = 1 << ((model->raw->types >> 8) & 3);  /* tmap index size */
+        model->bi_s = 1 << ((model->raw->types >> 10) & 3);  /* bone index size */
+        model->nb_s = 1 << ((model->raw->types >> 12) & 3);  /* number of bones per vertex */
+        model->sk_s = 1 << ((model->raw->types >> 14) & 3);  /* skin index size */
+        model->fc_s = 1 << ((model->raw->types >> 16) & 3);  /* frame counter size */
+        model->hi_s = 1 << ((model->raw->types >> 18) & 3);  /* shape index size */
+        model->fi_s = 1 << ((model->raw->types >> 20) & 3);  /* face index size */
+        model->vd_s = 1 << ((model->raw->types >> 22) & 3);  /* voxel dimension size */
+        model->vp_s = 1 << ((model->raw->types >> 24) & 3);  /* voxel pixel size */
+        if (model->ci_s == 8) model->ci_s = 0;               /* optional indices */
+        if (model->ti_s == 8) model->ti_s = 0;
+        if (model->bi_s == 8) model->bi_s = 0;
+        if (model->sk_s == 8) model->sk_s = 0;
+        if (model->fc_s == 8) model->fc_s = 0;
+        if (model->hi_s == 8) model->hi_s = 0;
+        if (model->fi_s == 8) model->fi_s = 0;
+
+        /* variable limit checks */
+        if (sizeof(M3D_FLOAT) == 4 && model->vc_s > 4) {
+            M3D_LOG("Double precision coordinates not supported, truncating to float...");
+            model->errcode = M3D_ERR_TRUNC;
+        }
+        if ((sizeof(M3D_INDEX) == 2 && (model->vi_s > 2 || model->si_s > 2 || model->ci_s > 2 || model->ti_s > 2 ||
+            model->bi_s > 2 || model->sk_s > 2 || model->fc_s > 2 || model->hi_s > 2 || model->fi_s > 2)) ||
+            (sizeof(M3D_VOXEL) < (size_t)model->vp_s && model->vp_s != 8)) {
+            M3D_LOG("32 bit indices not supported, unable to load model");
+            return 0;
+        }
+        if (model->vi_s > 4 || model->si_s > 4 || model->vp_s == 4) {
+            M3D_LOG("Invalid index size, unable to load model");
+            return 0;
+        }
+        if (model->nb_s > M3D_NUMBONE) {
+            M3D_LOG("Model has more bones per vertex than what importer was configured to support");
+            model->errcode = M3D_ERR_TRUNC;
+        }
+        return 1;
+    }
+
+
+    /* register an inlined asset chunk, returns 0 when out of memory */
+    static int _m3d_getinlined(m3d_t* model, unsigned char* data)
+    {
+        unsigned int len = ((m3dchunk_t*)data)->length - sizeof(m3dchunk_t) - model->si_s, i, offs;
+        m3di_t* t;
+
+        if (!M3D_CHUNKMAGIC(data, 'A', 'S', 'E', 'T') || ((m3dchunk_t*)data)->length <= sizeof(m3dchunk_t) + model->si_s) return 1;
+        M3D_LOG("Inlined asset");
+        i = model->numinlined++;
+        model->inlined = (m3di_t*)M3D_REALLOC(model->inlined, model->numinlined * sizeof(m3di_t));
+        if (!model->inlined) return 0;
+        data += sizeof(m3dchunk_t);
+        t = &model->inlined[i];
+        M3D_GETSTR(t->name);
+        M3D_LOG(t->name);
+        t->data = (uint8_t*)data;
+        t->length = len;
+        return 1;
+    }
+
+
+    /* parse one chunk after the header, returns one of the M3D_CHUNK_* codes */
+    static int _m3d_parsechunk(m3d_t* model, unsigned char* data, m3dread_t readfilecb, m3dfree_t freecb)
+    {
+        unsigned char* chunk = data + ((m3dchunk_t*)data)->length, weights[8];
+        unsigned int i, j, k, l, n, am, len = ((m3dchunk_t*)data)->length - sizeof(m3dchunk_t), reclen, offs;
         char* name, * lang;
         float f;
-        m3d_t* model;
-        M3D_INDEX mi;
+        M3D_INDEX mi = M3D_UNDEF;
 #ifdef M3D_VERTEXMAX
         M3D_INDEX pi;
 #endif
@@ -2431,1131 +2526,1140 @@ extern "C" {
         m3dh_t* h;
         m3dm_t* m;
         m3da_t* a;
-        m3di_t* t;
-#ifndef M3D_NONORMALS
-        char neednorm = 0;
-        m3dv_t* norm = NULL, * v0, * v1, * v2, va, vb;
-#endif
-#ifndef M3D_NOANIMATION
-        M3D_FLOAT r[16];
-#endif
-#if !defined(M3D_NOWEIGHTS) || !defined(M3D_NOANIMATION)
-        m3db_t* b;
-#endif
-#ifndef M3D_NOWEIGHTS
-        m3ds_t* sk;
-#endif
-#ifdef M3D_ASCII
-        m3ds_t s;
-        M3D_INDEX bi[M3D_BONEMAXLEVEL + 1], level;
-        const char* ol;
-        char* ptr, * pe, * fn;
-#endif
-#ifdef M3D_PROFILING
-        struct timeval tv0, tv1, tvd;
-        gettimeofday(&tv0, NULL);
-#endif
-
-        if (!data || (!M3D_CHUNKMAGIC(data, '3', 'D', 'M', 'O')
-#ifdef M3D_ASCII
-            && !M3D_CHUNKMAGIC(data, '3', 'd', 'm', 'o')
-#endif
-            )) return NULL;
-        model = (m3d_t*)M3D_MALLOC(sizeof(m3d_t));
-        if (!model) {
-            M3D_LOG("Out of memory");
-            return NULL;
-        }
-        memset(model, 0, sizeof(m3d_t));
 
-        if (mtllib) {
-            model->nummaterial = mtllib->nummaterial;
-            model->material = mtllib->material;
-            model->numtexture = mtllib->numtexture;
-            model->texture = mtllib->texture;
-            model->flags |= M3D_FLG_MTLLIB;
+        /* color map */
+        if (M3D_CHUNKMAGIC(data, 'C', 'M', 'A', 'P')) {
+            M3D_LOG("Color map");
+            if (model->cmap) { M3D_LOG("More color map chunks, should be unique"); model->errcode = M3D_ERR_CMAP; return M3D_CHUNK_NEXT; }
+            if (!model->ci_s) { M3D_LOG("Color map chunk, shouldn't be any"); model->errcode = M3D_ERR_CMAP; return M3D_CHUNK_NEXT; }
+            model->numcmap = len / sizeof(uint32_t);
+            model->cmap = (uint32_t*)(data + sizeof(m3dchunk_t));
+            return M3D_CHUNK_KEEP;
         }
-#ifdef M3D_ASCII
-        /* ASCII variant? */
-        if (M3D_CHUNKMAGIC(data, '3', 'd', 'm', 'o')) {
-            model->errcode = M3D_ERR_BADFILE;
-            model->flags |= M3D_FLG_FREESTR;
-            model->raw = (m3dhdr_t*)data;
-            ptr = (char*)data;
-            ol = setlocale(LC_NUMERIC, NULL);
-            setlocale(LC_NUMERIC, "C");
-            /* parse header. Don't use sscanf, that's incredibly slow */
-            ptr = _m3d_findarg(ptr);
-            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-            pe = _m3d_findnl(ptr);
-            model->scale = (float)strtod(ptr, NULL); ptr = pe;
-            if (model->scale <= (M3D_FLOAT)0.0) model->scale = (M3D_FLOAT)1.0;
-            model->name = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
-            if (!*ptr) goto asciiend;
-            model->license = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
-            if (!*ptr) goto asciiend;
-            model->author = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
-            if (!*ptr) goto asciiend;
-            if (*ptr != '\r' && *ptr != '\n')
-                model->desc = _m3d_safestr(ptr, 3);
-            while (*ptr) {
-                while (*ptr && *ptr != '\n') ptr++;
-                ptr++; if (*ptr == '\r') ptr++;
-                if (*ptr == '\n') break;
+        else
+            /* texture map */
+            if (M3D_CHUNKMAGIC(data, 'T', 'M', 'A', 'P')) {
+                M3D_LOG("Texture map");
+                if (model->tmap) { M3D_LOG("More texture map chunks, should be unique"); model->errcode = M3D_ERR_TMAP; return M3D_CHUNK_NEXT; }
+                if (!model->ti_s) { M3D_LOG("Texture map chunk, shouldn't be any"); model->errcode = M3D_ERR_TMAP; return M3D_CHUNK_NEXT; }
+                reclen = model->vc_s + model->vc_s;
+                model->numtmap = len / reclen;
+                model->tmap = (m3dti_t*)M3D_MALLOC(model->numtmap * sizeof(m3dti_t));
+                if (!model->tmap) goto memerr;
+                for (i = 0, data += sizeof(m3dchunk_t); data < chunk; i++) {
+                    switch (model->vc_s) {
+                    case 1:
+                        model->tmap[i].u = (M3D_FLOAT)((uint8_t)data[0]) / (M3D_FLOAT)255.0;
+                        model->tmap[i].v = (M3D_FLOAT)((uint8_t)data[1]) / (M3D_FLOAT)255.0;
+                        break;
+                    case 2:
+                        model->tmap[i].u = (M3D_FLOAT)(*((uint16_t*)(data + 0))) / (M3D_FLOAT)65535.0;
+                        model->tmap[i].v = (M3D_FLOAT)(*((uint16_t*)(data + 2))) / (M3D_FLOAT)65535.0;
+                        break;
+                    case 4:
+                        model->tmap[i].u = (M3D_FLOAT)(*((float*)(data + 0)));
+                        model->tmap[i].v = (M3D_FLOAT)(*((float*)(data + 4)));
+                        break;
+                    case 8:
+                        model->tmap[i].u = (M3D_FLOAT)(*((double*)(data + 0)));
+                        model->tmap[i].v = (M3D_FLOAT)(*((double*)(data + 8)));
+                        break;
+                    }
+                    data += reclen;
+                }
             }
-
-            /* the main chunk reader loop */
-            while (*ptr) {
-                while (*ptr && (*ptr == '\r' || *ptr == '\n')) ptr++;
-                if (!*ptr || (ptr[0] == 'E' && ptr[1] == 'n' && ptr[2] == 'd')) break;
-                /* make sure there's at least one data row */
-                pe = ptr; ptr = _m3d_findnl(ptr);
-                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                /* Preview chunk */
-                if (!memcmp(pe, "Preview", 7)) {
-                    if (readfilecb) {
-                        pe = _m3d_safestr(ptr, 0);
-                        if (!pe || !*pe) goto asciiend;
-                        model->preview.data = (*readfilecb)(pe, &model->preview.length);
-                        M3D_FREE(pe);
+            else
+                /* vertex list */
+                if (M3D_CHUNKMAGIC(data, 'V', 'R', 'T', 'S')) {
+                    M3D_LOG("Vertex list");
+                    if (model->vertex) { M3D_LOG("More vertex chunks, should be unique"); model->errcode = M3D_ERR_VRTS; return M3D_CHUNK_NEXT; }
+                    if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
+                    reclen = model->ci_s + model->sk_s + 4 * model->vc_s;
+                    model->numvertex = len / reclen;
+                    model->vertex = (m3dv_t*)M3D_MALLOC(model->numvertex * sizeof(m3dv_t));
+                    if (!model->vertex) goto memerr;
+                    memset(model->vertex, 0, model->numvertex * sizeof(m3dv_t));
+                    for (i = 0, data += sizeof(m3dchunk_t); data < chunk && i < model->numvertex; i++) {
+                        switch (model->vc_s) {
+                        case 1:
+                            model->vertex[i].x = (M3D_FLOAT)((int8_t)data[0]) / (M3D_FLOAT)127.0;
+                            model->vertex[i].y = (M3D_FLOAT)((int8_t)data[1]) / (M3D_FLOAT)127.0;
+                            model->vertex[i].z = (M3D_FLOAT)((int8_t)data[2]) / (M3D_FLOAT)127.0;
+                            model->vertex[i].w = (M3D_FLOAT)((int8_t)data[3]) / (M3D_FLOAT)127.0;
+                            data += 4;
+                            break;
+                        case 2:
+                            model->vertex[i].x = (M3D_FLOAT)(*((int16_t*)(data + 0))) / (M3D_FLOAT)32767.0;
+                            model->vertex[i].y = (M3D_FLOAT)(*((int16_t*)(data + 2))) / (M3D_FLOAT)32767.0;
+                            model->vertex[i].z = (M3D_FLOAT)(*((int16_t*)(data + 4))) / (M3D_FLOAT)32767.0;
+                            model->vertex[i].w = (M3D_FLOAT)(*((int16_t*)(data + 6))) / (M3D_FLOAT)32767.0;
+                            data += 8;
+                            break;
+                        case 4:
+                            model->vertex[i].x = (M3D_FLOAT)(*((float*)(data + 0)));
+                            model->vertex[i].y = (M3D_FLOAT)(*((float*)(data + 4)));
+                            model->vertex[i].z = (M3D_FLOAT)(*((float*)(data + 8)));
+                            model->vertex[i].w = (M3D_FLOAT)(*((float*)(data + 12)));
+                            data += 16;
+                            break;
+                        case 8:
+                            model->vertex[i].x = (M3D_FLOAT)(*((double*)(data + 0)));
+                            model->vertex[i].y = (M3D_FLOAT)(*((double*)(data + 8)));
+                            model->vertex[i].z = (M3D_FLOAT)(*((double*)(data + 16)));
+                            model->vertex[i].w = (M3D_FLOAT)(*((double*)(data + 24)));
+                            data += 32;
+                            break;
+                        }
+                        switch (model->ci_s) {
+                        case 1: model->vertex[i].color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
+                        case 2: model->vertex[i].color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
+                        case 4: model->vertex[i].color = *((uint32_t*)data); data += 4; break;
+                            /* case 8: break; */
+                        }
+                        model->vertex[i].skinid = M3D_UNDEF;
+                        data = _m3d_getidx(data, model->sk_s, &model->vertex[i].skinid);
                     }
-                    while (*ptr && *ptr != '\r' && *ptr != '\n')
-                        ptr = _m3d_findnl(ptr);
                 }
                 else
-                    /* texture map chunk */
-                    if (!memcmp(pe, "Textmap", 7)) {
-                        if (model->tmap) { M3D_LOG("More texture map chunks, should be unique"); goto asciiend; }
-                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                            i = model->numtmap++;
-                            model->tmap = (m3dti_t*)M3D_REALLOC(model->tmap, model->numtmap * sizeof(m3dti_t));
-                            if (!model->tmap) goto memerr;
-                            ptr = _m3d_getfloat(ptr, &model->tmap[i].u);
-                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                            _m3d_getfloat(ptr, &model->tmap[i].v);
-                            ptr = _m3d_findnl(ptr);
+                    /* skeleton: bone hierarchy and skin */
+                    if (M3D_CHUNKMAGIC(data, 'B', 'O', 'N', 'E')) {
+                        M3D_LOG("Skeleton");
+                        if (model->bone) { M3D_LOG("More bone chunks, should be unique"); model->errcode = M3D_ERR_BONE; return M3D_CHUNK_NEXT; }
+                        if (!model->bi_s) { M3D_LOG("Bone chunk, shouldn't be any"); model->errcode = M3D_ERR_BONE; return M3D_CHUNK_NEXT; }
+                        if (!model->vertex) { M3D_LOG("No vertex chunk before bones"); model->errcode = M3D_ERR_VRTS; return M3D_CHUNK_STOP; }
+                        data += sizeof(m3dchunk_t);
+                        model->numbone = 0;
+                        data = _m3d_getidx(data, model->bi_s, &model->numbone);
+                        if (model->numbone) {
+                            model->bone = (m3db_t*)M3D_MALLOC(model->numbone * sizeof(m3db_t));
+                            if (!model->bone) goto memerr;
+                        }
+                        model->numskin = 0;
+                        data = _m3d_getidx(data, model->sk_s, &model->numskin);
+                        /* read bone hierarchy */
+                        for (i = 0; data < chunk && i < model->numbone; i++) {
+                            data = _m3d_getidx(data, model->bi_s, &model->bone[i].parent);
+                            M3D_GETSTR(model->bone[i].name);
+                            data = _m3d_getidx(data, model->vi_s, &model->bone[i].pos);
+                            data = _m3d_getidx(data, model->vi_s, &model->bone[i].ori);
+                            model->bone[i].numweight = 0;
+                            model->bone[i].weight = NULL;
+                        }
+                        /* read skin definitions */
+                        if (model->numskin) {
+                            model->skin = (m3ds_t*)M3D_MALLOC(model->numskin * sizeof(m3ds_t));
+                            if (!model->skin) goto memerr;
+                            for (i = 0; data < chunk && i < model->numskin; i++) {
+                                for (j = 0; j < M3D_NUMBONE; j++) {
+                                    model->skin[i].boneid[j] = M3D_UNDEF;
+                                    model->skin[i].weight[j] = (M3D_FLOAT)0.0;
+                                }
+                                memset(&weights, 0, sizeof(weights));
+                                if (model->nb_s == 1) weights[0] = 255;
+                                else {
+                                    memcpy(&weights, data, model->nb_s);
+                                    data += model->nb_s;
+                                }
+                                for (j = 0, w = (M3D_FLOAT)0.0; j < (unsigned int)model->nb_s; j++) {
+                                    if (weights[j]) {
+                                        if (j >= M3D_NUMBONE)
+                                            data += model->bi_s;
+                                        else {
+                                            model->skin[i].weight[j] = (M3D_FLOAT)(weights[j]) / (M3D_FLOAT)255.0;
+                                            w += model->skin[i].weight[j];
+                                            data = _m3d_getidx(data, model->bi_s, &model->skin[i].boneid[j]);
+                                        }
+                                    }
+                                }
+                                /* this can occur if model has more bones than what the importer is configured to handle */
+                                if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0) {
+                                    for (j = 0; j < M3D_NUMBONE; j++)
+                                        model->skin[i].weight[j] /= w;
+                                }
+                            }
                         }
                     }
                     else
-                        /* vertex chunk */
-                        if (!memcmp(pe, "Vertex", 6)) {
-                            if (model->vertex) { M3D_LOG("More vertex chunks, should be unique"); goto asciiend; }
-                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                i = model->numvertex++;
-                                model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
-                                if (!model->vertex) goto memerr;
-                                memset(&model->vertex[i], 0, sizeof(m3dv_t));
-                                model->vertex[i].skinid = M3D_UNDEF;
-                                model->vertex[i].color = 0;
-                                model->vertex[i].w = (M3D_FLOAT)1.0;
-                                ptr = _m3d_getfloat(ptr, &model->vertex[i].x);
-                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                ptr = _m3d_getfloat(ptr, &model->vertex[i].y);
-                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                ptr = _m3d_getfloat(ptr, &model->vertex[i].z);
-                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                ptr = _m3d_getfloat(ptr, &model->vertex[i].w);
-                                if (!*ptr) goto asciiend;
-                                if (*ptr == '#') {
-                                    ptr = _m3d_gethex(ptr, &model->vertex[i].color);
-                                    if (!*ptr) goto asciiend;
+                        /* material */
+                        if (M3D_CHUNKMAGIC(data, 'M', 'T', 'R', 'L')) {
+                            data += sizeof(m3dchunk_t);
+                            M3D_GETSTR(name);
+                            M3D_LOG("Material");
+                            M3D_LOG(name);
+                            if (model->ci_s < 4 && !model->numcmap) model->errcode = M3D_ERR_CMAP;
+                            for (i = 0; i < model->nummaterial; i++)
+                                if (!strcmp(name, model->material[i].name)) {
+                                    model->errcode = M3D_ERR_MTRL;
+                                    M3D_LOG("Multiple definitions for material");
+                                    M3D_LOG(name);
+                                    name = NULL;
+                                    break;
                                 }
-                                /* parse skin */
-                                memset(&s, 0, sizeof(m3ds_t));
-                                for (j = 0, w = (M3D_FLOAT)0.0; j < M3D_NUMBONE && *ptr && *ptr != '\r' && *ptr != '\n'; j++) {
-                                    ptr = _m3d_findarg(ptr);
-                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                    ptr = _m3d_getint(ptr, &k);
-                                    s.boneid[j] = (M3D_INDEX)k;
-                                    if (*ptr == ':') {
-                                        ptr++;
-                                        ptr = _m3d_getfloat(ptr, &s.weight[j]);
-                                        w += s.weight[j];
+                            if (name) {
+                                i = model->nummaterial++;
+                                if (model->flags & M3D_FLG_MTLLIB) {
+                                    m = model->material;
+                                    model->material = (m3dm_t*)M3D_MALLOC(model->nummaterial * sizeof(m3dm_t));
+                                    if (!model->material) goto memerr;
+                                    memcpy(model->material, m, (model->nummaterial - 1) * sizeof(m3dm_t));
+                                    if (model->texture) {
+                                        tx = model->texture;
+                                        model->texture = (m3dtx_t*)M3D_MALLOC(model->numtexture * sizeof(m3dtx_t));
+                                        if (!model->texture) goto memerr;
+                                        memcpy(model->texture, tx, model->numtexture * sizeof(m3dm_t));
                                     }
-                                    else if (!j)
-                                        s.weight[j] = (M3D_FLOAT)1.0;
-                                    if (!*ptr) goto asciiend;
+                                    model->flags &= ~M3D_FLG_MTLLIB;
                                 }
-                                if (s.boneid[0] != M3D_UNDEF && s.weight[0] > (M3D_FLOAT)0.0) {
-                                    if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0)
-                                        for (j = 0; j < M3D_NUMBONE && s.weight[j] >(M3D_FLOAT)0.0; j++)
-                                            s.weight[j] /= w;
-                                    k = M3D_NOTDEFINED;
-                                    if (model->skin) {
-                                        for (j = 0; j < model->numskin; j++)
-                                            if (!memcmp(&model->skin[j], &s, sizeof(m3ds_t))) { k = j; break; }
+                                else {
+                                    model->material = (m3dm_t*)M3D_REALLOC(model->material, model->nummaterial * sizeof(m3dm_t));
+                                    if (!model->material) goto memerr;
+                                }
+                                m = &model->material[i];
+                                m->numprop = 0;
+                                m->name = name;
+                                m->prop = (m3dp_t*)M3D_MALLOC((len / 2) * sizeof(m3dp_t));
+                                if (!m->prop) goto memerr;
+                                while (data < chunk) {
+                                    i = m->numprop++;
+                                    m->prop[i].type = *data++;
+                                    m->prop[i].value.num = 0;
+                                    if (m->prop[i].type >= 128)
+                                        k = m3dpf_map;
+                                    else {
+                                        for (k = 256, j = 0; j < sizeof(m3d_propertytypes) / sizeof(m3d_propertytypes[0]); j++)
+                                            if (m->prop[i].type == m3d_propertytypes[j].id) { k = m3d_propertytypes[j].format; break; }
                                     }
-                                    if (k == M3D_NOTDEFINED) {
-                                        k = model->numskin++;
-                                        model->skin = (m3ds_t*)M3D_REALLOC(model->skin, model->numskin * sizeof(m3ds_t));
-                                        if (!model->skin) goto memerr;
-                                        memcpy(&model->skin[k], &s, sizeof(m3ds_t));
+                                    switch (k) {
+                                    case m3dpf_color:
+                                        switch (model->ci_s) {
+                                        case 1: m->prop[i].value.color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
+                                        case 2: m->prop[i].value.color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
+                                        case 4: m->prop[i].value.color = *((uint32_t*)data); data += 4; break;
+                                        }
+                                        break;
+
+                                    case m3dpf_uint8: m->prop[i].value.num = *data++; break;
+                                    case m3dpf_uint16:m->prop[i].value.num = *((uint16_t*)data); data += 2; break;
+                                    case m3dpf_uint32:m->prop[i].value.num = *((uint32_t*)data); data += 4; break;
+                                    case m3dpf_float: m->prop[i].value.fnum = *((float*)data); data += 4; break;
+
+                                    case m3dpf_map:
+                                        M3D_GETSTR(name);
+                                        m->prop[i].value.textureid = _m3d_gettx(model, readfilecb, freecb, name);
+                                        if (model->errcode == M3D_ERR_ALLOC) goto memerr;
+                                        /* this error code only returned if readfilecb was specified */
+                                        if (m->prop[i].value.textureid == M3D_UNDEF) {
+                                            M3D_LOG("Texture not found");
+                                            M3D_LOG(m->name);
+                                            m->numprop--;
+                                        }
+                                        break;
+
+                                    default:
+                                        M3D_LOG("Unknown material property in");
+                                        M3D_LOG(m->name);
+                                        model->errcode = M3D_ERR_UNKPROP;
+                                        data = chunk;
+                                        break;
                                     }
-                                    model->vertex[i].skinid = (M3D_INDEX)k;
                                 }
-                                ptr = _m3d_findnl(ptr);
+                                m->prop = (m3dp_t*)M3D_REALLOC(m->prop, m->numprop * sizeof(m3dp_t));
+                                if (!m->prop) goto memerr;
                             }
                         }
                         else
-                            /* Skeleton, bone hierarchy */
-                            if (!memcmp(pe, "Bones", 5)) {
-                                if (model->bone) { M3D_LOG("More bones chunks, should be unique"); goto asciiend; }
-                                bi[0] = M3D_UNDEF;
-                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                    i = model->numbone++;
-                                    model->bone = (m3db_t*)M3D_REALLOC(model->bone, model->numbone * sizeof(m3db_t));
-                                    if (!model->bone) goto memerr;
-                                    for (level = 0; *ptr == '/'; ptr++, level++);
-                                    if (level > M3D_BONEMAXLEVEL || !*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                    bi[level + 1] = i;
-                                    model->bone[i].numweight = 0;
-                                    model->bone[i].weight = NULL;
-                                    model->bone[i].parent = bi[level];
-                                    ptr = _m3d_getint(ptr, &k);
-                                    ptr = _m3d_findarg(ptr);
-                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                    model->bone[i].pos = (M3D_INDEX)k;
-                                    ptr = _m3d_getint(ptr, &k);
-                                    ptr = _m3d_findarg(ptr);
-                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                    model->bone[i].ori = (M3D_INDEX)k;
-                                    model->vertex[k].skinid = M3D_INDEXMAX;
-                                    pe = _m3d_safestr(ptr, 0);
-                                    if (!pe || !*pe) goto asciiend;
-                                    model->bone[i].name = pe;
-                                    ptr = _m3d_findnl(ptr);
-                                }
+                            /* face */
+                            if (M3D_CHUNKMAGIC(data, 'P', 'R', 'O', 'C')) {
+                                /* procedural surface */
+                                M3D_GETSTR(name);
+                                M3D_LOG("Procedural surface");
+                                M3D_LOG(name);
+                                _m3d_getpr(model, readfilecb, freecb, name);
                             }
                             else
-                                /* material chunk */
-                                if (!memcmp(pe, "Material", 8)) {
-                                    pe = _m3d_findarg(pe);
-                                    if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                    pe = _m3d_safestr(pe, 0);
-                                    if (!pe || !*pe) goto asciiend;
-                                    for (i = 0; i < model->nummaterial; i++)
-                                        if (!strcmp(pe, model->material[i].name)) {
-                                            M3D_LOG("Multiple definitions for material");
-                                            M3D_LOG(pe);
-                                            M3D_FREE(pe);
-                                            pe = NULL;
-                                            while (*ptr && *ptr != '\r' && *ptr != '\n') ptr = _m3d_findnl(ptr);
-                                            break;
-                                        }
-                                    if (!pe) continue;
-                                    i = model->nummaterial++;
-                                    if (model->flags & M3D_FLG_MTLLIB) {
-                                        m = model->material;
-                                        model->material = (m3dm_t*)M3D_MALLOC(model->nummaterial * sizeof(m3dm_t));
-                                        if (!model->material) goto memerr;
-                                        memcpy(model->material, m, (model->nummaterial - 1) * sizeof(m3dm_t));
-                                        if (model->texture) {
-                                            tx = model->texture;
-                                            model->texture = (m3dtx_t*)M3D_MALLOC(model->numtexture * sizeof(m3dtx_t));
-                                            if (!model->texture) goto memerr;
-                                            memcpy(model->texture, tx, model->numtexture * sizeof(m3dm_t));
-                                        }
-                                        model->flags &= ~M3D_FLG_MTLLIB;
-                                    }
-                                    else {
-                                        model->material = (m3dm_t*)M3D_REALLOC(model->material, model->nummaterial * sizeof(m3dm_t));
-                                        if (!model->material) goto memerr;
-                                    }
-                                    m = &model->material[i];
-                                    m->name = pe;
-                                    m->numprop = 0;
-                                    m->prop = NULL;
-                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                        k = n = 256;
-                                        if (*ptr == 'm' && *(ptr + 1) == 'a' && *(ptr + 2) == 'p' && *(ptr + 3) == '_') {
-                                            k = m3dpf_map;
-                                            ptr += 4;
-                                        }
-                                        for (j = 0; j < sizeof(m3d_propertytypes) / sizeof(m3d_propertytypes[0]); j++)
-                                            if (!memcmp(ptr, m3d_propertytypes[j].key, strlen(m3d_propertytypes[j].key))) {
-                                                n = m3d_propertytypes[j].id;
-                                                if (k != m3dpf_map) k = m3d_propertytypes[j].format;
-                                                break;
+                                if (M3D_CHUNKMAGIC(data, 'M', 'E', 'S', 'H')) {
+                                    M3D_LOG("Mesh data");
+                                    if (!model->vertex) { M3D_LOG("No vertex chunk before mesh"); model->errcode = M3D_ERR_VRTS; }
+                                    /* mesh */
+                                    data += sizeof(m3dchunk_t);
+                                    mi = M3D_UNDEF;
+#ifdef M3D_VERTEXMAX
+                                    pi = M3D_UNDEF;
+#endif
+                                    am = model->numface;
+                                    while (data < chunk) {
+                                        k = *data++;
+                                        n = k >> 4;
+                                        k &= 15;
+                                        if (!n) {
+                                            if (!k) {
+                                                /* use material */
+                                                mi = M3D_UNDEF;
+                                                M3D_GETSTR(name);
+                                                if (name) {
+                                                    for (j = 0; j < model->nummaterial; j++)
+                                                        if (!strcmp(name, model->material[j].name)) {
+                                                            mi = (M3D_INDEX)j;
+                                                            break;
+                                                        }
+                                                    if (mi == M3D_UNDEF) model->errcode = M3D_ERR_MTRL;
+                                                }
                                             }
-                                        if (n != 256 && k != 256) {
-                                            ptr = _m3d_findarg(ptr);
-                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                            j = m->numprop++;
-                                            m->prop = (m3dp_t*)M3D_REALLOC(m->prop, m->numprop * sizeof(m3dp_t));
-                                            if (!m->prop) goto memerr;
-                                            m->prop[j].type = n + (k == m3dpf_map && n < 128 ? 128 : 0);
-                                            switch (k) {
-                                            case m3dpf_color: ptr = _m3d_gethex(ptr, &m->prop[j].value.color); break;
-                                            case m3dpf_uint8:
-                                            case m3dpf_uint16:
-                                            case m3dpf_uint32: ptr = _m3d_getint(ptr, &m->prop[j].value.num); break;
-                                            case m3dpf_float:  ptr = _m3d_getfloat(ptr, &m->prop[j].value.fnum); break;
-                                            case m3dpf_map:
-                                                pe = _m3d_safestr(ptr, 0);
-                                                if (!pe || !*pe) goto asciiend;
-                                                m->prop[j].value.textureid = _m3d_gettx(model, readfilecb, freecb, pe);
-                                                if (model->errcode == M3D_ERR_ALLOC) { M3D_FREE(pe); goto memerr; }
-                                                /* this error code only returned if readfilecb was specified */
-                                                if (m->prop[j].value.textureid == M3D_UNDEF) {
-                                                    M3D_LOG("Texture not found");
-                                                    M3D_LOG(pe);
-                                                    m->numprop--;
+                                            else {
+                                                /* use parameter */
+                                                M3D_GETSTR(name);
+#ifdef M3D_VERTEXMAX
+                                                pi = M3D_UNDEF;
+                                                if (name) {
+                                                    for (j = 0; j < model->numparam; j++)
+                                                        if (!strcmp(name, model->param[j].name)) {
+                                                            pi = (M3D_INDEX)j;
+                                                            break;
+                                                        }
+                                                    if (pi == M3D_UNDEF) {
+                                                        pi = model->numparam++;
+                                                        model->param = (m3dvi_t*)M3D_REALLOC(model->param, model->numparam * sizeof(m3dvi_t));
+                                                        if (!model->param) goto memerr;
+                                                        model->param[pi].name = name;
+                                                        model->param[pi].count = 0;
+                                                    }
                                                 }
-                                                M3D_FREE(pe);
-                                                break;
+#endif
                                             }
+                                            continue;
                                         }
-                                        else {
-                                            M3D_LOG("Unknown material property in");
-                                            M3D_LOG(m->name);
-                                            model->errcode = M3D_ERR_UNKPROP;
+                                        if (n != 3) { M3D_LOG("Only triangle mesh supported for now"); model->errcode = M3D_ERR_UNKMESH; return M3D_CHUNK_ABORT; }
+                                        i = model->numface++;
+                                        if (model->numface > am) {
+                                            am = model->numface + 4095;
+                                            model->face = (m3df_t*)M3D_REALLOC(model->face, am * sizeof(m3df_t));
+                                            if (!model->face) goto memerr;
                                         }
-                                        ptr = _m3d_findnl(ptr);
+                                        memset(&model->face[i], 255, sizeof(m3df_t)); /* set all index to -1 by default */
+                                        model->face[i].materialid = mi;
+#ifdef M3D_VERTEXMAX
+                                        model->face[i].paramid = pi;
+#endif
+                                        for (j = 0; data < chunk && j < n; j++) {
+                                            /* vertex */
+                                            data = _m3d_getidx(data, model->vi_s, &model->face[i].vertex[j]);
+                                            /* texcoord */
+                                            if (k & 1)
+                                                data = _m3d_getidx(data, model->ti_s, &model->face[i].texcoord[j]);
+                                            /* normal */
+                                            if (k & 2)
+                                                data = _m3d_getidx(data, model->vi_s, &model->face[i].normal[j]);
+#ifndef M3D_NONORMALS
+                                            if (model->face[i].normal[j] == M3D_UNDEF) model->flags |= M3D_FLG_NEEDNORM;
+#endif
+                                            /* maximum */
+                                            if (k & 4)
+#ifdef M3D_VERTEXMAX
+                                                data = _m3d_getidx(data, model->vi_s, &model->face[i].vertmax[j]);
+#else
+                                                data += model->vi_s;
+#endif
+                                        }
+                                        if (j != n) { M3D_LOG("Invalid mesh"); model->numface = 0; model->errcode = M3D_ERR_UNKMESH; return M3D_CHUNK_ABORT; }
                                     }
-                                    if (!m->numprop) model->nummaterial--;
+                                    model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
                                 }
                                 else
-                                    /* procedural */
-                                    if (!memcmp(pe, "Procedural", 10)) {
-                                        pe = _m3d_safestr(ptr, 0);
-                                        _m3d_getpr(model, readfilecb, freecb, pe);
-                                        M3D_FREE(pe);
-                                        while (*ptr && *ptr != '\r' && *ptr != '\n') ptr = _m3d_findnl(ptr);
+                                    if (M3D_CHUNKMAGIC(data, 'V', 'O', 'X', 'T')) {
+                                        /* voxel types */
+                                        M3D_LOG("Voxel types list");
+                                        if (model->voxtype) { M3D_LOG("More voxel type chunks, should be unique"); model->errcode = M3D_ERR_VOXT; return M3D_CHUNK_NEXT; }
+                                        if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
+                                        reclen = model->ci_s + model->si_s + 3 + model->sk_s;
+                                        k = len / reclen;
+                                        model->voxtype = (m3dvt_t*)M3D_MALLOC(k * sizeof(m3dvt_t));
+                                        if (!model->voxtype) goto memerr;
+                                        memset(model->voxtype, 0, k * sizeof(m3dvt_t));
+                                        model->numvoxtype = 0;
+                                        for (i = 0, data += sizeof(m3dchunk_t); data < chunk && i < k; i++) {
+                                            switch (model->ci_s) {
+                                            case 1: model->voxtype[i].color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
+                                            case 2: model->voxtype[i].color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
+                                            case 4: model->voxtype[i].color = *((uint32_t*)data); data += 4; break;
+                                                /* case 8: break; */
+                                            }
+                                            M3D_GETSTR(name);
+                                            model->voxtype[i].materialid = M3D_UNDEF;
+                                            if (name) {
+                                                model->voxtype[i].name = name;
+                                                /*
+                                                                    for(j = 0; j < model->nummaterial; j++)
+                                                                        if(!strcmp(name, model->material[j].name)) {
+                                                                            model->voxtype[i].materialid = (M3D_INDEX)j;
+                                                                            break;
+                                                                        }
+                                                */
+                                            }
+                                            j = *data++;
+                                            model->voxtype[i].rotation = j & 0xBF;
+                                            model->voxtype[i].voxshape = ((j & 0x40) << 2) | *data++;
+                                            model->voxtype[i].numitem = *data++;
+                                            model->voxtype[i].skinid = M3D_UNDEF;
+                                            data = _m3d_getidx(data, model->sk_s, &model->voxtype[i].skinid);
+                                            if (model->voxtype[i].numitem) {
+                                                model->voxtype[i].item = (m3dvi_t*)M3D_MALLOC(model->voxtype[i].numitem * sizeof(m3dvi_t));
+                                                if (!model->voxtype[i].item) goto memerr;
+                                                memset(model->voxtype[i].item, 0, model->voxtype[i].numitem * sizeof(m3dvi_t));
+                                                for (j = 0; j < model->voxtype[i].numitem; j++) {
+                                                    model->voxtype[i].item[j].count = *data++;
+                                                    model->voxtype[i].item[j].count |= (*data++) << 8;
+                                                    M3D_GETSTR(model->voxtype[i].item[j].name);
+                                                }
+                                            }
+                                        }
+                                        model->numvoxtype = i;
+                                        if (k != model->numvoxtype) {
+                                            model->voxtype = (m3dvt_t*)M3D_REALLOC(model->voxtype, model->numvoxtype * sizeof(m3dvt_t));
+                                            if (!model->voxtype) goto memerr;
+                                        }
                                     }
                                     else
-                                        /* mesh */
-                                        if (!memcmp(pe, "Mesh", 4)) {
-                                            mi = M3D_UNDEF;
-#ifdef M3D_VERTEXMAX
-                                            pi = M3D_UNDEF;
-#endif
-                                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                if (*ptr == 'u') {
-                                                    ptr = _m3d_findarg(ptr);
-                                                    if (!*ptr) goto asciiend;
-                                                    mi = M3D_UNDEF;
-                                                    if (*ptr != '\r' && *ptr != '\n') {
-                                                        pe = _m3d_safestr(ptr, 0);
-                                                        if (!pe || !*pe) goto asciiend;
-                                                        for (j = 0; j < model->nummaterial; j++)
-                                                            if (!strcmp(pe, model->material[j].name)) { mi = (M3D_INDEX)j; break; }
-                                                        if (mi == M3D_UNDEF && !(model->flags & M3D_FLG_MTLLIB)) {
-                                                            mi = model->nummaterial++;
-                                                            model->material = (m3dm_t*)M3D_REALLOC(model->material, model->nummaterial * sizeof(m3dm_t));
-                                                            if (!model->material) goto memerr;
-                                                            model->material[mi].name = pe;
-                                                            model->material[mi].numprop = 1;
-                                                            model->material[mi].prop = NULL;
-                                                        }
-                                                        else
-                                                            M3D_FREE(pe);
-                                                    }
+                                        if (M3D_CHUNKMAGIC(data, 'V', 'O', 'X', 'D')) {
+                                            /* voxel data */
+                                            data += sizeof(m3dchunk_t);
+                                            M3D_GETSTR(name);
+                                            M3D_LOG("Voxel Data Layer");
+                                            M3D_LOG(name);
+                                            if (model->vd_s > 4 || model->vp_s > 2) { M3D_LOG("No voxel index size"); model->errcode = M3D_ERR_UNKVOX; return M3D_CHUNK_NEXT; }
+                                            if (!model->voxtype) { M3D_LOG("No voxel type chunk before voxel data"); model->errcode = M3D_ERR_VOXT; }
+                                            i = model->numvoxel++;
+                                            model->voxel = (m3dvx_t*)M3D_REALLOC(model->voxel, model->numvoxel * sizeof(m3dvx_t));
+                                            if (!model->voxel) goto memerr;
+                                            memset(&model->voxel[i], 0, sizeof(m3dvx_t));
+                                            model->voxel[i].name = name;
+                                            switch (model->vd_s) {
+                                            case 1:
+                                                model->voxel[i].x = (int32_t)((int8_t)data[0]);
+                                                model->voxel[i].y = (int32_t)((int8_t)data[1]);
+                                                model->voxel[i].z = (int32_t)((int8_t)data[2]);
+                                                model->voxel[i].w = (uint32_t)(data[3]);
+                                                model->voxel[i].h = (uint32_t)(data[4]);
+                                                model->voxel[i].d = (uint32_t)(data[5]);
+                                                data += 6;
+                                                break;
+                                            case 2:
+                                                model->voxel[i].x = (int32_t)(*((int16_t*)(data + 0)));
+                                                model->voxel[i].y = (int32_t)(*((int16_t*)(data + 2)));
+                                                model->voxel[i].z = (int32_t)(*((int16_t*)(data + 4)));
+                                                model->voxel[i].w = (uint32_t)(*((uint16_t*)(data + 6)));
+                                                model->voxel[i].h = (uint32_t)(*((uint16_t*)(data + 8)));
+                                                model->voxel[i].d = (uint32_t)(*((uint16_t*)(data + 10)));
+                                                data += 12;
+                                                break;
+                                            case 4:
+                                                model->voxel[i].x = *((int32_t*)(data + 0));
+                                                model->voxel[i].y = *((int32_t*)(data + 4));
+                                                model->voxel[i].z = *((int32_t*)(data + 8));
+                                                model->voxel[i].w = *((uint32_t*)(data + 12));
+                                                model->voxel[i].h = *((uint32_t*)(data + 16));
+                                                model->voxel[i].d = *((uint32_t*)(data + 20));
+                                                data += 24;
+                                                break;
+                                            }
+                                            model->voxel[i].uncertain = *data++;
+                                            model->voxel[i].groupid = *data++;
+                                            k = model->voxel[i].w * model->voxel[i].h * model->voxel[i].d;
+                                            model->voxel[i].data = (M3D_VOXEL*)M3D_MALLOC(k * sizeof(M3D_VOXEL));
+                                            if (!model->voxel[i].data) goto memerr;
+                                            memset(model->voxel[i].data, 0xff, k * sizeof(M3D_VOXEL));
+                                            for (j = 0; data < chunk && j < k;) {
+                                                l = ((*data++) & 0x7F) + 1;
+                                                if (data[-1] & 0x80) {
+                                                    data = _m3d_getidx(data, model->vp_s, &mi);
+                                                    while (l-- && j < k) model->voxel[i].data[j++] = (M3D_VOXEL)mi;
                                                 }
                                                 else
-                                                    if (*ptr == 'p') {
-                                                        ptr = _m3d_findarg(ptr);
-                                                        if (!*ptr) goto asciiend;
-#ifdef M3D_VERTEXMAX
-                                                        pi = M3D_UNDEF;
-                                                        if (*ptr != '\r' && *ptr != '\n') {
-                                                            pe = _m3d_safestr(ptr, 0);
-                                                            if (!pe || !*pe) goto asciiend;
-                                                            for (j = 0; j < model->numparam; j++)
-                                                                if (!strcmp(pe, model->param[j].name)) { pi = (M3D_INDEX)j; break; }
-                                                            if (pi == M3D_UNDEF) {
-                                                                pi = model->numparam++;
-                                                                model->param = (m3dvi_t*)M3D_REALLOC(model->param, model->numparam * sizeof(m3dvi_t));
-                                                                if (!model->param) goto memerr;
-                                                                model->param[pi].name = pe;
-                                                                model->param[pi].count = 0;
+                                                    while (l-- && j < k) {
+                                                        data = _m3d_getidx(data, model->vp_s, &mi);
+                                                        model->voxel[i].data[j++] = (M3D_VOXEL)mi;
+                                                    }
+                                            }
+                                        }
+                                        else
+                                            if (M3D_CHUNKMAGIC(data, 'S', 'H', 'P', 'E')) {
+                                                /* mathematical shape */
+                                                data += sizeof(m3dchunk_t);
+                                                M3D_GETSTR(name);
+                                                M3D_LOG("Mathematical Shape");
+                                                M3D_LOG(name);
+                                                i = model->numshape++;
+                                                model->shape = (m3dh_t*)M3D_REALLOC(model->shape, model->numshape * sizeof(m3dh_t));
+                                                if (!model->shape) goto memerr;
+                                                h = &model->shape[i];
+                                                h->numcmd = 0;
+                                                h->cmd = NULL;
+                                                h->name = name;
+                                                h->group = M3D_UNDEF;
+                                                data = _m3d_getidx(data, model->bi_s, &h->group);
+                                                if (h->group != M3D_UNDEF && h->group >= model->numbone) {
+                                                    M3D_LOG("Unknown bone id as shape group in shape");
+                                                    M3D_LOG(name);
+                                                    h->group = M3D_UNDEF;
+                                                    model->errcode = M3D_ERR_SHPE;
+                                                }
+                                                while (data < chunk) {
+                                                    i = h->numcmd++;
+                                                    h->cmd = (m3dc_t*)M3D_REALLOC(h->cmd, h->numcmd * sizeof(m3dc_t));
+                                                    if (!h->cmd) goto memerr;
+                                                    h->cmd[i].type = *data++;
+                                                    if (h->cmd[i].type & 0x80) {
+                                                        h->cmd[i].type &= 0x7F;
+                                                        h->cmd[i].type |= (*data++ << 7);
+                                                    }
+                                                    if (h->cmd[i].type >= (unsigned int)(sizeof(m3d_commandtypes) / sizeof(m3d_commandtypes[0]))) {
+                                                        M3D_LOG("Unknown shape command in");
+                                                        M3D_LOG(h->name);
+                                                        model->errcode = M3D_ERR_UNKCMD;
+                                                        break;
+                                                    }
+                                                    cd = &m3d_commandtypes[h->cmd[i].type];
+                                                    h->cmd[i].arg = (uint32_t*)M3D_MALLOC(cd->p * sizeof(uint32_t));
+                                                    if (!h->cmd[i].arg) goto memerr;
+                                                    memset(h->cmd[i].arg, 0, cd->p * sizeof(uint32_t));
+                                                    for (k = n = 0, l = cd->p; k < l; k++)
+                                                        switch (cd->a[((k - n) % (cd->p - n)) + n]) {
+                                                        case m3dcp_mi_t:
+                                                            h->cmd[i].arg[k] = M3D_NOTDEFINED;
+                                                            M3D_GETSTR(name);
+                                                            if (name) {
+                                                                for (n = 0; n < model->nummaterial; n++)
+                                                                    if (!strcmp(name, model->material[n].name)) {
+                                                                        h->cmd[i].arg[k] = n;
+                                                                        break;
+                                                                    }
+                                                                if (h->cmd[i].arg[k] == M3D_NOTDEFINED) model->errcode = M3D_ERR_MTRL;
                                                             }
-                                                            else
-                                                                M3D_FREE(pe);
+                                                            break;
+                                                        case m3dcp_vc_t:
+                                                            f = 0.0f;
+                                                            switch (model->vc_s) {
+                                                            case 1: f = (float)((int8_t)data[0]) / 127; break;
+                                                            case 2: f = (float)(*((int16_t*)(data + 0))) / 32767; break;
+                                                            case 4: f = (float)(*((float*)(data + 0))); break;
+                                                            case 8: f = (float)(*((double*)(data + 0))); break;
+                                                            }
+                                                            memcpy(&h->cmd[i].arg[k], &f, 4);
+                                                            data += model->vc_s;
+                                                            break;
+                                                        case m3dcp_hi_t: data = _m3d_getidx(data, model->hi_s, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_fi_t: data = _m3d_getidx(data, model->fi_s, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_ti_t: data = _m3d_getidx(data, model->ti_s, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_qi_t:
+                                                        case m3dcp_vi_t: data = _m3d_getidx(data, model->vi_s, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_i1_t: data = _m3d_getidx(data, 1, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_i2_t: data = _m3d_getidx(data, 2, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_i4_t: data = _m3d_getidx(data, 4, &h->cmd[i].arg[k]); break;
+                                                        case m3dcp_va_t: data = _m3d_getidx(data, 4, &h->cmd[i].arg[k]);
+                                                            n = k + 1; l += (h->cmd[i].arg[k] - 1) * (cd->p - k - 1);
+                                                            h->cmd[i].arg = (uint32_t*)M3D_REALLOC(h->cmd[i].arg, l * sizeof(uint32_t));
+                                                            if (!h->cmd[i].arg) goto memerr;
+                                                            memset(&h->cmd[i].arg[k + 1], 0, (l - k - 1) * sizeof(uint32_t));
+                                                            break;
                                                         }
-#endif
-                                                    }
-                                                    else {
-                                                        i = model->numface++;
-                                                        model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
-                                                        if (!model->face) goto memerr;
-                                                        memset(&model->face[i], 255, sizeof(m3df_t)); /* set all index to -1 by default */
-                                                        model->face[i].materialid = mi;
-#ifdef M3D_VERTEXMAX
-                                                        model->face[i].paramid = pi;
-#endif
-                                                        /* hardcoded triangles. */
-                                                        for (j = 0; j < 3; j++) {
-                                                            /* vertex */
-                                                            ptr = _m3d_getint(ptr, &k);
-                                                            model->face[i].vertex[j] = (M3D_INDEX)k;
-                                                            if (!*ptr) goto asciiend;
-                                                            if (*ptr == '/') {
-                                                                ptr++;
-                                                                if (*ptr != '/') {
-                                                                    /* texcoord */
-                                                                    ptr = _m3d_getint(ptr, &k);
-                                                                    model->face[i].texcoord[j] = (M3D_INDEX)k;
-                                                                    if (!*ptr) goto asciiend;
-                                                                }
-                                                                if (*ptr == '/') {
-                                                                    ptr++;
-                                                                    /* normal */
-                                                                    ptr = _m3d_getint(ptr, &k);
-                                                                    model->face[i].normal[j] = (M3D_INDEX)k;
-                                                                    if (!*ptr) goto asciiend;
-                                                                }
-                                                                if (*ptr == '/') {
-                                                                    ptr++;
-                                                                    /* maximum */
-                                                                    ptr = _m3d_getint(ptr, &k);
-#ifdef M3D_VERTEXMAX
-                                                                    model->face[i].vertmax[j] = (M3D_INDEX)k;
-#endif
-                                                                    if (!*ptr) goto asciiend;
-                                                                }
-                                                            }
-#ifndef M3D_NONORMALS
-                                                            if (model->face[i].normal[j] == M3D_UNDEF) neednorm = 1;
-#endif
-                                                            ptr = _m3d_findarg(ptr);
-                                                        }
-                                                    }
-                                                ptr = _m3d_findnl(ptr);
-                                            }
-                                        }
-                                        else
-                                            /* voxel types chunk */
-                                            if (!memcmp(pe, "VoxTypes", 8) || !memcmp(pe, "Voxtypes", 8)) {
-                                                if (model->voxtype) { M3D_LOG("More voxel types chunks, should be unique"); goto asciiend; }
-                                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                    i = model->numvoxtype++;
-                                                    model->voxtype = (m3dvt_t*)M3D_REALLOC(model->voxtype, model->numvoxtype * sizeof(m3dvt_t));
-                                                    if (!model->voxtype) goto memerr;
-                                                    memset(&model->voxtype[i], 0, sizeof(m3dvt_t));
-                                                    model->voxtype[i].materialid = M3D_UNDEF;
-                                                    model->voxtype[i].skinid = M3D_UNDEF;
-                                                    ptr = _m3d_gethex(ptr, &model->voxtype[i].color);
-                                                    if (!*ptr) goto asciiend;
-                                                    if (*ptr == '/') {
-                                                        ptr = _m3d_gethex(ptr, &k);
-                                                        model->voxtype[i].rotation = k;
-                                                        if (!*ptr) goto asciiend;
-                                                        if (*ptr == '/') {
-                                                            ptr = _m3d_gethex(ptr, &k);
-                                                            model->voxtype[i].voxshape = k;
-                                                            if (!*ptr) goto asciiend;
-                                                        }
-                                                    }
-                                                    while (*ptr == ' ' || *ptr == '\t') ptr++;
-                                                    if (*ptr == '\r' || *ptr == '\n') { ptr = _m3d_findnl(ptr); continue; }
-                                                    /* name */
-                                                    if (*ptr != '-') {
-                                                        pe = _m3d_safestr(ptr, 0);
-                                                        if (!pe || !*pe) goto asciiend;
-                                                        model->voxtype[i].name = pe;
-                                                        for (j = 0; j < model->nummaterial; j++)
-                                                            if (!strcmp(pe, model->material[j].name)) { model->voxtype[i].materialid = (M3D_INDEX)j; break; }
-                                                    }
-                                                    ptr = _m3d_findarg(ptr);
-                                                    /* parse skin */
-                                                    memset(&s, 0, sizeof(m3ds_t));
-                                                    for (j = 0, w = (M3D_FLOAT)0.0; j < M3D_NUMBONE && *ptr && *ptr != '{' && *ptr != '\r' && *ptr != '\n'; j++) {
-                                                        ptr = _m3d_getint(ptr, &k);
-                                                        s.boneid[j] = (M3D_INDEX)k;
-                                                        if (*ptr == ':') {
-                                                            ptr++;
-                                                            ptr = _m3d_getfloat(ptr, &s.weight[j]);
-                                                            w += s.weight[j];
-                                                        }
-                                                        else if (!j)
-                                                            s.weight[j] = (M3D_FLOAT)1.0;
-                                                        if (!*ptr) goto asciiend;
-                                                        ptr = _m3d_findarg(ptr);
-                                                    }
-                                                    if (s.boneid[0] != M3D_UNDEF && s.weight[0] > (M3D_FLOAT)0.0) {
-                                                        if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0)
-                                                            for (j = 0; j < M3D_NUMBONE && s.weight[j] >(M3D_FLOAT)0.0; j++)
-                                                                s.weight[j] /= w;
-                                                        k = M3D_NOTDEFINED;
-                                                        if (model->skin) {
-                                                            for (j = 0; j < model->numskin; j++)
-                                                                if (!memcmp(&model->skin[j], &s, sizeof(m3ds_t))) { k = j; break; }
-                                                        }
-                                                        if (k == M3D_NOTDEFINED) {
-                                                            k = model->numskin++;
-                                                            model->skin = (m3ds_t*)M3D_REALLOC(model->skin, model->numskin * sizeof(m3ds_t));
-                                                            if (!model->skin) goto memerr;
-                                                            memcpy(&model->skin[k], &s, sizeof(m3ds_t));
-                                                        }
-                                                        model->voxtype[i].skinid = (M3D_INDEX)k;
-                                                    }
-                                                    /* parse item list */
-                                                    if (*ptr == '{') {
-                                                        while (*ptr == '{' || *ptr == ' ' || *ptr == '\t') ptr++;
-                                                        while (*ptr && *ptr != '}' && *ptr != '\r' && *ptr != '\n') {
-                                                            ptr = _m3d_getint(ptr, &k);
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '}' || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            pe = _m3d_safestr(ptr, 0);
-                                                            if (!pe || !*pe) goto asciiend;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            j = model->voxtype[i].numitem++;
-                                                            model->voxtype[i].item = (m3dvi_t*)M3D_REALLOC(model->voxtype[i].item,
-                                                                model->voxtype[i].numitem * sizeof(m3dvi_t));
-                                                            if (!model->voxtype[i].item) goto memerr;
-                                                            model->voxtype[i].item[j].count = k;
-                                                            model->voxtype[i].item[j].name = pe;
-                                                        }
-                                                        if (*ptr != '}') goto asciiend;
-                                                    }
-                                                    ptr = _m3d_findnl(ptr);
                                                 }
                                             }
                                             else
-                                                /* voxel data */
-                                                if (!memcmp(pe, "Voxel", 5)) {
-                                                    if (!model->voxtype) { M3D_LOG("No voxel type chunk before voxel data"); goto asciiend; }
-                                                    pe = _m3d_findarg(pe);
-                                                    if (!*pe) goto asciiend;
-                                                    if (*pe == '\r' || *pe == '\n') pe = NULL;
-                                                    else pe = _m3d_safestr(pe, 0);
-                                                    i = model->numvoxel++;
-                                                    model->voxel = (m3dvx_t*)M3D_REALLOC(model->voxel, model->numvoxel * sizeof(m3dvx_t));
-                                                    if (!model->voxel) goto memerr;
-                                                    memset(&model->voxel[i], 0, sizeof(m3dvx_t));
-                                                    model->voxel[i].name = pe;
-                                                    k = l = 0;
-                                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                        switch (*ptr) {
-                                                        case 'u':
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].uncertain = ((n > 0 && n < 256 ? n : 0) * 255) / 100;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                                ptr = _m3d_getint(ptr, &n);
-                                                                model->voxel[i].groupid = n > 0 && n < 256 ? n : 0;
-                                                            }
-                                                            break;
-                                                        case 'p':
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].x = n;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].y = n;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].z = n;
-                                                            break;
-                                                        case 'd':
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].w = n;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].h = n;
-                                                            ptr = _m3d_findarg(ptr);
-                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                            ptr = _m3d_getint(ptr, &n);
-                                                            model->voxel[i].d = n;
-                                                            break;
-                                                        case 'l':
-                                                            if (model->voxel[i].data) { l++; k = 0; }
-                                                            else {
-                                                                if (!model->voxel[i].w || !model->voxel[i].h || !model->voxel[i].d) {
-                                                                    M3D_LOG("No voxel dimension before layer data");
-                                                                    goto asciiend;
-                                                                }
-                                                                model->voxel[i].data = (M3D_VOXEL*)M3D_MALLOC(
-                                                                    model->voxel[i].w * model->voxel[i].h * model->voxel[i].d * sizeof(M3D_VOXEL));
-                                                                if (!model->voxel[i].data) goto memerr;
-                                                            }
-                                                            break;
-                                                        default:
-                                                            if (!model->voxel[i].data || l >= model->voxel[i].h || k >= model->voxel[i].d) {
-                                                                M3D_LOG("Missing voxel attributes or out of bound data");
-                                                                goto asciiend;
-                                                            }
-                                                            for (n = l * model->voxel[i].w * model->voxel[i].d + k * model->voxel[i].w;
-                                                                j < model->voxel[i].w && *ptr && *ptr != '\r' && *ptr != '\n'; j++) {
-                                                                ptr = _m3d_getint(ptr, &am);
-                                                                if (am >= model->numvoxtype) goto asciiend;
-                                                                model->voxel[i].data[n + j] = am;
-                                                            }
-                                                            k++;
-                                                            break;
-                                                        }
-                                                        ptr = _m3d_findnl(ptr);
+                                                /* annotation label list */
+                                                if (M3D_CHUNKMAGIC(data, 'L', 'B', 'L', 'S')) {
+                                                    data += sizeof(m3dchunk_t);
+                                                    M3D_GETSTR(name);
+                                                    M3D_GETSTR(lang);
+                                                    M3D_LOG("Label list");
+                                                    if (name) { M3D_LOG(name); }
+                                                    if (lang) { M3D_LOG(lang); }
+                                                    if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
+                                                    k = 0;
+                                                    switch (model->ci_s) {
+                                                    case 1: k = model->cmap ? model->cmap[data[0]] : 0; data++; break;
+                                                    case 2: k = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
+                                                    case 4: k = *((uint32_t*)data); data += 4; break;
+                                                        /* case 8: break; */
+                                                    }
+                                                    reclen = model->vi_s + model->si_s;
+                                                    i = model->numlabel; model->numlabel += len / reclen;
+                                                    model->label = (m3dl_t*)M3D_REALLOC(model->label, model->numlabel * sizeof(m3dl_t));
+                                                    if (!model->label) goto memerr;
+                                                    memset(&model->label[i], 0, (model->numlabel - i) * sizeof(m3dl_t));
+                                                    for (; data < chunk && i < model->numlabel; i++) {
+                                                        model->label[i].name = name;
+                                                        model->label[i].lang = lang;
+                                                        model->label[i].color = k;
+                                                        data = _m3d_getidx(data, model->vi_s, &model->label[i].vertexid);
+                                                        M3D_GETSTR(model->label[i].text);
                                                     }
                                                 }
                                                 else
-                                                    /* mathematical shape */
-                                                    if (!memcmp(pe, "Shape", 5)) {
-                                                        pe = _m3d_findarg(pe);
-                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                        pe = _m3d_safestr(pe, 0);
-                                                        if (!pe || !*pe) goto asciiend;
-                                                        i = model->numshape++;
-                                                        model->shape = (m3dh_t*)M3D_REALLOC(model->shape, model->numshape * sizeof(m3ds_t));
-                                                        if (!model->shape) goto memerr;
-                                                        h = &model->shape[i];
-                                                        h->name = pe;
-                                                        h->group = M3D_UNDEF;
-                                                        h->numcmd = 0;
-                                                        h->cmd = NULL;
-                                                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                            if (!memcmp(ptr, "group", 5)) {
-                                                                ptr = _m3d_findarg(ptr);
-                                                                ptr = _m3d_getint(ptr, &h->group);
-                                                                ptr = _m3d_findnl(ptr);
-                                                                if (h->group != M3D_UNDEF && h->group >= model->numbone) {
-                                                                    M3D_LOG("Unknown bone id as shape group in shape");
-                                                                    M3D_LOG(pe);
-                                                                    h->group = M3D_UNDEF;
-                                                                    model->errcode = M3D_ERR_SHPE;
-                                                                }
-                                                                continue;
-                                                            }
-                                                            for (cd = NULL, k = 0; k < (unsigned int)(sizeof(m3d_commandtypes) / sizeof(m3d_commandtypes[0])); k++) {
-                                                                j = (unsigned int)strlen(m3d_commandtypes[k].key);
-                                                                if (!memcmp(ptr, m3d_commandtypes[k].key, j) && (ptr[j] == ' ' || ptr[j] == '\r' || ptr[j] == '\n'))
-                                                                {
-                                                                    cd = &m3d_commandtypes[k]; break;
+                                                    /* action */
+                                                    if (M3D_CHUNKMAGIC(data, 'A', 'C', 'T', 'N')) {
+                                                        M3D_LOG("Action");
+                                                        i = model->numaction++;
+                                                        model->action = (m3da_t*)M3D_REALLOC(model->action, model->numaction * sizeof(m3da_t));
+                                                        if (!model->action) goto memerr;
+                                                        a = &model->action[i];
+                                                        data += sizeof(m3dchunk_t);
+                                                        M3D_GETSTR(a->name);
+                                                        M3D_LOG(a->name);
+                                                        a->numframe = *((uint16_t*)data); data += 2;
+                                                        if (a->numframe < 1) {
+                                                            model->numaction--;
+                                                        }
+                                                        else {
+                                                            a->durationmsec = *((uint32_t*)data); data += 4;
+                                                            a->frame = (m3dfr_t*)M3D_MALLOC(a->numframe * sizeof(m3dfr_t));
+                                                            if (!a->frame) goto memerr;
+                                                            for (i = 0; data < chunk && i < a->numframe; i++) {
+                                                                a->frame[i].msec = *((uint32_t*)data); data += 4;
+                                                                a->frame[i].numtransform = 0; a->frame[i].transform = NULL;
+                                                                data = _m3d_getidx(data, model->fc_s, &a->frame[i].numtransform);
+                                                                if (a->frame[i].numtransform > 0) {
+                                                                    a->frame[i].transform = (m3dtr_t*)M3D_MALLOC(a->frame[i].numtransform * sizeof(m3dtr_t));
+                                                                    for (j = 0; j < a->frame[i].numtransform; j++) {
+                                                                        data = _m3d_getidx(data, model->bi_s, &a->frame[i].transform[j].boneid);
+                                                                        data = _m3d_getidx(data, model->vi_s, &a->frame[i].transform[j].pos);
+                                                                        data = _m3d_getidx(data, model->vi_s, &a->frame[i].transform[j].ori);
+                                                                    }
                                                                 }
                                                             }
-                                                            if (cd) {
-                                                                j = h->numcmd++;
-                                                                h->cmd = (m3dc_t*)M3D_REALLOC(h->cmd, h->numcmd * sizeof(m3dc_t));
-                                                                if (!h->cmd) goto memerr;
-                                                                h->cmd[j].type = k;
-                                                                h->cmd[j].arg = (uint32_t*)M3D_MALLOC(cd->p * sizeof(uint32_t));
-                                                                if (!h->cmd[j].arg) goto memerr;
-                                                                memset(h->cmd[j].arg, 0, cd->p * sizeof(uint32_t));
-                                                                for (k = n = 0, l = cd->p; k < l; k++) {
-                                                                    ptr = _m3d_findarg(ptr);
-                                                                    if (!*ptr) goto asciiend;
-                                                                    if (*ptr == '[') {
-                                                                        ptr = _m3d_findarg(ptr + 1);
-                                                                        if (!*ptr) goto asciiend;
-                                                                    }
-                                                                    if (*ptr == ']' || *ptr == '\r' || *ptr == '\n') break;
-                                                                    switch (cd->a[((k - n) % (cd->p - n)) + n]) {
-                                                                    case m3dcp_mi_t:
-                                                                        mi = M3D_UNDEF;
-                                                                        if (*ptr != '\r' && *ptr != '\n') {
-                                                                            pe = _m3d_safestr(ptr, 0);
-                                                                            if (!pe || !*pe) goto asciiend;
-                                                                            for (n = 0; n < model->nummaterial; n++)
-                                                                                if (!strcmp(pe, model->material[n].name)) { mi = (M3D_INDEX)n; break; }
-                                                                            if (mi == M3D_UNDEF && !(model->flags & M3D_FLG_MTLLIB)) {
-                                                                                mi = model->nummaterial++;
-                                                                                model->material = (m3dm_t*)M3D_REALLOC(model->material,
-                                                                                    model->nummaterial * sizeof(m3dm_t));
-                                                                                if (!model->material) goto memerr;
-                                                                                model->material[mi].name = pe;
-                                                                                model->material[mi].numprop = 1;
-                                                                                model->material[mi].prop = NULL;
-                                                                            }
-                                                                            else
-                                                                                M3D_FREE(pe);
-                                                                        }
-                                                                        h->cmd[j].arg[k] = mi;
-                                                                        break;
-                                                                    case m3dcp_vc_t:
-#ifdef M3D_DOUBLE
-                                                                        _m3d_getfloat(ptr, &w); f = w;
-                                                                        memcpy(&h->cmd[j].arg[k], &f, 4);
-#else
-                                                                        _m3d_getfloat(ptr, (float*)&h->cmd[j].arg[k]);
-#endif
-                                                                        break;
-                                                                    case m3dcp_va_t:
-                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
-                                                                        n = k + 1; l += (h->cmd[j].arg[k] - 1) * (cd->p - k - 1);
-                                                                        h->cmd[j].arg = (uint32_t*)M3D_REALLOC(h->cmd[j].arg, l * sizeof(uint32_t));
-                                                                        if (!h->cmd[j].arg) goto memerr;
-                                                                        memset(&h->cmd[j].arg[k + 1], 0, (l - k - 1) * sizeof(uint32_t));
-                                                                        break;
-                                                                    case m3dcp_qi_t:
-                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
-                                                                        model->vertex[h->cmd[i].arg[k]].skinid = M3D_INDEXMAX;
-                                                                        break;
-                                                                    default:
-                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
-                                                                        break;
-                                                                    }
-                                                                }
-                                                            }
-                                                            else {
-                                                                M3D_LOG("Unknown shape command in");
-                                                                M3D_LOG(h->name);
-                                                                model->errcode = M3D_ERR_UNKCMD;
-                                                            }
-                                                            ptr = _m3d_findnl(ptr);
                                                         }
-                                                        if (!h->numcmd) model->numshape--;
                                                     }
-                                                    else
-                                                        /* annotation labels */
-                                                        if (!memcmp(pe, "Labels", 6)) {
-                                                            pe = _m3d_findarg(pe);
-                                                            if (!*pe) goto asciiend;
-                                                            if (*pe == '\r' || *pe == '\n') pe = NULL;
-                                                            else pe = _m3d_safestr(pe, 0);
-                                                            k = 0; fn = NULL;
-                                                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                                if (*ptr == 'c') {
-                                                                    ptr = _m3d_findarg(ptr);
-                                                                    if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                    ptr = _m3d_gethex(ptr, &k);
-                                                                }
-                                                                else
-                                                                    if (*ptr == 'l') {
-                                                                        ptr = _m3d_findarg(ptr);
-                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                        fn = _m3d_safestr(ptr, 2);
-                                                                    }
-                                                                    else {
-                                                                        i = model->numlabel++;
-                                                                        model->label = (m3dl_t*)M3D_REALLOC(model->label, model->numlabel * sizeof(m3dl_t));
-                                                                        if (!model->label) goto memerr;
-                                                                        model->label[i].name = pe;
-                                                                        model->label[i].lang = fn;
-                                                                        model->label[i].color = k;
-                                                                        ptr = _m3d_getint(ptr, &j);
-                                                                        model->label[i].vertexid = (M3D_INDEX)j;
-                                                                        ptr = _m3d_findarg(ptr);
-                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                        model->label[i].text = _m3d_safestr(ptr, 2);
-                                                                    }
-                                                                ptr = _m3d_findnl(ptr);
-                                                            }
-                                                        }
-                                                        else
-                                                            /* action */
-                                                            if (!memcmp(pe, "Action", 6)) {
-                                                                pe = _m3d_findarg(pe);
-                                                                if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                pe = _m3d_getint(pe, &k);
-                                                                pe = _m3d_findarg(pe);
-                                                                if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                pe = _m3d_safestr(pe, 0);
-                                                                if (!pe || !*pe) goto asciiend;
-                                                                i = model->numaction++;
-                                                                model->action = (m3da_t*)M3D_REALLOC(model->action, model->numaction * sizeof(m3da_t));
-                                                                if (!model->action) goto memerr;
-                                                                a = &model->action[i];
-                                                                a->name = pe;
-                                                                a->durationmsec = k;
-                                                                /* skip the first frame marker as there's always at least one frame */
-                                                                a->numframe = 1;
-                                                                a->frame = (m3dfr_t*)M3D_MALLOC(sizeof(m3dfr_t));
-                                                                if (!a->frame) goto memerr;
-                                                                a->frame[0].msec = 0;
-                                                                a->frame[0].numtransform = 0;
-                                                                a->frame[0].transform = NULL;
-                                                                i = 0;
-                                                                if (*ptr == 'f')
-                                                                    ptr = _m3d_findnl(ptr);
-                                                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                                    if (*ptr == 'f') {
-                                                                        i = a->numframe++;
-                                                                        a->frame = (m3dfr_t*)M3D_REALLOC(a->frame, a->numframe * sizeof(m3dfr_t));
-                                                                        if (!a->frame) goto memerr;
-                                                                        ptr = _m3d_findarg(ptr);
-                                                                        ptr = _m3d_getint(ptr, &a->frame[i].msec);
-                                                                        a->frame[i].numtransform = 0;
-                                                                        a->frame[i].transform = NULL;
-                                                                    }
-                                                                    else {
-                                                                        j = a->frame[i].numtransform++;
-                                                                        a->frame[i].transform = (m3dtr_t*)M3D_REALLOC(a->frame[i].transform,
-                                                                            a->frame[i].numtransform * sizeof(m3dtr_t));
-                                                                        if (!a->frame[i].transform) goto memerr;
-                                                                        ptr = _m3d_getint(ptr, &k);
-                                                                        ptr = _m3d_findarg(ptr);
-                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                                        a->frame[i].transform[j].boneid = (M3D_INDEX)k;
-                                                                        ptr = _m3d_getint(ptr, &k);
-                                                                        ptr = _m3d_findarg(ptr);
-                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                                        a->frame[i].transform[j].pos = (M3D_INDEX)k;
-                                                                        ptr = _m3d_getint(ptr, &k);
-                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
-                                                                        a->frame[i].transform[j].ori = (M3D_INDEX)k;
-                                                                        model->vertex[k].skinid = M3D_INDEXMAX;
-                                                                    }
-                                                                    ptr = _m3d_findnl(ptr);
-                                                                }
-                                                            }
-                                                            else
-                                                                /* inlined assets chunk */
-                                                                if (!memcmp(pe, "Assets", 6)) {
-                                                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                                        if (readfilecb) {
-                                                                            pe = _m3d_safestr(ptr, 2);
-                                                                            if (!pe || !*pe) goto asciiend;
-                                                                            i = model->numinlined++;
-                                                                            model->inlined = (m3di_t*)M3D_REALLOC(model->inlined, model->numinlined * sizeof(m3di_t));
-                                                                            if (!model->inlined) goto memerr;
-                                                                            t = &model->inlined[i];
-                                                                            model->inlined[i].data = (*readfilecb)(pe, &model->inlined[i].length);
-                                                                            if (model->inlined[i].data) {
-                                                                                fn = strrchr(pe, '.');
-                                                                                if (fn && (fn[1] == 'p' || fn[1] == 'P') && (fn[2] == 'n' || fn[2] == 'N') &&
-                                                                                    (fn[3] == 'g' || fn[3] == 'G')) *fn = 0;
-                                                                                fn = strrchr(pe, '/');
-                                                                                if (!fn) fn = strrchr(pe, '\\');
-                                                                                if (!fn) fn = pe; else fn++;
-                                                                                model->inlined[i].name = _m3d_safestr(fn, 0);
-                                                                            }
-                                                                            else
-                                                                                model->numinlined--;
-                                                                            M3D_FREE(pe);
-                                                                        }
-                                                                        ptr = _m3d_findnl(ptr);
-                                                                    }
-                                                                }
-                                                                else
-                                                                    /* extra chunks */
-                                                                    if (!memcmp(pe, "Extra", 5)) {
-                                                                        pe = _m3d_findarg(pe);
-                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
-                                                                        buff = (unsigned char*)_m3d_findnl(ptr);
-                                                                        k = ((uint32_t)((uintptr_t)buff - (uintptr_t)ptr) / 3) + 1;
-                                                                        i = model->numextra++;
-                                                                        model->extra = (m3dchunk_t**)M3D_REALLOC(model->extra, model->numextra * sizeof(m3dchunk_t*));
-                                                                        if (!model->extra) goto memerr;
-                                                                        model->extra[i] = (m3dchunk_t*)M3D_MALLOC(k + sizeof(m3dchunk_t));
-                                                                        if (!model->extra[i]) goto memerr;
-                                                                        memcpy(&model->extra[i]->magic, pe, 4);
-                                                                        model->extra[i]->length = sizeof(m3dchunk_t);
-                                                                        pe = (char*)model->extra[i] + sizeof(m3dchunk_t);
-                                                                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
-                                                                            ptr = _m3d_gethex(ptr, &k);
-                                                                            *pe++ = (uint8_t)k;
-                                                                            model->extra[i]->length++;
-                                                                        }
-                                                                    }
-                                                                    else
-                                                                        goto asciiend;
+                                                    else {
+                                                        i = model->numextra++;
+                                                        model->extra = (m3dchunk_t**)M3D_REALLOC(model->extra, model->numextra * sizeof(m3dchunk_t*));
+                                                        if (!model->extra) goto memerr;
+                                                        model->extra[i] = (m3dchunk_t*)data;
+                                                        return M3D_CHUNK_KEEP;
+                                                    }
+        return M3D_CHUNK_NEXT;
+    memerr:
+        M3D_LOG("Out of memory");
+        model->errcode = M3D_ERR_ALLOC;
+        return M3D_CHUNK_ABORT;
+    }
+
+    /* calculate normals, normalize skin weights, create bone/vertex cross-references and calculate transform matrices */
+    static m3d_t* _m3d_postprocess(m3d_t* model)
+    {
+        unsigned int i, j, k, l, n, am, len, reclen;
+#ifndef M3D_NOVOXELS
+        int32_t min_x, min_y, min_z, max_x, max_y, max_z, sx, sy, sz, x, y, z;
+        M3D_INDEX edge[8], enorm;
+#endif
+        M3D_FLOAT w;
+#ifndef M3D_NONORMALS
+        char neednorm = (model->flags & M3D_FLG_NEEDNORM) != 0;
+        m3dv_t* norm = NULL, * v0, * v1, * v2, va, vb;
+#endif
+#ifndef M3D_NOANIMATION
+        M3D_FLOAT r[16];
+#endif
+#if !defined(M3D_NOWEIGHTS) || !defined(M3D_NOANIMATION)
+        m3db_t* b;
+#endif
+#ifndef M3D_NOWEIGHTS
+        m3ds_t* sk;
+#endif
+#ifdef M3D_PROFILING
+        struct timeval tv0, tv1, tvd;
+        gettimeofday(&tv1, NULL);
+#endif
+
+        model->flags &= ~M3D_FLG_NEEDNORM;
+        M3D_LOG("Post-process");
+#ifndef M3D_NOVOXELS
+        if (model->numvoxel && model->voxel) {
+            M3D_LOG("Converting voxels into vertices and mesh");
+            /* add normals */
+            enorm = model->numvertex; model->numvertex += 6;
+            model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
+            if (!model->vertex) goto memerr;
+            memset(&model->vertex[enorm], 0, 6 * sizeof(m3dv_t));
+            for (l = 0; l < 6; l++)
+                model->vertex[enorm + l].skinid = M3D_UNDEF;
+            model->vertex[enorm + 0].y = (M3D_FLOAT)-1.0;
+            model->vertex[enorm + 1].z = (M3D_FLOAT)-1.0;
+            model->vertex[enorm + 2].x = (M3D_FLOAT)-1.0;
+            model->vertex[enorm + 3].y = (M3D_FLOAT)1.0;
+            model->vertex[enorm + 4].z = (M3D_FLOAT)1.0;
+            model->vertex[enorm + 5].x = (M3D_FLOAT)1.0;
+            /* this is a fast, not so memory efficient version, only basic face culling used */
+            min_x = min_y = min_z = 2147483647L;
+            max_x = max_y = max_z = -2147483647L;
+            for (i = 0; i < model->numvoxel; i++) {
+                if (model->voxel[i].x + (int32_t)model->voxel[i].w > max_x) max_x = model->voxel[i].x + (int32_t)model->voxel[i].w;
+                if (model->voxel[i].x < min_x) min_x = model->voxel[i].x;
+                if (model->voxel[i].y + (int32_t)model->voxel[i].h > max_y) max_y = model->voxel[i].y + (int32_t)model->voxel[i].h;
+                if (model->voxel[i].y < min_y) min_y = model->voxel[i].y;
+                if (model->voxel[i].z + (int32_t)model->voxel[i].d > max_z) max_z = model->voxel[i].z + (int32_t)model->voxel[i].d;
+                if (model->voxel[i].z < min_z) min_z = model->voxel[i].z;
+            }
+            i = (-min_x > max_x ? -min_x : max_x);
+            j = (-min_y > max_y ? -min_y : max_y);
+            k = (-min_z > max_z ? -min_z : max_z);
+            if (j > i) i = j;
+            if (k > i) i = k;
+            if (i <= 1) i = 1;
+            w = (M3D_FLOAT)1.0 / (M3D_FLOAT)i;
+            if (i >= 254) model->vc_s = 2;
+            if (i >= 65534) model->vc_s = 4;
+            for (i = 0; i < model->numvoxel; i++) {
+                sx = model->voxel[i].w; sz = model->voxel[i].d; sy = model->voxel[i].h;
+                for (y = 0, j = 0; y < sy; y++)
+                    for (z = 0; z < sz; z++)
+                        for (x = 0; x < sx; x++, j++)
+                            if (model->voxel[i].data[j] < model->numvoxtype) {
+                                k = 0;
+                                /*  16__32     ____
+                                 *  /|  /|    /|2 /|
+                                 *64_128 |   /_8_/ 32
+                                 * | 1_|_2   |4|_|_|
+                                 * |/  |/    |/ 1|/
+                                 * 4___8     |16_|    */
+                                k = n = am = 0;
+                                if (!y || model->voxel[i].data[j - sx * sz] >= model->numvoxtype) { n++; am |= 1; k |= 1 | 2 | 4 | 8; }
+                                if (!z || model->voxel[i].data[j - sx] >= model->numvoxtype) { n++; am |= 2; k |= 1 | 2 | 16 | 32; }
+                                if (!x || model->voxel[i].data[j - 1] >= model->numvoxtype) { n++; am |= 4; k |= 1 | 4 | 16 | 64; }
+                                if (y == sy - 1 || model->voxel[i].data[j + sx * sz] >= model->numvoxtype) { n++; am |= 8; k |= 16 | 32 | 64 | 128; }
+                                if (z == sz - 1 || model->voxel[i].data[j + sx] >= model->numvoxtype) { n++; am |= 16; k |= 4 | 8 | 64 | 128; }
+                                if (x == sx - 1 || model->voxel[i].data[j + 1] >= model->numvoxtype) { n++; am |= 32; k |= 2 | 8 | 32 | 128; }
+                                if (k) {
+                                    memset(edge, 255, sizeof(edge));
+                                    for (l = 0, len = 1, reclen = model->numvertex; l < 8; l++, len <<= 1)
+                                        if (k & len) edge[l] = model->numvertex++;
+                                    model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
+                                    if (!model->vertex) goto memerr;
+                                    memset(&model->vertex[reclen], 0, (model->numvertex - reclen) * sizeof(m3dv_t));
+                                    for (l = reclen; l < model->numvertex; l++) {
+                                        model->vertex[l].skinid = model->voxtype[model->voxel[i].data[j]].skinid;
+                                        model->vertex[l].color = model->voxtype[model->voxel[i].data[j]].color;
+                                    }
+                                    l = reclen;
+                                    if (k & 1) {
+                                        model->vertex[l].x = (model->voxel[i].x + x) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z) * w;
+                                        l++;
+                                    }
+                                    if (k & 2) {
+                                        model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z) * w;
+                                        l++;
+                                    }
+                                    if (k & 4) {
+                                        model->vertex[l].x = (model->voxel[i].x + x) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
+                                        l++;
+                                    }
+                                    if (k & 8) {
+                                        model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
+                                        l++;
+                                    }
+                                    if (k & 16) {
+                                        model->vertex[l].x = (model->voxel[i].x + x) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z) * w;
+                                        l++;
+                                    }
+                                    if (k & 32) {
+                                        model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z) * w;
+                                        l++;
+                                    }
+                                    if (k & 64) {
+                                        model->vertex[l].x = (model->voxel[i].x + x) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
+                                        l++;
+                                    }
+                                    if (k & 128) {
+                                        model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
+                                        model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
+                                        model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
+                                        l++;
+                                    }
+                                    n <<= 1;
+                                    l = model->numface; model->numface += n;
+                                    model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
+                                    if (!model->face) goto memerr;
+                                    memset(&model->face[l], 255, n * sizeof(m3df_t));
+                                    for (reclen = l; reclen < model->numface; reclen++)
+                                        model->face[reclen].materialid = model->voxtype[model->voxel[i].data[j]].materialid;
+                                    if (am & 1) {            /* bottom */
+                                        model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[1];   model->face[l].vertex[2] = edge[2];
+                                        model->face[l + 1].vertex[0] = edge[2]; model->face[l + 1].vertex[1] = edge[1]; model->face[l + 1].vertex[2] = edge[3];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm;
+                                        l += 2;
+                                    }
+                                    if (am & 2) {            /* north */
+                                        model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[4];   model->face[l].vertex[2] = edge[1];
+                                        model->face[l + 1].vertex[0] = edge[1]; model->face[l + 1].vertex[1] = edge[4]; model->face[l + 1].vertex[2] = edge[5];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 1;
+                                        l += 2;
+                                    }
+                                    if (am & 4) {            /* west */
+                                        model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[2];   model->face[l].vertex[2] = edge[4];
+                                        model->face[l + 1].vertex[0] = edge[2]; model->face[l + 1].vertex[1] = edge[6]; model->face[l + 1].vertex[2] = edge[4];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 2;
+                                        l += 2;
+                                    }
+                                    if (am & 8) {            /* top */
+                                        model->face[l].vertex[0] = edge[4];   model->face[l].vertex[1] = edge[6];   model->face[l].vertex[2] = edge[5];
+                                        model->face[l + 1].vertex[0] = edge[5]; model->face[l + 1].vertex[1] = edge[6]; model->face[l + 1].vertex[2] = edge[7];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 3;
+                                        l += 2;
+                                    }
+                                    if (am & 16) {           /* south */
+                                        model->face[l].vertex[0] = edge[2];   model->face[l].vertex[1] = edge[7];   model->face[l].vertex[2] = edge[6];
+                                        model->face[l + 1].vertex[0] = edge[7]; model->face[l + 1].vertex[1] = edge[2]; model->face[l + 1].vertex[2] = edge[3];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 4;
+                                        l += 2;
+                                    }
+                                    if (am & 32) {           /* east */
+                                        model->face[l].vertex[0] = edge[1];   model->face[l].vertex[1] = edge[5];   model->face[l].vertex[2] = edge[7];
+                                        model->face[l + 1].vertex[0] = edge[1]; model->face[l + 1].vertex[1] = edge[7]; model->face[l + 1].vertex[2] = edge[3];
+                                        model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
+                                            model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 5;
+                                        l += 2;
+                                    }
+                                }
+                            }
             }
-            model->errcode = M3D_SUCCESS;
-        asciiend:
-            setlocale(LC_NUMERIC, ol);
-            goto postprocess;
         }
 #endif
-        /* Binary variant */
-        len = ((m3dhdr_t*)data)->length - 8;
-        data += 8;
-        if (M3D_CHUNKMAGIC(data, 'P', 'R', 'V', 'W')) {
-            /* optional preview chunk */
-            model->preview.length = ((m3dchunk_t*)data)->length;
-            model->preview.data = data + sizeof(m3dchunk_t);
-            data += model->preview.length;
-            len -= model->preview.length;
+#ifndef M3D_NONORMALS
+        if (model->numface && model->face && neednorm) {
+            /* if they are missing, calculate triangle normals into a temporary buffer */
+            norm = (m3dv_t*)M3D_MALLOC(model->numface * sizeof(m3dv_t));
+            if (!norm) goto memerr;
+            for (i = 0, n = model->numvertex; i < model->numface; i++)
+                if (model->face[i].normal[0] == M3D_UNDEF) {
+                    v0 = &model->vertex[model->face[i].vertex[0]];
+                    v1 = &model->vertex[model->face[i].vertex[1]];
+                    v2 = &model->vertex[model->face[i].vertex[2]];
+                    va.x = v1->x - v0->x; va.y = v1->y - v0->y; va.z = v1->z - v0->z;
+                    vb.x = v2->x - v0->x; vb.y = v2->y - v0->y; vb.z = v2->z - v0->z;
+                    v0 = &norm[i];
+                    v0->x = (va.y * vb.z) - (va.z * vb.y);
+                    v0->y = (va.z * vb.x) - (va.x * vb.z);
+                    v0->z = (va.x * vb.y) - (va.y * vb.x);
+                    w = _m3d_rsq((v0->x * v0->x) + (v0->y * v0->y) + (v0->z * v0->z));
+                    v0->x *= w; v0->y *= w; v0->z *= w;
+                    model->face[i].normal[0] = model->face[i].vertex[0] + n;
+                    model->face[i].normal[1] = model->face[i].vertex[1] + n;
+                    model->face[i].normal[2] = model->face[i].vertex[2] + n;
+                }
+            /* this is the fast way, we don't care if a normal is repeated in model->vertex */
+            M3D_LOG("Generating normals");
+            model->flags |= M3D_FLG_GENNORM;
+            model->numvertex <<= 1;
+            model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
+            if (!model->vertex) goto memerr;
+            memset(&model->vertex[n], 0, n * sizeof(m3dv_t));
+            for (i = 0; i < model->numface; i++)
+                for (j = 0; j < 3; j++) {
+                    v0 = &model->vertex[model->face[i].vertex[j] + n];
+                    v0->x += norm[i].x;
+                    v0->y += norm[i].y;
+                    v0->z += norm[i].z;
+                }
+            /* for each vertex, take the average of the temporary normals and use that */
+            for (i = 0, v0 = &model->vertex[n]; i < n; i++, v0++) {
+                w = _m3d_rsq((v0->x * v0->x) + (v0->y * v0->y) + (v0->z * v0->z));
+                v0->x *= w; v0->y *= w; v0->z *= w;
+                v0->skinid = M3D_UNDEF;
+            }
+            M3D_FREE(norm);
         }
-        if (!M3D_CHUNKMAGIC(data, 'H', 'E', 'A', 'D')) {
-            buff = (unsigned char*)stbi_zlib_decode_malloc_guesssize_headerflag((const char*)data, len, 4096, (int*)&len, 1);
-            if (!buff || !len || !M3D_CHUNKMAGIC(buff, 'H', 'E', 'A', 'D')) {
-                if (buff) M3D_FREE(buff);
-                M3D_FREE(model);
-                return NULL;
+#endif
+        if (model->numbone && model->bone && model->numskin && model->skin && model->numvertex && model->vertex) {
+#ifndef M3D_NOWEIGHTS
+            M3D_LOG("Generating weight cross-reference");
+            for (i = 0; i < model->numvertex; i++) {
+                if (model->vertex[i].skinid < model->numskin) {
+                    sk = &model->skin[model->vertex[i].skinid];
+                    w = (M3D_FLOAT)0.0;
+                    for (j = 0; j < M3D_NUMBONE && sk->boneid[j] != M3D_UNDEF && sk->weight[j] >(M3D_FLOAT)0.0; j++)
+                        w += sk->weight[j];
+                    for (j = 0; j < M3D_NUMBONE && sk->boneid[j] != M3D_UNDEF && sk->weight[j] >(M3D_FLOAT)0.0; j++) {
+                        sk->weight[j] /= w;
+                        b = &model->bone[sk->boneid[j]];
+                        k = b->numweight++;
+                        b->weight = (m3dw_t*)M3D_REALLOC(b->weight, b->numweight * sizeof(m3da_t));
+                        if (!b->weight) goto memerr;
+                        b->weight[k].vertexid = i;
+                        b->weight[k].weight = sk->weight[j];
+                    }
+                }
             }
-            buff = (unsigned char*)M3D_REALLOC(buff, len);
-            model->flags |= M3D_FLG_FREERAW; /* mark that we have to free the raw buffer */
-            data = buff;
-#ifdef M3D_PROFILING
-            gettimeofday(&tv1, NULL);
-            tvd.tv_sec = tv1.tv_sec - tv0.tv_sec;
-            tvd.tv_usec = tv1.tv_usec - tv0.tv_usec;
-            if (tvd.tv_usec < 0) { tvd.tv_sec--; tvd.tv_usec += 1000000L; }
-            printf("  Deflate model   %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
-            memcpy(&tv0, &tv1, sizeof(struct timeval));
+#endif
+#ifndef M3D_NOANIMATION
+            M3D_LOG("Calculating bone transformation matrices");
+            for (i = 0; i < model->numbone; i++) {
+                b = &model->bone[i];
+                if (model->bone[i].parent == M3D_UNDEF) {
+                    _m3d_mat((M3D_FLOAT*)&b->mat4, &model->vertex[b->pos], &model->vertex[b->ori]);
+                }
+                else {
+                    _m3d_mat((M3D_FLOAT*)&r, &model->vertex[b->pos], &model->vertex[b->ori]);
+                    _m3d_mul((M3D_FLOAT*)&b->mat4, (M3D_FLOAT*)&model->bone[b->parent].mat4, (M3D_FLOAT*)&r);
+                }
+            }
+            for (i = 0; i < model->numbone; i++)
+                _m3d_inv((M3D_FLOAT*)&model->bone[i].mat4);
 #endif
         }
-        model->raw = (m3dhdr_t*)data;
-        end = data + len;
+#ifdef M3D_PROFILING
+        gettimeofday(&tv0, NULL);
+        tvd.tv_sec = tv0.tv_sec - tv1.tv_sec;
+        tvd.tv_usec = tv0.tv_usec - tv1.tv_usec;
+        if (tvd.tv_usec < 0) { tvd.tv_sec--; tvd.tv_usec += 1000000L; }
+        printf("  Post-process    %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
+#endif
+        return model;
+    memerr:
+        M3D_LOG("Out of memory");
+        model->errcode = M3D_ERR_ALLOC;
+        return model;
+    }
 
-        /* parse header */
-        data += sizeof(m3dhdr_t);
-        M3D_LOG((char*)data);
-        model->name = (char*)data;
-        for (; data < end && *data; data++) {}; data++;
-        model->license = (char*)data;
-        for (; data < end && *data; data++) {}; data++;
-        model->author = (char*)data;
-        for (; data < end && *data; data++) {}; data++;
-        model->desc = (char*)data;
-        chunk = (unsigned char*)model->raw + model->raw->length;
-        model->scale = (M3D_FLOAT)model->raw->scale;
-        if (model->scale <= (M3D_FLOAT)0.0) model->scale = (M3D_FLOAT)1.0;
-        model->vc_s = 1 << ((model->raw->types >> 0) & 3);  /* vertex coordinate size */
-        model->vi_s = 1 << ((model->raw->types >> 2) & 3);  /* vertex index size */
-        model->si_s = 1 << ((model->raw->types >> 4) & 3);  /* string offset size */
-        model->ci_s = 1 << ((model->raw->types >> 6) & 3);  /* color index size */
-        model->ti_s = 1 << ((model->raw->types >> 8) & 3);  /* tmap index size */
-        model->bi_s = 1 << ((model->raw->types >> 10) & 3);  /* bone index size */
-        model->nb_s = 1 << ((model->raw->types >> 12) & 3);  /* number of bones per vertex */
-        model->sk_s = 1 << ((model->raw->types >> 14) & 3);  /* skin index size */
-        model->fc_s = 1 << ((model->raw->types >> 16) & 3);  /* frame counter size */
-        model->hi_s = 1 << ((model->raw->types >> 18) & 3);  /* shape index size */
-        model->fi_s = 1 << ((model->raw->types >> 20) & 3);  /* face index size */
-        model->vd_s = 1 << ((model->raw->types >> 22) & 3);  /* voxel dimension size */
-        model->vp_s = 1 << ((model->raw->types >> 24) & 3);  /* voxel pixel size */
-        if (model->ci_s == 8) model->ci_s = 0;               /* optional indices */
-        if (model->ti_s == 8) model->ti_s = 0;
-        if (model->bi_s == 8) model->bi_s = 0;
-        if (model->sk_s == 8) model->sk_s = 0;
-        if (model->fc_s == 8) model->fc_s = 0;
-        if (model->hi_s == 8) model->hi_s = 0;
-        if (model->fi_s == 8) model->fi_s = 0;
 
-        /* variable limit checks */
-        if (sizeof(M3D_FLOAT) == 4 && model->vc_s > 4) {
-            M3D_LOG("Double precision coordinates not supported, truncating to float...");
-            model->errcode = M3D_ERR_TRUNC;
-        }
-        if ((sizeof(M3D_INDEX) == 2 && (model->vi_s > 2 || model->si_s > 2 || model->ci_s > 2 || model->ti_s > 2 ||
-            model->bi_s > 2 || model->sk_s > 2 || model->fc_s > 2 || model->hi_s > 2 || model->fi_s > 2)) ||
-            (sizeof(M3D_VOXEL) < (size_t)model->vp_s && model->vp_s != 8)) {
-            M3D_LOG("32 bit indices not supported, unable to load model");
-            M3D_FREE(model);
-            return NULL;
-        }
-        if (model->vi_s > 4 || model->si_s > 4 || model->vp_s == 4) {
-            M3D_LOG("Invalid index size, unable to load model");
-            M3D_FREE(model);
-            return NULL;
-        }
-        if (!M3D_CHUNKMAGIC(end - 4, 'O', 'M', 'D', '3')) {
-            M3D_LOG("Missing end chunk");
-            M3D_FREE(model);
-            return NULL;
-        }
-        if (model->nb_s > M3D_NUMBONE) {
-            M3D_LOG("Model has more bones per vertex than what importer was configured to support");
-            model->errcode = M3D_ERR_TRUNC;
-        }
+    /* built-in decompressor, the output buffer grows by doubling as the stream gives no uncompressed size */
+    unsigned char* m3d_inflate(const unsigned char* data, unsigned int len, unsigned int* outlen)
+    {
+        return (unsigned char*)stbi_zlib_decode_malloc_guesssize_headerflag((const char*)data, len, 4096, (int*)outlen, 1);
+    }
 
-        /* look for inlined assets in advance, material and procedural chunks may need them */
-        buff = chunk;
-        while (buff < end && !M3D_CHUNKMAGIC(buff, 'O', 'M', 'D', '3')) {
-            data = buff;
-            len = ((m3dchunk_t*)data)->length;
-            buff += len;
-            if (len < sizeof(m3dchunk_t) || buff >= end) {
-                M3D_LOG("Invalid chunk size");
-                break;
-            }
-            len -= sizeof(m3dchunk_t) + model->si_s;
+    /**
+     * Function to decode a Model 3D into in-memory format
+     */
+    m3d_t* m3d_load(unsigned char* data, m3dread_t readfilecb, m3dfree_t freecb, m3d_t* mtllib)
+    {
+        unsigned char* end, * chunk, * buff;
+        unsigned int i, len = 0;
+        m3d_t* model;
+#ifdef M3D_ASCII
+        unsigned int j, k, l, n, am;
+        M3D_INDEX mi;
+#ifdef M3D_VERTEXMAX
+        M3D_INDEX pi;
+#endif
+        M3D_FLOAT w;
+        m3dcd_t* cd;
+        m3dtx_t* tx;
+        m3dh_t* h;
+        m3dm_t* m;
+        m3da_t* a;
+        m3ds_t s;
+        M3D_INDEX bi[M3D_BONEMAXLEVEL + 1], level;
+        const char* ol;
+        char* ptr, * pe, * fn;
+#endif
+#ifdef M3D_PROFILING
+        struct timeval tv0, tv1, tvd;
+        gettimeofday(&tv0, NULL);
+#endif
 
-            /* inlined assets */
-            if (M3D_CHUNKMAGIC(data, 'A', 'S', 'E', 'T') && len > 0) {
-                M3D_LOG("Inlined asset");
-                i = model->numinlined++;
-                model->inlined = (m3di_t*)M3D_REALLOC(model->inlined, model->numinlined * sizeof(m3di_t));
-                if (!model->inlined) {
-                memerr:         M3D_LOG("Out of memory");
-                    model->errcode = M3D_ERR_ALLOC;
-                    return model;
-                }
-                data += sizeof(m3dchunk_t);
-                t = &model->inlined[i];
-                M3D_GETSTR(t->name);
-                M3D_LOG(t->name);
-                t->data = (uint8_t*)data;
-                t->length = len;
-            }
+        if (!data || (!M3D_CHUNKMAGIC(data, '3', 'D', 'M', 'O')
+#ifdef M3D_ASCII
+            && !M3D_CHUNKMAGIC(data, '3', 'd', 'm', 'o')
+#endif
+            )) return NULL;
+        model = (m3d_t*)M3D_MALLOC(sizeof(m3d_t));
+        if (!model) {
+            M3D_LOG("Out of memory");
+            return NULL;
         }
+        memset(model, 0, sizeof(m3d_t));
 
-        /* parse chunks */
-        while (chunk < end && !M3D_CHUNKMAGIC(chunk, 'O', 'M', 'D', '3')) {
-            data = chunk;
-            len = ((m3dchunk_t*)chunk)->length;
-            chunk += len;
-            if (len < sizeof(m3dchunk_t) || chunk >= end) {
-                M3D_LOG("Invalid chunk size");
-                break;
+        if (mtllib) {
+            model->nummaterial = mtllib->nummaterial;
+            model->material = mtllib->material;
+            model->numtexture = mtllib->numtexture;
+            model->texture = mtllib->texture;
+            model->flags |= M3D_FLG_MTLLIB;
+        }
+#ifdef M3D_ASCII
+        /* ASCII variant? */
+        if (M3D_CHUNKMAGIC(data, '3', 'd', 'm', 'o')) {
+            model->errcode = M3D_ERR_BADFILE;
+            model->flags |= M3D_FLG_FREESTR;
+            model->raw = (m3dhdr_t*)data;
+            ptr = (char*)data;
+            ol = setlocale(LC_NUMERIC, NULL);
+            setlocale(LC_NUMERIC, "C");
+            /* parse header. Don't use sscanf, that's incredibly slow */
+            ptr = _m3d_findarg(ptr);
+            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+            pe = _m3d_findnl(ptr);
+            model->scale = (float)strtod(ptr, NULL); ptr = pe;
+            if (model->scale <= (M3D_FLOAT)0.0) model->scale = (M3D_FLOAT)1.0;
+            model->name = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
+            if (!*ptr) goto asciiend;
+            model->license = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
+            if (!*ptr) goto asciiend;
+            model->author = _m3d_safestr(ptr, 2); ptr = _m3d_findnl(ptr);
+            if (!*ptr) goto asciiend;
+            if (*ptr != '\r' && *ptr != '\n')
+                model->desc = _m3d_safestr(ptr, 3);
+            while (*ptr) {
+                while (*ptr && *ptr != '\n') ptr++;
+                ptr++; if (*ptr == '\r') ptr++;
+                if (*ptr == '\n') break;
             }
-            len -= sizeof(m3dchunk_t);
 
-            /* color map */
-            if (M3D_CHUNKMAGIC(data, 'C', 'M', 'A', 'P')) {
-                M3D_LOG("Color map");
-                if (model->cmap) { M3D_LOG("More color map chunks, should be unique"); model->errcode = M3D_ERR_CMAP; continue; }
-                if (!model->ci_s) { M3D_LOG("Color map chunk, shouldn't be any"); model->errcode = M3D_ERR_CMAP; continue; }
-                model->numcmap = len / sizeof(uint32_t);
-                model->cmap = (uint32_t*)(data + sizeof(m3dchunk_t));
-            }
-            else
-                /* texture map */
-                if (M3D_CHUNKMAGIC(data, 'T', 'M', 'A', 'P')) {
-                    M3D_LOG("Texture map");
-                    if (model->tmap) { M3D_LOG("More texture map chunks, should be unique"); model->errcode = M3D_ERR_TMAP; continue; }
-                    if (!model->ti_s) { M3D_LOG("Texture map chunk, shouldn't be any"); model->errcode = M3D_ERR_TMAP; continue; }
-                    reclen = model->vc_s + model->vc_s;
-                    model->numtmap = len / reclen;
-                    model->tmap = (m3dti_t*)M3D_MALLOC(model->numtmap * sizeof(m3dti_t));
-                    if (!model->tmap) goto memerr;
-                    for (i = 0, data += sizeof(m3dchunk_t); data < chunk; i++) {
-                        switch (model->vc_s) {
-                        case 1:
-                            model->tmap[i].u = (M3D_FLOAT)((uint8_t)data[0]) / (M3D_FLOAT)255.0;
-                            model->tmap[i].v = (M3D_FLOAT)((uint8_t)data[1]) / (M3D_FLOAT)255.0;
-                            break;
-                        case 2:
-                            model->tmap[i].u = (M3D_FLOAT)(*((uint16_t*)(data + 0))) / (M3D_FLOAT)65535.0;
-                            model->tmap[i].v = (M3D_FLOAT)(*((uint16_t*)(data + 2))) / (M3D_FLOAT)65535.0;
-                            break;
-                        case 4:
-                            model->tmap[i].u = (M3D_FLOAT)(*((float*)(data + 0)));
-                            model->tmap[i].v = (M3D_FLOAT)(*((float*)(data + 4)));
-                            break;
-                        case 8:
-                            model->tmap[i].u = (M3D_FLOAT)(*((double*)(data + 0)));
-                            model->tmap[i].v = (M3D_FLOAT)(*((double*)(data + 8)));
-                            break;
-                        }
-                        data += reclen;
+            /* the main chunk reader loop */
+            while (*ptr) {
+                while (*ptr && (*ptr == '\r' || *ptr == '\n')) ptr++;
+                if (!*ptr || (ptr[0] == 'E' && ptr[1] == 'n' && ptr[2] == 'd')) break;
+                /* make sure there's at least one data row */
+                pe = ptr; ptr = _m3d_findnl(ptr);
+                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                /* Preview chunk */
+                if (!memcmp(pe, "Preview", 7)) {
+                    if (readfilecb) {
+                        pe = _m3d_safestr(ptr, 0);
+                        if (!pe || !*pe) goto asciiend;
+                        model->preview.data = (*readfilecb)(pe, &model->preview.length);
+                        M3D_FREE(pe);
                     }
+                    while (*ptr && *ptr != '\r' && *ptr != '\n')
+                        ptr = _m3d_findnl(ptr);
                 }
                 else
-                    /* vertex list */
-                    if (M3D_CHUNKMAGIC(data, 'V', 'R', 'T', 'S')) {
-                        M3D_LOG("Vertex list");
-                        if (model->vertex) { M3D_LOG("More vertex chunks, should be unique"); model->errcode = M3D_ERR_VRTS; continue; }
-                        if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
-                        reclen = model->ci_s + model->sk_s + 4 * model->vc_s;
-                        model->numvertex = len / reclen;
-                        model->vertex = (m3dv_t*)M3D_MALLOC(model->numvertex * sizeof(m3dv_t));
-                        if (!model->vertex) goto memerr;
-                        memset(model->vertex, 0, model->numvertex * sizeof(m3dv_t));
-                        for (i = 0, data += sizeof(m3dchunk_t); data < chunk && i < model->numvertex; i++) {
-                            switch (model->vc_s) {
-                            case 1:
-                                model->vertex[i].x = (M3D_FLOAT)((int8_t)data[0]) / (M3D_FLOAT)127.0;
-                                model->vertex[i].y = (M3D_FLOAT)((int8_t)data[1]) / (M3D_FLOAT)127.0;
-                                model->vertex[i].z = (M3D_FLOAT)((int8_t)data[2]) / (M3D_FLOAT)127.0;
-                                model->vertex[i].w = (M3D_FLOAT)((int8_t)data[3]) / (M3D_FLOAT)127.0;
-                                data += 4;
-                                break;
-                            case 2:
-                                model->vertex[i].x = (M3D_FLOAT)(*((int16_t*)(data + 0))) / (M3D_FLOAT)32767.0;
-                                model->vertex[i].y = (M3D_FLOAT)(*((int16_t*)(data + 2))) / (M3D_FLOAT)32767.0;
-                                model->vertex[i].z = (M3D_FLOAT)(*((int16_t*)(data + 4))) / (M3D_FLOAT)32767.0;
-                                model->vertex[i].w = (M3D_FLOAT)(*((int16_t*)(data + 6))) / (M3D_FLOAT)32767.0;
-                                data += 8;
-                                break;
-                            case 4:
-                                model->vertex[i].x = (M3D_FLOAT)(*((float*)(data + 0)));
-                                model->vertex[i].y = (M3D_FLOAT)(*((float*)(data + 4)));
-                                model->vertex[i].z = (M3D_FLOAT)(*((float*)(data + 8)));
-                                model->vertex[i].w = (M3D_FLOAT)(*((float*)(data + 12)));
-                                data += 16;
-                                break;
-                            case 8:
-                                model->vertex[i].x = (M3D_FLOAT)(*((double*)(data + 0)));
-                                model->vertex[i].y = (M3D_FLOAT)(*((double*)(data + 8)));
-                                model->vertex[i].z = (M3D_FLOAT)(*((double*)(data + 16)));
-                                model->vertex[i].w = (M3D_FLOAT)(*((double*)(data + 24)));
-                                data += 32;
-                                break;
-                            }
-                            switch (model->ci_s) {
-                            case 1: model->vertex[i].color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
-                            case 2: model->vertex[i].color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
-                            case 4: model->vertex[i].color = *((uint32_t*)data); data += 4; break;
-                                /* case 8: break; */
-                            }
-                            model->vertex[i].skinid = M3D_UNDEF;
-                            data = _m3d_getidx(data, model->sk_s, &model->vertex[i].skinid);
+                    /* texture map chunk */
+                    if (!memcmp(pe, "Textmap", 7)) {
+                        if (model->tmap) { M3D_LOG("More texture map chunks, should be unique"); goto asciiend; }
+                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                            i = model->numtmap++;
+                            model->tmap = (m3dti_t*)M3D_REALLOC(model->tmap, model->numtmap * sizeof(m3dti_t));
+                            if (!model->tmap) goto memerr;
+                            ptr = _m3d_getfloat(ptr, &model->tmap[i].u);
+                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                            _m3d_getfloat(ptr, &model->tmap[i].v);
+                            ptr = _m3d_findnl(ptr);
                         }
                     }
                     else
-                        /* skeleton: bone hierarchy and skin */
-                        if (M3D_CHUNKMAGIC(data, 'B', 'O', 'N', 'E')) {
-                            M3D_LOG("Skeleton");
-                            if (model->bone) { M3D_LOG("More bone chunks, should be unique"); model->errcode = M3D_ERR_BONE; continue; }
-                            if (!model->bi_s) { M3D_LOG("Bone chunk, shouldn't be any"); model->errcode = M3D_ERR_BONE; continue; }
-                            if (!model->vertex) { M3D_LOG("No vertex chunk before bones"); model->errcode = M3D_ERR_VRTS; break; }
-                            data += sizeof(m3dchunk_t);
-                            model->numbone = 0;
-                            data = _m3d_getidx(data, model->bi_s, &model->numbone);
-                            if (model->numbone) {
-                                model->bone = (m3db_t*)M3D_MALLOC(model->numbone * sizeof(m3db_t));
-                                if (!model->bone) goto memerr;
-                            }
-                            model->numskin = 0;
-                            data = _m3d_getidx(data, model->sk_s, &model->numskin);
-                            /* read bone hierarchy */
-                            for (i = 0; data < chunk && i < model->numbone; i++) {
-                                data = _m3d_getidx(data, model->bi_s, &model->bone[i].parent);
-                                M3D_GETSTR(model->bone[i].name);
-                                data = _m3d_getidx(data, model->vi_s, &model->bone[i].pos);
-                                data = _m3d_getidx(data, model->vi_s, &model->bone[i].ori);
-                                model->bone[i].numweight = 0;
-                                model->bone[i].weight = NULL;
-                            }
-                            /* read skin definitions */
-                            if (model->numskin) {
-                                model->skin = (m3ds_t*)M3D_MALLOC(model->numskin * sizeof(m3ds_t));
-                                if (!model->skin) goto memerr;
-                                for (i = 0; data < chunk && i < model->numskin; i++) {
-                                    for (j = 0; j < M3D_NUMBONE; j++) {
-                                        model->skin[i].boneid[j] = M3D_UNDEF;
-                                        model->skin[i].weight[j] = (M3D_FLOAT)0.0;
-                                    }
-                                    memset(&weights, 0, sizeof(weights));
-                                    if (model->nb_s == 1) weights[0] = 255;
-                                    else {
-                                        memcpy(&weights, data, model->nb_s);
-                                        data += model->nb_s;
+                        /* vertex chunk */
+                        if (!memcmp(pe, "Vertex", 6)) {
+                            if (model->vertex) { M3D_LOG("More vertex chunks, should be unique"); goto asciiend; }
+                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                i = model->numvertex++;
+                                model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
+                                if (!model->vertex) goto memerr;
+                                memset(&model->vertex[i], 0, sizeof(m3dv_t));
+                                model->vertex[i].skinid = M3D_UNDEF;
+                                model->vertex[i].color = 0;
+                                model->vertex[i].w = (M3D_FLOAT)1.0;
+                                ptr = _m3d_getfloat(ptr, &model->vertex[i].x);
+                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                ptr = _m3d_getfloat(ptr, &model->vertex[i].y);
+                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                ptr = _m3d_getfloat(ptr, &model->vertex[i].z);
+                                if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                ptr = _m3d_getfloat(ptr, &model->vertex[i].w);
+                                if (!*ptr) goto asciiend;
+                                if (*ptr == '#') {
+                                    ptr = _m3d_gethex(ptr, &model->vertex[i].color);
+                                    if (!*ptr) goto asciiend;
+                                }
+                                /* parse skin */
+                                memset(&s, 0, sizeof(m3ds_t));
+                                for (j = 0, w = (M3D_FLOAT)0.0; j < M3D_NUMBONE && *ptr && *ptr != '\r' && *ptr != '\n'; j++) {
+                                    ptr = _m3d_findarg(ptr);
+                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                    ptr = _m3d_getint(ptr, &k);
+                                    s.boneid[j] = (M3D_INDEX)k;
+                                    if (*ptr == ':') {
+                                        ptr++;
+                                        ptr = _m3d_getfloat(ptr, &s.weight[j]);
+                                        w += s.weight[j];
                                     }
-                                    for (j = 0, w = (M3D_FLOAT)0.0; j < (unsigned int)model->nb_s; j++) {
-                                        if (weights[j]) {
-                                            if (j >= M3D_NUMBONE)
-                                                data += model->bi_s;
-                                            else {
-                                                model->skin[i].weight[j] = (M3D_FLOAT)(weights[j]) / (M3D_FLOAT)255.0;
-                                                w += model->skin[i].weight[j];
-                                                data = _m3d_getidx(data, model->bi_s, &model->skin[i].boneid[j]);
-                                            }
-                                        }
+                                    else if (!j)
+                                        s.weight[j] = (M3D_FLOAT)1.0;
+                                    if (!*ptr) goto asciiend;
+                                }
+                                if (s.boneid[0] != M3D_UNDEF && s.weight[0] > (M3D_FLOAT)0.0) {
+                                    if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0)
+                                        for (j = 0; j < M3D_NUMBONE && s.weight[j] >(M3D_FLOAT)0.0; j++)
+                                            s.weight[j] /= w;
+                                    k = M3D_NOTDEFINED;
+                                    if (model->skin) {
+                                        for (j = 0; j < model->numskin; j++)
+                                            if (!memcmp(&model->skin[j], &s, sizeof(m3ds_t))) { k = j; break; }
                                     }
-                                    /* this can occur if model has more bones than what the importer is configured to handle */
-                                    if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0) {
-                                        for (j = 0; j < M3D_NUMBONE; j++)
-                                            model->skin[i].weight[j] /= w;
+                                    if (k == M3D_NOTDEFINED) {
+                                        k = model->numskin++;
+                                        model->skin = (m3ds_t*)M3D_REALLOC(model->skin, model->numskin * sizeof(m3ds_t));
+                                        if (!model->skin) goto memerr;
+                                        memcpy(&model->skin[k], &s, sizeof(m3ds_t));
                                     }
+                                    model->vertex[i].skinid = (M3D_INDEX)k;
                                 }
+                                ptr = _m3d_findnl(ptr);
                             }
                         }
                         else
-                            /* material */
-                            if (M3D_CHUNKMAGIC(data, 'M', 'T', 'R', 'L')) {
-                                data += sizeof(m3dchunk_t);
-                                M3D_GETSTR(name);
-                                M3D_LOG("Material");
-                                M3D_LOG(name);
-                                if (model->ci_s < 4 && !model->numcmap) model->errcode = M3D_ERR_CMAP;
-                                for (i = 0; i < model->nummaterial; i++)
-                                    if (!strcmp(name, model->material[i].name)) {
-                                        model->errcode = M3D_ERR_MTRL;
-                                        M3D_LOG("Multiple definitions for material");
-                                        M3D_LOG(name);
-                                        name = NULL;
-                                        break;
-                                    }
-                                if (name) {
+                            /* Skeleton, bone hierarchy */
+                            if (!memcmp(pe, "Bones", 5)) {
+                                if (model->bone) { M3D_LOG("More bones chunks, should be unique"); goto asciiend; }
+                                bi[0] = M3D_UNDEF;
+                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                    i = model->numbone++;
+                                    model->bone = (m3db_t*)M3D_REALLOC(model->bone, model->numbone * sizeof(m3db_t));
+                                    if (!model->bone) goto memerr;
+                                    for (level = 0; *ptr == '/'; ptr++, level++);
+                                    if (level > M3D_BONEMAXLEVEL || !*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                    bi[level + 1] = i;
+                                    model->bone[i].numweight = 0;
+                                    model->bone[i].weight = NULL;
+                                    model->bone[i].parent = bi[level];
+                                    ptr = _m3d_getint(ptr, &k);
+                                    ptr = _m3d_findarg(ptr);
+                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                    model->bone[i].pos = (M3D_INDEX)k;
+                                    ptr = _m3d_getint(ptr, &k);
+                                    ptr = _m3d_findarg(ptr);
+                                    if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                    model->bone[i].ori = (M3D_INDEX)k;
+                                    model->vertex[k].skinid = M3D_INDEXMAX;
+                                    pe = _m3d_safestr(ptr, 0);
+                                    if (!pe || !*pe) goto asciiend;
+                                    model->bone[i].name = pe;
+                                    ptr = _m3d_findnl(ptr);
+                                }
+                            }
+                            else
+                                /* material chunk */
+                                if (!memcmp(pe, "Material", 8)) {
+                                    pe = _m3d_findarg(pe);
+                                    if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                    pe = _m3d_safestr(pe, 0);
+                                    if (!pe || !*pe) goto asciiend;
+                                    for (i = 0; i < model->nummaterial; i++)
+                                        if (!strcmp(pe, model->material[i].name)) {
+                                            M3D_LOG("Multiple definitions for material");
+                                            M3D_LOG(pe);
+                                            M3D_FREE(pe);
+                                            pe = NULL;
+                                            while (*ptr && *ptr != '\r' && *ptr != '\n') ptr = _m3d_findnl(ptr);
+                                            break;
+                                        }
+                                    if (!pe) continue;
                                     i = model->nummaterial++;
                                     if (model->flags & M3D_FLG_MTLLIB) {
                                         m = model->material;
@@ -3575,701 +3679,754 @@ extern "C" {
                                         if (!model->material) goto memerr;
                                     }
                                     m = &model->material[i];
+                                    m->name = pe;
                                     m->numprop = 0;
-                                    m->name = name;
-                                    m->prop = (m3dp_t*)M3D_MALLOC((len / 2) * sizeof(m3dp_t));
-                                    if (!m->prop) goto memerr;
-                                    while (data < chunk) {
-                                        i = m->numprop++;
-                                        m->prop[i].type = *data++;
-                                        m->prop[i].value.num = 0;
-                                        if (m->prop[i].type >= 128)
+                                    m->prop = NULL;
+                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                        k = n = 256;
+                                        if (*ptr == 'm' && *(ptr + 1) == 'a' && *(ptr + 2) == 'p' && *(ptr + 3) == '_') {
                                             k = m3dpf_map;
-                                        else {
-                                            for (k = 256, j = 0; j < sizeof(m3d_propertytypes) / sizeof(m3d_propertytypes[0]); j++)
-                                                if (m->prop[i].type == m3d_propertytypes[j].id) { k = m3d_propertytypes[j].format; break; }
+                                            ptr += 4;
                                         }
-                                        switch (k) {
-                                        case m3dpf_color:
-                                            switch (model->ci_s) {
-                                            case 1: m->prop[i].value.color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
-                                            case 2: m->prop[i].value.color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
-                                            case 4: m->prop[i].value.color = *((uint32_t*)data); data += 4; break;
+                                        for (j = 0; j < sizeof(m3d_propertytypes) / sizeof(m3d_propertytypes[0]); j++)
+                                            if (!memcmp(ptr, m3d_propertytypes[j].key, strlen(m3d_propertytypes[j].key))) {
+                                                n = m3d_propertytypes[j].id;
+                                                if (k != m3dpf_map) k = m3d_propertytypes[j].format;
+                                                break;
                                             }
-                                            break;
-
-                                        case m3dpf_uint8: m->prop[i].value.num = *data++; break;
-                                        case m3dpf_uint16:m->prop[i].value.num = *((uint16_t*)data); data += 2; break;
-                                        case m3dpf_uint32:m->prop[i].value.num = *((uint32_t*)data); data += 4; break;
-                                        case m3dpf_float: m->prop[i].value.fnum = *((float*)data); data += 4; break;
-
-                                        case m3dpf_map:
-                                            M3D_GETSTR(name);
-                                            m->prop[i].value.textureid = _m3d_gettx(model, readfilecb, freecb, name);
-                                            if (model->errcode == M3D_ERR_ALLOC) goto memerr;
-                                            /* this error code only returned if readfilecb was specified */
-                                            if (m->prop[i].value.textureid == M3D_UNDEF) {
-                                                M3D_LOG("Texture not found");
-                                                M3D_LOG(m->name);
-                                                m->numprop--;
+                                        if (n != 256 && k != 256) {
+                                            ptr = _m3d_findarg(ptr);
+                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                            j = m->numprop++;
+                                            m->prop = (m3dp_t*)M3D_REALLOC(m->prop, m->numprop * sizeof(m3dp_t));
+                                            if (!m->prop) goto memerr;
+                                            m->prop[j].type = n + (k == m3dpf_map && n < 128 ? 128 : 0);
+                                            switch (k) {
+                                            case m3dpf_color: ptr = _m3d_gethex(ptr, &m->prop[j].value.color); break;
+                                            case m3dpf_uint8:
+                                            case m3dpf_uint16:
+                                            case m3dpf_uint32: ptr = _m3d_getint(ptr, &m->prop[j].value.num); break;
+                                            case m3dpf_float:  ptr = _m3d_getfloat(ptr, &m->prop[j].value.fnum); break;
+                                            case m3dpf_map:
+                                                pe = _m3d_safestr(ptr, 0);
+                                                if (!pe || !*pe) goto asciiend;
+                                                m->prop[j].value.textureid = _m3d_gettx(model, readfilecb, freecb, pe);
+                                                if (model->errcode == M3D_ERR_ALLOC) { M3D_FREE(pe); goto memerr; }
+                                                /* this error code only returned if readfilecb was specified */
+                                                if (m->prop[j].value.textureid == M3D_UNDEF) {
+                                                    M3D_LOG("Texture not found");
+                                                    M3D_LOG(pe);
+                                                    m->numprop--;
+                                                }
+                                                M3D_FREE(pe);
+                                                break;
                                             }
-                                            break;
-
-                                        default:
+                                        }
+                                        else {
                                             M3D_LOG("Unknown material property in");
                                             M3D_LOG(m->name);
                                             model->errcode = M3D_ERR_UNKPROP;
-                                            data = chunk;
-                                            break;
                                         }
-                                    }
-                                    m->prop = (m3dp_t*)M3D_REALLOC(m->prop, m->numprop * sizeof(m3dp_t));
-                                    if (!m->prop) goto memerr;
-                                }
-                            }
-                            else
-                                /* face */
-                                if (M3D_CHUNKMAGIC(data, 'P', 'R', 'O', 'C')) {
-                                    /* procedural surface */
-                                    M3D_GETSTR(name);
-                                    M3D_LOG("Procedural surface");
-                                    M3D_LOG(name);
-                                    _m3d_getpr(model, readfilecb, freecb, name);
+                                        ptr = _m3d_findnl(ptr);
+                                    }
+                                    if (!m->numprop) model->nummaterial--;
                                 }
                                 else
-                                    if (M3D_CHUNKMAGIC(data, 'M', 'E', 'S', 'H')) {
-                                        M3D_LOG("Mesh data");
-                                        if (!model->vertex) { M3D_LOG("No vertex chunk before mesh"); model->errcode = M3D_ERR_VRTS; }
+                                    /* procedural */
+                                    if (!memcmp(pe, "Procedural", 10)) {
+                                        pe = _m3d_safestr(ptr, 0);
+                                        _m3d_getpr(model, readfilecb, freecb, pe);
+                                        M3D_FREE(pe);
+                                        while (*ptr && *ptr != '\r' && *ptr != '\n') ptr = _m3d_findnl(ptr);
+                                    }
+                                    else
                                         /* mesh */
-                                        data += sizeof(m3dchunk_t);
-                                        mi = M3D_UNDEF;
+                                        if (!memcmp(pe, "Mesh", 4)) {
+                                            mi = M3D_UNDEF;
 #ifdef M3D_VERTEXMAX
-                                        pi = M3D_UNDEF;
+                                            pi = M3D_UNDEF;
 #endif
-                                        am = model->numface;
-                                        while (data < chunk) {
-                                            k = *data++;
-                                            n = k >> 4;
-                                            k &= 15;
-                                            if (!n) {
-                                                if (!k) {
-                                                    /* use material */
+                                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                if (*ptr == 'u') {
+                                                    ptr = _m3d_findarg(ptr);
+                                                    if (!*ptr) goto asciiend;
                                                     mi = M3D_UNDEF;
-                                                    M3D_GETSTR(name);
-                                                    if (name) {
+                                                    if (*ptr != '\r' && *ptr != '\n') {
+                                                        pe = _m3d_safestr(ptr, 0);
+                                                        if (!pe || !*pe) goto asciiend;
+                                                        for (j = 0; j < model->nummaterial; j++)
+                                                            if (!strcmp(pe, model->material[j].name)) { mi = (M3D_INDEX)j; break; }
+                                                        if (mi == M3D_UNDEF && !(model->flags & M3D_FLG_MTLLIB)) {
+                                                            mi = model->nummaterial++;
+                                                            model->material = (m3dm_t*)M3D_REALLOC(model->material, model->nummaterial * sizeof(m3dm_t));
+                                                            if (!model->material) goto memerr;
+                                                            model->material[mi].name = pe;
+                                                            model->material[mi].numprop = 1;
+                                                            model->material[mi].prop = NULL;
+                                                        }
+                                                        else
+                                                            M3D_FREE(pe);
+                                                    }
+                                                }
+                                                else
+                                                    if (*ptr == 'p') {
+                                                        ptr = _m3d_findarg(ptr);
+                                                        if (!*ptr) goto asciiend;
+#ifdef M3D_VERTEXMAX
+                                                        pi = M3D_UNDEF;
+                                                        if (*ptr != '\r' && *ptr != '\n') {
+                                                            pe = _m3d_safestr(ptr, 0);
+                                                            if (!pe || !*pe) goto asciiend;
+                                                            for (j = 0; j < model->numparam; j++)
+                                                                if (!strcmp(pe, model->param[j].name)) { pi = (M3D_INDEX)j; break; }
+                                                            if (pi == M3D_UNDEF) {
+                                                                pi = model->numparam++;
+                                                                model->param = (m3dvi_t*)M3D_REALLOC(model->param, model->numparam * sizeof(m3dvi_t));
+                                                                if (!model->param) goto memerr;
+                                                                model->param[pi].name = pe;
+                                                                model->param[pi].count = 0;
+                                                            }
+                                                            else
+                                                                M3D_FREE(pe);
+                                                        }
+#endif
+                                                    }
+                                                    else {
+                                                        i = model->numface++;
+                                                        model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
+                                                        if (!model->face) goto memerr;
+                                                        memset(&model->face[i], 255, sizeof(m3df_t)); /* set all index to -1 by default */
+                                                        model->face[i].materialid = mi;
+#ifdef M3D_VERTEXMAX
+                                                        model->face[i].paramid = pi;
+#endif
+                                                        /* hardcoded triangles. */
+                                                        for (j = 0; j < 3; j++) {
+                                                            /* vertex */
+                                                            ptr = _m3d_getint(ptr, &k);
+                                                            model->face[i].vertex[j] = (M3D_INDEX)k;
+                                                            if (!*ptr) goto asciiend;
+                                                            if (*ptr == '/') {
+                                                                ptr++;
+                                                                if (*ptr != '/') {
+                                                                    /* texcoord */
+                                                                    ptr = _m3d_getint(ptr, &k);
+                                                                    model->face[i].texcoord[j] = (M3D_INDEX)k;
+                                                                    if (!*ptr) goto asciiend;
+                                                                }
+                                                                if (*ptr == '/') {
+                                                                    ptr++;
+                                                                    /* normal */
+                                                                    ptr = _m3d_getint(ptr, &k);
+                                                                    model->face[i].normal[j] = (M3D_INDEX)k;
+                                                                    if (!*ptr) goto asciiend;
+                                                                }
+                                                                if (*ptr == '/') {
+                                                                    ptr++;
+                                                                    /* maximum */
+                                                                    ptr = _m3d_getint(ptr, &k);
+#ifdef M3D_VERTEXMAX
+                                                                    model->face[i].vertmax[j] = (M3D_INDEX)k;
+#endif
+                                                                    if (!*ptr) goto asciiend;
+                                                                }
+                                                            }
+#ifndef M3D_NONORMALS
+                                                            if (model->face[i].normal[j] == M3D_UNDEF) model->flags |= M3D_FLG_NEEDNORM;
+#endif
+                                                            ptr = _m3d_findarg(ptr);
+                                                        }
+                                                    }
+                                                ptr = _m3d_findnl(ptr);
+                                            }
+                                        }
+                                        else
+                                            /* voxel types chunk */
+                                            if (!memcmp(pe, "VoxTypes", 8) || !memcmp(pe, "Voxtypes", 8)) {
+                                                if (model->voxtype) { M3D_LOG("More voxel types chunks, should be unique"); goto asciiend; }
+                                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                    i = model->numvoxtype++;
+                                                    model->voxtype = (m3dvt_t*)M3D_REALLOC(model->voxtype, model->numvoxtype * sizeof(m3dvt_t));
+                                                    if (!model->voxtype) goto memerr;
+                                                    memset(&model->voxtype[i], 0, sizeof(m3dvt_t));
+                                                    model->voxtype[i].materialid = M3D_UNDEF;
+                                                    model->voxtype[i].skinid = M3D_UNDEF;
+                                                    ptr = _m3d_gethex(ptr, &model->voxtype[i].color);
+                                                    if (!*ptr) goto asciiend;
+                                                    if (*ptr == '/') {
+                                                        ptr = _m3d_gethex(ptr, &k);
+                                                        model->voxtype[i].rotation = k;
+                                                        if (!*ptr) goto asciiend;
+                                                        if (*ptr == '/') {
+                                                            ptr = _m3d_gethex(ptr, &k);
+                                                            model->voxtype[i].voxshape = k;
+                                                            if (!*ptr) goto asciiend;
+                                                        }
+                                                    }
+                                                    while (*ptr == ' ' || *ptr == '\t') ptr++;
+                                                    if (*ptr == '\r' || *ptr == '\n') { ptr = _m3d_findnl(ptr); continue; }
+                                                    /* name */
+                                                    if (*ptr != '-') {
+                                                        pe = _m3d_safestr(ptr, 0);
+                                                        if (!pe || !*pe) goto asciiend;
+                                                        model->voxtype[i].name = pe;
                                                         for (j = 0; j < model->nummaterial; j++)
-                                                            if (!strcmp(name, model->material[j].name)) {
-                                                                mi = (M3D_INDEX)j;
-                                                                break;
+                                                            if (!strcmp(pe, model->material[j].name)) { model->voxtype[i].materialid = (M3D_INDEX)j; break; }
+                                                    }
+                                                    ptr = _m3d_findarg(ptr);
+                                                    /* parse skin */
+                                                    memset(&s, 0, sizeof(m3ds_t));
+                                                    for (j = 0, w = (M3D_FLOAT)0.0; j < M3D_NUMBONE && *ptr && *ptr != '{' && *ptr != '\r' && *ptr != '\n'; j++) {
+                                                        ptr = _m3d_getint(ptr, &k);
+                                                        s.boneid[j] = (M3D_INDEX)k;
+                                                        if (*ptr == ':') {
+                                                            ptr++;
+                                                            ptr = _m3d_getfloat(ptr, &s.weight[j]);
+                                                            w += s.weight[j];
+                                                        }
+                                                        else if (!j)
+                                                            s.weight[j] = (M3D_FLOAT)1.0;
+                                                        if (!*ptr) goto asciiend;
+                                                        ptr = _m3d_findarg(ptr);
+                                                    }
+                                                    if (s.boneid[0] != M3D_UNDEF && s.weight[0] > (M3D_FLOAT)0.0) {
+                                                        if (w != (M3D_FLOAT)1.0 && w != (M3D_FLOAT)0.0)
+                                                            for (j = 0; j < M3D_NUMBONE && s.weight[j] >(M3D_FLOAT)0.0; j++)
+                                                                s.weight[j] /= w;
+                                                        k = M3D_NOTDEFINED;
+                                                        if (model->skin) {
+                                                            for (j = 0; j < model->numskin; j++)
+                                                                if (!memcmp(&model->skin[j], &s, sizeof(m3ds_t))) { k = j; break; }
+                                                        }
+                                                        if (k == M3D_NOTDEFINED) {
+                                                            k = model->numskin++;
+                                                            model->skin = (m3ds_t*)M3D_REALLOC(model->skin, model->numskin * sizeof(m3ds_t));
+                                                            if (!model->skin) goto memerr;
+                                                            memcpy(&model->skin[k], &s, sizeof(m3ds_t));
+                                                        }
+                                                        model->voxtype[i].skinid = (M3D_INDEX)k;
+                                                    }
+                                                    /* parse item list */
+                                                    if (*ptr == '{') {
+                                                        while (*ptr == '{' || *ptr == ' ' || *ptr == '\t') ptr++;
+                                                        while (*ptr && *ptr != '}' && *ptr != '\r' && *ptr != '\n') {
+                                                            ptr = _m3d_getint(ptr, &k);
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '}' || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            pe = _m3d_safestr(ptr, 0);
+                                                            if (!pe || !*pe) goto asciiend;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            j = model->voxtype[i].numitem++;
+                                                            model->voxtype[i].item = (m3dvi_t*)M3D_REALLOC(model->voxtype[i].item,
+                                                                model->voxtype[i].numitem * sizeof(m3dvi_t));
+                                                            if (!model->voxtype[i].item) goto memerr;
+                                                            model->voxtype[i].item[j].count = k;
+                                                            model->voxtype[i].item[j].name = pe;
+                                                        }
+                                                        if (*ptr != '}') goto asciiend;
+                                                    }
+                                                    ptr = _m3d_findnl(ptr);
+                                                }
+                                            }
+                                            else
+                                                /* voxel data */
+                                                if (!memcmp(pe, "Voxel", 5)) {
+                                                    if (!model->voxtype) { M3D_LOG("No voxel type chunk before voxel data"); goto asciiend; }
+                                                    pe = _m3d_findarg(pe);
+                                                    if (!*pe) goto asciiend;
+                                                    if (*pe == '\r' || *pe == '\n') pe = NULL;
+                                                    else pe = _m3d_safestr(pe, 0);
+                                                    i = model->numvoxel++;
+                                                    model->voxel = (m3dvx_t*)M3D_REALLOC(model->voxel, model->numvoxel * sizeof(m3dvx_t));
+                                                    if (!model->voxel) goto memerr;
+                                                    memset(&model->voxel[i], 0, sizeof(m3dvx_t));
+                                                    model->voxel[i].name = pe;
+                                                    k = l = 0;
+                                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                        switch (*ptr) {
+                                                        case 'u':
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].uncertain = ((n > 0 && n < 256 ? n : 0) * 255) / 100;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                                ptr = _m3d_getint(ptr, &n);
+                                                                model->voxel[i].groupid = n > 0 && n < 256 ? n : 0;
+                                                            }
+                                                            break;
+                                                        case 'p':
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].x = n;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].y = n;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].z = n;
+                                                            break;
+                                                        case 'd':
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].w = n;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].h = n;
+                                                            ptr = _m3d_findarg(ptr);
+                                                            if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                            ptr = _m3d_getint(ptr, &n);
+                                                            model->voxel[i].d = n;
+                                                            break;
+                                                        case 'l':
+                                                            if (model->voxel[i].data) { l++; k = 0; }
+                                                            else {
+                                                                if (!model->voxel[i].w || !model->voxel[i].h || !model->voxel[i].d) {
+                                                                    M3D_LOG("No voxel dimension before layer data");
+                                                                    goto asciiend;
+                                                                }
+                                                                model->voxel[i].data = (M3D_VOXEL*)M3D_MALLOC(
+                                                                    model->voxel[i].w * model->voxel[i].h * model->voxel[i].d * sizeof(M3D_VOXEL));
+                                                                if (!model->voxel[i].data) goto memerr;
                                                             }
-                                                        if (mi == M3D_UNDEF) model->errcode = M3D_ERR_MTRL;
-                                                    }
-                                                }
-                                                else {
-                                                    /* use parameter */
-                                                    M3D_GETSTR(name);
-#ifdef M3D_VERTEXMAX
-                                                    pi = M3D_UNDEF;
-                                                    if (name) {
-                                                        for (j = 0; j < model->numparam; j++)
-                                                            if (!strcmp(name, model->param[j].name)) {
-                                                                pi = (M3D_INDEX)j;
-                                                                break;
+                                                            break;
+                                                        default:
+                                                            if (!model->voxel[i].data || l >= model->voxel[i].h || k >= model->voxel[i].d) {
+                                                                M3D_LOG("Missing voxel attributes or out of bound data");
+                                                                goto asciiend;
+                                                            }
+                                                            for (n = l * model->voxel[i].w * model->voxel[i].d + k * model->voxel[i].w;
+                                                                j < model->voxel[i].w && *ptr && *ptr != '\r' && *ptr != '\n'; j++) {
+                                                                ptr = _m3d_getint(ptr, &am);
+                                                                if (am >= model->numvoxtype) goto asciiend;
+                                                                model->voxel[i].data[n + j] = am;
                                                             }
-                                                        if (pi == M3D_UNDEF) {
-                                                            pi = model->numparam++;
-                                                            model->param = (m3dvi_t*)M3D_REALLOC(model->param, model->numparam * sizeof(m3dvi_t));
-                                                            if (!model->param) goto memerr;
-                                                            model->param[pi].name = name;
-                                                            model->param[pi].count = 0;
+                                                            k++;
+                                                            break;
                                                         }
+                                                        ptr = _m3d_findnl(ptr);
                                                     }
-#endif
-                                                }
-                                                continue;
-                                            }
-                                            if (n != 3) { M3D_LOG("Only triangle mesh supported for now"); model->errcode = M3D_ERR_UNKMESH; return model; }
-                                            i = model->numface++;
-                                            if (model->numface > am) {
-                                                am = model->numface + 4095;
-                                                model->face = (m3df_t*)M3D_REALLOC(model->face, am * sizeof(m3df_t));
-                                                if (!model->face) goto memerr;
-                                            }
-                                            memset(&model->face[i], 255, sizeof(m3df_t)); /* set all index to -1 by default */
-                                            model->face[i].materialid = mi;
-#ifdef M3D_VERTEXMAX
-                                            model->face[i].paramid = pi;
-#endif
-                                            for (j = 0; data < chunk && j < n; j++) {
-                                                /* vertex */
-                                                data = _m3d_getidx(data, model->vi_s, &model->face[i].vertex[j]);
-                                                /* texcoord */
-                                                if (k & 1)
-                                                    data = _m3d_getidx(data, model->ti_s, &model->face[i].texcoord[j]);
-                                                /* normal */
-                                                if (k & 2)
-                                                    data = _m3d_getidx(data, model->vi_s, &model->face[i].normal[j]);
-#ifndef M3D_NONORMALS
-                                                if (model->face[i].normal[j] == M3D_UNDEF) neednorm = 1;
-#endif
-                                                /* maximum */
-                                                if (k & 4)
-#ifdef M3D_VERTEXMAX
-                                                    data = _m3d_getidx(data, model->vi_s, &model->face[i].vertmax[j]);
-#else
-                                                    data += model->vi_s;
-#endif
-                                            }
-                                            if (j != n) { M3D_LOG("Invalid mesh"); model->numface = 0; model->errcode = M3D_ERR_UNKMESH; return model; }
-                                        }
-                                        model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
-                                    }
-                                    else
-                                        if (M3D_CHUNKMAGIC(data, 'V', 'O', 'X', 'T')) {
-                                            /* voxel types */
-                                            M3D_LOG("Voxel types list");
-                                            if (model->voxtype) { M3D_LOG("More voxel type chunks, should be unique"); model->errcode = M3D_ERR_VOXT; continue; }
-                                            if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
-                                            reclen = model->ci_s + model->si_s + 3 + model->sk_s;
-                                            k = len / reclen;
-                                            model->voxtype = (m3dvt_t*)M3D_MALLOC(k * sizeof(m3dvt_t));
-                                            if (!model->voxtype) goto memerr;
-                                            memset(model->voxtype, 0, k * sizeof(m3dvt_t));
-                                            model->numvoxtype = 0;
-                                            for (i = 0, data += sizeof(m3dchunk_t); data < chunk && i < k; i++) {
-                                                switch (model->ci_s) {
-                                                case 1: model->voxtype[i].color = model->cmap ? model->cmap[data[0]] : 0; data++; break;
-                                                case 2: model->voxtype[i].color = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
-                                                case 4: model->voxtype[i].color = *((uint32_t*)data); data += 4; break;
-                                                    /* case 8: break; */
-                                                }
-                                                M3D_GETSTR(name);
-                                                model->voxtype[i].materialid = M3D_UNDEF;
-                                                if (name) {
-                                                    model->voxtype[i].name = name;
-                                                    /*
-                                                                        for(j = 0; j < model->nummaterial; j++)
-                                                                            if(!strcmp(name, model->material[j].name)) {
-                                                                                model->voxtype[i].materialid = (M3D_INDEX)j;
-                                                                                break;
-                                                                            }
-                                                    */
-                                                }
-                                                j = *data++;
-                                                model->voxtype[i].rotation = j & 0xBF;
-                                                model->voxtype[i].voxshape = ((j & 0x40) << 2) | *data++;
-                                                model->voxtype[i].numitem = *data++;
-                                                model->voxtype[i].skinid = M3D_UNDEF;
-                                                data = _m3d_getidx(data, model->sk_s, &model->voxtype[i].skinid);
-                                                if (model->voxtype[i].numitem) {
-                                                    model->voxtype[i].item = (m3dvi_t*)M3D_MALLOC(model->voxtype[i].numitem * sizeof(m3dvi_t));
-                                                    if (!model->voxtype[i].item) goto memerr;
-                                                    memset(model->voxtype[i].item, 0, model->voxtype[i].numitem * sizeof(m3dvi_t));
-                                                    for (j = 0; j < model->voxtype[i].numitem; j++) {
-                                                        model->voxtype[i].item[j].count = *data++;
-                                                        model->voxtype[i].item[j].count |= (*data++) << 8;
-                                                        M3D_GETSTR(model->voxtype[i].item[j].name);
-                                                    }
-                                                }
-                                            }
-                                            model->numvoxtype = i;
-                                            if (k != model->numvoxtype) {
-                                                model->voxtype = (m3dvt_t*)M3D_REALLOC(model->voxtype, model->numvoxtype * sizeof(m3dvt_t));
-                                                if (!model->voxtype) goto memerr;
-                                            }
-                                        }
-                                        else
-                                            if (M3D_CHUNKMAGIC(data, 'V', 'O', 'X', 'D')) {
-                                                /* voxel data */
-                                                data += sizeof(m3dchunk_t);
-                                                M3D_GETSTR(name);
-                                                M3D_LOG("Voxel Data Layer");
-                                                M3D_LOG(name);
-                                                if (model->vd_s > 4 || model->vp_s > 2) { M3D_LOG("No voxel index size"); model->errcode = M3D_ERR_UNKVOX; continue; }
-                                                if (!model->voxtype) { M3D_LOG("No voxel type chunk before voxel data"); model->errcode = M3D_ERR_VOXT; }
-                                                i = model->numvoxel++;
-                                                model->voxel = (m3dvx_t*)M3D_REALLOC(model->voxel, model->numvoxel * sizeof(m3dvx_t));
-                                                if (!model->voxel) goto memerr;
-                                                memset(&model->voxel[i], 0, sizeof(m3dvx_t));
-                                                model->voxel[i].name = name;
-                                                switch (model->vd_s) {
-                                                case 1:
-                                                    model->voxel[i].x = (int32_t)((int8_t)data[0]);
-                                                    model->voxel[i].y = (int32_t)((int8_t)data[1]);
-                                                    model->voxel[i].z = (int32_t)((int8_t)data[2]);
-                                                    model->voxel[i].w = (uint32_t)(data[3]);
-                                                    model->voxel[i].h = (uint32_t)(data[4]);
-                                                    model->voxel[i].d = (uint32_t)(data[5]);
-                                                    data += 6;
-                                                    break;
-                                                case 2:
-                                                    model->voxel[i].x = (int32_t)(*((int16_t*)(data + 0)));
-                                                    model->voxel[i].y = (int32_t)(*((int16_t*)(data + 2)));
-                                                    model->voxel[i].z = (int32_t)(*((int16_t*)(data + 4)));
-                                                    model->voxel[i].w = (uint32_t)(*((uint16_t*)(data + 6)));
-                                                    model->voxel[i].h = (uint32_t)(*((uint16_t*)(data + 8)));
-                                                    model->voxel[i].d = (uint32_t)(*((uint16_t*)(data + 10)));
-                                                    data += 12;
-                                                    break;
-                                                case 4:
-                                                    model->voxel[i].x = *((int32_t*)(data + 0));
-                                                    model->voxel[i].y = *((int32_t*)(data + 4));
-                                                    model->voxel[i].z = *((int32_t*)(data + 8));
-                                                    model->voxel[i].w = *((uint32_t*)(data + 12));
-                                                    model->voxel[i].h = *((uint32_t*)(data + 16));
-                                                    model->voxel[i].d = *((uint32_t*)(data + 20));
-                                                    data += 24;
-                                                    break;
-                                                }
-                                                model->voxel[i].uncertain = *data++;
-                                                model->voxel[i].groupid = *data++;
-                                                k = model->voxel[i].w * model->voxel[i].h * model->voxel[i].d;
-                                                model->voxel[i].data = (M3D_VOXEL*)M3D_MALLOC(k * sizeof(M3D_VOXEL));
-                                                if (!model->voxel[i].data) goto memerr;
-                                                memset(model->voxel[i].data, 0xff, k * sizeof(M3D_VOXEL));
-                                                for (j = 0; data < chunk && j < k;) {
-                                                    l = ((*data++) & 0x7F) + 1;
-                                                    if (data[-1] & 0x80) {
-                                                        data = _m3d_getidx(data, model->vp_s, &mi);
-                                                        while (l-- && j < k) model->voxel[i].data[j++] = (M3D_VOXEL)mi;
-                                                    }
-                                                    else
-                                                        while (l-- && j < k) {
-                                                            data = _m3d_getidx(data, model->vp_s, &mi);
-                                                            model->voxel[i].data[j++] = (M3D_VOXEL)mi;
-                                                        }
                                                 }
-                                            }
-                                            else
-                                                if (M3D_CHUNKMAGIC(data, 'S', 'H', 'P', 'E')) {
+                                                else
                                                     /* mathematical shape */
-                                                    data += sizeof(m3dchunk_t);
-                                                    M3D_GETSTR(name);
-                                                    M3D_LOG("Mathematical Shape");
-                                                    M3D_LOG(name);
-                                                    i = model->numshape++;
-                                                    model->shape = (m3dh_t*)M3D_REALLOC(model->shape, model->numshape * sizeof(m3dh_t));
-                                                    if (!model->shape) goto memerr;
-                                                    h = &model->shape[i];
-                                                    h->numcmd = 0;
-                                                    h->cmd = NULL;
-                                                    h->name = name;
-                                                    h->group = M3D_UNDEF;
-                                                    data = _m3d_getidx(data, model->bi_s, &h->group);
-                                                    if (h->group != M3D_UNDEF && h->group >= model->numbone) {
-                                                        M3D_LOG("Unknown bone id as shape group in shape");
-                                                        M3D_LOG(name);
+                                                    if (!memcmp(pe, "Shape", 5)) {
+                                                        pe = _m3d_findarg(pe);
+                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                        pe = _m3d_safestr(pe, 0);
+                                                        if (!pe || !*pe) goto asciiend;
+                                                        i = model->numshape++;
+                                                        model->shape = (m3dh_t*)M3D_REALLOC(model->shape, model->numshape * sizeof(m3ds_t));
+                                                        if (!model->shape) goto memerr;
+                                                        h = &model->shape[i];
+                                                        h->name = pe;
                                                         h->group = M3D_UNDEF;
-                                                        model->errcode = M3D_ERR_SHPE;
-                                                    }
-                                                    while (data < chunk) {
-                                                        i = h->numcmd++;
-                                                        h->cmd = (m3dc_t*)M3D_REALLOC(h->cmd, h->numcmd * sizeof(m3dc_t));
-                                                        if (!h->cmd) goto memerr;
-                                                        h->cmd[i].type = *data++;
-                                                        if (h->cmd[i].type & 0x80) {
-                                                            h->cmd[i].type &= 0x7F;
-                                                            h->cmd[i].type |= (*data++ << 7);
-                                                        }
-                                                        if (h->cmd[i].type >= (unsigned int)(sizeof(m3d_commandtypes) / sizeof(m3d_commandtypes[0]))) {
-                                                            M3D_LOG("Unknown shape command in");
-                                                            M3D_LOG(h->name);
-                                                            model->errcode = M3D_ERR_UNKCMD;
-                                                            break;
-                                                        }
-                                                        cd = &m3d_commandtypes[h->cmd[i].type];
-                                                        h->cmd[i].arg = (uint32_t*)M3D_MALLOC(cd->p * sizeof(uint32_t));
-                                                        if (!h->cmd[i].arg) goto memerr;
-                                                        memset(h->cmd[i].arg, 0, cd->p * sizeof(uint32_t));
-                                                        for (k = n = 0, l = cd->p; k < l; k++)
-                                                            switch (cd->a[((k - n) % (cd->p - n)) + n]) {
-                                                            case m3dcp_mi_t:
-                                                                h->cmd[i].arg[k] = M3D_NOTDEFINED;
-                                                                M3D_GETSTR(name);
-                                                                if (name) {
-                                                                    for (n = 0; n < model->nummaterial; n++)
-                                                                        if (!strcmp(name, model->material[n].name)) {
-                                                                            h->cmd[i].arg[k] = n;
-                                                                            break;
-                                                                        }
-                                                                    if (h->cmd[i].arg[k] == M3D_NOTDEFINED) model->errcode = M3D_ERR_MTRL;
+                                                        h->numcmd = 0;
+                                                        h->cmd = NULL;
+                                                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                            if (!memcmp(ptr, "group", 5)) {
+                                                                ptr = _m3d_findarg(ptr);
+                                                                ptr = _m3d_getint(ptr, &h->group);
+                                                                ptr = _m3d_findnl(ptr);
+                                                                if (h->group != M3D_UNDEF && h->group >= model->numbone) {
+                                                                    M3D_LOG("Unknown bone id as shape group in shape");
+                                                                    M3D_LOG(pe);
+                                                                    h->group = M3D_UNDEF;
+                                                                    model->errcode = M3D_ERR_SHPE;
                                                                 }
-                                                                break;
-                                                            case m3dcp_vc_t:
-                                                                f = 0.0f;
-                                                                switch (model->vc_s) {
-                                                                case 1: f = (float)((int8_t)data[0]) / 127; break;
-                                                                case 2: f = (float)(*((int16_t*)(data + 0))) / 32767; break;
-                                                                case 4: f = (float)(*((float*)(data + 0))); break;
-                                                                case 8: f = (float)(*((double*)(data + 0))); break;
+                                                                continue;
+                                                            }
+                                                            for (cd = NULL, k = 0; k < (unsigned int)(sizeof(m3d_commandtypes) / sizeof(m3d_commandtypes[0])); k++) {
+                                                                j = (unsigned int)strlen(m3d_commandtypes[k].key);
+                                                                if (!memcmp(ptr, m3d_commandtypes[k].key, j) && (ptr[j] == ' ' || ptr[j] == '\r' || ptr[j] == '\n'))
+                                                                {
+                                                                    cd = &m3d_commandtypes[k]; break;
                                                                 }
-                                                                memcpy(&h->cmd[i].arg[k], &f, 4);
-                                                                data += model->vc_s;
-                                                                break;
-                                                            case m3dcp_hi_t: data = _m3d_getidx(data, model->hi_s, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_fi_t: data = _m3d_getidx(data, model->fi_s, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_ti_t: data = _m3d_getidx(data, model->ti_s, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_qi_t:
-                                                            case m3dcp_vi_t: data = _m3d_getidx(data, model->vi_s, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_i1_t: data = _m3d_getidx(data, 1, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_i2_t: data = _m3d_getidx(data, 2, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_i4_t: data = _m3d_getidx(data, 4, &h->cmd[i].arg[k]); break;
-                                                            case m3dcp_va_t: data = _m3d_getidx(data, 4, &h->cmd[i].arg[k]);
-                                                                n = k + 1; l += (h->cmd[i].arg[k] - 1) * (cd->p - k - 1);
-                                                                h->cmd[i].arg = (uint32_t*)M3D_REALLOC(h->cmd[i].arg, l * sizeof(uint32_t));
-                                                                if (!h->cmd[i].arg) goto memerr;
-                                                                memset(&h->cmd[i].arg[k + 1], 0, (l - k - 1) * sizeof(uint32_t));
-                                                                break;
                                                             }
-                                                    }
-                                                }
-                                                else
-                                                    /* annotation label list */
-                                                    if (M3D_CHUNKMAGIC(data, 'L', 'B', 'L', 'S')) {
-                                                        data += sizeof(m3dchunk_t);
-                                                        M3D_GETSTR(name);
-                                                        M3D_GETSTR(lang);
-                                                        M3D_LOG("Label list");
-                                                        if (name) { M3D_LOG(name); }
-                                                        if (lang) { M3D_LOG(lang); }
-                                                        if (model->ci_s && model->ci_s < 4 && !model->cmap) model->errcode = M3D_ERR_CMAP;
-                                                        k = 0;
-                                                        switch (model->ci_s) {
-                                                        case 1: k = model->cmap ? model->cmap[data[0]] : 0; data++; break;
-                                                        case 2: k = model->cmap ? model->cmap[*((uint16_t*)data)] : 0; data += 2; break;
-                                                        case 4: k = *((uint32_t*)data); data += 4; break;
-                                                            /* case 8: break; */
-                                                        }
-                                                        reclen = model->vi_s + model->si_s;
-                                                        i = model->numlabel; model->numlabel += len / reclen;
-                                                        model->label = (m3dl_t*)M3D_REALLOC(model->label, model->numlabel * sizeof(m3dl_t));
-                                                        if (!model->label) goto memerr;
-                                                        memset(&model->label[i], 0, (model->numlabel - i) * sizeof(m3dl_t));
-                                                        for (; data < chunk && i < model->numlabel; i++) {
-                                                            model->label[i].name = name;
-                                                            model->label[i].lang = lang;
-                                                            model->label[i].color = k;
-                                                            data = _m3d_getidx(data, model->vi_s, &model->label[i].vertexid);
-                                                            M3D_GETSTR(model->label[i].text);
+                                                            if (cd) {
+                                                                j = h->numcmd++;
+                                                                h->cmd = (m3dc_t*)M3D_REALLOC(h->cmd, h->numcmd * sizeof(m3dc_t));
+                                                                if (!h->cmd) goto memerr;
+                                                                h->cmd[j].type = k;
+                                                                h->cmd[j].arg = (uint32_t*)M3D_MALLOC(cd->p * sizeof(uint32_t));
+                                                                if (!h->cmd[j].arg) goto memerr;
+                                                                memset(h->cmd[j].arg, 0, cd->p * sizeof(uint32_t));
+                                                                for (k = n = 0, l = cd->p; k < l; k++) {
+                                                                    ptr = _m3d_findarg(ptr);
+                                                                    if (!*ptr) goto asciiend;
+                                                                    if (*ptr == '[') {
+                                                                        ptr = _m3d_findarg(ptr + 1);
+                                                                        if (!*ptr) goto asciiend;
+                                                                    }
+                                                                    if (*ptr == ']' || *ptr == '\r' || *ptr == '\n') break;
+                                                                    switch (cd->a[((k - n) % (cd->p - n)) + n]) {
+                                                                    case m3dcp_mi_t:
+                                                                        mi = M3D_UNDEF;
+                                                                        if (*ptr != '\r' && *ptr != '\n') {
+                                                                            pe = _m3d_safestr(ptr, 0);
+                                                                            if (!pe || !*pe) goto asciiend;
+                                                                            for (n = 0; n < model->nummaterial; n++)
+                                                                                if (!strcmp(pe, model->material[n].name)) { mi = (M3D_INDEX)n; break; }
+                                                                            if (mi == M3D_UNDEF && !(model->flags & M3D_FLG_MTLLIB)) {
+                                                                                mi = model->nummaterial++;
+                                                                                model->material = (m3dm_t*)M3D_REALLOC(model->material,
+                                                                                    model->nummaterial * sizeof(m3dm_t));
+                                                                                if (!model->material) goto memerr;
+                                                                                model->material[mi].name = pe;
+                                                                                model->material[mi].numprop = 1;
+                                                                                model->material[mi].prop = NULL;
+                                                                            }
+                                                                            else
+                                                                                M3D_FREE(pe);
+                                                                        }
+                                                                        h->cmd[j].arg[k] = mi;
+                                                                        break;
+                                                                    case m3dcp_vc_t:
+#ifdef M3D_DOUBLE
+                                                                        _m3d_getfloat(ptr, &w); f = w;
+                                                                        memcpy(&h->cmd[j].arg[k], &f, 4);
+#else
+                                                                        _m3d_getfloat(ptr, (float*)&h->cmd[j].arg[k]);
+#endif
+                                                                        break;
+                                                                    case m3dcp_va_t:
+                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
+                                                                        n = k + 1; l += (h->cmd[j].arg[k] - 1) * (cd->p - k - 1);
+                                                                        h->cmd[j].arg = (uint32_t*)M3D_REALLOC(h->cmd[j].arg, l * sizeof(uint32_t));
+                                                                        if (!h->cmd[j].arg) goto memerr;
+                                                                        memset(&h->cmd[j].arg[k + 1], 0, (l - k - 1) * sizeof(uint32_t));
+                                                                        break;
+                                                                    case m3dcp_qi_t:
+                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
+                                                                        model->vertex[h->cmd[i].arg[k]].skinid = M3D_INDEXMAX;
+                                                                        break;
+                                                                    default:
+                                                                        ptr = _m3d_getint(ptr, &h->cmd[j].arg[k]);
+                                                                        break;
+                                                                    }
+                                                                }
+                                                            }
+                                                            else {
+                                                                M3D_LOG("Unknown shape command in");
+                                                                M3D_LOG(h->name);
+                                                                model->errcode = M3D_ERR_UNKCMD;
+                                                            }
+                                                            ptr = _m3d_findnl(ptr);
                                                         }
+                                                        if (!h->numcmd) model->numshape--;
                                                     }
                                                     else
-                                                        /* action */
-                                                        if (M3D_CHUNKMAGIC(data, 'A', 'C', 'T', 'N')) {
-                                                            M3D_LOG("Action");
-                                                            i = model->numaction++;
-                                                            model->action = (m3da_t*)M3D_REALLOC(model->action, model->numaction * sizeof(m3da_t));
-                                                            if (!model->action) goto memerr;
-                                                            a = &model->action[i];
-                                                            data += sizeof(m3dchunk_t);
-                                                            M3D_GETSTR(a->name);
-                                                            M3D_LOG(a->name);
-                                                            a->numframe = *((uint16_t*)data); data += 2;
-                                                            if (a->numframe < 1) {
-                                                                model->numaction--;
+                                                        /* annotation labels */
+                                                        if (!memcmp(pe, "Labels", 6)) {
+                                                            pe = _m3d_findarg(pe);
+                                                            if (!*pe) goto asciiend;
+                                                            if (*pe == '\r' || *pe == '\n') pe = NULL;
+                                                            else pe = _m3d_safestr(pe, 0);
+                                                            k = 0; fn = NULL;
+                                                            while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                                if (*ptr == 'c') {
+                                                                    ptr = _m3d_findarg(ptr);
+                                                                    if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                    ptr = _m3d_gethex(ptr, &k);
+                                                                }
+                                                                else
+                                                                    if (*ptr == 'l') {
+                                                                        ptr = _m3d_findarg(ptr);
+                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                        fn = _m3d_safestr(ptr, 2);
+                                                                    }
+                                                                    else {
+                                                                        i = model->numlabel++;
+                                                                        model->label = (m3dl_t*)M3D_REALLOC(model->label, model->numlabel * sizeof(m3dl_t));
+                                                                        if (!model->label) goto memerr;
+                                                                        model->label[i].name = pe;
+                                                                        model->label[i].lang = fn;
+                                                                        model->label[i].color = k;
+                                                                        ptr = _m3d_getint(ptr, &j);
+                                                                        model->label[i].vertexid = (M3D_INDEX)j;
+                                                                        ptr = _m3d_findarg(ptr);
+                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                        model->label[i].text = _m3d_safestr(ptr, 2);
+                                                                    }
+                                                                ptr = _m3d_findnl(ptr);
+                                                            }
+                                                        }
+                                                        else
+                                                            /* action */
+                                                            if (!memcmp(pe, "Action", 6)) {
+                                                                pe = _m3d_findarg(pe);
+                                                                if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                pe = _m3d_getint(pe, &k);
+                                                                pe = _m3d_findarg(pe);
+                                                                if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                pe = _m3d_safestr(pe, 0);
+                                                                if (!pe || !*pe) goto asciiend;
+                                                                i = model->numaction++;
+                                                                model->action = (m3da_t*)M3D_REALLOC(model->action, model->numaction * sizeof(m3da_t));
+                                                                if (!model->action) goto memerr;
+                                                                a = &model->action[i];
+                                                                a->name = pe;
+                                                                a->durationmsec = k;
+                                                                /* skip the first frame marker as there's always at least one frame */
+                                                                a->numframe = 1;
+                                                                a->frame = (m3dfr_t*)M3D_MALLOC(sizeof(m3dfr_t));
+                                                                if (!a->frame) goto memerr;
+                                                                a->frame[0].msec = 0;
+                                                                a->frame[0].numtransform = 0;
+                                                                a->frame[0].transform = NULL;
+                                                                i = 0;
+                                                                if (*ptr == 'f')
+                                                                    ptr = _m3d_findnl(ptr);
+                                                                while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                                    if (*ptr == 'f') {
+                                                                        i = a->numframe++;
+                                                                        a->frame = (m3dfr_t*)M3D_REALLOC(a->frame, a->numframe * sizeof(m3dfr_t));
+                                                                        if (!a->frame) goto memerr;
+                                                                        ptr = _m3d_findarg(ptr);
+                                                                        ptr = _m3d_getint(ptr, &a->frame[i].msec);
+                                                                        a->frame[i].numtransform = 0;
+                                                                        a->frame[i].transform = NULL;
+                                                                    }
+                                                                    else {
+                                                                        j = a->frame[i].numtransform++;
+                                                                        a->frame[i].transform = (m3dtr_t*)M3D_REALLOC(a->frame[i].transform,
+                                                                            a->frame[i].numtransform * sizeof(m3dtr_t));
+                                                                        if (!a->frame[i].transform) goto memerr;
+                                                                        ptr = _m3d_getint(ptr, &k);
+                                                                        ptr = _m3d_findarg(ptr);
+                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                                        a->frame[i].transform[j].boneid = (M3D_INDEX)k;
+                                                                        ptr = _m3d_getint(ptr, &k);
+                                                                        ptr = _m3d_findarg(ptr);
+                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                                        a->frame[i].transform[j].pos = (M3D_INDEX)k;
+                                                                        ptr = _m3d_getint(ptr, &k);
+                                                                        if (!*ptr || *ptr == '\r' || *ptr == '\n') goto asciiend;
+                                                                        a->frame[i].transform[j].ori = (M3D_INDEX)k;
+                                                                        model->vertex[k].skinid = M3D_INDEXMAX;
+                                                                    }
+                                                                    ptr = _m3d_findnl(ptr);
+                                                                }
                                                             }
-                                                            else {
-                                                                a->durationmsec = *((uint32_t*)data); data += 4;
-                                                                a->frame = (m3dfr_t*)M3D_MALLOC(a->numframe * sizeof(m3dfr_t));
-                                                                if (!a->frame) goto memerr;
-                                                                for (i = 0; data < chunk && i < a->numframe; i++) {
-                                                                    a->frame[i].msec = *((uint32_t*)data); data += 4;
-                                                                    a->frame[i].numtransform = 0; a->frame[i].transform = NULL;
-                                                                    data = _m3d_getidx(data, model->fc_s, &a->frame[i].numtransform);
-                                                                    if (a->frame[i].numtransform > 0) {
-                                                                        a->frame[i].transform = (m3dtr_t*)M3D_MALLOC(a->frame[i].numtransform * sizeof(m3dtr_t));
-                                                                        for (j = 0; j < a->frame[i].numtransform; j++) {
-                                                                            data = _m3d_getidx(data, model->bi_s, &a->frame[i].transform[j].boneid);
-                                                                            data = _m3d_getidx(data, model->vi_s, &a->frame[i].transform[j].pos);
-                                                                            data = _m3d_getidx(data, model->vi_s, &a->frame[i].transform[j].ori);
+                                                            else
+                                                                /* inlined assets chunk */
+                                                                if (!memcmp(pe, "Assets", 6)) {
+                                                                    while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                                        if (readfilecb) {
+                                                                            pe = _m3d_safestr(ptr, 2);
+                                                                            if (!pe || !*pe) goto asciiend;
+                                                                            i = model->numinlined++;
+                                                                            model->inlined = (m3di_t*)M3D_REALLOC(model->inlined, model->numinlined * sizeof(m3di_t));
+                                                                            if (!model->inlined) goto memerr;
+                                                                            model->inlined[i].data = (*readfilecb)(pe, &model->inlined[i].length);
+                                                                            if (model->inlined[i].data) {
+                                                                                fn = strrchr(pe, '.');
+                                                                                if (fn && (fn[1] == 'p' || fn[1] == 'P') && (fn[2] == 'n' || fn[2] == 'N') &&
+                                                                                    (fn[3] == 'g' || fn[3] == 'G')) *fn = 0;
+                                                                                fn = strrchr(pe, '/');
+                                                                                if (!fn) fn = strrchr(pe, '\\');
+                                                                                if (!fn) fn = pe; else fn++;
+                                                                                model->inlined[i].name = _m3d_safestr(fn, 0);
+                                                                            }
+                                                                            else
+                                                                                model->numinlined--;
+                                                                            M3D_FREE(pe);
                                                                         }
+                                                                        ptr = _m3d_findnl(ptr);
                                                                     }
                                                                 }
-                                                            }
-                                                        }
-                                                        else {
-                                                            i = model->numextra++;
-                                                            model->extra = (m3dchunk_t**)M3D_REALLOC(model->extra, model->numextra * sizeof(m3dchunk_t*));
-                                                            if (!model->extra) goto memerr;
-                                                            model->extra[i] = (m3dchunk_t*)data;
-                                                        }
+                                                                else
+                                                                    /* extra chunks */
+                                                                    if (!memcmp(pe, "Extra", 5)) {
+                                                                        pe = _m3d_findarg(pe);
+                                                                        if (!*pe || *pe == '\r' || *pe == '\n') goto asciiend;
+                                                                        buff = (unsigned char*)_m3d_findnl(ptr);
+                                                                        k = ((uint32_t)((uintptr_t)buff - (uintptr_t)ptr) / 3) + 1;
+                                                                        i = model->numextra++;
+                                                                        model->extra = (m3dchunk_t**)M3D_REALLOC(model->extra, model->numextra * sizeof(m3dchunk_t*));
+                                                                        if (!model->extra) goto memerr;
+                                                                        model->extra[i] = (m3dchunk_t*)M3D_MALLOC(k + sizeof(m3dchunk_t));
+                                                                        if (!model->extra[i]) goto memerr;
+                                                                        memcpy(&model->extra[i]->magic, pe, 4);
+                                                                        model->extra[i]->length = sizeof(m3dchunk_t);
+                                                                        pe = (char*)model->extra[i] + sizeof(m3dchunk_t);
+                                                                        while (*ptr && *ptr != '\r' && *ptr != '\n') {
+                                                                            ptr = _m3d_gethex(ptr, &k);
+                                                                            *pe++ = (uint8_t)k;
+                                                                            model->extra[i]->length++;
+                                                                        }
+                                                                    }
+                                                                    else
+                                                                        goto asciiend;
+            }
+            model->errcode = M3D_SUCCESS;
+        asciiend:
+            setlocale(LC_NUMERIC, ol);
+            return _m3d_postprocess(model);
         }
-        /* calculate normals, normalize skin weights, create bone/vertex cross-references and calculate transform matrices */
-#ifdef M3D_ASCII
-        postprocess :
 #endif
-        if (model) {
-            M3D_LOG("Post-process");
+        /* Binary variant */
+        len = ((m3dhdr_t*)data)->length - 8;
+        data += 8;
+        if (M3D_CHUNKMAGIC(data, 'P', 'R', 'V', 'W')) {
+            /* optional preview chunk */
+            model->preview.length = ((m3dchunk_t*)data)->length;
+            model->preview.data = data + sizeof(m3dchunk_t);
+            data += model->preview.length;
+            len -= model->preview.length;
+        }
+        if (!M3D_CHUNKMAGIC(data, 'H', 'E', 'A', 'D')) {
+#ifdef M3D_INFLATE
+            buff = M3D_INFLATE(data, len, &len);
+#else
+            buff = m3d_inflate(data, len, &len);
+#endif
+            if (!buff || !len || !M3D_CHUNKMAGIC(buff, 'H', 'E', 'A', 'D')) {
+                if (buff) M3D_FREE(buff);
+                M3D_FREE(model);
+                return NULL;
+            }
+            buff = (unsigned char*)M3D_REALLOC(buff, len);
+            model->flags |= M3D_FLG_FREERAW; /* mark that we have to free the raw buffer */
+            data = buff;
 #ifdef M3D_PROFILING
             gettimeofday(&tv1, NULL);
             tvd.tv_sec = tv1.tv_sec - tv0.tv_sec;
             tvd.tv_usec = tv1.tv_usec - tv0.tv_usec;
             if (tvd.tv_usec < 0) { tvd.tv_sec--; tvd.tv_usec += 1000000L; }
-            printf("  Parsing chunks  %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
+            printf("  Deflate model   %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
+            memcpy(&tv0, &tv1, sizeof(struct timeval));
 #endif
-#ifndef M3D_NOVOXELS
-            if (model->numvoxel && model->voxel) {
-                M3D_LOG("Converting voxels into vertices and mesh");
-                /* add normals */
-                enorm = model->numvertex; model->numvertex += 6;
-                model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
-                if (!model->vertex) goto memerr;
-                memset(&model->vertex[enorm], 0, 6 * sizeof(m3dv_t));
-                for (l = 0; l < 6; l++)
-                    model->vertex[enorm + l].skinid = M3D_UNDEF;
-                model->vertex[enorm + 0].y = (M3D_FLOAT)-1.0;
-                model->vertex[enorm + 1].z = (M3D_FLOAT)-1.0;
-                model->vertex[enorm + 2].x = (M3D_FLOAT)-1.0;
-                model->vertex[enorm + 3].y = (M3D_FLOAT)1.0;
-                model->vertex[enorm + 4].z = (M3D_FLOAT)1.0;
-                model->vertex[enorm + 5].x = (M3D_FLOAT)1.0;
-                /* this is a fast, not so memory efficient version, only basic face culling used */
-                min_x = min_y = min_z = 2147483647L;
-                max_x = max_y = max_z = -2147483647L;
-                for (i = 0; i < model->numvoxel; i++) {
-                    if (model->voxel[i].x + (int32_t)model->voxel[i].w > max_x) max_x = model->voxel[i].x + (int32_t)model->voxel[i].w;
-                    if (model->voxel[i].x < min_x) min_x = model->voxel[i].x;
-                    if (model->voxel[i].y + (int32_t)model->voxel[i].h > max_y) max_y = model->voxel[i].y + (int32_t)model->voxel[i].h;
-                    if (model->voxel[i].y < min_y) min_y = model->voxel[i].y;
-                    if (model->voxel[i].z + (int32_t)model->voxel[i].d > max_z) max_z = model->voxel[i].z + (int32_t)model->voxel[i].d;
-                    if (model->voxel[i].z < min_z) min_z = model->voxel[i].z;
-                }
-                i = (-min_x > max_x ? -min_x : max_x);
-                j = (-min_y > max_y ? -min_y : max_y);
-                k = (-min_z > max_z ? -min_z : max_z);
-                if (j > i) i = j;
-                if (k > i) i = k;
-                if (i <= 1) i = 1;
-                w = (M3D_FLOAT)1.0 / (M3D_FLOAT)i;
-                if (i >= 254) model->vc_s = 2;
-                if (i >= 65534) model->vc_s = 4;
-                for (i = 0; i < model->numvoxel; i++) {
-                    sx = model->voxel[i].w; sz = model->voxel[i].d; sy = model->voxel[i].h;
-                    for (y = 0, j = 0; y < sy; y++)
-                        for (z = 0; z < sz; z++)
-                            for (x = 0; x < sx; x++, j++)
-                                if (model->voxel[i].data[j] < model->numvoxtype) {
-                                    k = 0;
-                                    /*  16__32     ____
-                                     *  /|  /|    /|2 /|
-                                     *64_128 |   /_8_/ 32
-                                     * | 1_|_2   |4|_|_|
-                                     * |/  |/    |/ 1|/
-                                     * 4___8     |16_|    */
-                                    k = n = am = 0;
-                                    if (!y || model->voxel[i].data[j - sx * sz] >= model->numvoxtype) { n++; am |= 1; k |= 1 | 2 | 4 | 8; }
-                                    if (!z || model->voxel[i].data[j - sx] >= model->numvoxtype) { n++; am |= 2; k |= 1 | 2 | 16 | 32; }
-                                    if (!x || model->voxel[i].data[j - 1] >= model->numvoxtype) { n++; am |= 4; k |= 1 | 4 | 16 | 64; }
-                                    if (y == sy - 1 || model->voxel[i].data[j + sx * sz] >= model->numvoxtype) { n++; am |= 8; k |= 16 | 32 | 64 | 128; }
-                                    if (z == sz - 1 || model->voxel[i].data[j + sx] >= model->numvoxtype) { n++; am |= 16; k |= 4 | 8 | 64 | 128; }
-                                    if (x == sx - 1 || model->voxel[i].data[j + 1] >= model->numvoxtype) { n++; am |= 32; k |= 2 | 8 | 32 | 128; }
-                                    if (k) {
-                                        memset(edge, 255, sizeof(edge));
-                                        for (l = 0, len = 1, reclen = model->numvertex; l < 8; l++, len <<= 1)
-                                            if (k & len) edge[l] = model->numvertex++;
-                                        model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
-                                        if (!model->vertex) goto memerr;
-                                        memset(&model->vertex[reclen], 0, (model->numvertex - reclen) * sizeof(m3dv_t));
-                                        for (l = reclen; l < model->numvertex; l++) {
-                                            model->vertex[l].skinid = model->voxtype[model->voxel[i].data[j]].skinid;
-                                            model->vertex[l].color = model->voxtype[model->voxel[i].data[j]].color;
-                                        }
-                                        l = reclen;
-                                        if (k & 1) {
-                                            model->vertex[l].x = (model->voxel[i].x + x) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z) * w;
-                                            l++;
-                                        }
-                                        if (k & 2) {
-                                            model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z) * w;
-                                            l++;
-                                        }
-                                        if (k & 4) {
-                                            model->vertex[l].x = (model->voxel[i].x + x) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
-                                            l++;
-                                        }
-                                        if (k & 8) {
-                                            model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
-                                            l++;
-                                        }
-                                        if (k & 16) {
-                                            model->vertex[l].x = (model->voxel[i].x + x) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z) * w;
-                                            l++;
-                                        }
-                                        if (k & 32) {
-                                            model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z) * w;
-                                            l++;
-                                        }
-                                        if (k & 64) {
-                                            model->vertex[l].x = (model->voxel[i].x + x) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
-                                            l++;
-                                        }
-                                        if (k & 128) {
-                                            model->vertex[l].x = (model->voxel[i].x + x + 1) * w;
-                                            model->vertex[l].y = (model->voxel[i].y + y + 1) * w;
-                                            model->vertex[l].z = (model->voxel[i].z + z + 1) * w;
-                                            l++;
-                                        }
-                                        n <<= 1;
-                                        l = model->numface; model->numface += n;
-                                        model->face = (m3df_t*)M3D_REALLOC(model->face, model->numface * sizeof(m3df_t));
-                                        if (!model->face) goto memerr;
-                                        memset(&model->face[l], 255, n * sizeof(m3df_t));
-                                        for (reclen = l; reclen < model->numface; reclen++)
-                                            model->face[reclen].materialid = model->voxtype[model->voxel[i].data[j]].materialid;
-                                        if (am & 1) {            /* bottom */
-                                            model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[1];   model->face[l].vertex[2] = edge[2];
-                                            model->face[l + 1].vertex[0] = edge[2]; model->face[l + 1].vertex[1] = edge[1]; model->face[l + 1].vertex[2] = edge[3];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm;
-                                            l += 2;
-                                        }
-                                        if (am & 2) {            /* north */
-                                            model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[4];   model->face[l].vertex[2] = edge[1];
-                                            model->face[l + 1].vertex[0] = edge[1]; model->face[l + 1].vertex[1] = edge[4]; model->face[l + 1].vertex[2] = edge[5];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 1;
-                                            l += 2;
-                                        }
-                                        if (am & 4) {            /* west */
-                                            model->face[l].vertex[0] = edge[0];   model->face[l].vertex[1] = edge[2];   model->face[l].vertex[2] = edge[4];
-                                            model->face[l + 1].vertex[0] = edge[2]; model->face[l + 1].vertex[1] = edge[6]; model->face[l + 1].vertex[2] = edge[4];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 2;
-                                            l += 2;
-                                        }
-                                        if (am & 8) {            /* top */
-                                            model->face[l].vertex[0] = edge[4];   model->face[l].vertex[1] = edge[6];   model->face[l].vertex[2] = edge[5];
-                                            model->face[l + 1].vertex[0] = edge[5]; model->face[l + 1].vertex[1] = edge[6]; model->face[l + 1].vertex[2] = edge[7];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 3;
-                                            l += 2;
-                                        }
-                                        if (am & 16) {           /* south */
-                                            model->face[l].vertex[0] = edge[2];   model->face[l].vertex[1] = edge[7];   model->face[l].vertex[2] = edge[6];
-                                            model->face[l + 1].vertex[0] = edge[7]; model->face[l + 1].vertex[1] = edge[2]; model->face[l + 1].vertex[2] = edge[3];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 4;
-                                            l += 2;
-                                        }
-                                        if (am & 32) {           /* east */
-                                            model->face[l].vertex[0] = edge[1];   model->face[l].vertex[1] = edge[5];   model->face[l].vertex[2] = edge[7];
-                                            model->face[l + 1].vertex[0] = edge[1]; model->face[l + 1].vertex[1] = edge[7]; model->face[l + 1].vertex[2] = edge[3];
-                                            model->face[l].normal[0] = model->face[l].normal[1] = model->face[l].normal[2] =
-                                                model->face[l + 1].normal[0] = model->face[l + 1].normal[1] = model->face[l + 1].normal[2] = enorm + 5;
-                                            l += 2;
-                                        }
-                                    }
-                                }
-                }
+        }
+        model->raw = (m3dhdr_t*)data;
+        end = data + len;
+
+        /* parse header */
+        chunk = (unsigned char*)model->raw + model->raw->length;
+        if (!_m3d_parsehead(model)) {
+            M3D_FREE(model);
+            return NULL;
+        }
+        if (!M3D_CHUNKMAGIC(end - 4, 'O', 'M', 'D', '3')) {
+            M3D_LOG("Missing end chunk");
+            M3D_FREE(model);
+            return NULL;
+        }
+
+        /* look for inlined assets in advance, material and procedural chunks may need them */
+        buff = chunk;
+        while (buff < end && !M3D_CHUNKMAGIC(buff, 'O', 'M', 'D', '3')) {
+            data = buff;
+            len = ((m3dchunk_t*)data)->length;
+            buff += len;
+            if (len < sizeof(m3dchunk_t) || buff >= end) {
+                M3D_LOG("Invalid chunk size");
+                break;
             }
+            /* inlined assets */
+            if (!_m3d_getinlined(model, data)) {
+#ifdef M3D_ASCII
+            memerr:
 #endif
-#ifndef M3D_NONORMALS
-            if (model->numface && model->face && neednorm) {
-                /* if they are missing, calculate triangle normals into a temporary buffer */
-                norm = (m3dv_t*)M3D_MALLOC(model->numface * sizeof(m3dv_t));
-                if (!norm) goto memerr;
-                for (i = 0, n = model->numvertex; i < model->numface; i++)
-                    if (model->face[i].normal[0] == M3D_UNDEF) {
-                        v0 = &model->vertex[model->face[i].vertex[0]];
-                        v1 = &model->vertex[model->face[i].vertex[1]];
-                        v2 = &model->vertex[model->face[i].vertex[2]];
-                        va.x = v1->x - v0->x; va.y = v1->y - v0->y; va.z = v1->z - v0->z;
-                        vb.x = v2->x - v0->x; vb.y = v2->y - v0->y; vb.z = v2->z - v0->z;
-                        v0 = &norm[i];
-                        v0->x = (va.y * vb.z) - (va.z * vb.y);
-                        v0->y = (va.z * vb.x) - (va.x * vb.z);
-                        v0->z = (va.x * vb.y) - (va.y * vb.x);
-                        w = _m3d_rsq((v0->x * v0->x) + (v0->y * v0->y) + (v0->z * v0->z));
-                        v0->x *= w; v0->y *= w; v0->z *= w;
-                        model->face[i].normal[0] = model->face[i].vertex[0] + n;
-                        model->face[i].normal[1] = model->face[i].vertex[1] + n;
-                        model->face[i].normal[2] = model->face[i].vertex[2] + n;
-                    }
-                /* this is the fast way, we don't care if a normal is repeated in model->vertex */
-                M3D_LOG("Generating normals");
-                model->flags |= M3D_FLG_GENNORM;
-                model->numvertex <<= 1;
-                model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, model->numvertex * sizeof(m3dv_t));
-                if (!model->vertex) goto memerr;
-                memset(&model->vertex[n], 0, n * sizeof(m3dv_t));
-                for (i = 0; i < model->numface; i++)
-                    for (j = 0; j < 3; j++) {
-                        v0 = &model->vertex[model->face[i].vertex[j] + n];
-                        v0->x += norm[i].x;
-                        v0->y += norm[i].y;
-                        v0->z += norm[i].z;
-                    }
-                /* for each vertex, take the average of the temporary normals and use that */
-                for (i = 0, v0 = &model->vertex[n]; i < n; i++, v0++) {
-                    w = _m3d_rsq((v0->x * v0->x) + (v0->y * v0->y) + (v0->z * v0->z));
-                    v0->x *= w; v0->y *= w; v0->z *= w;
-                    v0->skinid = M3D_UNDEF;
-                }
-                M3D_FREE(norm);
+                M3D_LOG("Out of memory");
+                model->errcode = M3D_ERR_ALLOC;
+                return model;
             }
-#endif
-            if (model->numbone && model->bone && model->numskin && model->skin && model->numvertex && model->vertex) {
-#ifndef M3D_NOWEIGHTS
-                M3D_LOG("Generating weight cross-reference");
-                for (i = 0; i < model->numvertex; i++) {
-                    if (model->vertex[i].skinid < model->numskin) {
-                        sk = &model->skin[model->vertex[i].skinid];
-                        w = (M3D_FLOAT)0.0;
-                        for (j = 0; j < M3D_NUMBONE && sk->boneid[j] != M3D_UNDEF && sk->weight[j] >(M3D_FLOAT)0.0; j++)
-                            w += sk->weight[j];
-                        for (j = 0; j < M3D_NUMBONE && sk->boneid[j] != M3D_UNDEF && sk->weight[j] >(M3D_FLOAT)0.0; j++) {
-                            sk->weight[j] /= w;
-                            b = &model->bone[sk->boneid[j]];
-                            k = b->numweight++;
-                            b->weight = (m3dw_t*)M3D_REALLOC(b->weight, b->numweight * sizeof(m3da_t));
-                            if (!b->weight) goto memerr;
-                            b->weight[k].vertexid = i;
-                            b->weight[k].weight = sk->weight[j];
-                        }
-                    }
-                }
-#endif
-#ifndef M3D_NOANIMATION
-                M3D_LOG("Calculating bone transformation matrices");
-                for (i = 0; i < model->numbone; i++) {
-                    b = &model->bone[i];
-                    if (model->bone[i].parent == M3D_UNDEF) {
-                        _m3d_mat((M3D_FLOAT*)&b->mat4, &model->vertex[b->pos], &model->vertex[b->ori]);
-                    }
-                    else {
-                        _m3d_mat((M3D_FLOAT*)&r, &model->vertex[b->pos], &model->vertex[b->ori]);
-                        _m3d_mul((M3D_FLOAT*)&b->mat4, (M3D_FLOAT*)&model->bone[b->parent].mat4, (M3D_FLOAT*)&r);
-                    }
-                }
-                for (i = 0; i < model->numbone; i++)
-                    _m3d_inv((M3D_FLOAT*)&model->bone[i].mat4);
-#endif
+        }
+
+        /* parse chunks */
+        while (chunk < end && !M3D_CHUNKMAGIC(chunk, 'O', 'M', 'D', '3')) {
+            data = chunk;
+            len = ((m3dchunk_t*)chunk)->length;
+            chunk += len;
+            if (len < sizeof(m3dchunk_t) || chunk >= end) {
+                M3D_LOG("Invalid chunk size");
+                break;
             }
+            i = _m3d_parsechunk(model, data, readfilecb, freecb);
+            if (i == M3D_CHUNK_ABORT) return model;
+            if (i == M3D_CHUNK_STOP) break;
+        }
 #ifdef M3D_PROFILING
-            gettimeofday(&tv0, NULL);
-            tvd.tv_sec = tv0.tv_sec - tv1.tv_sec;
-            tvd.tv_usec = tv0.tv_usec - tv1.tv_usec;
-            if (tvd.tv_usec < 0) { tvd.tv_sec--; tvd.tv_usec += 1000000L; }
-            printf("  Post-process    %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
+        gettimeofday(&tv1, NULL);
+        tvd.tv_sec = tv1.tv_sec - tv0.tv_sec;
+        tvd.tv_usec = tv1.tv_usec - tv0.tv_usec;
+        if (tvd.tv_usec < 0) { tvd.tv_sec--; tvd.tv_usec += 1000000L; }
+        printf("  Parsing chunks  %ld.%06ld sec\n", tvd.tv_sec, tvd.tv_usec);
 #endif
+        return _m3d_postprocess(model);
+    }
+
+    /**
+     * Chunk by chunk variant of m3d_load, for callers that decompress the model body as a stream.
+     * m3d_loadhead takes the HEAD chunk, which the model points into for its whole lifetime. Every following
+     * chunk then goes to m3d_loadchunk up to the end chunk, and m3d_loadend post-processes the model. Chunks
+     * m3d_loadchunk answers M3D_CHUNK_KEEP for must be kept as long as the model, all others can be dropped.
+     * Inlined textures are resolved once every chunk was seen, as ASET chunks usually come after the materials.
+     */
+    m3d_t* m3d_loadhead(unsigned char* head, m3d_t* mtllib)
+    {
+        m3d_t* model;
+
+        if (!head || !M3D_CHUNKMAGIC(head, 'H', 'E', 'A', 'D') || ((m3dchunk_t*)head)->length < sizeof(m3dhdr_t)) return NULL;
+        model = (m3d_t*)M3D_MALLOC(sizeof(m3d_t));
+        if (!model) {
+            M3D_LOG("Out of memory");
+            return NULL;
+        }
+        memset(model, 0, sizeof(m3d_t));
+        if (mtllib) {
+            model->nummaterial = mtllib->nummaterial;
+            model->material = mtllib->material;
+            model->numtexture = mtllib->numtexture;
+            model->texture = mtllib->texture;
+            model->flags |= M3D_FLG_MTLLIB;
+        }
+        model->raw = (m3dhdr_t*)head;
+        if (!_m3d_parsehead(model)) {
+            M3D_FREE(model);
+            return NULL;
         }
         return model;
     }
 
+    int m3d_loadchunk(m3d_t* model, unsigned char* chunk, m3dread_t readfilecb, m3dfree_t freecb)
+    {
+        if (!model || !chunk || ((m3dchunk_t*)chunk)->length < sizeof(m3dchunk_t)) {
+            M3D_LOG("Invalid chunk size");
+            return M3D_CHUNK_STOP;
+        }
+        if (!_m3d_getinlined(model, chunk)) {
+            M3D_LOG("Out of memory");
+            model->errcode = M3D_ERR_ALLOC;
+            return M3D_CHUNK_ABORT;
+        }
+        return _m3d_parsechunk(model, chunk, readfilecb, freecb);
+    }
+
+    m3d_t* m3d_loadend(m3d_t* model)
+    {
+        unsigned int i, j, missing = 0;
+
+        if (!model) return NULL;
+        /* textures whose inlined asset came after their material */
+        for (i = 0; i < model->numtexture; i++) {
+            if (model->texture[i].d) continue;
+            for (j = 0; j < model->numinlined; j++)
+                if (model->inlined[j].name && !strcmp(model->texture[i].name, model->inlined[j].name)) {
+                    _m3d_decodetx(model, i, model->inlined[j].data, model->inlined[j].length);
+                    break;
+                }
+            if (!model->texture[i].d) missing++;
+        }
+        if (!missing && model->errcode == M3D_ERR_UNKIMG) model->errcode = M3D_SUCCESS;
+        return _m3d_postprocess(model);
+    }
+
     /**
      * Calculates skeletons for animation frames, returns a working copy (should be freed after use)
      */
@@ -4314,118 +4471,146 @@ extern "C" {
     }
 
 #ifndef M3D_NOANIMATION
+    /* resolve a pose vertex index, indices past the model's vertices refer to the interpolation buffer */
+    static m3dv_t* _m3d_posevertex(const m3d_t* model, m3dv_t* interp, M3D_INDEX idx)
+    {
+        return idx < model->numvertex ? &model->vertex[idx] : &interp[idx - model->numvertex];
+    }
+
     /**
-     * Returns interpolated animation-pose, a working copy (should be freed after use)
+     * Reentrant animation-pose, the model is only read so several poses can be evaluated concurrently.
+     * The caller provides pose (numbone), frame (numbone) and interp (M3D_POSEINTERP(model)) buffers, nothing is allocated.
+     * Interpolated bones get pos / ori indices past numvertex, which refer to interp[index - numvertex].
+     * Returns pose, or NULL if the model has no skeleton.
      */
-    m3db_t* m3d_pose(m3d_t* model, M3D_INDEX actionid, uint32_t msec)
+    m3db_t* m3d_pose_r(const m3d_t* model, M3D_INDEX actionid, uint32_t msec, m3db_t* pose, m3dtr_t* frame, m3dv_t* interp)
     {
         unsigned int i, j, l;
-        M3D_FLOAT r[16], t, c, d, s;
-        m3db_t* ret;
+        M3D_FLOAT r[16], t, a, c, d, s;
         m3dv_t* v, * p, * f;
-        m3dtr_t* tmp;
-        m3dfr_t* fr;
+        const m3dfr_t* fr;
+        const m3da_t* action;
 
-        if (!model || !model->numbone || !model->bone) {
-            model->errcode = M3D_ERR_UNKFRAME;
-            return NULL;
-        }
-        ret = (m3db_t*)M3D_MALLOC(model->numbone * sizeof(m3db_t));
-        if (!ret) {
-            model->errcode = M3D_ERR_ALLOC;
+        if (!model || !model->numbone || !model->bone || !pose || !frame || !interp)
             return NULL;
-        }
-        memcpy(ret, model->bone, model->numbone * sizeof(m3db_t));
-        for (i = 0; i < model->numbone; i++)
-            _m3d_inv((M3D_FLOAT*)&ret[i].mat4);
-        if (!model->action || actionid >= model->numaction) {
-            model->errcode = M3D_ERR_UNKFRAME;
-            return ret;
-        }
-        msec %= model->action[actionid].durationmsec;
-        model->errcode = M3D_SUCCESS;
-        fr = &model->action[actionid].frame[0];
-        for (j = l = 0; j < model->action[actionid].numframe && model->action[actionid].frame[j].msec <= msec; j++) {
-            fr = &model->action[actionid].frame[j];
+        memcpy(pose, model->bone, model->numbone * sizeof(m3db_t));
+        if (!model->action || actionid >= model->numaction || !model->action[actionid].numframe) {
+            /* bind pose, m3d_load stores the inverse of the bone matrices */
+            for (i = 0; i < model->numbone; i++)
+                _m3d_inv((M3D_FLOAT*)&pose[i].mat4);
+            return pose;
+        }
+        action = &model->action[actionid];
+        msec = action->durationmsec ? msec % action->durationmsec : 0;
+        fr = &action->frame[0];
+        for (j = l = 0; j < action->numframe && action->frame[j].msec <= msec; j++) {
+            fr = &action->frame[j];
             l = fr->msec;
             for (i = 0; i < fr->numtransform; i++) {
-                ret[fr->transform[i].boneid].pos = fr->transform[i].pos;
-                ret[fr->transform[i].boneid].ori = fr->transform[i].ori;
+                pose[fr->transform[i].boneid].pos = fr->transform[i].pos;
+                pose[fr->transform[i].boneid].ori = fr->transform[i].ori;
             }
         }
         if (l != msec) {
-            model->vertex = (m3dv_t*)M3D_REALLOC(model->vertex, (model->numvertex + 2 * model->numbone) * sizeof(m3dv_t));
-            if (!model->vertex) {
-                free(ret);
-                model->errcode = M3D_ERR_ALLOC;
-                return NULL;
+            for (i = 0; i < model->numbone; i++) {
+                frame[i].pos = pose[i].pos;
+                frame[i].ori = pose[i].ori;
             }
-            tmp = (m3dtr_t*)M3D_MALLOC(model->numbone * sizeof(m3dtr_t));
-            if (tmp) {
-                for (i = 0; i < model->numbone; i++) {
-                    tmp[i].pos = ret[i].pos;
-                    tmp[i].ori = ret[i].ori;
-                }
-                fr = &model->action[actionid].frame[j % model->action[actionid].numframe];
-                t = l >= fr->msec ? (M3D_FLOAT)1.0 : (M3D_FLOAT)(msec - l) / (M3D_FLOAT)(fr->msec - l);
-                for (i = 0; i < fr->numtransform; i++) {
-                    tmp[fr->transform[i].boneid].pos = fr->transform[i].pos;
-                    tmp[fr->transform[i].boneid].ori = fr->transform[i].ori;
+            fr = &action->frame[j % action->numframe];
+            t = l >= fr->msec ? (M3D_FLOAT)1.0 : (M3D_FLOAT)(msec - l) / (M3D_FLOAT)(fr->msec - l);
+            for (i = 0; i < fr->numtransform; i++) {
+                frame[fr->transform[i].boneid].pos = fr->transform[i].pos;
+                frame[fr->transform[i].boneid].ori = fr->transform[i].ori;
+            }
+            for (i = 0, j = 0; i < model->numbone; i++) {
+                /* interpolation of position */
+                if (pose[i].pos != frame[i].pos) {
+                    p = &model->vertex[pose[i].pos];
+                    f = &model->vertex[frame[i].pos];
+                    v = &interp[j];
+                    v->x = p->x + t * (f->x - p->x);
+                    v->y = p->y + t * (f->y - p->y);
+                    v->z = p->z + t * (f->z - p->z);
+                    pose[i].pos = model->numvertex + j++;
                 }
-                for (i = 0, j = model->numvertex; i < model->numbone; i++) {
-                    /* interpolation of position */
-                    if (ret[i].pos != tmp[i].pos) {
-                        p = &model->vertex[ret[i].pos];
-                        f = &model->vertex[tmp[i].pos];
-                        v = &model->vertex[j];
-                        v->x = p->x + t * (f->x - p->x);
-                        v->y = p->y + t * (f->y - p->y);
-                        v->z = p->z + t * (f->z - p->z);
-                        ret[i].pos = j++;
-                    }
-                    /* interpolation of orientation */
-                    if (ret[i].ori != tmp[i].ori) {
-                        p = &model->vertex[ret[i].ori];
-                        f = &model->vertex[tmp[i].ori];
-                        v = &model->vertex[j];
-                        d = p->w * f->w + p->x * f->x + p->y * f->y + p->z * f->z;
-                        if (d < 0) { d = -d; s = (M3D_FLOAT)-1.0; }
-                        else s = (M3D_FLOAT)1.0;
+                /* interpolation of orientation */
+                if (pose[i].ori != frame[i].ori) {
+                    p = &model->vertex[pose[i].ori];
+                    f = &model->vertex[frame[i].ori];
+                    v = &interp[j];
+                    d = p->w * f->w + p->x * f->x + p->y * f->y + p->z * f->z;
+                    if (d < 0) { d = -d; s = (M3D_FLOAT)-1.0; }
+                    else s = (M3D_FLOAT)1.0;
 #if 0
-                        /* don't use SLERP, requires two more variables, libm linkage and it is slow (but nice) */
-                        a = (M3D_FLOAT)1.0 - t; b = t;
-                        if (d < (M3D_FLOAT)0.999999) { c = acosf(d); b = 1 / sinf(c); a = sinf(a * c) * b; b *= sinf(t * c) * s; }
-                        v->x = p->x * a + f->x * b;
-                        v->y = p->y * a + f->y * b;
-                        v->z = p->z * a + f->z * b;
-                        v->w = p->w * a + f->w * b;
+                    /* don't use SLERP, requires two more variables, libm linkage and it is slow (but nice) */
+                    a = (M3D_FLOAT)1.0 - t; b = t;
+                    if (d < (M3D_FLOAT)0.999999) { c = acosf(d); b = 1 / sinf(c); a = sinf(a * c) * b; b *= sinf(t * c) * s; }
+                    v->x = p->x * a + f->x * b;
+                    v->y = p->y * a + f->y * b;
+                    v->z = p->z * a + f->z * b;
+                    v->w = p->w * a + f->w * b;
 #else
-                        /* approximated NLERP, original approximation by Arseny Kapoulkine, heavily optimized by me */
-                        c = t - (M3D_FLOAT)0.5; t += t * c * (t - (M3D_FLOAT)1.0) * (((M3D_FLOAT)1.0904 + d * ((M3D_FLOAT)-3.2452 +
-                            d * ((M3D_FLOAT)3.55645 - d * (M3D_FLOAT)1.43519))) * c * c + ((M3D_FLOAT)0.848013 + d *
-                                ((M3D_FLOAT)-1.06021 + d * (M3D_FLOAT)0.215638)));
-                        v->x = p->x + t * (s * f->x - p->x);
-                        v->y = p->y + t * (s * f->y - p->y);
-                        v->z = p->z + t * (s * f->z - p->z);
-                        v->w = p->w + t * (s * f->w - p->w);
-                        d = _m3d_rsq(v->w * v->w + v->x * v->x + v->y * v->y + v->z * v->z);
-                        v->x *= d; v->y *= d; v->z *= d; v->w *= d;
+                    /* approximated NLERP, original approximation by Arseny Kapoulkine, heavily optimized by me.
+                     * the corrected factor goes to a, so the next bones still blend with t */
+                    c = t - (M3D_FLOAT)0.5; a = t + t * c * (t - (M3D_FLOAT)1.0) * (((M3D_FLOAT)1.0904 + d * ((M3D_FLOAT)-3.2452 +
+                        d * ((M3D_FLOAT)3.55645 - d * (M3D_FLOAT)1.43519))) * c * c + ((M3D_FLOAT)0.848013 + d *
+                            ((M3D_FLOAT)-1.06021 + d * (M3D_FLOAT)0.215638)));
+                    v->x = p->x + a * (s * f->x - p->x);
+                    v->y = p->y + a * (s * f->y - p->y);
+                    v->z = p->z + a * (s * f->z - p->z);
+                    v->w = p->w + a * (s * f->w - p->w);
+                    d = _m3d_rsq(v->w * v->w + v->x * v->x + v->y * v->y + v->z * v->z);
+                    v->x *= d; v->y *= d; v->z *= d; v->w *= d;
 #endif
-                        ret[i].ori = j++;
-                    }
+                    pose[i].ori = model->numvertex + j++;
                 }
-                M3D_FREE(tmp);
             }
         }
         for (i = 0; i < model->numbone; i++) {
-            if (ret[i].parent == M3D_UNDEF) {
-                _m3d_mat((M3D_FLOAT*)&ret[i].mat4, &model->vertex[ret[i].pos], &model->vertex[ret[i].ori]);
+            p = _m3d_posevertex(model, interp, pose[i].pos);
+            f = _m3d_posevertex(model, interp, pose[i].ori);
+            if (pose[i].parent == M3D_UNDEF) {
+                _m3d_mat((M3D_FLOAT*)&pose[i].mat4, p, f);
             }
             else {
-                _m3d_mat((M3D_FLOAT*)&r, &model->vertex[ret[i].pos], &model->vertex[ret[i].ori]);
-                _m3d_mul((M3D_FLOAT*)&ret[i].mat4, (M3D_FLOAT*)&ret[ret[i].parent].mat4, (M3D_FLOAT*)&r);
+                _m3d_mat((M3D_FLOAT*)&r, p, f);
+                _m3d_mul((M3D_FLOAT*)&pose[i].mat4, (M3D_FLOAT*)&pose[pose[i].parent].mat4, (M3D_FLOAT*)&r);
             }
         }
+        return pose;
+    }
+
+    /**
+     * Returns interpolated animation-pose, a working copy (should be freed after use)
+     */
+    m3db_t* m3d_pose(m3d_t* model, M3D_INDEX actionid, uint32_t msec)
+    {
+        m3db_t* ret;
+        m3dtr_t* frame;
+        m3dv_t* vertex;
+
+        if (!model || !model->numbone || !model->bone) {
+            if (model) model->errcode = M3D_ERR_UNKFRAME;
+            return NULL;
+        }
+        /* interpolated bones point past numvertex, keep them in model->vertex so callers can still look them up */
+        vertex = (m3dv_t*)M3D_REALLOC(model->vertex, (model->numvertex + M3D_POSEINTERP(model)) * sizeof(m3dv_t));
+        if (!vertex) {
+            model->errcode = M3D_ERR_ALLOC;
+            return NULL;
+        }
+        model->vertex = vertex;
+        ret = (m3db_t*)M3D_MALLOC(model->numbone * sizeof(m3db_t));
+        frame = (m3dtr_t*)M3D_MALLOC(model->numbone * sizeof(m3dtr_t));
+        if (!ret || !frame) {
+            if (ret) M3D_FREE(ret);
+            if (frame) M3D_FREE(frame);
+            model->errcode = M3D_ERR_ALLOC;
+            return NULL;
+        }
+        m3d_pose_r(model, actionid, msec, ret, frame, model->vertex + model->numvertex);
+        model->errcode = !model->action || actionid >= model->numaction ? M3D_ERR_UNKFRAME : M3D_SUCCESS;
+        M3D_FREE(frame);
         return ret;
     }
 
@@ -6611,7 +6796,18 @@ namespace M3D {
         }
         std::vector<m3db_t> getActionPose(int aidx, unsigned int msec) {
             m3db_t* pose = m3d_pose(this->model, (unsigned int)aidx, (unsigned int)msec);
-            return std::vector<m3db_t>(pose, pose + this->model->numbone);
+            if (!pose) return std::vector<m3db_t>();
+            std::vector<m3db_t> ret(pose, pose + this->model->numbone);
+            M3D_FREE(pose);
+            return ret;
+        }
+        /* allocation-free once the buffers have grown to the model's size, the model is left untouched */
+        bool getActionPose(int aidx, unsigned int msec, std::vector<m3db_t>& pose, std::vector<m3dtr_t>& frame,
+            std::vector<m3dv_t>& interp) const {
+            pose.resize(this->model->numbone);
+            frame.resize(this->model->numbone);
+            interp.resize(M3D_POSEINTERP(this->model));
+            return m3d_pose_r(this->model, (unsigned int)aidx, (unsigned int)msec, pose.data(), frame.data(), interp.data()) != nullptr;
         }
         std::vector<m3di_t> getInlinedAssets() {
             return this->model->inlined ? std::vector<m3di_t>(this->model->inlined,
@@ -6692,6 +6888,8 @@ namespace M3D {
         std::vector<m3dtr_t> getActionFrameTransforms(int aidx, int fidx);
         std::vector<m3dtr_t> getActionFrame(int aidx, int fidx, std::vector<m3dtr_t> skeleton);
         std::vector<m3db_t> getActionPose(int aidx, unsigned int msec);
+        bool getActionPose(int aidx, unsigned int msec, std::vector<m3db_t>& pose, std::vector<m3dtr_t>& frame,
+            std::vector<m3dv_t>& interp) const;
         std::vector<m3di_t> getInlinedAssets();
         std::vector<std::unique_ptr<m3dchunk_t>> getExtras();
         std::vector<unsigned char> Save(int quality, int flags);